@@ -27,6 +27,7 @@ misrepresented as being the original software.
 #include "Bone.h"
 #include "Node.h"
 #include "Scene.h"
+#include "Skeleton.h"
 #include "StringConverter.h"
 #include "Util.h"
 #include "pugixml.hpp"
@@ -87,6 +88,10 @@ void AnimationKeyFrame::SetPose(PBone bone) {
     m.Decompose(position_, rotation_, scale_);
 }
 
+bool AnimationTrack::HasKeyFrames() const {
+    return !keyFrames_.empty() || !compressed_.IsEmpty();
+}
+
 void AnimationTrack::GetKeyFrameIndex(float time, size_t& index) const {
     if (time < 0)
         time = 0;
@@ -103,6 +108,36 @@ void AnimationTrack::GetKeyFrameIndex(float time, size_t& index) const {
         ++index;
 }
 
+void AnimationTrack::Sample(float time, float length, bool looped,
+                            size_t& index, Vector3& position,
+                            Quaternion& rotation, Vector3& scale) const {
+    if (keyFrames_.empty()) {
+        compressed_.Sample(time, looped, position, rotation, scale);
+        return;
+    }
+    GetKeyFrameIndex(time, index);
+    const AnimationKeyFrame& keyFrame = keyFrames_[index];
+    size_t nextIndex = index + 1;
+    if (nextIndex >= keyFrames_.size()) {
+        if (!looped) {
+            // No interpolation
+            position = keyFrame.position_;
+            rotation = keyFrame.rotation_;
+            scale = keyFrame.scale_;
+            return;
+        }
+        nextIndex = 0;
+    }
+    const AnimationKeyFrame& nextKeyFrame = keyFrames_[nextIndex];
+    auto timeInterval = nextKeyFrame.time_ - keyFrame.time_;
+    if (timeInterval < 0.0f)
+        timeInterval += length;
+    auto t = timeInterval > 0 ? (time - keyFrame.time_) / timeInterval : 1;
+    position = keyFrame.position_.Lerp(nextKeyFrame.position_, t);
+    rotation = keyFrame.rotation_.Slerp(nextKeyFrame.rotation_, t);
+    scale = keyFrame.scale_.Lerp(nextKeyFrame.scale_, t);
+}
+
 void AnimationTrack::Save(pugi::xml_node& node) {
     pugi::xml_node child = node.append_child("Track");
     child.append_attribute("nodeName") = nodeName_.c_str();
@@ -112,6 +147,8 @@ void AnimationTrack::Save(pugi::xml_node& node) {
         for (auto& obj : keyFrames_)
             obj.Save(childFrames);
     }
+    if (keyFrames_.empty() && !compressed_.IsEmpty())
+        compressed_.Save(child);
 }
 
 void AnimationTrack::Load(const pugi::xml_node& node) {
@@ -129,6 +166,24 @@ void AnimationTrack::Load(const pugi::xml_node& node) {
         }
         ResolveKeyFrameGaps();
     }
+    pugi::xml_node childCompressed = node.child("Compressed");
+    if (childCompressed)
+        compressed_.Load(childCompressed);
+}
+
+void AnimationTrack::Compress(float length,
+                              const AnimationCompression& settings) {
+    if (keyFrames_.empty())
+        return;
+    compressed_.Compress(keyFrames_, channelMask_, length, settings);
+    std::vector<AnimationKeyFrame>().swap(keyFrames_);
+}
+
+size_t AnimationTrack::GetSize() const {
+    auto size = keyFrames_.size() * sizeof(AnimationKeyFrame);
+    if (keyFrames_.empty() && !compressed_.IsEmpty())
+        size = compressed_.GetSize();
+    return size;
 }
 
 void AnimationTrack::ResolveKeyFrameGaps() {
@@ -186,9 +241,10 @@ void AnimationTrack::ResolveScaleGap(Vector3& scale, int frame) {
 }
 
 void AnimationTrack::ResolveFor(PBone bone) {
-    node_ = bone;
     for (auto& kf : keyFrames_)
         kf.SetPose(bone);
+    if (keyFrames_.empty() && !compressed_.IsEmpty())
+        compressed_.SetPose(bone->GetPose());
 }
 
 Animation::Animation(const std::string& name) : Object(name), length_(0) {}
@@ -210,12 +266,36 @@ void Animation::ResolveFor(PSceneNode node) {
     }
 }
 
+PAnimation Animation::GetResolvedFor(PSkeleton skeleton) {
+    auto it = resolved_.begin();
+    while (it != resolved_.end()) {
+        auto animation = it->animation_.lock();
+        auto obj = it->skeleton_.lock();
+        if (!animation || !obj)
+            it = resolved_.erase(it);
+        else if (obj == skeleton)
+            return animation;
+        else
+            ++it;
+    }
+    auto clone = Clone();
+    for (auto& track : clone->tracks_) {
+        auto bone = skeleton->GetBone(track.nodeName_);
+        if (bone)
+            track.ResolveFor(bone);
+    }
+    resolved_.push_back(Resolved{skeleton, clone});
+    return clone;
+}
+
 void Animation::SetLength(float length) {
     length_ = std::max<float>(length, 0);
+    resolved_.clear();
 }
 
 void Animation::SetTracks(const std::vector<AnimationTrack>& tracks) {
     tracks_ = tracks;
+    resolved_.clear();
 }
 
 void Animation::Save(pugi::xml_node& node) {
@@ -231,6 +311,7 @@ void Animation::Save(pugi::xml_node& node) {
 
 void Animation::Load(const pugi::xml_node& node) {
     tracks_.clear();
+    resolved_.clear();
     length_ = node.attribute("length").as_float();
 
     pugi::xml_node childTracks = node.child("Tracks");
@@ -247,6 +328,20 @@ void Animation::Load(const pugi::xml_node& node) {
 
 void Animation::AddTrack(const AnimationTrack& track) {
     tracks_.push_back(track);
+    resolved_.clear();
+}
+
+void Animation::Compress(const AnimationCompression& settings) {
+    for (auto& track : tracks_)
+        track.Compress(length_, settings);
+    resolved_.clear();
+}
+
+size_t Animation::GetSize() const {
+    size_t size = 0;
+    for (auto& track : tracks_)
+        size += track.GetSize();
+    return size;
 }
 
 void Animation::SaveAnimations(pugi::xml_node& node) {
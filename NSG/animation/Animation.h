@@ -24,6 +24,7 @@ misrepresented as being the original software.
 -------------------------------------------------------------------------------
 */
 #pragma once
+#include "AnimationCompression.h"
 #include "Object.h"
 #include "StrongFactory.h"
 #include "Types.h"
@@ -44,13 +45,20 @@ struct AnimationKeyFrame {
 
 struct AnimationTrack {
     std::string nodeName_;
-    PWeakNode node_; // not set till the animation is resolved (see
-                     // Animation::ResolveFor)
+    PWeakNode node_; // used when there is no bone with nodeName_
     AnimationChannelMask channelMask_;
     std::vector<AnimationKeyFrame> keyFrames_;
+    AnimationCompressedTrack compressed_; // used when keyFrames_ is empty
+    bool HasKeyFrames() const;
     void GetKeyFrameIndex(float time, size_t& index) const;
+    // Interpolated key frame at time. The index is the cursor of the caller.
+    void Sample(float time, float length, bool looped, size_t& index,
+                Vector3& position, Quaternion& rotation,
+                Vector3& scale) const;
     void Save(pugi::xml_node& node);
     void Load(const pugi::xml_node& node);
+    void Compress(float length, const AnimationCompression& settings);
+    size_t GetSize() const; // bytes of the key frames
     void ResolveFor(PBone bone);
     void ResolveKeyFrameGaps();
     void ResolvePositionGap(Vector3& position, int frame);
@@ -66,6 +74,9 @@ public:
     ~Animation();
     PAnimation Clone() const;
     void ResolveFor(PSceneNode node);
+    // Read-only copy shared by every armature of the skeleton, with the key
+    // frames relative to the pose of its bones (resolved once)
+    PAnimation GetResolvedFor(PSkeleton skeleton);
     const std::string& GetName() const { return name_; }
     void SetLength(float length);
     float GetLength() const { return length_; }
@@ -74,10 +85,19 @@ public:
     void Save(pugi::xml_node& node);
     void Load(const pugi::xml_node& node) override;
     void AddTrack(const AnimationTrack& track);
+    // Replaces the key frames of the tracks with their compressed streams
+    void
+    Compress(const AnimationCompression& settings = AnimationCompression());
+    size_t GetSize() const; // bytes of the key frames
     static void SaveAnimations(pugi::xml_node& node);
 
 private:
     float length_;
     std::vector<AnimationTrack> tracks_;
+    struct Resolved {
+        PWeakSkeleton skeleton_;
+        PWeakAnimation animation_;
+    };
+    std::vector<Resolved> resolved_;
 };
 }
\ No newline at end of file
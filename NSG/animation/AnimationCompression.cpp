@@ -0,0 +1,392 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "AnimationCompression.h"
+#include "Animation.h"
+#include "Check.h"
+#include "Maths.h"
+#include "Quaternion.h"
+#include "b64/decode.h"
+#include "b64/encode.h"
+#include "pugixml.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace NSG {
+static const float TIME_STEPS = 65535.f;
+static const float VALUE_STEPS = 65535.f;
+static const float ROTATION_STEPS = 32767.f;
+static const float SQRT2 = 1.41421356f;
+
+AnimationCompression::AnimationCompression()
+    : positionError_(0.001f), rotationError_(0.001f), scaleError_(0.001f) {}
+
+static uint16_t Quantize(float value, float steps) {
+    return (uint16_t)std::floor(Clamp(value, 0.f, 1.f) * steps + 0.5f);
+}
+
+static Vector3 Interpolate(const Vector3& a, const Vector3& b, float t) {
+    return a.Lerp(b, t);
+}
+
+static Quaternion Interpolate(const Quaternion& a, const Quaternion& b,
+                              float t) {
+    return a.Slerp(b, t);
+}
+
+static float Error(const Vector3& a, const Vector3& b) {
+    return a.Distance(b);
+}
+
+static float Error(const Quaternion& a, const Quaternion& b) {
+    return a.Angle(b);
+}
+
+// The keys between first and last can be interpolated
+template <typename T>
+static bool Fits(const std::vector<float>& times, const std::vector<T>& values,
+                 size_t first, size_t last, float maxError) {
+    auto interval = times[last] - times[first];
+    for (auto i = first + 1; i < last; i++) {
+        auto t = interval > 0 ? (times[i] - times[first]) / interval : 1;
+        auto value = Interpolate(values[first], values[last], t);
+        if (Error(value, values[i]) > maxError)
+            return false;
+    }
+    return true;
+}
+
+// Indexes of the keys to keep: the first one of a constant channel or the
+// ends of the longest segments that interpolate the removed keys
+template <typename T>
+static std::vector<size_t> ReduceKeys(const std::vector<float>& times,
+                                      const std::vector<T>& values,
+                                      float maxError) {
+    std::vector<size_t> keys{0};
+    auto n = values.size();
+    auto constant = true;
+    for (size_t i = 1; i < n && constant; i++)
+        constant = Error(values[0], values[i]) <= maxError;
+    if (constant)
+        return keys;
+    size_t first = 0;
+    for (size_t last = 2; last < n; last++) {
+        if (!Fits(times, values, first, last, maxError)) {
+            first = last - 1;
+            keys.push_back(first);
+        }
+    }
+    keys.push_back(n - 1);
+    return keys;
+}
+
+static void SetTimes(AnimationCompressedChannel& channel,
+                     const std::vector<float>& times,
+                     const std::vector<size_t>& keys, float length) {
+    channel.times_.clear();
+    if (keys.size() > 1)
+        for (auto key : keys)
+            channel.times_.push_back(
+                Quantize(length > 0 ? times[key] / length : 0, TIME_STEPS));
+}
+
+static void SetValues(AnimationCompressedChannel& channel,
+                      const std::vector<Vector3>& values,
+                      const std::vector<size_t>& keys) {
+    auto min = values[keys[0]];
+    auto max = min;
+    for (auto key : keys) {
+        for (int i = 0; i < 3; i++) {
+            min[i] = std::min(min[i], values[key][i]);
+            max[i] = std::max(max[i], values[key][i]);
+        }
+    }
+    channel.min_ = min;
+    channel.extent_ = max - min;
+    channel.values_.clear();
+    for (auto key : keys) {
+        for (int i = 0; i < 3; i++) {
+            auto extent = channel.extent_[i];
+            auto value = extent > 0 ? (values[key][i] - min[i]) / extent : 0;
+            channel.values_.push_back(Quantize(value, VALUE_STEPS));
+        }
+    }
+}
+
+// Smallest three: the largest component is dropped (made positive, since q
+// and -q are the same rotation) and the other ones are in
+// [-1/sqrt(2), 1/sqrt(2)]. The index of the dropped component goes in the
+// top bits of the first two values.
+static void SetValues(AnimationCompressedChannel& channel,
+                      const std::vector<Quaternion>& values,
+                      const std::vector<size_t>& keys) {
+    channel.min_ = Vector3::Zero;
+    channel.extent_ = Vector3::Zero;
+    channel.values_.clear();
+    for (auto key : keys) {
+        auto q = values[key].Normalize();
+        float c[4] = {q.x, q.y, q.z, q.w};
+        int largest = 0;
+        for (int i = 1; i < 4; i++)
+            if (std::abs(c[i]) > std::abs(c[largest]))
+                largest = i;
+        auto sign = c[largest] < 0 ? -1.f : 1.f;
+        uint16_t v[3];
+        for (int i = 0, j = 0; i < 4; i++)
+            if (i != largest)
+                v[j++] = Quantize((sign * c[i] * SQRT2 + 1) * 0.5f,
+                                  ROTATION_STEPS);
+        v[0] |= (largest >> 1) << 15;
+        v[1] |= (largest & 1) << 15;
+        channel.values_.insert(channel.values_.end(), v, v + 3);
+    }
+}
+
+static Vector3 DecodeVector(const AnimationCompressedChannel& channel,
+                            size_t key) {
+    auto values = &channel.values_[3 * key];
+    Vector3 v;
+    for (int i = 0; i < 3; i++)
+        v[i] = channel.min_[i] +
+               values[i] * (1 / VALUE_STEPS) * channel.extent_[i];
+    return v;
+}
+
+static Quaternion DecodeRotation(const AnimationCompressedChannel& channel,
+                                 size_t key) {
+    auto values = &channel.values_[3 * key];
+    int largest = ((values[0] >> 15) << 1) | (values[1] >> 15);
+    float c[4];
+    float sum = 0;
+    for (int i = 0, j = 0; i < 4; i++) {
+        if (i == largest)
+            continue;
+        auto value = (values[j++] & 0x7FFF) * (2 / ROTATION_STEPS) - 1;
+        c[i] = value * (1 / SQRT2);
+        sum += c[i] * c[i];
+    }
+    c[largest] = std::sqrt(std::max(0.f, 1 - sum));
+    return Quaternion(c[3], c[0], c[1], c[2]);
+}
+
+// Keys around time (in time steps) and the interpolation factor between them
+static float FindKeys(const AnimationCompressedChannel& channel, float time,
+                      bool looped, size_t& index, size_t& next) {
+    auto& times = channel.times_;
+    index = next = 0;
+    if (times.empty())
+        return 0;
+    auto it = std::upper_bound(
+        times.begin(), times.end(), time,
+        [](float value, uint16_t key) { return value < key; });
+    index = it == times.begin() ? 0 : it - times.begin() - 1;
+    next = index + 1;
+    if (next >= times.size()) {
+        if (!looped) {
+            next = index;
+            return 0;
+        }
+        next = 0;
+    }
+    auto interval = (float)times[next] - times[index];
+    if (interval < 0)
+        interval += TIME_STEPS;
+    return interval > 0 ? (time - times[index]) / interval : 1;
+}
+
+static Vector3 SampleVector(const AnimationCompressedChannel& channel,
+                            float time, bool looped) {
+    size_t index, next;
+    auto t = FindKeys(channel, time, looped, index, next);
+    auto value = DecodeVector(channel, index);
+    if (index == next)
+        return value;
+    return value.Lerp(DecodeVector(channel, next), t);
+}
+
+static Quaternion SampleRotation(const AnimationCompressedChannel& channel,
+                                 float time, bool looped) {
+    size_t index, next;
+    auto t = FindKeys(channel, time, looped, index, next);
+    auto value = DecodeRotation(channel, index);
+    if (index == next)
+        return value;
+    return value.Slerp(DecodeRotation(channel, next), t);
+}
+
+size_t AnimationCompressedChannel::GetSize() const {
+    return sizeof(min_) + sizeof(extent_) +
+           sizeof(uint16_t) * (times_.size() + values_.size());
+}
+
+AnimationCompressedTrack::AnimationCompressedTrack()
+    : length_(0), posed_(false) {}
+
+void AnimationCompressedTrack::Compress(
+    const std::vector<AnimationKeyFrame>& keyFrames, AnimationChannelMask mask,
+    float length, const AnimationCompression& settings) {
+    CHECK_CONDITION(!keyFrames.empty());
+    length_ = length;
+    settings_ = settings;
+    posed_ = false;
+    std::vector<float> times;
+    std::vector<Vector3> positions;
+    std::vector<Quaternion> rotations;
+    std::vector<Vector3> scales;
+    for (auto& keyFrame : keyFrames) {
+        times.push_back(keyFrame.time_);
+        positions.push_back(keyFrame.position_);
+        rotations.push_back(keyFrame.rotation_);
+        scales.push_back(keyFrame.scale_);
+    }
+    const auto ANY = std::numeric_limits<float>::max();
+    auto keys = ReduceKeys(
+        times, positions,
+        mask & (int)AnimationChannel::POSITION ? settings.positionError_ : ANY);
+    SetTimes(position_, times, keys, length);
+    SetValues(position_, positions, keys);
+    keys = ReduceKeys(
+        times, rotations,
+        mask & (int)AnimationChannel::ROTATION ? settings.rotationError_ : ANY);
+    SetTimes(rotation_, times, keys, length);
+    SetValues(rotation_, rotations, keys);
+    keys = ReduceKeys(
+        times, scales,
+        mask & (int)AnimationChannel::SCALE ? settings.scaleError_ : ANY);
+    SetTimes(scale_, times, keys, length);
+    SetValues(scale_, scales, keys);
+}
+
+void AnimationCompressedTrack::SetPose(const Matrix4& pose) {
+    pose_ = pose;
+    posed_ = true;
+}
+
+void AnimationCompressedTrack::Sample(float time, bool looped,
+                                      Vector3& position, Quaternion& rotation,
+                                      Vector3& scale) const {
+    time = length_ > 0 ? std::max(time, 0.f) * TIME_STEPS / length_ : 0;
+    position = SampleVector(position_, time, looped);
+    rotation = SampleRotation(rotation_, time, looped);
+    scale = SampleVector(scale_, time, looped);
+    if (posed_) {
+        // same as AnimationKeyFrame::SetPose
+        Matrix4 m = pose_ * Matrix4(position, rotation, scale);
+        m.Decompose(position, rotation, scale);
+    }
+}
+
+size_t AnimationCompressedTrack::GetSize() const {
+    return sizeof(length_) + position_.GetSize() + rotation_.GetSize() +
+           scale_.GetSize();
+}
+
+template <typename T>
+static void Write(std::string& data, const T* values, size_t n) {
+    if (n)
+        data.append((const char*)values, n * sizeof(T));
+}
+
+template <typename T>
+static void Read(const std::string& data, size_t& offset, T* values,
+                 size_t n) {
+    auto bytes = n * sizeof(T);
+    CHECK_CONDITION(offset + bytes <= data.size());
+    if (n)
+        memcpy(values, &data[offset], bytes);
+    offset += bytes;
+}
+
+// [times][values][min_][extent_][times_][values_]
+static void Write(std::string& data,
+                  const AnimationCompressedChannel& channel) {
+    uint32_t sizes[] = {(uint32_t)channel.times_.size(),
+                        (uint32_t)channel.values_.size()};
+    Write(data, sizes, 2);
+    Write(data, &channel.min_.x, 3);
+    Write(data, &channel.extent_.x, 3);
+    Write(data, channel.times_.data(), channel.times_.size());
+    Write(data, channel.values_.data(), channel.values_.size());
+}
+
+static void Read(const std::string& data, size_t& offset,
+                 AnimationCompressedChannel& channel) {
+    uint32_t sizes[2];
+    Read(data, offset, sizes, 2);
+    CHECK_CONDITION(sizes[1] == 3 * std::max<uint32_t>(sizes[0], 1));
+    Read(data, offset, &channel.min_.x, 3);
+    Read(data, offset, &channel.extent_.x, 3);
+    channel.times_.resize(sizes[0]);
+    channel.values_.resize(sizes[1]);
+    Read(data, offset, channel.times_.data(), sizes[0]);
+    Read(data, offset, channel.values_.data(), sizes[1]);
+}
+
+void AnimationCompressedTrack::Save(pugi::xml_node& node) const {
+    pugi::xml_node child = node.append_child("Compressed");
+    child.append_attribute("length").set_value(length_);
+    child.append_attribute("positionError").set_value(settings_.positionError_);
+    child.append_attribute("rotationError").set_value(settings_.rotationError_);
+    child.append_attribute("scaleError").set_value(settings_.scaleError_);
+
+    std::string data;
+    Write(data, position_);
+    Write(data, rotation_);
+    Write(data, scale_);
+
+    base64::base64_encodestate state;
+    base64::base64_init_encodestate(&state);
+    std::string encoded(2 * data.size() + 4, 0);
+    CHECK_ASSERT(data.size() < std::numeric_limits<int>::max());
+    auto numchars = base64::base64_encode_block(&data[0], (int)data.size(),
+                                                &encoded[0], &state);
+    numchars += base64::base64_encode_blockend(&encoded[0] + numchars, &state);
+    encoded.resize(numchars);
+    child.append_child(pugi::node_pcdata).set_value(encoded.c_str());
+}
+
+void AnimationCompressedTrack::Load(const pugi::xml_node& node) {
+    length_ = node.attribute("length").as_float();
+    settings_.positionError_ = node.attribute("positionError").as_float();
+    settings_.rotationError_ = node.attribute("rotationError").as_float();
+    settings_.scaleError_ = node.attribute("scaleError").as_float();
+
+    std::string encoded = node.child_value();
+    std::string data(encoded.size(), 0);
+    base64::base64_decodestate state;
+    base64::base64_init_decodestate(&state);
+    CHECK_ASSERT(encoded.size() < std::numeric_limits<int>::max());
+    auto length = base64::base64_decode_block(
+        encoded.c_str(), (int)encoded.size(), &data[0], &state);
+    data.resize(length);
+
+    size_t offset = 0;
+    Read(data, offset, position_);
+    Read(data, offset, rotation_);
+    Read(data, offset, scale_);
+}
+}
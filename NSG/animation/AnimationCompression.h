@@ -0,0 +1,83 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Matrix4.h"
+#include "Types.h"
+#include "Vector3.h"
+#include <cstdint>
+#include <vector>
+
+namespace NSG {
+struct AnimationKeyFrame;
+struct Quaternion;
+
+// Maximum error allowed to the key reduction of Animation::Compress
+struct AnimationCompression {
+    float positionError_;
+    float rotationError_; // radians
+    float scaleError_;
+    AnimationCompression();
+};
+
+// Keys of one channel. The time of each key is stored in 16 bits of the clip
+// length and its value in three 16 bits components: fixed point inside the
+// bounds (min_, min_ + extent_) for positions and scales, or the smallest
+// three components for rotations. A constant channel has no times and a
+// single value.
+struct AnimationCompressedChannel {
+    Vector3 min_;
+    Vector3 extent_;
+    std::vector<uint16_t> times_;
+    std::vector<uint16_t> values_;
+    size_t GetSize() const;
+};
+
+// Track reduced and quantized by Animation::Compress.
+// It is sampled from the compressed stream, without expanding the keys. The
+// bone pose of a resolved track is applied to the samples, so the keys are
+// never compressed twice.
+struct AnimationCompressedTrack {
+    float length_;
+    AnimationCompression settings_;
+    AnimationCompressedChannel position_;
+    AnimationCompressedChannel rotation_;
+    AnimationCompressedChannel scale_;
+    Matrix4 pose_;
+    bool posed_;
+    AnimationCompressedTrack();
+    bool IsEmpty() const { return position_.values_.empty(); }
+    // Channels out of the mask keep only their first value
+    void Compress(const std::vector<AnimationKeyFrame>& keyFrames,
+                  AnimationChannelMask mask, float length,
+                  const AnimationCompression& settings);
+    void SetPose(const Matrix4& pose);
+    void Sample(float time, bool looped, Vector3& position,
+                Quaternion& rotation, Vector3& scale) const;
+    size_t GetSize() const; // in bytes
+    void Save(pugi::xml_node& node) const;
+    void Load(const pugi::xml_node& node);
+};
+}
@@ -49,11 +49,16 @@ AnimationController::GetAnimationControl(const std::string& name) {
     if (it == animations_.end()) {
         auto animation = Animation::Get(name);
         CHECK_CONDITION(animation->IsReady());
-        auto clone = animation->Clone();
         auto sceneNode = sceneNode_.lock();
-        clone->ResolveFor(sceneNode);
+        auto skeleton = sceneNode->GetSkeleton();
+        if (skeleton)
+            animation = animation->GetResolvedFor(skeleton);
+        else {
+            animation = animation->Clone();
+            animation->ResolveFor(sceneNode);
+        }
         PAnimationControl control = std::make_shared<AnimationControl>();
-        control->animation_ = clone;
+        control->animation_ = animation;
         animations_[name] = control;
         return control;
     }
@@ -79,6 +84,7 @@ void AnimationController::Play(const std::string& name, bool looped,
     auto animationState = GetAnimationState(control->animation_);
     if (!animationState) {
         animationState = std::make_shared<AnimationState>(control->animation_);
+        animationState->Bind(sceneNode_.lock(), pose_);
         animationStates_.push_back(animationState);
     }
     animationState->SetLooped(looped);
@@ -177,7 +183,11 @@ void AnimationController::Update(float deltaTime) {
         ++it;
     }
 
+    if (animationStates_.empty())
+        return;
+    pose_.Read();
     for (auto& state : animationStates_)
-        state->Update();
+        state->Update(pose_);
+    pose_.Write();
 }
 }
@@ -24,6 +24,7 @@ misrepresented as being the original software.
 -------------------------------------------------------------------------------
 */
 #pragma once
+#include "AnimationState.h"
 #include "Types.h"
 #include <map>
 #include <vector>
@@ -65,6 +66,7 @@ private:
     Animations animations_;
     typedef std::vector<PAnimationState> AnimationStates;
     AnimationStates animationStates_;
+    AnimationPose pose_; // blended by the states
     PWeakSceneNode sceneNode_;
     SignalUpdate::PSlot slotUpdate_;
 };
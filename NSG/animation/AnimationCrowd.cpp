@@ -0,0 +1,143 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "AnimationCrowd.h"
+#include "Animation.h"
+#include "Check.h"
+#include "Scene.h"
+#include "SceneNode.h"
+#include "Skeleton.h"
+#include <algorithm>
+#include <cmath>
+
+namespace NSG {
+AnimationCrowd::AnimationCrowd(PScene scene, PSkeleton skeleton,
+                               float timeStep)
+    : skeleton_(skeleton), timeStep_(timeStep), time_(0), speed_(1) {
+    CHECK_CONDITION(skeleton_ && timeStep_ > 0);
+    slotUpdate_ = scene->SigUpdate()->Connect(
+        [this](float deltaTime) { Update(deltaTime); });
+}
+
+AnimationCrowd::~AnimationCrowd() {
+    for (auto& member : members_) {
+        auto armature = member.armature_.lock();
+        if (armature)
+            armature->SetSharedPose(nullptr);
+    }
+}
+
+void AnimationCrowd::Play(PSceneNode armature, const std::string& name,
+                          float timeOffset) {
+    CHECK_CONDITION(armature->GetSkeleton() == skeleton_);
+    auto animation = Animation::Get(name);
+    CHECK_CONDITION(animation && animation->IsReady());
+    Remove(armature);
+    members_.push_back(
+        Member{armature, animation->GetResolvedFor(skeleton_), timeOffset});
+}
+
+void AnimationCrowd::Remove(PSceneNode armature) {
+    auto it = std::find_if(members_.begin(), members_.end(),
+                           [&](const Member& member) {
+                               return member.armature_.lock() == armature;
+                           });
+    if (it != members_.end()) {
+        armature->SetSharedPose(nullptr);
+        members_.erase(it);
+    }
+}
+
+AnimationCrowd::Pose& AnimationCrowd::GetPose(PAnimation animation,
+                                              unsigned step) {
+    auto key = PoseKey(animation.get(), step);
+    auto it = poses_.find(key);
+    if (it != poses_.end())
+        return it->second;
+
+    Pose pose;
+    if (freePoses_.empty()) {
+        pose.armature_ =
+            std::make_shared<SceneNode>(skeleton_->GetName() + "_pose");
+        pose.armature_->SetSkeleton(skeleton_);
+    } else {
+        pose = std::move(freePoses_.back());
+        freePoses_.pop_back();
+    }
+    if (!pose.state_ || pose.state_->GetAnimation() != animation) {
+        pose.state_ = std::make_shared<AnimationState>(animation);
+        pose.state_->Bind(pose.armature_, pose.pose_);
+        pose.state_->SetLooped(true);
+        pose.state_->SetWeight(1);
+    }
+    // the pose of a step does not change while it is used
+    pose.state_->SetTime(step * timeStep_);
+    pose.pose_.Read();
+    pose.state_->Update(pose.pose_);
+    pose.pose_.Write();
+    auto& obj = poses_[key];
+    obj = std::move(pose);
+    return obj;
+}
+
+void AnimationCrowd::Update(float deltaTime) {
+    time_ += speed_ * deltaTime;
+    for (auto& obj : poses_)
+        obj.second.used_ = false;
+
+    auto it = members_.begin();
+    while (it != members_.end()) {
+        auto armature = it->armature_.lock();
+        if (!armature) {
+            it = members_.erase(it);
+            continue;
+        }
+        auto length = it->animation_->GetLength();
+        unsigned step = 0;
+        if (length > 0) {
+            auto time = std::fmod(time_ + it->timeOffset_, length);
+            if (time < 0)
+                time += length;
+            auto steps = std::max(1u, (unsigned)std::ceil(length / timeStep_));
+            step = (unsigned)(time / timeStep_) % steps;
+        }
+        auto& pose = GetPose(it->animation_, step);
+        pose.used_ = true;
+        armature->SetSharedPose(pose.armature_);
+        ++it;
+    }
+
+    // poses of past steps are reused for the next ones
+    auto poseIt = poses_.begin();
+    while (poseIt != poses_.end()) {
+        if (poseIt->second.used_)
+            ++poseIt;
+        else {
+            freePoses_.push_back(std::move(poseIt->second));
+            poseIt = poses_.erase(poseIt);
+        }
+    }
+}
+}
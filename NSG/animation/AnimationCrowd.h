@@ -0,0 +1,77 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "AnimationState.h"
+#include "Types.h"
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace NSG {
+/// Shared poses for crowds playing looped animations.
+/// The time of each character is quantized to steps of timeStep and every
+/// animation and step is evaluated once, in a pose armature with the skeleton
+/// of the crowd. The armatures of the characters are skinned with its palette
+/// (see SceneNode::SetSharedPose): their own bones are not animated and the
+/// characters sharing a pose are drawn instanced.
+class AnimationCrowd {
+public:
+    AnimationCrowd(PScene scene, PSkeleton skeleton,
+                   float timeStep = 1.f / 30.f);
+    ~AnimationCrowd();
+    // armature has to use the skeleton of the crowd
+    void Play(PSceneNode armature, const std::string& name,
+              float timeOffset = 0);
+    void Remove(PSceneNode armature);
+    void SetSpeed(float speed) { speed_ = speed; }
+    // Poses in use after the last update
+    size_t GetPosesCount() const { return poses_.size(); }
+
+private:
+    void Update(float deltaTime);
+    struct Member {
+        PWeakSceneNode armature_;
+        PAnimation animation_; // resolved for the skeleton
+        float timeOffset_;
+    };
+    struct Pose {
+        PSceneNode armature_;
+        PAnimationState state_;
+        AnimationPose pose_;
+        bool used_;
+    };
+    typedef std::pair<const Animation*, unsigned> PoseKey; // animation, step
+    Pose& GetPose(PAnimation animation, unsigned step);
+    PSkeleton skeleton_;
+    float timeStep_;
+    float time_;
+    float speed_;
+    std::vector<Member> members_;
+    std::map<PoseKey, Pose> poses_;
+    std::vector<Pose> freePoses_;
+    SignalUpdate::PSlot slotUpdate_;
+};
+}
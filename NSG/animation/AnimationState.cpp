@@ -27,23 +27,61 @@ misrepresented as being the original software.
 #include "Bone.h"
 #include "Log.h"
 #include "Maths.h"
+#include "SceneNode.h"
 #include "Util.h"
 
 namespace NSG {
-AnimationStateTrack::AnimationStateTrack(const AnimationTrack& base)
-    : currentKeyFrame_(0) {
-    *static_cast<AnimationTrack*>(this) = base;
+size_t AnimationPose::GetIndex(PNode node) {
+    for (size_t i = 0; i < nodes_.size(); i++)
+        if (nodes_[i].lock() == node)
+            return i;
+    nodes_.push_back(node);
+    positions_.push_back(node->GetPosition());
+    rotations_.push_back(node->GetOrientation());
+    scales_.push_back(node->GetScale());
+    channels_.push_back((int)AnimationChannel::NONE);
+    return nodes_.size() - 1;
 }
 
-AnimationState::AnimationState(PAnimation animation)
-    : animation_(animation), timePosition_(0), looped_(false), weight_(0) {
-    auto tracks = animation_->GetTracks();
-    for (auto& track : tracks)
-        tracks_.push_back(track);
+void AnimationPose::Read() {
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        auto node = nodes_[i].lock();
+        if (node) {
+            positions_[i] = node->GetPosition();
+            rotations_[i] = node->GetOrientation();
+            scales_[i] = node->GetScale();
+        }
+        channels_[i] = (int)AnimationChannel::NONE;
+    }
 }
 
+void AnimationPose::Write() {
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        if (channels_[i].none())
+            continue;
+        auto node = nodes_[i].lock();
+        if (node)
+            node->SetTransform(positions_[i], rotations_[i], scales_[i]);
+    }
+}
+
+AnimationState::AnimationState(PAnimation animation)
+    : animation_(animation), timePosition_(0),
+      cursors_(animation->GetTracks().size(), 0),
+      slots_(animation->GetTracks().size(), -1), looped_(false), weight_(0) {}
+
 AnimationState::~AnimationState() {}
 
+void AnimationState::Bind(PSceneNode sceneNode, AnimationPose& pose) {
+    auto& tracks = animation_->GetTracks();
+    for (size_t i = 0; i < tracks.size(); i++) {
+        auto& track = tracks[i];
+        PNode node = sceneNode->GetChild<Bone>(track.nodeName_, true);
+        if (!node)
+            node = track.node_.lock();
+        slots_[i] = node ? (int)pose.GetIndex(node) : -1;
+    }
+}
 void AnimationState::AddTime(float delta) {
     auto length = animation_->GetLength();
 
@@ -82,59 +120,32 @@ void AnimationState::SetWeight(float weight) {
     weight_ = Clamp(weight, 0.f, 1.f);
 }
 
-void AnimationState::Update() {
-    for (auto& track : tracks_) {
-        if (Equals(weight_, 0))
-            continue;
-        Blend(track, weight_);
-    }
-}
-
-void AnimationState::Blend(AnimationStateTrack& track, float weight) {
-    size_t& frame = track.currentKeyFrame_;
-    track.GetKeyFrameIndex(timePosition_, frame);
-    const AnimationKeyFrame* keyFrame = &track.keyFrames_[frame];
-    auto bone = track.node_.lock();
-    if (!bone)
+void AnimationState::Update(AnimationPose& pose) {
+    if (Equals(weight_, 0))
         return;
-    size_t nextFrame = frame + 1;
-    bool interpolate = true;
-    if (nextFrame >= track.keyFrames_.size()) {
-        if (!looped_) {
-            nextFrame = frame;
-            interpolate = false;
-        } else
-            nextFrame = 0;
-    }
-    if (!interpolate) {
-        // No interpolation, blend between old transform & animation
-        if (track.channelMask_ & (int)AnimationChannel::POSITION)
-            bone->SetPosition(
-                bone->GetPosition().Lerp(keyFrame->position_, weight));
-        if (track.channelMask_ & (int)AnimationChannel::ROTATION)
-            bone->SetOrientation(
-                bone->GetOrientation().Slerp(keyFrame->rotation_, weight));
-        if (track.channelMask_ & (int)AnimationChannel::SCALE)
-            bone->SetScale(bone->GetScale().Lerp(keyFrame->scale_, weight));
-    } else {
-        const AnimationKeyFrame& nextKeyFrame = track.keyFrames_[nextFrame];
-        auto timeInterval = nextKeyFrame.time_ - keyFrame->time_;
-        if (timeInterval < 0.0f)
-            timeInterval += animation_->GetLength();
-        auto t = timeInterval > 0
-                     ? (timePosition_ - keyFrame->time_) / timeInterval
-                     : 1;
-
-        // Interpolation, blend between old transform & animation
-        if (track.channelMask_ & (int)AnimationChannel::POSITION)
-            bone->SetPosition(bone->GetPosition().Lerp(
-                keyFrame->position_.Lerp(nextKeyFrame.position_, t), weight));
-        if (track.channelMask_ & (int)AnimationChannel::ROTATION)
-            bone->SetOrientation(bone->GetOrientation().Slerp(
-                keyFrame->rotation_.Slerp(nextKeyFrame.rotation_, t), weight));
-        if (track.channelMask_ & (int)AnimationChannel::SCALE)
-            bone->SetScale(bone->GetScale().Lerp(
-                keyFrame->scale_.Lerp(nextKeyFrame.scale_, t), weight));
+    auto& tracks = animation_->GetTracks();
+    auto length = animation_->GetLength();
+    Vector3 position;
+    Quaternion rotation;
+    Vector3 scale;
+    for (size_t i = 0; i < tracks.size(); i++) {
+        auto slot = slots_[i];
+        auto& track = tracks[i];
+        if (slot < 0 || !track.HasKeyFrames())
+            continue;
+        track.Sample(timePosition_, length, looped_, cursors_[i], position,
+                     rotation, scale);
+        // blend between old transform & animation
+        auto mask = track.channelMask_;
+        if (mask & (int)AnimationChannel::POSITION)
+            pose.positions_[slot] =
+                pose.positions_[slot].Lerp(position, weight_);
+        if (mask & (int)AnimationChannel::ROTATION)
+            pose.rotations_[slot] =
+                pose.rotations_[slot].Slerp(rotation, weight_);
+        if (mask & (int)AnimationChannel::SCALE)
+            pose.scales_[slot] = pose.scales_[slot].Lerp(scale, weight_);
+        pose.channels_[slot] |= mask;
     }
 }
 
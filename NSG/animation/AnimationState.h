@@ -28,16 +28,27 @@ misrepresented as being the original software.
 #include "Types.h"
 
 namespace NSG {
-struct AnimationStateTrack : AnimationTrack {
-    size_t currentKeyFrame_;
-    AnimationStateTrack(const AnimationTrack& base);
+/// Local transforms of the nodes animated by a controller.
+/// The states blend into it and it is written to the nodes once per frame.
+struct AnimationPose {
+    std::vector<PWeakNode> nodes_;
+    std::vector<Vector3> positions_;
+    std::vector<Quaternion> rotations_;
+    std::vector<Vector3> scales_;
+    std::vector<AnimationChannelMask> channels_; // blended in this frame
+    size_t GetIndex(PNode node); // adds the node if not there
+    void Read();
+    void Write();
 };
 
+/// Playback of a shared animation: only its time and cursors
 class AnimationState {
 public:
     AnimationState(PAnimation animation);
     ~AnimationState();
-    void Update();
+    // Finds the node of each track in sceneNode (bones by name)
+    void Bind(PSceneNode sceneNode, AnimationPose& pose);
+    void Update(AnimationPose& pose);
     void SetTime(float time);
     float GetTime() const { return timePosition_; }
     float GetLength() const;
@@ -50,10 +61,10 @@ public:
     PAnimation GetAnimation() const { return animation_; }
 
 private:
-    void Blend(AnimationStateTrack& track, float weight);
     PAnimation animation_;
     float timePosition_;
-    std::vector<AnimationStateTrack> tracks_;
+    std::vector<size_t> cursors_; // current key frame of each track
+    std::vector<int> slots_; // pose index of each track (-1 if not found)
     bool looped_;
     float weight_; // Blending weight.
 };
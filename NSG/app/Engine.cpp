@@ -32,9 +32,12 @@ misrepresented as being the original software.
 #endif
 #include "Animation.h"
 #include "FileSystem.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
 #include "LoaderXML.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "Profiler.h"
 #include "Program.h"
 #include "Resource.h"
 #include "Shape.h"
@@ -51,19 +54,28 @@ misrepresented as being the original software.
 namespace NSG {
 AppConfiguration Engine::conf_;
 
-Engine::Engine() : Tick(conf_.fps_), deltaTime_(0) { Tick::Initialize(); }
+Engine::Engine()
+    : Tick(conf_.fps_), deltaTime_(0), jobSystem_(Task::JobSystem::Create()) {
+    Tick::Initialize();
+    PROFILE_THREAD("main");
+    // completions posted by the jobs run in the engine's thread
+    slotBeginFrame_ = Engine::SigBeginFrame()->Connect(
+        [this]() { jobSystem_->ProcessMainThreadJobs(); });
+}
 
 Engine::~Engine() {}
 
 void Engine::InitializeTicks() {}
 
 void Engine::BeginTicks() {
+    PROFILE_FRAME();
     auto mainWindow = Window::GetMainWindow();
     if (mainWindow)
         mainWindow->HandleEvents();
 }
 
 void Engine::DoTick(float delta) {
+    PROFILE_ZONE("Engine::DoTick");
     deltaTime_ = delta;
     Window::UpdateScenes(delta);
     Engine::SigUpdate()->Run(delta);
@@ -75,6 +87,8 @@ void Engine::EndTicks() {
 }
 
 void Engine::RenderFrame() {
+    PROFILE_ZONE("Engine::RenderFrame");
+    FrameArena::GetFrame().Reset();
     Engine::SigBeginFrame()->Run();
     Window::RenderWindows();
 }
@@ -30,6 +30,9 @@ misrepresented as being the original software.
 #include "Types.h"
 
 namespace NSG {
+namespace Task {
+class JobSystem;
+}
 class Engine : public Tick, public Singleton<Engine> {
 public:
     ~Engine();
@@ -48,6 +51,8 @@ private:
     void DoTick(float delta) override;
     void EndTicks() override;
     float deltaTime_; // Fixed time in seconds (1/AppConfiguration::fps_)
+    std::shared_ptr<Task::JobSystem> jobSystem_;
+    SignalEmpty::PSlot slotBeginFrame_;
     static AppConfiguration conf_;
     friend class Singleton<Engine>;
 };
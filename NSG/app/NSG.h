@@ -25,7 +25,9 @@ misrepresented as being the original software.
 */
 #pragma once
 #include "Animation.h"
+#include "AnimationCompression.h"
 #include "AnimationController.h"
+#include "AnimationCrowd.h"
 #include "AnimationState.h"
 #include "AppConfiguration.h"
 #include "Batch.h"
@@ -38,6 +40,7 @@ misrepresented as being the original software.
 #include "Check.h"
 #include "CircleMesh.h"
 #include "Color.h"
+#include "Cone.h"
 #include "CylinderMesh.h"
 #include "DebugRenderer.h"
 #include "EllipseMesh.h"
@@ -47,23 +50,32 @@ misrepresented as being the original software.
 #include "FollowCamera.h"
 #include "FontTTFAtlas.h"
 #include "FontXMLAtlas.h"
+#include "FrameArena.h"
 #include "FrameBuffer.h"
 #include "Frustum.h"
+#include "FrustumCulling.h"
 #include "GUI.h"
 #include "HTTPRequest.h"
 #include "ICollision.h"
 #include "IcoSphereMesh.h"
 #include "Image.h"
+#include "JobSystem.h"
 #include "Keys.h"
 #include "Light.h"
 #include "LoaderXML.h"
 #include "Log.h"
 #include "Main.h"
+#include "MappedFile.h"
 #include "Material.h"
 #include "Maths.h"
 #include "MemoryManager.h"
 #include "MemoryTest.h"
+#include "MeshBVH.h"
+#include "MeshFormat.h"
+#include "MeshOptimizer.h"
 #include "ModelMesh.h"
+#include "OcclusionBuffer.h"
+#include "Octree.h"
 #include "ParticleSystem.h"
 #include "Pass.h"
 #include "Path.h"
@@ -71,11 +83,13 @@ misrepresented as being the original software.
 #include "PlaneMesh.h"
 #include "PlayerControl.h"
 #include "PointOnSphere.h"
+#include "Profiler.h"
 #include "Program.h"
 #include "QuadMesh.h"
 #include "QueuedTask.h"
 #include "Ray.h"
 #include "RectangleMesh.h"
+#include "RenderQueue.h"
 #include "Renderer.h"
 #include "RenderingCapabilities.h"
 #include "RenderingContext.h"
@@ -91,14 +105,17 @@ misrepresented as being the original software.
 #include "SharedFromPointer.h"
 #include "SharedPointers.h"
 #include "Skeleton.h"
+#include "Sphere.h"
 #include "SphereMesh.h"
 #include "StringConverter.h"
 #include "TextMesh.h"
 #include "Texture2D.h"
 #include "TimedTask.h"
+#include "TransformHierarchy.h"
 #include "TriangleMesh.h"
 #include "Types.h"
 #include "Util.h"
+#include "VertexFormat.h"
 #include "Window.h"
 #include "imgui.h"
 #include "pugixml.hpp"
@@ -36,7 +36,7 @@ Object::Object(const std::string& name)
     : name_(name), isValid_(false), resourcesAllocated_(false),
       signalBeforeAllocating_(new SignalEmpty),
       signalAllocated_(new SignalEmpty), signalReleased_(new SignalEmpty),
-      disableInvalidation_(false) {
+      disableInvalidation_(false), nodeLoaded_(false), preparing_(false) {
     if (name_.empty())
         name_ = GetUniqueName("Object");
 
@@ -61,6 +61,7 @@ void Object::Invalidate() {
 void Object::SetLoader(PLoaderXMLNode nodeLoader) {
     if (nodeLoader_ != nodeLoader) {
         nodeLoader_ = nodeLoader;
+        nodeLoaded_ = false;
         Invalidate();
     }
 }
@@ -74,11 +75,15 @@ bool Object::IsReady() {
     return isValid_;
 }
 
+void Object::LoadNode() { nodeLoaded_ = nodeLoader_ && nodeLoader_->Load(); }
+
 void Object::TryReady() {
-    if (!isValid_) {
-        isValid_ = (!nodeLoader_ || nodeLoader_->Load()) && IsValid();
+    if (!isValid_ && !preparing_) {
+        isValid_ =
+            (nodeLoaded_ || !nodeLoader_ || nodeLoader_->Load()) && IsValid();
 
         if (isValid_) {
+            nodeLoaded_ = false;
             CHECK_ASSERT(!resourcesAllocated_);
             signalBeforeAllocating_->Run();
             LOGI("Begin: Allocating resources for %s", GetNameType().c_str());
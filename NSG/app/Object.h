@@ -46,6 +46,15 @@ public:
     SignalEmpty::PSignal SigAllocated() { return signalAllocated_; }
     SignalEmpty::PSignal SigReleased() { return signalReleased_; }
     void SetLoader(PLoaderXMLNode nodeLoader);
+    // Runs the node loader now. TryReady does not run it again until the
+    // object is ready.
+    void LoadNode();
+    // The node has been loaded by other means (see LoaderXML)
+    void SetNodeLoaded() { nodeLoaded_ = true; }
+    // Jobs are preparing the data of the object: it cannot be ready until
+    // they finish
+    void SetPreparing(bool preparing) { preparing_ = preparing; }
+    bool IsPreparing() const { return preparing_; }
     template <typename T, typename U>
     static std::vector<std::shared_ptr<T>> LoadAll(LoaderXML* loader,
                                                    const char* collectionType) {
@@ -81,5 +90,7 @@ private:
     SignalEmpty::PSignal signalAllocated_;
     SignalEmpty::PSignal signalReleased_;
     bool disableInvalidation_;
+    bool nodeLoaded_;
+    bool preparing_;
 };
 }
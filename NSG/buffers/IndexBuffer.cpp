@@ -27,19 +27,23 @@ misrepresented as being the original software.
 #include "IndexBuffer.h"
 #include "Check.h"
 #include "Log.h"
+#include "RenderingCapabilities.h"
 #include "RenderingContext.h"
 #include "Types.h"
 #include <algorithm>
+#include <limits>
 #include <sstream>
 #include <vector>
 
 namespace NSG {
 static Indexes emptyIndexes;
 IndexBuffer::IndexBuffer(GLenum usage)
-    : Buffer(GL_ELEMENT_ARRAY_BUFFER, usage), indexes_(emptyIndexes) {}
+    : Buffer(GL_ELEMENT_ARRAY_BUFFER, usage), indexes_(emptyIndexes),
+      indexType_(GL_UNSIGNED_SHORT) {}
 
 IndexBuffer::IndexBuffer(const Indexes& indexes, GLenum usage)
-    : Buffer(GL_ELEMENT_ARRAY_BUFFER, usage), indexes_(indexes) {}
+    : Buffer(GL_ELEMENT_ARRAY_BUFFER, usage), indexes_(indexes),
+      indexType_(GL_UNSIGNED_SHORT) {}
 
 IndexBuffer::~IndexBuffer() {}
 
@@ -49,10 +53,8 @@ void IndexBuffer::AllocateResources() {
     CHECK_ASSERT(ctx);
     Buffer::AllocateResources();
     ctx->SetIndexBuffer(this);
-    if (indexes_.size()) {
-        auto bytesNeeded = sizeof(IndexType) * indexes_.size();
-        glBufferData(type_, bytesNeeded, &indexes_[0], usage_);
-    }
+    if (indexes_.size())
+        Upload();
     // SetBufferSubData(0, bytesNeeded, &indexes_[0]);
     CHECK_GL_STATUS();
 }
@@ -66,13 +68,34 @@ void IndexBuffer::ReleaseResources() {
     }
 }
 
+bool IndexBuffer::Needs32Bits(const Indexes& indexes) {
+    return !indexes.empty() &&
+           *std::max_element(indexes.begin(), indexes.end()) >
+               std::numeric_limits<unsigned short>::max();
+}
+
+void IndexBuffer::Upload() {
+    if (!Needs32Bits(indexes_)) {
+        indexType_ = GL_UNSIGNED_SHORT;
+        shortIndexes_.assign(indexes_.begin(), indexes_.end());
+        auto bytesNeeded = sizeof(unsigned short) * shortIndexes_.size();
+        glBufferData(type_, bytesNeeded, &shortIndexes_[0], usage_);
+        if (usage_ == GL_STATIC_DRAW)
+            std::vector<unsigned short>().swap(shortIndexes_);
+    } else {
+        CHECK_CONDITION(RenderingCapabilities::GetPtr()->HasElementIndexUint());
+        indexType_ = GL_UNSIGNED_INT;
+        auto bytesNeeded = sizeof(IndexType) * indexes_.size();
+        glBufferData(type_, bytesNeeded, &indexes_[0], usage_);
+    }
+}
+
 void IndexBuffer::Unbind() { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); }
 
 void IndexBuffer::UpdateData() {
     if (IsReady()) {
         CHECK_GL_STATUS();
-        auto bytesNeeded = sizeof(IndexType) * indexes_.size();
-        glBufferData(type_, bytesNeeded, &indexes_[0], usage_);
+        Upload();
         CHECK_GL_STATUS();
     }
 }
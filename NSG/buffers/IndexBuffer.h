@@ -26,6 +26,7 @@ misrepresented as being the original software.
 #pragma once
 
 #include "Buffer.h"
+#include <vector>
 
 namespace NSG {
 class IndexBuffer : public Buffer {
@@ -36,10 +37,16 @@ public:
     void UpdateData();
     void SetData(GLsizeiptr size, const GLvoid* data);
     static void Unbind();
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, depends on the highest index
+    GLenum GetIndexType() const { return indexType_; }
+    static bool Needs32Bits(const Indexes& indexes);
 
 private:
     void AllocateResources() override;
     void ReleaseResources() override;
+    void Upload();
     const Indexes& indexes_;
+    GLenum indexType_;
+    std::vector<unsigned short> shortIndexes_; // scratch for 16 bits uploads
 };
 }
@@ -26,6 +26,8 @@ misrepresented as being the original software.
 #include "InstanceBuffer.h"
 #include "Batch.h"
 #include "Check.h"
+#include "FrameArena.h"
+#include "ParticleSystem.h"
 #include "RenderingCapabilities.h"
 #include "RenderingContext.h"
 #include "SceneNode.h"
@@ -49,18 +51,18 @@ void InstanceBuffer::ReleaseResources() {
 
 void InstanceBuffer::Unbind() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
 
-void InstanceBuffer::UpdateData(const std::vector<InstanceData>& data) {
+void InstanceBuffer::UpdateData(const InstanceData* data, size_t count) {
     auto ctx = RenderingContext::GetSharedPtr();
     ctx->SetVertexBuffer(this);
-    if (maxInstances_ >= data.size()) {
-        auto size = data.size() * sizeof(InstanceData);
+    if (maxInstances_ >= count) {
+        auto size = count * sizeof(InstanceData);
         auto bufferSize = maxInstances_ * sizeof(InstanceData);
         CHECK_ASSERT(size <= bufferSize);
-        SetBufferSubData(0, data.size() * sizeof(InstanceData), &(data[0]));
+        SetBufferSubData(0, size, data);
     } else {
-        maxInstances_ = data.size();
+        maxInstances_ = count;
         auto bufferSize = maxInstances_ * sizeof(InstanceData);
-        glBufferData(type_, bufferSize, &(data[0]), usage_);
+        glBufferData(type_, bufferSize, data, usage_);
     }
 }
 
@@ -69,10 +71,10 @@ void InstanceBuffer::UpdateBatchBuffer(const Batch& batch) {
         CHECK_GL_STATUS();
         CHECK_ASSERT(RenderingCapabilities::GetPtr()->HasInstancedArrays());
 
-        std::vector<InstanceData> instancesData;
-        auto& nodes = batch.GetNodes();
-        instancesData.reserve(nodes.size());
-        for (auto& node : nodes) {
+        FrameArena::Scope frameScope;
+        FrameVector<InstanceData> instancesData;
+        instancesData.reserve(batch.GetNodesCount());
+        for (auto node : batch) {
             InstanceData data;
             const Matrix4& m = node->GetGlobalModelMatrix();
             // for the model matrix be careful in the shader as we are using
@@ -93,9 +95,19 @@ void InstanceBuffer::UpdateBatchBuffer(const Batch& batch) {
             instancesData.push_back(data);
         }
 
-        UpdateData(instancesData);
+        UpdateData(instancesData.data(), instancesData.size());
 
         CHECK_GL_STATUS();
     }
 }
+
+void InstanceBuffer::UpdateParticlesBuffer(const ParticleSystem& ps) {
+    if (IsReady()) {
+        CHECK_GL_STATUS();
+        CHECK_ASSERT(RenderingCapabilities::GetPtr()->HasInstancedArrays());
+        ps.FillInstancesData(particlesData_);
+        UpdateData(particlesData_.data(), particlesData_.size());
+        CHECK_GL_STATUS();
+    }
+}
 }
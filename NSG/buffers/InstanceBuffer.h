@@ -36,11 +36,13 @@ public:
     ~InstanceBuffer();
     static void Unbind();
     void UpdateBatchBuffer(const Batch& batch);
+    void UpdateParticlesBuffer(const ParticleSystem& ps);
 
 private:
     void AllocateResources() override;
     void ReleaseResources() override;
-    void UpdateData(const std::vector<InstanceData>& data);
+    void UpdateData(const InstanceData* data, size_t count);
     size_t maxInstances_;
+    std::vector<InstanceData> particlesData_;
 };
 }
@@ -29,6 +29,7 @@ misrepresented as being the original software.
 #include "InstanceBuffer.h"
 #include "Material.h"
 #include "Mesh.h"
+#include "Profiler.h"
 #include "Program.h"
 #include "RenderingContext.h"
 #include "VertexBuffer.h"
@@ -90,32 +91,33 @@ void VertexArrayObj::AllocateResources() {
     auto tangent_loc = program->GetAttTangentLoc();
     auto bones_id_loc = program->GetAttBonesIDLoc();
     auto bones_weight = program->GetAttBonesWeightLoc();
+    auto& format = vBuffer->GetFormat();
 
-    if (position_loc != -1)
+    if (position_loc != -1 && format.Has(AttributesLoc::POSITION))
         glEnableVertexAttribArray((int)AttributesLoc::POSITION);
 
-    if (normal_loc != -1)
+    if (normal_loc != -1 && format.Has(AttributesLoc::NORMAL))
         glEnableVertexAttribArray((int)AttributesLoc::NORMAL);
 
-    if (texcoord_loc0 != -1)
+    if (texcoord_loc0 != -1 && format.Has(AttributesLoc::TEXTURECOORD0))
         glEnableVertexAttribArray((int)AttributesLoc::TEXTURECOORD0);
 
-    if (texcoord_loc1 != -1)
+    if (texcoord_loc1 != -1 && format.Has(AttributesLoc::TEXTURECOORD1))
         glEnableVertexAttribArray((int)AttributesLoc::TEXTURECOORD1);
 
-    if (color_loc != -1)
+    if (color_loc != -1 && format.Has(AttributesLoc::COLOR))
         glEnableVertexAttribArray((int)AttributesLoc::COLOR);
 
-    if (tangent_loc != -1)
+    if (tangent_loc != -1 && format.Has(AttributesLoc::TANGENT))
         glEnableVertexAttribArray((int)AttributesLoc::TANGENT);
 
-    if (bones_id_loc != -1)
+    if (bones_id_loc != -1 && format.Has(AttributesLoc::BONES_ID))
         glEnableVertexAttribArray((int)AttributesLoc::BONES_ID);
 
-    if (bones_weight != -1)
+    if (bones_weight != -1 && format.Has(AttributesLoc::BONES_WEIGHT))
         glEnableVertexAttribArray((int)AttributesLoc::BONES_WEIGHT);
 
-    ctx->SetVertexAttrPointers();
+    ctx->SetVertexAttrPointers(format);
 
     ctx->SetIndexBuffer(iBuffer, true);
 
@@ -150,7 +152,10 @@ void VertexArrayObj::Use() {
     }
 }
 
-void VertexArrayObj::Bind() { glBindVertexArray(vao_); }
+void VertexArrayObj::Bind() {
+    glBindVertexArray(vao_);
+    PROFILE_COUNT(VAO_BINDS, 1);
+}
 
 void VertexArrayObj::Unbind() { glBindVertexArray(0); }
 
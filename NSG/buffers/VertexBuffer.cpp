@@ -36,6 +36,11 @@ VertexBuffer::VertexBuffer(GLenum usage)
 VertexBuffer::VertexBuffer(const VertexsData& vertexes, GLenum usage)
     : Buffer(GL_ARRAY_BUFFER, usage), vertexes_(vertexes) {}
 
+VertexBuffer::VertexBuffer(const VertexsData& vertexes,
+                           const VertexFormat& format, GLenum usage)
+    : Buffer(GL_ARRAY_BUFFER, usage), vertexes_(vertexes),
+      requestedFormat_(format) {}
+
 VertexBuffer::~VertexBuffer() {}
 
 void VertexBuffer::AllocateResources() {
@@ -44,11 +49,22 @@ void VertexBuffer::AllocateResources() {
     CHECK_ASSERT(ctx);
     Buffer::AllocateResources();
     ctx->SetVertexBuffer(this);
-    if (vertexes_.size()) {
+    format_ = requestedFormat_.Resolve();
+    if (vertexes_.size())
+        Upload();
+    CHECK_GL_STATUS();
+}
+
+void VertexBuffer::Upload() {
+    if (format_.IsFloat()) {
         auto bytesNeeded = vertexes_.size() * sizeof(VertexData);
         glBufferData(type_, bytesNeeded, &vertexes_[0], usage_);
+    } else {
+        format_.Pack(vertexes_, packed_);
+        glBufferData(type_, packed_.size(), &packed_[0], usage_);
+        if (usage_ == GL_STATIC_DRAW)
+            std::vector<char>().swap(packed_);
     }
-    CHECK_GL_STATUS();
 }
 
 void VertexBuffer::ReleaseResources() {
@@ -65,8 +81,7 @@ void VertexBuffer::Unbind() { glBindBuffer(GL_ARRAY_BUFFER, 0); }
 void VertexBuffer::UpdateData() {
     if (IsReady()) {
         CHECK_GL_STATUS();
-        auto bytesNeeded = vertexes_.size() * sizeof(VertexData);
-        glBufferData(type_, bytesNeeded, &vertexes_[0], usage_);
+        Upload();
         CHECK_GL_STATUS();
     }
 }
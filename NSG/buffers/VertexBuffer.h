@@ -27,20 +27,30 @@ misrepresented as being the original software.
 
 #include "Buffer.h"
 #include "VertexData.h"
+#include "VertexFormat.h"
+#include <vector>
 
 namespace NSG {
 class VertexBuffer : public Buffer {
 public:
     VertexBuffer(GLenum usage);
     VertexBuffer(const VertexsData& vertexes, GLenum usage);
+    VertexBuffer(const VertexsData& vertexes, const VertexFormat& format,
+                 GLenum usage);
     ~VertexBuffer();
     void UpdateData();
     static void Unbind();
     void SetData(GLsizeiptr size, const GLvoid* data);
+    // format really uploaded (once resolved with the context capabilities)
+    const VertexFormat& GetFormat() const { return format_; }
 
 private:
     void AllocateResources() override;
     void ReleaseResources() override;
+    void Upload();
     const VertexsData& vertexes_;
+    VertexFormat requestedFormat_;
+    VertexFormat format_;
+    std::vector<char> packed_; // scratch for non float formats
 };
 }
@@ -32,29 +32,36 @@ misrepresented as being the original software.
 #include "RenderingContext.h"
 #include "RigidBody.h"
 #include "SceneNode.h"
+#include <algorithm>
 
 namespace NSG {
-Batch::Batch() : material_(nullptr), mesh_(nullptr), allowInstancing_(true) {}
+Batch::Batch()
+    : material_(nullptr), mesh_(nullptr), nodes_(nullptr), nNodes_(0),
+      allowInstancing_(true) {}
 
-Batch::Batch(Material* material, Mesh* mesh)
-    : material_(material), mesh_(mesh), allowInstancing_(true) {
-    CHECK_ASSERT(material_ && mesh_);
+Batch::Batch(Material* material, Mesh* mesh, SceneNode* const* nodes,
+             size_t nNodes)
+    : material_(material), mesh_(mesh), nodes_(nodes), nNodes_(nNodes),
+      allowInstancing_(true) {
+    CHECK_ASSERT(material_ && mesh_ && nodes_ && nNodes_);
+    // skinned nodes are instanced when they share the pose of a crowd
+    auto first = *begin();
+    auto palette = first->GetPaletteNode();
+    for (auto node : *this)
+        allowInstancing_ &= node->GetPaletteNode() == palette;
+    if (palette)
+        allowInstancing_ &= first->GetArmature()->GetSharedPose() != nullptr;
 }
 
 Batch::~Batch() {}
 
 bool Batch::operator==(const Batch& obj) const {
     return material_ == obj.material_ && mesh_ == obj.mesh_ &&
-           nodes_ == obj.nodes_;
+           nNodes_ == obj.nNodes_ && std::equal(begin(), end(), obj.begin());
 }
 
 bool Batch::IsReady() { return material_->IsReady() && mesh_->IsReady(); }
 
-void Batch::Add(SceneNode* node) {
-    allowInstancing_ &= !node->GetArmature();
-    nodes_.push_back(node);
-}
-
 bool Batch::AllowInstancing() const {
     return RenderingCapabilities::GetPtr()->HasInstancedArrays() &&
            allowInstancing_ && mesh_->IsStatic();
@@ -63,7 +70,8 @@ bool Batch::AllowInstancing() const {
 void Batch::Clear() {
     material_ = nullptr;
     mesh_ = nullptr;
-    nodes_.clear();
+    nodes_ = nullptr;
+    nNodes_ = 0;
     allowInstancing_ = true;
 }
 }
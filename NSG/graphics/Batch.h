@@ -28,19 +28,21 @@ misrepresented as being the original software.
 #include "Types.h"
 
 namespace NSG {
+// Range of nodes sharing material and mesh. The nodes are not owned: they
+// live in the sorted array of the RenderQueue that generated the batch.
 class Batch {
 public:
     Batch();
-    Batch(Material* material, Mesh* mesh);
+    Batch(Material* material, Mesh* mesh, SceneNode* const* nodes,
+          size_t nNodes);
     ~Batch();
     bool operator==(const Batch& obj) const;
-    // Batch(const Batch&) = delete;
-    // Batch& operator = (const Batch&) = delete;
     bool IsReady();
-    void Add(SceneNode* node);
     Mesh* GetMesh() const { return mesh_; }
     Material* GetMaterial() const { return material_; }
-    const std::vector<SceneNode*>& GetNodes() const { return nodes_; }
+    SceneNode* const* begin() const { return nodes_; }
+    SceneNode* const* end() const { return nodes_ + nNodes_; }
+    size_t GetNodesCount() const { return nNodes_; }
     bool AllowInstancing() const;
     void Clear();
     bool IsEmpty() const { return !material_; }
@@ -49,7 +51,8 @@ public:
 private:
     Material* material_;
     Mesh* mesh_;
-    std::vector<SceneNode*> nodes_;
+    SceneNode* const* nodes_;
+    size_t nNodes_;
     bool allowInstancing_;
 };
 }
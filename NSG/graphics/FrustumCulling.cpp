@@ -0,0 +1,233 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "FrustumCulling.h"
+#include "Check.h"
+#include "Frustum.h"
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define NSG_CULLING_AVX
+#elif defined(__SSE__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NSG_CULLING_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NSG_CULLING_NEON
+#endif
+
+namespace NSG {
+void CullingBoxes::Add(const BoundingBox& box) {
+    minX_.push_back(box.min_.x);
+    minY_.push_back(box.min_.y);
+    minZ_.push_back(box.min_.z);
+    maxX_.push_back(box.max_.x);
+    maxY_.push_back(box.max_.y);
+    maxZ_.push_back(box.max_.z);
+}
+
+void CullingBoxes::Set(size_t index, const BoundingBox& box) {
+    CHECK_ASSERT(index < Size());
+    minX_[index] = box.min_.x;
+    minY_[index] = box.min_.y;
+    minZ_[index] = box.min_.z;
+    maxX_[index] = box.max_.x;
+    maxY_[index] = box.max_.y;
+    maxZ_[index] = box.max_.z;
+}
+
+BoundingBox CullingBoxes::Get(size_t index) const {
+    CHECK_ASSERT(index < Size());
+    return BoundingBox(Vector3(minX_[index], minY_[index], minZ_[index]),
+                       Vector3(maxX_[index], maxY_[index], maxZ_[index]));
+}
+
+void CullingBoxes::RemoveSwap(size_t index) {
+    CHECK_ASSERT(index < Size());
+    Set(index, Get(Size() - 1));
+    minX_.pop_back();
+    minY_.pop_back();
+    minZ_.pop_back();
+    maxX_.pop_back();
+    maxY_.pop_back();
+    maxZ_.pop_back();
+}
+
+void CullingBoxes::Clear() {
+    minX_.clear();
+    minY_.clear();
+    minZ_.clear();
+    maxX_.clear();
+    maxY_.clear();
+    maxZ_.clear();
+}
+
+// A box is outside when its corner furthest along the normal of a plane
+// (the "positive vertex") is behind it: then the eight corners are behind.
+// The coordinates of that corner are selected once per plane.
+struct CullingPlane {
+    float nx_, ny_, nz_, d_;
+    const float* x_;
+    const float* y_;
+    const float* z_;
+};
+
+static void GetCullingPlanes(const Frustum& frustum, const float* const* min,
+                             const float* const* max,
+                             CullingPlane planes[MAX_PLANES]) {
+    for (int p = 0; p < MAX_PLANES; p++) {
+        auto& normald = frustum.GetPlane((FrustumPlane)p).GetNormalD();
+        auto& plane = planes[p];
+        plane.nx_ = normald.x;
+        plane.ny_ = normald.y;
+        plane.nz_ = normald.z;
+        plane.d_ = normald.w;
+        plane.x_ = normald.x > 0 ? max[0] : min[0];
+        plane.y_ = normald.y > 0 ? max[1] : min[1];
+        plane.z_ = normald.z > 0 ? max[2] : min[2];
+    }
+}
+
+static inline bool IsVisible(const CullingPlane planes[MAX_PLANES],
+                             size_t i) {
+    for (int p = 0; p < MAX_PLANES; p++) {
+        auto& plane = planes[p];
+        if (plane.nx_ * plane.x_[i] + plane.ny_ * plane.y_[i] +
+                plane.nz_ * plane.z_[i] + plane.d_ <
+            0)
+            return false;
+    }
+    return true;
+}
+
+// Visibility mask of the boxes [i, i + LANES)
+#if defined(NSG_CULLING_AVX)
+static const size_t LANES = 8;
+static inline unsigned CullLanes(const CullingPlane planes[MAX_PLANES],
+                                 size_t i) {
+    auto zero = _mm256_setzero_ps();
+    auto outside = zero;
+    for (int p = 0; p < MAX_PLANES; p++) {
+        auto& plane = planes[p];
+        auto d = _mm256_add_ps(
+            _mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(plane.nx_),
+                              _mm256_loadu_ps(plane.x_ + i)),
+                _mm256_mul_ps(_mm256_set1_ps(plane.ny_),
+                              _mm256_loadu_ps(plane.y_ + i))),
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.nz_),
+                                        _mm256_loadu_ps(plane.z_ + i)),
+                          _mm256_set1_ps(plane.d_)));
+        outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+    }
+    return ~_mm256_movemask_ps(outside) & 0xff;
+}
+#elif defined(NSG_CULLING_SSE)
+static const size_t LANES = 4;
+static inline unsigned CullLanes(const CullingPlane planes[MAX_PLANES],
+                                 size_t i) {
+    auto zero = _mm_setzero_ps();
+    auto outside = zero;
+    for (int p = 0; p < MAX_PLANES; p++) {
+        auto& plane = planes[p];
+        auto d = _mm_add_ps(
+            _mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(plane.nx_), _mm_loadu_ps(plane.x_ + i)),
+                _mm_mul_ps(_mm_set1_ps(plane.ny_), _mm_loadu_ps(plane.y_ + i))),
+            _mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(plane.nz_), _mm_loadu_ps(plane.z_ + i)),
+                _mm_set1_ps(plane.d_)));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(d, zero));
+    }
+    return ~_mm_movemask_ps(outside) & 0xf;
+}
+#elif defined(NSG_CULLING_NEON)
+static const size_t LANES = 4;
+static inline unsigned CullLanes(const CullingPlane planes[MAX_PLANES],
+                                 size_t i) {
+    static const uint32_t laneBits[LANES] = {1, 2, 4, 8};
+    auto zero = vdupq_n_f32(0);
+    auto outside = vdupq_n_u32(0);
+    for (int p = 0; p < MAX_PLANES; p++) {
+        auto& plane = planes[p];
+        auto d = vaddq_f32(
+            vaddq_f32(vmulq_n_f32(vld1q_f32(plane.x_ + i), plane.nx_),
+                      vmulq_n_f32(vld1q_f32(plane.y_ + i), plane.ny_)),
+            vaddq_f32(vmulq_n_f32(vld1q_f32(plane.z_ + i), plane.nz_),
+                      vdupq_n_f32(plane.d_)));
+        outside = vorrq_u32(outside, vcltq_f32(d, zero));
+    }
+    auto bits = vandq_u32(outside, vld1q_u32(laneBits));
+    auto mask = vgetq_lane_u32(bits, 0) | vgetq_lane_u32(bits, 1) |
+                vgetq_lane_u32(bits, 2) | vgetq_lane_u32(bits, 3);
+    return ~mask & 0xf;
+}
+#endif
+
+void CullBoxesScalar(const Frustum& frustum, const CullingBoxes& boxes,
+                     size_t first, size_t count, uint32_t* visibility) {
+    CHECK_ASSERT(first + count <= boxes.Size());
+    if (!count)
+        return;
+    const float* min[] = {&boxes.minX_[0] + first, &boxes.minY_[0] + first,
+                          &boxes.minZ_[0] + first};
+    const float* max[] = {&boxes.maxX_[0] + first, &boxes.maxY_[0] + first,
+                          &boxes.maxZ_[0] + first};
+    CullingPlane planes[MAX_PLANES];
+    GetCullingPlanes(frustum, min, max, planes);
+    memset(visibility, 0, sizeof(uint32_t) * ((count + 31) / 32));
+    for (size_t i = 0; i < count; i++)
+        if (IsVisible(planes, i))
+            visibility[i / 32] |= 1u << (i % 32);
+}
+
+void CullBoxes(const Frustum& frustum, const CullingBoxes& boxes,
+               size_t first, size_t count, uint32_t* visibility) {
+#if defined(NSG_CULLING_AVX) || defined(NSG_CULLING_SSE) ||                    \
+    defined(NSG_CULLING_NEON)
+    CHECK_ASSERT(first + count <= boxes.Size());
+    if (!count)
+        return;
+    const float* min[] = {&boxes.minX_[0] + first, &boxes.minY_[0] + first,
+                          &boxes.minZ_[0] + first};
+    const float* max[] = {&boxes.maxX_[0] + first, &boxes.maxY_[0] + first,
+                          &boxes.maxZ_[0] + first};
+    CullingPlane planes[MAX_PLANES];
+    GetCullingPlanes(frustum, min, max, planes);
+    memset(visibility, 0, sizeof(uint32_t) * ((count + 31) / 32));
+    size_t i = 0;
+    // LANES divides 32: the lanes never straddle two words
+    for (; i + LANES <= count; i += LANES)
+        visibility[i / 32] |= CullLanes(planes, i) << (i % 32);
+    for (; i < count; i++)
+        if (IsVisible(planes, i))
+            visibility[i / 32] |= 1u << (i % 32);
+#else
+    CullBoxesScalar(frustum, boxes, first, count, visibility);
+#endif
+}
+}
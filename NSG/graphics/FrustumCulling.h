@@ -0,0 +1,60 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "BoundingBox.h"
+#include <cstdint>
+#include <vector>
+
+namespace NSG {
+class Frustum;
+// World bounding boxes as a structure of arrays, so the culling kernels can
+// test several boxes per iteration (see CullBoxes)
+class CullingBoxes {
+public:
+    size_t Size() const { return minX_.size(); }
+    void Add(const BoundingBox& box);
+    void Set(size_t index, const BoundingBox& box);
+    BoundingBox Get(size_t index) const;
+    void RemoveSwap(size_t index); // moves the last box to index
+    void Clear();
+
+private:
+    std::vector<float> minX_, minY_, minZ_;
+    std::vector<float> maxX_, maxY_, maxZ_;
+    friend void CullBoxes(const Frustum&, const CullingBoxes&, size_t, size_t,
+                          uint32_t*);
+    friend void CullBoxesScalar(const Frustum&, const CullingBoxes&, size_t,
+                                size_t, uint32_t*);
+};
+
+// Sets bit i of visibility (32 boxes per word) for each box first + i not
+// outside of the frustum, clearing the rest. Same result as
+// Frustum::IsInside(box) != OUTSIDE. Uses AVX, SSE or NEON when available.
+void CullBoxes(const Frustum& frustum, const CullingBoxes& boxes, size_t first,
+               size_t count, uint32_t* visibility);
+void CullBoxesScalar(const Frustum& frustum, const CullingBoxes& boxes,
+                     size_t first, size_t count, uint32_t* visibility);
+}
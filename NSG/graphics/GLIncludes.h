@@ -442,6 +442,18 @@ extern PFNGLGENERATEMIPMAPPROC glGenerateMipmap;
 #define glDrawArraysInstanced glDrawArraysInstancedEXT
 #endif
 
+#ifndef GL_HALF_FLOAT
+#if defined(GL_HALF_FLOAT_OES)
+#define GL_HALF_FLOAT GL_HALF_FLOAT_OES
+#else
+#define GL_HALF_FLOAT 0x140B
+#endif
+#endif
+
+#ifndef GL_INT_2_10_10_10_REV
+#define GL_INT_2_10_10_10_REV 0x8D9F
+#endif
+
 #ifndef GL_EXT_texture_compression_s3tc
 #define GL_EXT_texture_compression_s3tc 1
 #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
@@ -56,7 +56,8 @@ Material::Material(const std::string& name)
       flipYTextureCoords_(false), shadeless_(false),
       cullFaceMode_(CullFaceMode::DEFAULT), friction_(0.5f), // same as Blender
       signalPhysicsSet_(new SignalEmpty()), castShadow_(true),
-      receiveShadows_(true), shadowBias_(0.001f), slopeScaledBias_(0.001f) {}
+      receiveShadows_(true), shadowBias_(0.001f), slopeScaledBias_(0.001f),
+      variationStamp_(NewVariationStamp()) {}
 
 Material::~Material() {}
 
@@ -172,6 +173,7 @@ bool Material::SetTexture(MaterialTexture index, PTexture texture) {
     CHECK_ASSERT(index >= 0 && index < MaterialTexture::MAX_MAPS);
     if (texture_[index] != texture) {
         texture_[index] = texture;
+        variationStamp_ = NewVariationStamp();
         SetUniformsNeedUpdate();
         return true;
     }
@@ -293,6 +295,7 @@ void Material::Save(pugi::xml_node& node) {
 
 void Material::Load(const pugi::xml_node& node) {
     name_ = node.attribute("name").as_string();
+    variationStamp_ = NewVariationStamp();
     shadeless_ = node.attribute("shadeless").as_bool();
     castShadow_ = node.attribute("castShadow").as_bool();
     receiveShadows_ = node.attribute("receiveShadows").as_bool();
@@ -503,6 +506,38 @@ void Material::FillShaderDefines(std::string& defines, PassType passType,
 
 void Material::SetShadeless(bool shadeless) { shadeless_ = shadeless; }
 
+unsigned Material::GetVariationStamp() const {
+    // A texture changed after this material was stamped means the defines
+    // generated for this material may have changed as well.
+    for (int index = 0; index < MaterialTexture::MAX_MAPS; index++) {
+        auto texture = texture_[index].get();
+        if (texture && texture->GetVariationStamp() > variationStamp_)
+            variationStamp_ = NewVariationStamp();
+    }
+    return variationStamp_;
+}
+
+void Material::SetRenderPass(RenderPass pass) {
+    if (renderPass_ != pass) {
+        renderPass_ = pass;
+        variationStamp_ = NewVariationStamp();
+    }
+}
+
+void Material::SetBillboardType(BillboardType type) {
+    if (billboardType_ != type) {
+        billboardType_ = type;
+        variationStamp_ = NewVariationStamp();
+    }
+}
+
+void Material::FlipYTextureCoords(bool enable) {
+    if (flipYTextureCoords_ != enable) {
+        flipYTextureCoords_ = enable;
+        variationStamp_ = NewVariationStamp();
+    }
+}
+
 void Material::SetFriction(float friction) {
     if (friction_ != friction) {
         friction_ = friction;
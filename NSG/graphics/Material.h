@@ -116,11 +116,12 @@ public:
     bool HasLightMap() const;
     void FillShaderDefines(std::string& defines, PassType passType,
                            const Mesh* mesh, bool allowInstancing) const;
-    void SetRenderPass(RenderPass pass) { renderPass_ = pass; }
+    unsigned GetVariationStamp() const;
+    void SetRenderPass(RenderPass pass);
     RenderPass GetRenderPass() const { return renderPass_; }
-    void SetBillboardType(BillboardType type) { billboardType_ = type; }
+    void SetBillboardType(BillboardType type);
     BillboardType GetBillboardType() const { return billboardType_; }
-    void FlipYTextureCoords(bool enable) { flipYTextureCoords_ = enable; }
+    void FlipYTextureCoords(bool enable);
     bool IsYFlipped() const { return flipYTextureCoords_; }
     void SetShadeless(bool shadeless); // If true, makes this material
                                        // insensitive to light (but AMBIENT pass
@@ -180,6 +181,7 @@ private:
                        // Light::shadowBias_)
     float slopeScaledBias_;
     PFontAtlas fontAtlas_;
+    mutable unsigned variationStamp_; // changes with state affecting defines
     friend class Program;
 };
 }
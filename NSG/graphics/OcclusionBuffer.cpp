@@ -0,0 +1,335 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "OcclusionBuffer.h"
+#include "Check.h"
+#include "Mesh.h"
+#include "Profiler.h"
+#include "SceneNode.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NSG_OCCLUSION_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NSG_OCCLUSION_NEON
+#endif
+
+namespace NSG {
+// Blocks of the box test at the chosen level (see IsVisible)
+static const int MAX_TEST_TEXELS = 4;
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : occluders_(0), triangles_(0), hierarchyBuilt_(false) {
+    CHECK_CONDITION(width > 0 && height > 0);
+    // each level halves the previous one down to a single texel
+    for (;;) {
+        levels_.push_back(
+            Level{width, height, std::vector<float>(width * height, 1.f)});
+        if (width == 1 && height == 1)
+            break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+OcclusionBuffer::~OcclusionBuffer() {}
+
+void OcclusionBuffer::SetView(const Matrix4& viewProjection) {
+    viewProjection_ = viewProjection;
+    auto& depths = levels_[0].depths_;
+    std::fill(depths.begin(), depths.end(), 1.f);
+    occluders_ = 0;
+    triangles_ = 0;
+    hierarchyBuilt_ = false;
+}
+
+void OcclusionBuffer::AddOccluder(SceneNode* node) {
+    auto mesh = node->GetOccluderMesh();
+    if (!mesh)
+        mesh = node->GetMesh();
+    if (mesh && mesh->IsReady()) {
+        AddMesh(mesh.get(), node->GetGlobalModelMatrix());
+        ++occluders_;
+    }
+}
+
+void OcclusionBuffer::AddMesh(Mesh* mesh, const Matrix4& model) {
+    auto modelViewProjection = viewProjection_ * model;
+    auto n = mesh->GetNumberOfTriangles();
+    for (size_t i = 0; i < n; i++) {
+        Vector4 v[3];
+        for (size_t j = 0; j < 3; j++)
+            v[j] = modelViewProjection *
+                   Vector4(mesh->GetTriangleVertex(i, j).position_, 1);
+        AddClipTriangle(v[0], v[1], v[2]);
+    }
+}
+
+void OcclusionBuffer::AddTriangle(const Vector3& v0, const Vector3& v1,
+                                  const Vector3& v2) {
+    AddClipTriangle(viewProjection_ * Vector4(v0, 1),
+                    viewProjection_ * Vector4(v1, 1),
+                    viewProjection_ * Vector4(v2, 1));
+}
+
+// Distance to the near plane in clip space
+static inline float NearDistance(const Vector4& v) { return v.z + v.w; }
+
+void OcclusionBuffer::AddClipTriangle(const Vector4& v0, const Vector4& v1,
+                                      const Vector4& v2) {
+    CHECK_ASSERT(!hierarchyBuilt_);
+    const Vector4* v[] = {&v0, &v1, &v2};
+    // trivially outside of a plane of the frustum
+    auto outside = ~0u;
+    for (auto p : v) {
+        unsigned planes = 0;
+        planes |= p->x < -p->w ? 1 : 0;
+        planes |= p->x > p->w ? 2 : 0;
+        planes |= p->y < -p->w ? 4 : 0;
+        planes |= p->y > p->w ? 8 : 0;
+        planes |= NearDistance(*p) < 0 ? 16 : 0;
+        planes |= p->z > p->w ? 32 : 0;
+        outside &= planes;
+    }
+    if (outside)
+        return;
+    ++triangles_;
+
+    // clipped by the near plane in a polygon of up to four vertexes
+    Vector4 polygon[4];
+    int n = 0;
+    for (int i = 0; i < 3; i++) {
+        auto& a = *v[i];
+        auto& b = *v[(i + 1) % 3];
+        auto da = NearDistance(a);
+        auto db = NearDistance(b);
+        if (da >= 0)
+            polygon[n++] = a;
+        if ((da >= 0) != (db >= 0))
+            polygon[n++] = a + (b - a) * (da / (da - db));
+    }
+    for (int i = 2; i < n; i++)
+        Rasterize(polygon[0], polygon[i - 1], polygon[i]);
+}
+
+struct ScreenVertex {
+    float x_, y_, z_;
+};
+
+struct RowSetup {
+    float a_[3], b_[3], c_[3]; // edge k = a_[k] * x + b_[k] * y + c_[k]
+    float zx_, zy_, z0_;       // depth = zx_ * x + zy_ * y + z0_
+};
+
+// The depth is the minimum of the stored one and the triangle's one where
+// the three edge functions are not negative
+static inline void FillTexel(const RowSetup& s, float x, float y,
+                             float* depth) {
+    for (int k = 0; k < 3; k++)
+        if (s.a_[k] * x + (s.b_[k] * y + s.c_[k]) < 0)
+            return;
+    *depth = std::min(*depth, s.zx_ * x + (s.zy_ * y + s.z0_));
+}
+
+// Same as FillTexel for the texels [x, x + 4)
+#if defined(NSG_OCCLUSION_SSE)
+static inline void FillTexels4(const RowSetup& s, float x, float y,
+                               float* depth) {
+    auto px = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0, 1, 2, 3));
+    auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    auto zero = _mm_setzero_ps();
+    for (int k = 0; k < 3; k++) {
+        auto edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.a_[k]), px),
+                               _mm_set1_ps(s.b_[k] * y + s.c_[k]));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(edge, zero));
+    }
+    auto z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.zx_), px),
+                        _mm_set1_ps(s.zy_ * y + s.z0_));
+    auto old = _mm_loadu_ps(depth);
+    auto result = _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, z)),
+                            _mm_andnot_ps(inside, old));
+    _mm_storeu_ps(depth, result);
+}
+#elif defined(NSG_OCCLUSION_NEON)
+static inline void FillTexels4(const RowSetup& s, float x, float y,
+                               float* depth) {
+    static const float lanes[4] = {0, 1, 2, 3};
+    auto px = vaddq_f32(vdupq_n_f32(x), vld1q_f32(lanes));
+    auto inside = vdupq_n_u32(~0u);
+    auto zero = vdupq_n_f32(0);
+    for (int k = 0; k < 3; k++) {
+        auto edge = vaddq_f32(vmulq_n_f32(px, s.a_[k]),
+                              vdupq_n_f32(s.b_[k] * y + s.c_[k]));
+        inside = vandq_u32(inside, vcgeq_f32(edge, zero));
+    }
+    auto z = vaddq_f32(vmulq_n_f32(px, s.zx_),
+                       vdupq_n_f32(s.zy_ * y + s.z0_));
+    auto old = vld1q_f32(depth);
+    vst1q_f32(depth, vbslq_f32(inside, vminq_f32(old, z), old));
+}
+#else
+static inline void FillTexels4(const RowSetup& s, float x, float y,
+                               float* depth) {
+    for (int i = 0; i < 4; i++)
+        FillTexel(s, x + i, y, depth + i);
+}
+#endif
+
+void OcclusionBuffer::Rasterize(const Vector4& v0, const Vector4& v1,
+                                const Vector4& v2) {
+    auto& level = levels_[0];
+    const Vector4* v[] = {&v0, &v1, &v2};
+    ScreenVertex p[3];
+    for (int i = 0; i < 3; i++) {
+        auto invW = 1.f / v[i]->w;
+        p[i].x_ = (v[i]->x * invW * .5f + .5f) * level.width_;
+        p[i].y_ = (v[i]->y * invW * .5f + .5f) * level.height_;
+        p[i].z_ = v[i]->z * invW * .5f + .5f;
+    }
+    auto area = (p[1].x_ - p[0].x_) * (p[2].y_ - p[0].y_) -
+                (p[1].y_ - p[0].y_) * (p[2].x_ - p[0].x_);
+    if (area == 0 || !std::isfinite(area))
+        return;
+    if (area < 0) { // both faces are occluders
+        std::swap(p[1], p[2]);
+        area = -area;
+    }
+
+    RowSetup s;
+    for (int k = 0; k < 3; k++) {
+        auto& a = p[k];
+        auto& b = p[(k + 1) % 3];
+        s.a_[k] = a.y_ - b.y_;
+        s.b_[k] = b.x_ - a.x_;
+        s.c_[k] = -(s.a_[k] * a.x_ + s.b_[k] * a.y_);
+    }
+    auto dz1 = p[1].z_ - p[0].z_;
+    auto dz2 = p[2].z_ - p[0].z_;
+    s.zx_ = (dz1 * (p[2].y_ - p[0].y_) - dz2 * (p[1].y_ - p[0].y_)) / area;
+    s.zy_ = (dz2 * (p[1].x_ - p[0].x_) - dz1 * (p[2].x_ - p[0].x_)) / area;
+    s.z0_ = p[0].z_ - s.zx_ * p[0].x_ - s.zy_ * p[0].y_;
+
+    // texels with the center inside of the bounds
+    auto minX = std::min(std::min(p[0].x_, p[1].x_), p[2].x_);
+    auto maxX = std::max(std::max(p[0].x_, p[1].x_), p[2].x_);
+    auto minY = std::min(std::min(p[0].y_, p[1].y_), p[2].y_);
+    auto maxY = std::max(std::max(p[0].y_, p[1].y_), p[2].y_);
+    auto x0 = std::max(0, (int)std::ceil(minX - .5f));
+    auto x1 = std::min(level.width_ - 1, (int)std::floor(maxX - .5f));
+    auto y0 = std::max(0, (int)std::ceil(minY - .5f));
+    auto y1 = std::min(level.height_ - 1, (int)std::floor(maxY - .5f));
+    for (auto y = y0; y <= y1; y++) {
+        auto row = &level.depths_[y * level.width_];
+        auto centerY = y + .5f;
+        auto x = x0;
+        for (; x + 4 <= x1 + 1; x += 4)
+            FillTexels4(s, x + .5f, centerY, row + x);
+        for (; x <= x1; x++)
+            FillTexel(s, x + .5f, centerY, row + x);
+    }
+}
+
+void OcclusionBuffer::BuildHierarchy() {
+    PROFILE_ZONE("OcclusionBuffer::BuildHierarchy");
+    for (size_t i = 1; i < levels_.size(); i++) {
+        auto& src = levels_[i - 1];
+        auto& dst = levels_[i];
+        for (int y = 0; y < dst.height_; y++) {
+            auto y0 = 2 * y;
+            auto y1 = std::min(y0 + 1, src.height_ - 1);
+            for (int x = 0; x < dst.width_; x++) {
+                auto x0 = 2 * x;
+                auto x1 = std::min(x0 + 1, src.width_ - 1);
+                auto row0 = &src.depths_[y0 * src.width_];
+                auto row1 = &src.depths_[y1 * src.width_];
+                dst.depths_[y * dst.width_ + x] =
+                    std::max(std::max(row0[x0], row0[x1]),
+                             std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+    hierarchyBuilt_ = true;
+}
+
+bool OcclusionBuffer::IsVisible(const BoundingBox& box) const {
+    CHECK_ASSERT(hierarchyBuilt_);
+    auto& level0 = levels_[0];
+    float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+    float minZ = 1e30f;
+    for (int i = 0; i < 8; i++) {
+        Vector3 corner(i & 1 ? box.max_.x : box.min_.x,
+                       i & 2 ? box.max_.y : box.min_.y,
+                       i & 4 ? box.max_.z : box.min_.z);
+        auto v = viewProjection_ * Vector4(corner, 1);
+        if (NearDistance(v) <= 0)
+            return true; // crossing the near plane
+        auto invW = 1.f / v.w;
+        auto x = (v.x * invW * .5f + .5f) * level0.width_;
+        auto y = (v.y * invW * .5f + .5f) * level0.height_;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, v.z * invW * .5f + .5f);
+    }
+    if (maxX < 0 || maxY < 0 || minX >= level0.width_ ||
+        minY >= level0.height_)
+        return true; // left to the frustum test
+
+    // every texel touched by the box
+    auto x0 = std::max(0, (int)std::floor(minX));
+    auto x1 = std::min(level0.width_ - 1, (int)std::floor(maxX));
+    auto y0 = std::max(0, (int)std::floor(minY));
+    auto y1 = std::min(level0.height_ - 1, (int)std::floor(maxY));
+    size_t index = 0;
+    while (index + 1 < levels_.size() &&
+           (x1 - x0 >= MAX_TEST_TEXELS || y1 - y0 >= MAX_TEST_TEXELS)) {
+        x0 >>= 1;
+        x1 >>= 1;
+        y0 >>= 1;
+        y1 >>= 1;
+        ++index;
+    }
+    auto& level = levels_[index];
+    for (auto y = y0; y <= y1; y++) {
+        auto row = &level.depths_[y * level.width_];
+        for (auto x = x0; x <= x1; x++)
+            if (row[x] >= minZ)
+                return true;
+    }
+    return false;
+}
+
+float OcclusionBuffer::GetDepth(int x, int y, unsigned level) const {
+    CHECK_ASSERT(level < levels_.size());
+    auto& obj = levels_[level];
+    CHECK_ASSERT(x >= 0 && x < obj.width_ && y >= 0 && y < obj.height_);
+    return obj.depths_[y * obj.width_ + x];
+}
+}
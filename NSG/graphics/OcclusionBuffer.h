@@ -0,0 +1,77 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "BoundingBox.h"
+#include "Matrix4.h"
+#include "Types.h"
+#include <vector>
+
+namespace NSG {
+/// Low resolution depth buffer rasterized in the CPU with the occluders
+/// seen from a camera (see Scene::EnableOcclusionCulling).
+/// Depths go from 0 (near plane) to 1 (far plane). A hierarchy of reduced
+/// buffers keeps the farthest depth of each block, so a box is tested
+/// reading a few texels whatever its size. Coverage is sampled at the texel
+/// centers: occluders should not be bigger than the geometry they stand for.
+class OcclusionBuffer {
+public:
+    OcclusionBuffer(int width = 256, int height = 128);
+    ~OcclusionBuffer();
+    int GetWidth() const { return levels_[0].width_; }
+    int GetHeight() const { return levels_[0].height_; }
+    unsigned GetLevels() const { return (unsigned)levels_.size(); }
+    // Clears the buffer for a new view
+    void SetView(const Matrix4& viewProjection);
+    // Rasterizes the occluder mesh (or the mesh) of node
+    void AddOccluder(SceneNode* node);
+    // Rasterizes the triangles of mesh transformed by model
+    void AddMesh(Mesh* mesh, const Matrix4& model);
+    // World space triangle (both faces)
+    void AddTriangle(const Vector3& v0, const Vector3& v1, const Vector3& v2);
+    // To be called after the occluders and before the tests
+    void BuildHierarchy();
+    // false when the box is behind the occluders. Read only (thread safe).
+    bool IsVisible(const BoundingBox& box) const;
+    float GetDepth(int x, int y, unsigned level = 0) const;
+    unsigned GetOccludersCount() const { return occluders_; }
+    unsigned GetTrianglesCount() const { return triangles_; }
+
+private:
+    void AddClipTriangle(const Vector4& v0, const Vector4& v1,
+                         const Vector4& v2);
+    void Rasterize(const Vector4& v0, const Vector4& v1, const Vector4& v2);
+    struct Level {
+        int width_;
+        int height_;
+        std::vector<float> depths_;
+    };
+    std::vector<Level> levels_;
+    Matrix4 viewProjection_;
+    unsigned occluders_;
+    unsigned triangles_;
+    bool hierarchyBuilt_;
+};
+}
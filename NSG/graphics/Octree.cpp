@@ -22,10 +22,20 @@
 // Updated for nsg-library
 #include "Octree.h"
 #include "Check.h"
+#include "JobSystem.h"
 #include "OctreeQuery.h"
+#include "Profiler.h"
 #include "SceneNode.h"
 
 namespace NSG {
+// Octants visited by the thread, given to the profiler after each query
+static thread_local unsigned visitedOctants = 0;
+
+static void CountVisitedOctants() {
+    PROFILE_COUNT(OCTREE_NODES, visitedOctants);
+    visitedOctants = 0;
+}
+
 Octant::Octant(const BoundingBox& box, unsigned level, Octant* parent,
                Octree* root, unsigned index)
     : level_(level), numDrawables_(0), parent_(parent), root_(root),
@@ -39,11 +49,15 @@ Octant::Octant(const BoundingBox& box, unsigned level, Octant* parent,
 Octant::~Octant() {
     if (root_) {
         // Remove the drawables (if any) from this octant to the root octant
-        for (auto& obj : drawables_) {
+        for (size_t i = 0; i < drawables_.size(); i++) {
+            auto obj = drawables_[i];
             obj->SetOctant(root_);
+            obj->SetOctantIndex((unsigned)root_->drawables_.size());
             root_->drawables_.push_back(obj);
+            root_->boxes_.Add(boxes_.Get(i));
         }
         drawables_.clear();
+        boxes_.Clear();
         numDrawables_ = 0;
     }
 
@@ -121,10 +135,11 @@ void Octant::Insert(SceneNode* obj) {
         Octant* oldOctant = obj->GetOctant();
         if (oldOctant != this) {
             // Add first, then remove, because drawable count going to zero
-            // deletes the octree branch in question
+            // deletes the octree branch in question. Add changes the index.
+            auto oldIndex = obj->GetOctantIndex();
             Add(obj);
             if (oldOctant)
-                oldOctant->Remove(obj, false);
+                oldOctant->Remove(obj, oldIndex, false);
         }
     } else {
         Vector3 boxCenter = box.Center();
@@ -162,26 +177,67 @@ bool Octant::CheckFit(const BoundingBox& box) const {
 
 void Octant::Add(SceneNode* obj) {
     obj->SetOctant(this);
+    obj->SetOctantIndex((unsigned)drawables_.size());
     drawables_.push_back(obj);
+    boxes_.Add(obj->GetWorldBoundingBox());
     IncDrawableCount();
 }
 
 void Octant::Remove(SceneNode* obj, bool resetOctant) {
-    auto it = std::find(drawables_.begin(), drawables_.end(), obj);
-    if (it != drawables_.end()) {
-        drawables_.erase(it);
+    Remove(obj, obj->GetOctantIndex(), resetOctant);
+}
+
+void Octant::Remove(SceneNode* obj, unsigned index, bool resetOctant) {
+    CHECK_ASSERT(index < drawables_.size() && drawables_[index] == obj);
+    if (index < drawables_.size() && drawables_[index] == obj) {
+        auto last = drawables_.back();
+        drawables_[index] = last;
+        if (last != obj) // obj keeps its index in the new octant
+            last->SetOctantIndex(index);
+        drawables_.pop_back();
+        boxes_.RemoveSwap(index);
         if (resetOctant)
             obj->SetOctant(nullptr);
         DecDrawableCount();
     }
 }
 
+void Octant::UpdateBox(SceneNode* obj) {
+    CHECK_ASSERT(obj->GetOctant() == this);
+    boxes_.Set(obj->GetOctantIndex(), obj->GetWorldBoundingBox());
+}
+
 void Octant::IncDrawableCount() {
     ++numDrawables_;
     if (parent_)
         parent_->IncDrawableCount();
 }
 
+bool Octant::CheckIntegrity(unsigned& numDrawables) const {
+    if (drawables_.size() != boxes_.Size())
+        return false;
+    for (size_t i = 0; i < drawables_.size(); i++) {
+        auto obj = drawables_[i];
+        if (obj->GetOctant() != this || obj->GetOctantIndex() != i)
+            return false;
+        auto box = boxes_.Get(i);
+        auto& worldBox = obj->GetWorldBoundingBox();
+        if (box.min_ != worldBox.min_ || box.max_ != worldBox.max_)
+            return false;
+    }
+    numDrawables = (unsigned)drawables_.size();
+    for (auto child : children_) {
+        unsigned childDrawables = 0;
+        if (child) {
+            // empty branches are deleted
+            if (!child->CheckIntegrity(childDrawables) || !childDrawables)
+                return false;
+        }
+        numDrawables += childDrawables;
+    }
+    return numDrawables == numDrawables_;
+}
+
 void Octant::DecDrawableCount() {
     Octant* parent = parent_;
 
@@ -195,7 +251,9 @@ void Octant::DecDrawableCount() {
         parent->DecDrawableCount();
 }
 
-void Octant::ExecuteInternal(OctreeQuery& query, bool inside) {
+void Octant::ExecuteInternal(OctreeQuery& query, bool inside,
+                             QueryResult& result) {
+    ++visitedOctants;
     if (this != root_) {
         Intersection res = query.TestOctant(cullingBox_, inside);
         if (res == Intersection::INSIDE)
@@ -207,12 +265,56 @@ void Octant::ExecuteInternal(OctreeQuery& query, bool inside) {
     }
 
     if (drawables_.size()) {
-        query.Test(drawables_, inside);
+        query.Test(drawables_, boxes_, inside, result);
+    }
+
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i) {
+        if (children_[i])
+            children_[i]->ExecuteInternal(query, inside, result);
+    }
+}
+
+// Same traversal order as ExecuteInternal
+void Octant::CollectJobs(OctreeQuery& query, bool inside, unsigned depth,
+                         std::vector<Job>& jobs) {
+    if (!depth) {
+        jobs.push_back(Job{this, inside, true});
+        return;
+    }
+
+    ++visitedOctants;
+    if (this != root_) {
+        Intersection res = query.TestOctant(cullingBox_, inside);
+        if (res == Intersection::INSIDE)
+            inside = true;
+        else if (res == Intersection::OUTSIDE)
+            return;
     }
 
+    if (drawables_.size())
+        jobs.push_back(Job{this, inside, false});
+
     for (unsigned i = 0; i < NUM_OCTANTS; ++i) {
         if (children_[i])
-            children_[i]->ExecuteInternal(query, inside);
+            children_[i]->CollectJobs(query, inside, depth - 1, jobs);
+    }
+}
+
+void Octant::ExecuteInternal(MultiFrustumOctreeQuery& query, unsigned active,
+                             unsigned inside) {
+    ++visitedOctants;
+    if (this != root_) {
+        active = query.TestOctant(cullingBox_, active, inside);
+        if (!active)
+            return; // outside of every frustum
+    }
+
+    if (drawables_.size())
+        query.Test(drawables_, boxes_, active, inside);
+
+    for (unsigned i = 0; i < NUM_OCTANTS; ++i) {
+        if (children_[i])
+            children_[i]->ExecuteInternal(query, active, inside);
     }
 }
 
@@ -222,10 +324,12 @@ void Octant::ExecuteInternal(OctreeQuery& query, bool inside) {
 
 static const float DEFAULT_OCTREE_SIZE = 1000.0f;
 static const int DEFAULT_OCTREE_LEVELS = 8;
+static const unsigned DEFAULT_PARALLEL_DEPTH = 2; // up to 73 jobs
 Octree::Octree()
     : Octant(BoundingBox(-DEFAULT_OCTREE_SIZE, DEFAULT_OCTREE_SIZE), 0, nullptr,
              this),
-      numLevels_(DEFAULT_OCTREE_LEVELS) {}
+      numLevels_(DEFAULT_OCTREE_LEVELS),
+      parallelDepth_(DEFAULT_PARALLEL_DEPTH), jobs_(nullptr) {}
 
 Octree::~Octree() { ResetRoot(); }
 
@@ -236,10 +340,13 @@ void Octree::InsertUpdate(SceneNode* obj) {
     // Skip if still fits the current octant
     if (octant &&
         octant->GetCullingBox().IsInside(box) == Intersection::INSIDE &&
-        octant->CheckFit(box))
+        octant->CheckFit(box)) {
+        octant->UpdateBox(obj);
         return;
+    }
 
     Insert(obj);
+    obj->GetOctant()->UpdateBox(obj);
 
     // Verify that the obj will be culled correctly
     CHECK_ASSERT(obj->GetOctant() == this ||
@@ -252,6 +359,13 @@ void Octree::InsertUpdate(SceneNode* obj) {
     }
 }
 
+bool Octree::CheckIntegrity() const {
+    unsigned numDrawables = 0;
+    return Octant::CheckIntegrity(numDrawables) &&
+           numDrawables == allDrawables_.size() &&
+           allDrawablesSet_.size() == allDrawables_.size();
+}
+
 void Octree::Remove(SceneNode* obj) {
     Octant* octant = obj->GetOctant();
     if (octant) {
@@ -264,7 +378,43 @@ void Octree::Remove(SceneNode* obj) {
 }
 
 void Octree::Execute(OctreeQuery& query) {
-    query.result_.clear();
-    ExecuteInternal(query, false);
+    query.result_.Clear();
+    auto jobs = jobs_ ? jobs_ : Task::JobSystem::GetPtr();
+    if (!parallelDepth_ || !jobs || !jobs->GetWorkersCount() ||
+        numDrawables_ < PARALLEL_MIN_DRAWABLES) {
+        ExecuteInternal(query, false, query.result_);
+        CountVisitedOctants();
+        return;
+    }
+
+    queryJobs_.clear();
+    CollectJobs(query, false, parallelDepth_, queryJobs_);
+    CountVisitedOctants();
+    if (queryBuffers_.size() < queryJobs_.size())
+        queryBuffers_.resize(queryJobs_.size());
+    jobs->ParallelFor(queryJobs_.size(), 1, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto& job = queryJobs_[i];
+            auto& buffer = queryBuffers_[i];
+            buffer.clear();
+            QueryResult result(buffer);
+            if (job.subtree_)
+                job.octant_->ExecuteInternal(query, job.inside_, result);
+            else
+                query.Test(job.octant_->drawables_, job.octant_->boxes_,
+                           job.inside_, result);
+        }
+        CountVisitedOctants();
+    });
+    // concatenated in the order of the serial traversal
+    for (size_t i = 0; i < queryJobs_.size(); i++)
+        for (auto node : queryBuffers_[i])
+            query.result_.Add(node);
+}
+
+void Octree::Execute(MultiFrustumOctreeQuery& query) {
+    query.Clear();
+    ExecuteInternal(query, query.GetAllFrustums(), 0);
+    CountVisitedOctants();
 }
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
 
 #pragma once
 #include "BoundingBox.h"
+#include "FrustumCulling.h"
 #include "Types.h"
 #include <array>
 #include <set>
@@ -34,6 +35,11 @@ class Octree;
 static const int NUM_OCTANTS = 8;
 static const unsigned ROOT_INDEX = M_MAX_UNSIGNED;
 class OctreeQuery;
+class MultiFrustumOctreeQuery;
+class QueryResult;
+namespace Task {
+class JobSystem;
+}
 class Octant {
 public:
     Octant(const BoundingBox& box, unsigned level, Octant* parent, Octree* root,
@@ -49,11 +55,25 @@ protected:
     bool CheckFit(const BoundingBox& box) const;
     void Add(SceneNode* obj);
     void Remove(SceneNode* obj, bool resetOctant = true);
+    // index is obj's position in this octant (it may already be in another)
+    void Remove(SceneNode* obj, unsigned index, bool resetOctant);
+    void UpdateBox(SceneNode* obj);
     void IncDrawableCount();
     void DecDrawableCount();
     const BoundingBox& GetCullingBox() const { return cullingBox_; }
     Octree* GetRoot() const { return root_; }
-    void ExecuteInternal(OctreeQuery& query, bool inside);
+    void ExecuteInternal(OctreeQuery& query, bool inside,
+                         QueryResult& result);
+    struct Job {
+        Octant* octant_;
+        bool inside_;
+        bool subtree_; // otherwise just the octant's drawables
+    };
+    void CollectJobs(OctreeQuery& query, bool inside, unsigned depth,
+                     std::vector<Job>& jobs);
+    void ExecuteInternal(MultiFrustumOctreeQuery& query, unsigned active,
+                         unsigned inside);
+    bool CheckIntegrity(unsigned& numDrawables) const;
 
 private:
     /// World bounding box.
@@ -62,6 +82,8 @@ private:
     BoundingBox cullingBox_;
     /// Drawable objects.
     std::vector<SceneNode*> drawables_;
+    /// World bounding boxes of the drawables (same order).
+    CullingBoxes boxes_;
     /// Child octants.
     std::array<Octant*, NUM_OCTANTS> children_;
     /// World bounding box center.
@@ -88,14 +110,30 @@ public:
     unsigned GetNumLevels() const { return numLevels_; }
     void InsertUpdate(SceneNode* obj);
     void Remove(SceneNode* obj);
+    // The subtrees at depth parallelDepth are queried as independent jobs
+    // (0 disables it). The result keeps the order of the serial query.
+    // Execute is not reentrant.
     void Execute(OctreeQuery& query);
+    void Execute(MultiFrustumOctreeQuery& query);
     unsigned GetNumDrawables() const { return numDrawables_; }
+    // Drawables, boxes and counts of every octant agree (for the tests)
+    bool CheckIntegrity() const;
     const std::vector<SceneNode*>& GetDrawables() const {
         return allDrawables_;
     }
+    void SetParallelDepth(unsigned depth) { parallelDepth_ = depth; }
+    unsigned GetParallelDepth() const { return parallelDepth_; }
+    // nullptr uses JobSystem::GetPtr()
+    void SetJobSystem(Task::JobSystem* jobs) { jobs_ = jobs; }
+    // Smaller trees are always queried serially
+    static const unsigned PARALLEL_MIN_DRAWABLES = 4096;
 
 private:
     unsigned numLevels_; // Subdivision level.
+    unsigned parallelDepth_;
+    Task::JobSystem* jobs_;
+    std::vector<Job> queryJobs_;
+    std::vector<std::vector<SceneNode*>> queryBuffers_; // one per job
     std::vector<SceneNode*> allDrawables_;
     std::set<SceneNode*> allDrawablesSet_;
 };
@@ -25,15 +25,38 @@ misrepresented as being the original software.
 */
 #include "OctreeQuery.h"
 #include "Camera.h"
+#include "Check.h"
 #include "Frustum.h"
+#include "Material.h"
+#include "OcclusionBuffer.h"
 #include "SceneNode.h"
+#include <algorithm>
 
 namespace NSG {
-OctreeQuery::OctreeQuery(std::vector<SceneNode*>& result) : result_(result) {}
+// Boxes culled per CullBoxes call
+static const size_t CULL_CHUNK_SIZE = 256;
+
+QueryResult::QueryResult(std::vector<SceneNode*>& nodes)
+    : nodes_(&nodes), add_([](void* nodes, SceneNode* node) {
+          static_cast<std::vector<SceneNode*>*>(nodes)->push_back(node);
+      }),
+      clear_([](void* nodes) {
+          static_cast<std::vector<SceneNode*>*>(nodes)->clear();
+      }) {}
+
+QueryResult::QueryResult(FrameVector<SceneNode*>& nodes)
+    : nodes_(&nodes), add_([](void* nodes, SceneNode* node) {
+          static_cast<FrameVector<SceneNode*>*>(nodes)->push_back(node);
+      }),
+      clear_([](void* nodes) {
+          static_cast<FrameVector<SceneNode*>*>(nodes)->clear();
+      }) {}
+
+OctreeQuery::OctreeQuery(QueryResult result) : result_(result) {}
 
 OctreeQuery::~OctreeQuery() {}
 
-FrustumOctreeQuery::FrustumOctreeQuery(std::vector<SceneNode*>& result,
+FrustumOctreeQuery::FrustumOctreeQuery(QueryResult result,
                                        const Frustum* frustum)
     : OctreeQuery(result), frustum_(frustum) {}
 
@@ -46,18 +69,72 @@ Intersection FrustumOctreeQuery::TestOctant(const BoundingBox& box,
 }
 
 void FrustumOctreeQuery::Test(const std::vector<SceneNode*>& objs,
-                              bool inside) {
-    for (auto& obj : objs) {
-        if (obj->CanBeVisible()) {
-            if (inside ||
-                frustum_->IsInside(obj->GetWorldBoundingBox()) !=
-                    Intersection::OUTSIDE)
-                result_.push_back(obj);
+                              const CullingBoxes& boxes, bool inside,
+                              QueryResult& result) {
+    if (inside) {
+        for (auto& obj : objs)
+            if (obj->CanBeVisible())
+                result.Add(obj);
+        return;
+    }
+    CHECK_ASSERT(boxes.Size() == objs.size());
+    uint32_t visibility[CULL_CHUNK_SIZE / 32];
+    for (size_t first = 0; first < objs.size(); first += CULL_CHUNK_SIZE) {
+        auto count = std::min(CULL_CHUNK_SIZE, objs.size() - first);
+        CullBoxes(*frustum_, boxes, first, count, visibility);
+        for (size_t i = 0; i < count; i++) {
+            if (!(visibility[i / 32] & (1u << (i % 32))))
+                continue;
+            auto obj = objs[first + i];
+            if (obj->CanBeVisible())
+                result.Add(obj);
         }
     }
 }
 
-RayOctreeQuery::RayOctreeQuery(std::vector<SceneNode*>& result, const Ray& ray)
+OcclusionOctreeQuery::OcclusionOctreeQuery(QueryResult result,
+                                           const Frustum* frustum,
+                                           const OcclusionBuffer* buffer)
+    : FrustumOctreeQuery(result, frustum), buffer_(buffer), culledOctants_(0),
+      culledNodes_(0) {}
+
+Intersection OcclusionOctreeQuery::TestOctant(const BoundingBox& box,
+                                              bool inside) {
+    auto res = FrustumOctreeQuery::TestOctant(box, inside);
+    if (res != Intersection::OUTSIDE && !buffer_->IsVisible(box)) {
+        ++culledOctants_;
+        return Intersection::OUTSIDE;
+    }
+    return res;
+}
+
+void OcclusionOctreeQuery::Test(const std::vector<SceneNode*>& objs,
+                                const CullingBoxes& boxes, bool inside,
+                                QueryResult& result) {
+    CHECK_ASSERT(boxes.Size() == objs.size());
+    unsigned culled = 0;
+    uint32_t visibility[CULL_CHUNK_SIZE / 32];
+    for (size_t first = 0; first < objs.size(); first += CULL_CHUNK_SIZE) {
+        auto count = std::min(CULL_CHUNK_SIZE, objs.size() - first);
+        if (!inside)
+            CullBoxes(*frustum_, boxes, first, count, visibility);
+        for (size_t i = 0; i < count; i++) {
+            if (!inside && !(visibility[i / 32] & (1u << (i % 32))))
+                continue;
+            auto obj = objs[first + i];
+            if (!obj->CanBeVisible())
+                continue;
+            if (!obj->IsOccluder() &&
+                !buffer_->IsVisible(boxes.Get(first + i)))
+                ++culled;
+            else
+                result.Add(obj);
+        }
+    }
+    culledNodes_ += culled;
+}
+
+RayOctreeQuery::RayOctreeQuery(QueryResult result, const Ray& ray)
     : OctreeQuery(result), ray_(ray) {}
 
 Intersection RayOctreeQuery::TestOctant(const BoundingBox& box, bool inside) {
@@ -67,15 +144,20 @@ Intersection RayOctreeQuery::TestOctant(const BoundingBox& box, bool inside) {
         return ray_.IsInside(box);
 }
 
-void RayOctreeQuery::Test(const std::vector<SceneNode*>& objs, bool inside) {
-    for (auto& obj : objs) {
+void RayOctreeQuery::Test(const std::vector<SceneNode*>& objs,
+                          const CullingBoxes& boxes, bool inside,
+                          QueryResult& result) {
+    CHECK_ASSERT(boxes.Size() == objs.size());
+    for (size_t i = 0; i < objs.size(); i++) {
+        auto obj = objs[i];
         if (!obj->AllowRayQuery())
             continue;
         if (obj->CanBeVisible()) {
             if (inside)
-                result_.push_back(obj);
+                result.Add(obj);
             else {
-                auto worldBB = obj->GetWorldBoundingBox();
+                // the octree's copy: no lazy updates in the parallel jobs
+                auto worldBB = boxes.Get(i);
                 if (obj->IsBillboard()) {
                     auto size = worldBB.Size();
                     auto maxDistance =
@@ -88,7 +170,128 @@ void RayOctreeQuery::Test(const std::vector<SceneNode*>& objs, bool inside) {
                 }
 
                 if (ray_.IsInside(worldBB) != Intersection::OUTSIDE)
-                    result_.push_back(obj);
+                    result.Add(obj);
+            }
+        }
+    }
+}
+
+SphereOctreeQuery::SphereOctreeQuery(QueryResult result,
+                                     const Sphere& sphere)
+    : OctreeQuery(result), sphere_(sphere) {}
+
+Intersection SphereOctreeQuery::TestOctant(const BoundingBox& box,
+                                           bool inside) {
+    if (inside)
+        return Intersection::INSIDE;
+    else
+        return sphere_.IsInside(box);
+}
+
+void SphereOctreeQuery::Test(const std::vector<SceneNode*>& objs,
+                             const CullingBoxes& boxes, bool inside,
+                             QueryResult& result) {
+    CHECK_ASSERT(boxes.Size() == objs.size());
+    for (size_t i = 0; i < objs.size(); i++) {
+        auto obj = objs[i];
+        if (obj->CanBeVisible() &&
+            (inside ||
+             sphere_.IsInside(boxes.Get(i)) != Intersection::OUTSIDE))
+            result.Add(obj);
+    }
+}
+
+ConeOctreeQuery::ConeOctreeQuery(QueryResult result, const Cone& cone)
+    : OctreeQuery(result), cone_(cone) {}
+
+Intersection ConeOctreeQuery::TestOctant(const BoundingBox& box,
+                                         bool inside) {
+    if (inside)
+        return Intersection::INSIDE;
+    else
+        return cone_.IsInside(box);
+}
+
+void ConeOctreeQuery::Test(const std::vector<SceneNode*>& objs,
+                           const CullingBoxes& boxes, bool inside,
+                           QueryResult& result) {
+    CHECK_ASSERT(boxes.Size() == objs.size());
+    for (size_t i = 0; i < objs.size(); i++) {
+        auto obj = objs[i];
+        if (obj->CanBeVisible() &&
+            (inside || cone_.IsInside(boxes.Get(i)) != Intersection::OUTSIDE))
+            result.Add(obj);
+    }
+}
+
+MultiFrustumOctreeQuery::MultiFrustumOctreeQuery(
+    const Frustum* const* frustums, size_t nFrustums,
+    std::vector<FrustumQueryResult>& results, bool collectNodes)
+    : frustums_(frustums), nFrustums_(nFrustums),
+      allFrustums_(nFrustums < MAX_FRUSTUMS ? (1u << nFrustums) - 1
+                                            : ~0u),
+      results_(results), collectNodes_(collectNodes) {
+    CHECK_CONDITION(nFrustums_ <= MAX_FRUSTUMS);
+}
+
+void MultiFrustumOctreeQuery::Clear() {
+    results_.resize(nFrustums_);
+    for (auto& result : results_) {
+        result.nodes_.clear();
+        result.receiversBox_ = BoundingBox();
+        result.castersBox_ = BoundingBox();
+    }
+}
+
+unsigned MultiFrustumOctreeQuery::TestOctant(const BoundingBox& box,
+                                             unsigned active,
+                                             unsigned& inside) const {
+    auto pending = active & ~inside;
+    for (size_t i = 0; pending; i++, pending >>= 1) {
+        if (!(pending & 1))
+            continue;
+        auto res = frustums_[i]->IsInside(box);
+        if (res == Intersection::OUTSIDE)
+            active &= ~(1u << i);
+        else if (res == Intersection::INSIDE)
+            inside |= 1u << i;
+    }
+    return active;
+}
+
+void MultiFrustumOctreeQuery::Test(const std::vector<SceneNode*>& objs,
+                                   const CullingBoxes& boxes, unsigned active,
+                                   unsigned inside) {
+    CHECK_ASSERT(boxes.Size() == objs.size());
+    uint32_t visibility[MAX_FRUSTUMS][CULL_CHUNK_SIZE / 32];
+    for (size_t first = 0; first < objs.size(); first += CULL_CHUNK_SIZE) {
+        auto count = std::min(CULL_CHUNK_SIZE, objs.size() - first);
+        auto pending = active & ~inside;
+        for (size_t i = 0; pending; i++, pending >>= 1)
+            if (pending & 1)
+                CullBoxes(*frustums_[i], boxes, first, count, visibility[i]);
+        for (size_t j = 0; j < count; j++) {
+            auto obj = objs[first + j];
+            if (!obj->CanBeVisible())
+                continue;
+            auto& worldBB = obj->GetWorldBoundingBox();
+            auto material = obj->GetMaterial().get();
+            auto receiver = material && material->ReceiveShadows();
+            auto caster = material && material->CastShadow();
+            auto bit = 1u << (j % 32);
+            auto mask = active;
+            for (size_t i = 0; mask; i++, mask >>= 1) {
+                if (!(mask & 1))
+                    continue;
+                if (!(inside & (1u << i)) && !(visibility[i][j / 32] & bit))
+                    continue;
+                auto& result = results_[i];
+                if (collectNodes_)
+                    result.nodes_.push_back(obj);
+                if (receiver)
+                    result.receiversBox_.Merge(worldBB);
+                if (caster)
+                    result.castersBox_.Merge(worldBB);
             }
         }
     }
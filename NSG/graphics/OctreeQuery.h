@@ -22,42 +22,150 @@
 // Updated by Néstor Silveira Gorski for nsg-library
 
 #pragma once
+#include "BoundingBox.h"
+#include "Cone.h"
+#include "FrameArena.h"
 #include "Frustum.h"
+#include "FrustumCulling.h"
 #include "Ray.h"
+#include "Sphere.h"
 #include "Types.h"
+#include <atomic>
 #include <vector>
 
 namespace NSG {
+// Where a query adds the nodes found: a std::vector or a FrameVector
+class QueryResult {
+public:
+    QueryResult(std::vector<SceneNode*>& nodes);
+    QueryResult(FrameVector<SceneNode*>& nodes);
+    void Add(SceneNode* node) { add_(nodes_, node); }
+    void Clear() { clear_(nodes_); }
+
+private:
+    void* nodes_;
+    void (*add_)(void* nodes, SceneNode* node);
+    void (*clear_)(void* nodes);
+};
+
 class OctreeQuery {
 public:
-    OctreeQuery(std::vector<SceneNode*>& result);
+    OctreeQuery(QueryResult result);
     virtual ~OctreeQuery();
     virtual Intersection TestOctant(const BoundingBox& box, bool inside) = 0;
-    virtual void Test(const std::vector<SceneNode*>& objs, bool inside) = 0;
-    std::vector<SceneNode*>& result_;
+    // boxes holds the world bounding box of each obj (same order). Adds the
+    // nodes found to result (result_ or a buffer of a parallel job), so it
+    // has to be thread safe.
+    virtual void Test(const std::vector<SceneNode*>& objs,
+                      const CullingBoxes& boxes, bool inside,
+                      QueryResult& result) = 0;
+    QueryResult result_;
 };
 
 class FrustumOctreeQuery : public OctreeQuery {
 public:
-    FrustumOctreeQuery(std::vector<SceneNode*>& result, const Frustum* frustum);
+    FrustumOctreeQuery(QueryResult result, const Frustum* frustum);
     virtual Intersection TestOctant(const BoundingBox& box,
                                     bool inside) override;
     virtual void Test(const std::vector<SceneNode*>& objs,
-                      bool inside) override;
+                      const CullingBoxes& boxes, bool inside,
+                      QueryResult& result) override;
 
-private:
+protected:
     const Frustum* frustum_;
 };
 
+// Frustum query that also culls the octants and nodes hidden behind the
+// occluders of buffer, already rasterized (see OcclusionBuffer). Nodes
+// flagged as occluders are never culled by it.
+class OcclusionOctreeQuery : public FrustumOctreeQuery {
+public:
+    OcclusionOctreeQuery(QueryResult result, const Frustum* frustum,
+                         const OcclusionBuffer* buffer);
+    virtual Intersection TestOctant(const BoundingBox& box,
+                                    bool inside) override;
+    virtual void Test(const std::vector<SceneNode*>& objs,
+                      const CullingBoxes& boxes, bool inside,
+                      QueryResult& result) override;
+    unsigned GetCulledOctants() const { return culledOctants_; }
+    unsigned GetCulledNodes() const { return culledNodes_; }
+
+private:
+    const OcclusionBuffer* buffer_;
+    std::atomic<unsigned> culledOctants_;
+    std::atomic<unsigned> culledNodes_;
+};
+
 class RayOctreeQuery : public OctreeQuery {
 public:
-    RayOctreeQuery(std::vector<SceneNode*>& result, const Ray& ray);
+    RayOctreeQuery(QueryResult result, const Ray& ray);
     virtual Intersection TestOctant(const BoundingBox& box,
                                     bool inside) override;
     virtual void Test(const std::vector<SceneNode*>& objs,
-                      bool inside) override;
+                      const CullingBoxes& boxes, bool inside,
+                      QueryResult& result) override;
 
 private:
     Ray ray_;
 };
+
+// Nodes reached by a point light
+class SphereOctreeQuery : public OctreeQuery {
+public:
+    SphereOctreeQuery(QueryResult result, const Sphere& sphere);
+    virtual Intersection TestOctant(const BoundingBox& box,
+                                    bool inside) override;
+    virtual void Test(const std::vector<SceneNode*>& objs,
+                      const CullingBoxes& boxes, bool inside,
+                      QueryResult& result) override;
+
+private:
+    Sphere sphere_;
+};
+
+// Nodes reached by a spot light
+class ConeOctreeQuery : public OctreeQuery {
+public:
+    ConeOctreeQuery(QueryResult result, const Cone& cone);
+    virtual Intersection TestOctant(const BoundingBox& box,
+                                    bool inside) override;
+    virtual void Test(const std::vector<SceneNode*>& objs,
+                      const CullingBoxes& boxes, bool inside,
+                      QueryResult& result) override;
+
+private:
+    Cone cone_;
+};
+
+struct FrustumQueryResult {
+    std::vector<SceneNode*> nodes_; // only if the query collects nodes
+    BoundingBox receiversBox_;      // nodes receiving shadows
+    BoundingBox castersBox_;        // nodes casting shadows
+};
+
+// Tests several frustums in a single descent of the octree. Each octant
+// carries two bitmasks: the frustums still intersecting it and the ones
+// containing it completely, so every frustum stops testing as soon as the
+// octant is fully inside or outside of it.
+class MultiFrustumOctreeQuery {
+public:
+    static const size_t MAX_FRUSTUMS = 32;
+    MultiFrustumOctreeQuery(const Frustum* const* frustums, size_t nFrustums,
+                            std::vector<FrustumQueryResult>& results,
+                            bool collectNodes = true);
+    unsigned GetAllFrustums() const { return allFrustums_; }
+    // Updates the masks, returns the frustums not excluding the octant
+    unsigned TestOctant(const BoundingBox& box, unsigned active,
+                        unsigned& inside) const;
+    void Test(const std::vector<SceneNode*>& objs, const CullingBoxes& boxes,
+              unsigned active, unsigned inside);
+    void Clear();
+
+private:
+    const Frustum* const* frustums_;
+    size_t nFrustums_;
+    unsigned allFrustums_;
+    std::vector<FrustumQueryResult>& results_;
+    bool collectNodes_;
+};
 }
\ No newline at end of file
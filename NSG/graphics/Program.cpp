@@ -35,6 +35,7 @@ misrepresented as being the original software.
 #include "Maths.h"
 #include "Mesh.h"
 #include "Pass.h"
+#include "Profiler.h"
 #include "Renderer.h"
 #include "RenderingContext.h"
 #include "Scene.h"
@@ -72,6 +73,31 @@ template <>
 std::map<std::string, PProgram> StrongFactory<std::string, Program>::objsMap_ =
     std::map<std::string, PProgram>{};
 
+Program::Variations Program::variations_;
+ProgramCacheStats Program::cacheStats_;
+Program::VariationOwners Program::owners_;
+// Bounds the keys of destroyed owners (they are never restamped)
+static const size_t MAX_VARIATIONS = 1024;
+
+ProgramKey::ProgramKey() : flags_(0), material_(0), mesh_(0), skeleton_(0) {}
+
+bool ProgramKey::operator==(const ProgramKey& obj) const {
+    return flags_ == obj.flags_ && material_ == obj.material_ &&
+           mesh_ == obj.mesh_ && skeleton_ == obj.skeleton_;
+}
+
+size_t ProgramKeyHash::operator()(const ProgramKey& key) const {
+    size_t seed = key.flags_;
+    seed ^= key.material_ + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= key.mesh_ + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= key.skeleton_ + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+ProgramCacheStats::ProgramCacheStats() : keys_(0), lookups_(0), defines_(0) {}
+
+Program::VariationOwner::VariationOwner() : stamp_(0) {}
+
 Program::Program(const std::string& defines)
     : Object(GetUniqueName("Program")), defines_(defines), id_(0),
       att_texcoordLoc0_(-1), att_texcoordLoc1_(-1), att_positionLoc_(-1),
@@ -89,6 +115,8 @@ Program::Program(const std::string& defines)
       activeMaterial_(nullptr), activeLight_(nullptr), activeCamera_(nullptr),
       sceneColor_(-1), skeleton_(nullptr), node_(nullptr), material_(nullptr),
       light_(nullptr), camera_(nullptr), scene_(nullptr) {
+    static unsigned programs = 0;
+    sortId_ = ++programs;
     memset(&textureLoc_, -1, sizeof(textureLoc_));
     memset(&u_uvTransformLoc_, -1, sizeof(u_uvTransformLoc_));
     memset(&materialLoc_, -1, sizeof(materialLoc_));
@@ -325,8 +353,8 @@ void Program::SetUniformLocations() {
 
     for (int index = 0; index < MaterialTexture::MAX_MAPS; index++) {
         if (textureLoc_[index] != -1)
-            glUniform1i(textureLoc_[index],
-                        index); // set fixed locations for samplers
+            UploadUniform(glUniform1i, textureLoc_[index],
+                          index); // set fixed locations for samplers
     }
 
     CHECK_GL_STATUS();
@@ -394,36 +422,38 @@ void Program::SetSceneVariables() {
     if (sceneColorAmbientLoc_ != -1) {
         if (scene_) {
             if (scene_->UniformsNeedUpdate())
-                glUniform3fv(sceneColorAmbientLoc_, 1,
-                             &scene_->GetAmbientColor()[0]);
+                UploadUniform(glUniform3fv, sceneColorAmbientLoc_, 1,
+                              &scene_->GetAmbientColor()[0]);
         } else if (sceneColor_ == Color(-1)) {
             sceneColor_ = Color(0);
-            glUniform3fv(sceneColorAmbientLoc_, 1, &sceneColor_[0]);
+            UploadUniform(glUniform3fv, sceneColorAmbientLoc_, 1,
+                          &sceneColor_[0]);
         }
     }
 
     if (scene_) {
         if (u_sceneHorizonColorLoc_)
-            glUniform3fv(u_sceneHorizonColorLoc_, 1,
-                         &scene_->GetHorizonColor()[0]);
+            UploadUniform(glUniform3fv, u_sceneHorizonColorLoc_, 1,
+                          &scene_->GetHorizonColor()[0]);
 
         if (u_fogMinIntensityLoc_ != -1)
-            glUniform1f(u_fogMinIntensityLoc_, scene_->GetFogMinIntensity());
+            UploadUniform(glUniform1f, u_fogMinIntensityLoc_,
+                          scene_->GetFogMinIntensity());
 
         if (u_fogStartLoc_ != -1) {
             auto start = scene_->GetFogStart();
             if (camera_)
                 start = std::max(camera_->GetZNear(), start);
-            glUniform1f(u_fogStartLoc_, start);
+            UploadUniform(glUniform1f, u_fogStartLoc_, start);
         }
         if (u_fogEndLoc_ != -1) {
             auto end = scene_->GetFogStart() + scene_->GetFogDepth();
             if (camera_)
                 end = std::min(camera_->GetZFar(), end);
-            glUniform1f(u_fogEndLoc_, end);
+            UploadUniform(glUniform1f, u_fogEndLoc_, end);
         }
         if (u_fogHeightLoc_ != -1)
-            glUniform1f(u_fogHeightLoc_, scene_->GetFogHeight());
+            UploadUniform(glUniform1f, u_fogHeightLoc_, scene_->GetFogHeight());
     }
 }
 
@@ -431,22 +461,26 @@ void Program::SetNodeVariables() {
     if (node_ && (activeNode_ != node_ || node_->UniformsNeedUpdate())) {
         if (modelLoc_ != -1) {
             const Matrix4& m = node_->GetGlobalModelMatrix();
-            glUniformMatrix4fv(modelLoc_, 1, GL_FALSE, m.GetPointer());
+            UploadUniform(glUniformMatrix4fv, modelLoc_, 1, GL_FALSE,
+                          m.GetPointer());
         }
 
         if (normalMatrixLoc_ != -1) {
             const Matrix3& m = node_->GetGlobalModelInvTranspMatrix();
-            glUniformMatrix3fv(normalMatrixLoc_, 1, GL_FALSE, m.GetPointer());
+            UploadUniform(glUniformMatrix3fv, normalMatrixLoc_, 1, GL_FALSE,
+                          m.GetPointer());
         }
     } else if (!node_) {
         if (modelLoc_ != -1) {
             static const Matrix4 m(1);
-            glUniformMatrix4fv(modelLoc_, 1, GL_FALSE, m.GetPointer());
+            UploadUniform(glUniformMatrix4fv, modelLoc_, 1, GL_FALSE,
+                          m.GetPointer());
         }
 
         if (normalMatrixLoc_ != -1) {
             static const Matrix4 m(1);
-            glUniformMatrix3fv(normalMatrixLoc_, 1, GL_FALSE, m.GetPointer());
+            UploadUniform(glUniformMatrix3fv, normalMatrixLoc_, 1, GL_FALSE,
+                          m.GetPointer());
         }
     }
 }
@@ -461,109 +495,98 @@ void Program::SetMaterialVariables() {
                 ctx->SetTexture(index, texture);
 
                 if (u_uvTransformLoc_[index] != -1)
-                    glUniform4fv(u_uvTransformLoc_[index], 1,
-                                 &texture->GetUVTransform()[0]);
+                    UploadUniform(glUniform4fv, u_uvTransformLoc_[index], 1,
+                                  &texture->GetUVTransform()[0]);
             }
         }
 
         if (activeMaterial_ != material_ || material_->UniformsNeedUpdate()) {
             if (materialLoc_.diffuseColor_ != -1)
-                glUniform4fv(materialLoc_.diffuseColor_, 1,
-                             &material_->diffuseColor_[0]);
+                UploadUniform(glUniform4fv, materialLoc_.diffuseColor_, 1,
+                              &material_->diffuseColor_[0]);
 
             if (materialLoc_.diffuseIntensity_ != -1)
-                glUniform1f(materialLoc_.diffuseIntensity_,
-                            material_->diffuseIntensity_);
+                UploadUniform(glUniform1f, materialLoc_.diffuseIntensity_,
+                              material_->diffuseIntensity_);
 
             if (materialLoc_.specularColor_ != -1)
-                glUniform4fv(materialLoc_.specularColor_, 1,
-                             &material_->specularColor_[0]);
+                UploadUniform(glUniform4fv, materialLoc_.specularColor_, 1,
+                              &material_->specularColor_[0]);
 
             if (materialLoc_.specularIntensity_ != -1)
-                glUniform1f(materialLoc_.specularIntensity_,
-                            material_->specularIntensity_);
+                UploadUniform(glUniform1f, materialLoc_.specularIntensity_,
+                              material_->specularIntensity_);
 
             if (materialLoc_.ambientIntensity_ != -1)
-                glUniform1f(materialLoc_.ambientIntensity_,
-                            material_->ambientIntensity_);
+                UploadUniform(glUniform1f, materialLoc_.ambientIntensity_,
+                              material_->ambientIntensity_);
 
             if (materialLoc_.shininess_ != -1)
-                glUniform1f(materialLoc_.shininess_, material_->shininess_);
+                UploadUniform(glUniform1f, materialLoc_.shininess_,
+                              material_->shininess_);
 
             if (materialLoc_.emitIntensity_ != -1)
-                glUniform1f(materialLoc_.emitIntensity_,
-                            material_->emitIntensity_);
+                UploadUniform(glUniform1f, materialLoc_.emitIntensity_,
+                              material_->emitIntensity_);
 
             if (blendMode_loc_ != -1)
-                glUniform1i(blendMode_loc_,
-                            (int)material_->GetFilterBlendMode());
+                UploadUniform(glUniform1i, blendMode_loc_,
+                              (int)material_->GetFilterBlendMode());
 
             if (blurFilterLoc_.blurDir_ != -1)
-                glUniform2fv(blurFilterLoc_.blurDir_, 1,
-                             &material_->blurFilter_.blurDir_[0]);
+                UploadUniform(glUniform2fv, blurFilterLoc_.blurDir_, 1,
+                              &material_->blurFilter_.blurDir_[0]);
 
             if (blurFilterLoc_.blurRadius_ != -1)
-                glUniform2fv(blurFilterLoc_.blurRadius_, 1,
-                             &material_->blurFilter_.blurRadius_[0]);
+                UploadUniform(glUniform2fv, blurFilterLoc_.blurRadius_, 1,
+                              &material_->blurFilter_.blurRadius_[0]);
 
             if (blurFilterLoc_.sigma_ != -1)
-                glUniform1f(blurFilterLoc_.sigma_,
-                            material_->blurFilter_.sigma_);
+                UploadUniform(glUniform1f, blurFilterLoc_.sigma_,
+                              material_->blurFilter_.sigma_);
 
             if (wavesFilterLoc_.factor_ != -1)
-                glUniform1f(wavesFilterLoc_.factor_,
-                            material_->waveFilter_.factor_);
+                UploadUniform(glUniform1f, wavesFilterLoc_.factor_,
+                              material_->waveFilter_.factor_);
 
             if (wavesFilterLoc_.offset_ != -1)
-                glUniform1f(wavesFilterLoc_.offset_,
-                            material_->waveFilter_.offset_);
+                UploadUniform(glUniform1f, wavesFilterLoc_.offset_,
+                              material_->waveFilter_.offset_);
 
             if (shockWaveFilterLoc_.center_ != -1)
-                glUniform2fv(shockWaveFilterLoc_.center_, 1,
-                             &material_->shockWaveFilter_.center_[0]);
+                UploadUniform(glUniform2fv, shockWaveFilterLoc_.center_, 1,
+                              &material_->shockWaveFilter_.center_[0]);
 
             if (shockWaveFilterLoc_.time_ != -1)
-                glUniform1f(shockWaveFilterLoc_.time_,
-                            material_->shockWaveFilter_.time_);
+                UploadUniform(glUniform1f, shockWaveFilterLoc_.time_,
+                              material_->shockWaveFilter_.time_);
 
             if (shockWaveFilterLoc_.params_ != -1)
-                glUniform3fv(shockWaveFilterLoc_.params_, 1,
-                             &material_->shockWaveFilter_.params_[0]);
+                UploadUniform(glUniform3fv, shockWaveFilterLoc_.params_, 1,
+                              &material_->shockWaveFilter_.params_[0]);
         }
     }
 }
 
 void Program::SetSkeletonVariables() {
     if (skeleton_) {
-        const std::vector<std::string>& names = skeleton_->GetShaderOrder();
-        size_t nBones = names.size();
-        PNode armatureNode = node_->GetArmature();
+        auto armatureNode = node_->GetArmature();
         auto ctx = RenderingContext::GetSharedPtr();
         CHECK_ASSERT(ctx->GetMesh()->HasDeformBones());
         CHECK_ASSERT(armatureNode);
-        Matrix4 globalInverseModelMatrix(1);
-        // In order to make all the bones relatives to the armature.
+        // The bones are relatives to the armature.
         // The model matrix and normal matrix for the active node is
         // premultiplied in the shader (see Program::SetNodeVariables)
         // See in Transform.glsl: GetModelMatrix() and GetWorldNormal()
-        globalInverseModelMatrix = armatureNode->GetGlobalModelInvMatrix();
+        // Be careful, bones don't have normal matrix so their scale must be
+        // uniform (sx == sy == sz)
+        // The palette is shared by every pass and light of the frame
+        auto& palette = armatureNode->GetBonePalette(ctx->GetFrame());
+        auto nBones = std::min(palette.size(), bonesBaseLoc_.size());
         CHECK_GL_STATUS();
-        for (unsigned idx = 0; idx < nBones; idx++) {
-            GLuint boneLoc = bonesBaseLoc_[idx];
-            std::string boneName = names[idx];
-            auto bone = armatureNode->GetChild<Node>(boneName, true);
-            // Be careful, bones don't have normal matrix so their scale must be
-            // uniform (sx == sy == sz)
-            // CHECK_ASSERT(bone->IsScaleUniform());
-            const Matrix4& m = bone->GetGlobalModelMatrix();
-            const Matrix4& offsetMatrix =
-                skeleton_->GetBoneOffsetMatrix(boneName);
-            Matrix4 boneMatrix(globalInverseModelMatrix * m * offsetMatrix);
-            glUniformMatrix4fv(boneLoc, 1, GL_FALSE, boneMatrix.GetPointer());
-            // Matrix3 boneMatrix(globalInverseModelMatrix * m * offsetMatrix);
-            // glUniformMatrix3fv(boneLoc, 1, GL_FALSE,
-            // boneMatrix.GetPointer());
-        }
+        if (nBones)
+            UploadUniform(glUniformMatrix4fv, bonesBaseLoc_[0], (GLsizei)nBones,
+                          GL_FALSE, palette[0].GetPointer());
         CHECK_GL_STATUS();
     }
     activeSkeleton_ = skeleton_;
@@ -592,33 +615,36 @@ void Program::SetCameraVariables(bool shadowPass) {
             if (shadowPass) {
                 auto m = AdjustProjection(camera_->GetProjection()) *
                          camera_->GetView();
-                glUniformMatrix4fv(viewProjectionLoc_, 1, GL_FALSE,
-                                   m.GetPointer());
+                UploadUniform(glUniformMatrix4fv, viewProjectionLoc_, 1,
+                              GL_FALSE, m.GetPointer());
             } else {
                 auto& m = camera_->GetViewProjection();
-                glUniformMatrix4fv(viewProjectionLoc_, 1, GL_FALSE,
-                                   m.GetPointer());
+                UploadUniform(glUniformMatrix4fv, viewProjectionLoc_, 1,
+                              GL_FALSE, m.GetPointer());
             }
         }
 
         if (viewLoc_ != -1) {
             auto& m = camera_->GetView();
-            glUniformMatrix4fv(viewLoc_, 1, GL_FALSE, m.GetPointer());
+            UploadUniform(glUniformMatrix4fv, viewLoc_, 1, GL_FALSE,
+                          m.GetPointer());
         }
 
         if (projectionLoc_ != -1) {
             if (shadowPass) {
                 auto m = AdjustProjection(camera_->GetProjection());
-                glUniformMatrix4fv(projectionLoc_, 1, GL_FALSE, m.GetPointer());
+                UploadUniform(glUniformMatrix4fv, projectionLoc_, 1, GL_FALSE,
+                              m.GetPointer());
             } else {
                 auto& m = camera_->GetProjection();
-                glUniformMatrix4fv(projectionLoc_, 1, GL_FALSE, m.GetPointer());
+                UploadUniform(glUniformMatrix4fv, projectionLoc_, 1, GL_FALSE,
+                              m.GetPointer());
             }
         }
 
         if (eyeWorldPosLoc_ != -1) {
             auto& position = camera_->GetGlobalPosition();
-            glUniform3fv(eyeWorldPosLoc_, 1, &position[0]);
+            UploadUniform(glUniform3fv, eyeWorldPosLoc_, 1, &position[0]);
         }
     }
 }
@@ -628,14 +654,16 @@ void Program::SetLightShadowVariables(bool) {
         if (activeLight_ != light_ || light_->UniformsNeedUpdate()) {
             if (lightDirectionLoc_ != -1) {
                 const Vertex3& direction = light_->GetLookAtDirection();
-                glUniform3fv(lightDirectionLoc_, 1, &direction[0]);
+                UploadUniform(glUniform3fv, lightDirectionLoc_, 1,
+                              &direction[0]);
             }
         }
 
         if (lightInvRangeLoc_ != -1) {
             // lightInvRangeLoc_ only used for point and spot lights
             CHECK_ASSERT(light_->GetType() != LightType::DIRECTIONAL);
-            glUniform1f(lightInvRangeLoc_, light_->GetInvRange());
+            UploadUniform(glUniform1f, lightInvRangeLoc_,
+                          light_->GetInvRange());
         }
 
         if (shadowCameraZFarLoc_ != -1) {
@@ -652,8 +680,8 @@ void Program::SetLightShadowVariables(bool) {
             }
 
             if (uniformsNeedUpdate) {
-                glUniform4fv(shadowCameraZFarLoc_, 1,
-                             &shadowCameraZFarSplits[0]);
+                UploadUniform(glUniform4fv, shadowCameraZFarLoc_, 1,
+                              &shadowCameraZFarSplits[0]);
                 // LOGI("zFar = %f %f %f %f", shadowCameraZFarSplits[0],
                 // shadowCameraZFarSplits[1], shadowCameraZFarSplits[2],
                 // shadowCameraZFarSplits[3]);
@@ -669,14 +697,14 @@ void Program::SetLightVariables() {
         if (light_->DoShadows()) {
             if (shadowColor_ != -1) {
                 const Color& color = light_->GetShadowColor();
-                glUniform4fv(shadowColor_, 1, &color[0]);
+                UploadUniform(glUniform4fv, shadowColor_, 1, &color[0]);
             }
 
 #if 0
                 if (shadowBias_ != -1)
                 {
                     auto bias = material_->GetBias() * light_->GetBias();
-                    glUniform1f(shadowBias_, bias);
+                    UploadUniform(glUniform1f, shadowBias_, bias);
                 }
 #endif
             if (shadowMapInvSize_ != -1) {
@@ -687,29 +715,31 @@ void Program::SetLightVariables() {
                     // CHECK_ASSERT(width > 0);
                     shadowMapsInvSize[i] = 1.f / width;
                 }
-                glUniform4fv(shadowMapInvSize_, 1, &shadowMapsInvSize[0]);
+                UploadUniform(glUniform4fv, shadowMapInvSize_, 1,
+                              &shadowMapsInvSize[0]);
             }
 
             for (int i = 0; i < shadowSplits; i++) {
                 if (lightViewLoc_[i] != -1) {
                     auto shadowCamera = light_->GetShadowCamera(i);
                     auto& m = shadowCamera->GetView();
-                    glUniformMatrix4fv(lightViewLoc_[i], 1, GL_FALSE,
-                                       m.GetPointer());
+                    UploadUniform(glUniformMatrix4fv, lightViewLoc_[i], 1,
+                                  GL_FALSE, m.GetPointer());
                 }
 
                 if (lightProjectionLoc_[i] != -1) {
                     auto shadowCamera = light_->GetShadowCamera(i);
                     auto& m = shadowCamera->GetProjection();
-                    glUniformMatrix4fv(lightProjectionLoc_[i], 1, GL_FALSE,
-                                       m.GetPointer());
+                    UploadUniform(glUniformMatrix4fv, lightProjectionLoc_[i], 1,
+                                  GL_FALSE, m.GetPointer());
                 }
 
                 if (lightViewProjectionLoc_[i] != -1) {
                     auto shadowCamera = light_->GetShadowCamera(i);
                     auto& m = shadowCamera->GetViewProjection();
-                    glUniformMatrix4fv(lightViewProjectionLoc_[i], 1, GL_FALSE,
-                                       m.GetPointer());
+                    UploadUniform(glUniformMatrix4fv,
+                                  lightViewProjectionLoc_[i], 1, GL_FALSE,
+                                  m.GetPointer());
                 }
 
                 int index = (int)MaterialTexture::SHADOW_MAP0 + i;
@@ -723,24 +753,26 @@ void Program::SetLightVariables() {
 
         if (lightPositionLoc_ != -1) {
             auto& position = light_->GetGlobalPosition();
-            glUniform3fv(lightPositionLoc_, 1, &position[0]);
+            UploadUniform(glUniform3fv, lightPositionLoc_, 1, &position[0]);
         }
 
         if (activeLight_ != light_ || light_->UniformsNeedUpdate()) {
             if (lightDiffuseColorLoc_ != -1) {
                 const Color& diffuse = light_->GetDiffuseColor();
-                glUniform4fv(lightDiffuseColorLoc_, 1, &diffuse[0]);
+                UploadUniform(glUniform4fv, lightDiffuseColorLoc_, 1,
+                              &diffuse[0]);
             }
 
             if (lightSpecularColorLoc_ != -1) {
                 const Color& specular = light_->GetSpecularColor();
-                glUniform4fv(lightSpecularColorLoc_, 1, &specular[0]);
+                UploadUniform(glUniform4fv, lightSpecularColorLoc_, 1,
+                              &specular[0]);
             }
 
             if (lightCutOffLoc_ != -1) {
                 float cutOff = light_->GetSpotCutOff() * 0.5f;
                 float value = Cos(Radians(cutOff));
-                glUniform1f(lightCutOffLoc_, value);
+                UploadUniform(glUniform1f, lightCutOffLoc_, value);
             }
         }
     }
@@ -824,8 +856,9 @@ std::string Program::GetShaderVariation(const Pass* pass, const Scene* scene,
                                         const Camera* camera, const Mesh* mesh,
                                         const Material* material,
                                         const Light* light,
-                                        const SceneNode* sceneNode) {
-    bool allowInstancing = sceneNode == nullptr;
+                                        const SceneNode* sceneNode,
+                                        bool instanced) {
+    bool allowInstancing = sceneNode == nullptr || instanced;
 #if defined(IS_TARGET_MOBILE)
     std::string defines = "IS_TARGET_MOBILE\n";
 #elif defined(IS_TARGET_WEB)
@@ -854,4 +887,103 @@ std::string Program::GetShaderVariation(const Pass* pass, const Scene* scene,
 
     return defines;
 }
+
+ProgramKey Program::GetShaderVariationKey(const Pass* pass, const Scene* scene,
+                                          const Camera* camera,
+                                          const Mesh* mesh,
+                                          const Material* material,
+                                          const Light* light,
+                                          const SceneNode* sceneNode,
+                                          bool instanced) {
+    ++cacheStats_.keys_;
+    // flags layout (see GetShaderVariation):
+    // bits 0-1: pass type
+    // bit 2: instancing
+    // bits 3-4: scene
+    // bits 5-8: camera
+    // bits 9-12: light
+    ProgramKey key;
+    auto passType = pass->GetType();
+    key.flags_ = (unsigned)passType;
+
+    if (scene)
+        key.flags_ |= scene->GetVariationFlags(passType) << 3;
+
+    if (camera)
+        key.flags_ |= camera->GetVariationFlags(passType) << 5;
+
+    if (material) {
+        bool allowInstancing = sceneNode == nullptr || instanced;
+        if (mesh->IsStatic() && allowInstancing)
+            key.flags_ |= 1 << 2;
+        key.material_ = material->GetVariationStamp();
+        key.mesh_ = mesh->GetVariationStamp();
+    }
+
+    if (sceneNode)
+        key.skeleton_ = sceneNode->GetVariationStamp();
+
+    if (light)
+        key.flags_ |= light->GetVariationFlags(passType, material) << 9;
+
+    return key;
+}
+
+PProgram Program::GetOrCreateVariation(const Pass* pass, const Scene* scene,
+                                       const Camera* camera, const Mesh* mesh,
+                                       const Material* material,
+                                       const Light* light,
+                                       const SceneNode* sceneNode,
+                                       bool instanced) {
+    auto key = GetShaderVariationKey(pass, scene, camera, mesh, material,
+                                     light, sceneNode, instanced);
+    auto it = variations_.find(key);
+    if (it != variations_.end()) {
+        ++cacheStats_.lookups_;
+        return it->second;
+    }
+    ++cacheStats_.defines_;
+    auto defines = GetShaderVariation(pass, scene, camera, mesh, material,
+                                      light, sceneNode, instanced);
+    auto program = GetOrCreate(defines);
+    if (variations_.size() >= MAX_VARIATIONS) {
+        variations_.clear();
+        owners_.clear();
+    }
+    variations_.insert(Variations::value_type(key, program));
+    if (material) {
+        AddVariationOwner(material, key.material_, key);
+        AddVariationOwner(mesh, key.mesh_, key);
+    }
+    if (key.skeleton_)
+        AddVariationOwner(sceneNode->GetArmature()->GetSkeleton().get(),
+                          key.skeleton_, key);
+    return program;
+}
+
+void Program::AddVariationOwner(const void* owner, unsigned stamp,
+                                const ProgramKey& key) {
+    auto& obj = owners_[owner];
+    if (obj.stamp_ != stamp) {
+        for (auto& oldKey : obj.keys_)
+            variations_.erase(oldKey);
+        obj.keys_.clear();
+        obj.stamp_ = stamp;
+    } else if (obj.keys_.size() >= 16 &&
+               (obj.keys_.size() & (obj.keys_.size() - 1)) == 0) {
+        // drop the keys already evicted through other owners
+        auto it = std::remove_if(
+            obj.keys_.begin(), obj.keys_.end(), [](const ProgramKey& k) {
+                return variations_.find(k) == variations_.end();
+            });
+        obj.keys_.erase(it, obj.keys_.end());
+    }
+    obj.keys_.push_back(key);
+}
+
+void Program::Clear() {
+    variations_.clear();
+    owners_.clear();
+    StrongFactory<std::string, Program>::Clear();
+}
 }
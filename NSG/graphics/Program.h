@@ -27,14 +27,41 @@ misrepresented as being the original software.
 
 #include "Color.h"
 #include "Object.h"
+#include "Profiler.h"
 #include "ResourceFile.h"
 #include "ShadowCamera.h"
 #include "StrongFactory.h"
 #include "Types.h"
 #include <string>
+#include <unordered_map>
 
 namespace NSG {
 struct ExtraUniforms;
+
+// Compact identifier of a shader variation.
+// Built per draw from cheap flags and variation stamps (see
+// NewVariationStamp), so the defines string is only generated when the key
+// is not found in the cache.
+struct ProgramKey {
+    unsigned flags_;
+    unsigned material_;
+    unsigned mesh_;
+    unsigned skeleton_;
+    ProgramKey();
+    bool operator==(const ProgramKey& obj) const;
+};
+
+struct ProgramKeyHash {
+    size_t operator()(const ProgramKey& key) const;
+};
+
+struct ProgramCacheStats {
+    size_t keys_;    // variation keys built
+    size_t lookups_; // keys found in the cache
+    size_t defines_; // defines strings generated (cache misses)
+    ProgramCacheStats();
+};
+
 class Program : public Object, public StrongFactory<std::string, Program> {
 public:
     Program(const std::string& defines);
@@ -62,13 +89,43 @@ public:
     GLuint GetId() const { return id_; }
     Material* GetMaterial() const { return material_; }
     const std::string& GetName() const { return name_; }
+    // Sequential: groups the draws using this program (see RenderQueue)
+    unsigned GetSortId() const { return sortId_; }
     void SetNodeVariables();
+    // Without sceneNode the variation is instanced. A skinned sceneNode is
+    // instanced when all the instances share its palette (see AnimationCrowd)
     static std::string GetShaderVariation(const Pass* pass, const Scene* scene,
                                           const Camera* camera,
                                           const Mesh* mesh,
                                           const Material* material,
                                           const Light* light,
-                                          const SceneNode* sceneNode);
+                                          const SceneNode* sceneNode,
+                                          bool instanced = false);
+    static ProgramKey GetShaderVariationKey(const Pass* pass,
+                                            const Scene* scene,
+                                            const Camera* camera,
+                                            const Mesh* mesh,
+                                            const Material* material,
+                                            const Light* light,
+                                            const SceneNode* sceneNode,
+                                            bool instanced = false);
+    static PProgram GetOrCreateVariation(const Pass* pass, const Scene* scene,
+                                         const Camera* camera,
+                                         const Mesh* mesh,
+                                         const Material* material,
+                                         const Light* light,
+                                         const SceneNode* sceneNode,
+                                         bool instanced = false);
+    static void Clear();
+    static size_t GetVariationsCount() { return variations_.size(); }
+    static const ProgramCacheStats& GetCacheStats() { return cacheStats_; }
+    static void ResetCacheStats() { cacheStats_ = ProgramCacheStats(); }
+    // Every uniform upload goes through it, so the profiler counts them
+    template <typename F, typename... Args>
+    static void UploadUniform(F function, Args... args) {
+        PROFILE_COUNT(UNIFORM_UPLOADS, 1);
+        function(args...);
+    }
 
 private:
     bool ReduceShaderComplexity();
@@ -195,5 +252,22 @@ private:
     const Light* light_;
     const Camera* camera_;
     const Scene* scene_;
+    unsigned sortId_;
+
+    static void AddVariationOwner(const void* owner, unsigned stamp,
+                                  const ProgramKey& key);
+
+    typedef std::unordered_map<ProgramKey, PProgram, ProgramKeyHash> Variations;
+    static Variations variations_;
+    // Keys using the current stamp of each material, mesh and skeleton.
+    // The keys of an old stamp are evicted when the owner gets a new one.
+    struct VariationOwner {
+        unsigned stamp_;
+        std::vector<ProgramKey> keys_;
+        VariationOwner();
+    };
+    typedef std::unordered_map<const void*, VariationOwner> VariationOwners;
+    static VariationOwners owners_;
+    static ProgramCacheStats cacheStats_;
 };
 }
@@ -0,0 +1,138 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "RenderQueue.h"
+#include "Check.h"
+#include "Material.h"
+#include "Maths.h"
+#include "Mesh.h"
+#include "SceneNode.h"
+
+namespace NSG {
+static const int MESH_SHIFT = RenderQueue::DEPTH_BITS;
+static const int MATERIAL_SHIFT = MESH_SHIFT + RenderQueue::MESH_BITS;
+static const int VARIATION_SHIFT = MATERIAL_SHIFT + RenderQueue::MATERIAL_BITS;
+static const int PASS_SHIFT = VARIATION_SHIFT + RenderQueue::VARIATION_BITS;
+static_assert(PASS_SHIFT + RenderQueue::PASS_BITS == 64, "Invalid key size");
+
+// Pointers are folded to a few bits: a collision only costs an extra batch
+static uint64_t HashPointer(const void* pointer, int bits) {
+    auto value = (uint64_t)(uintptr_t)pointer * 0x9e3779b97f4a7c15ull;
+    return value >> (64 - bits);
+}
+
+static uint64_t Mask(int bits) { return (uint64_t(1) << bits) - 1; }
+
+RenderQueue::RenderQueue(bool depthFirst) : depthFirst_(depthFirst) {}
+
+RenderQueue::~RenderQueue() {}
+
+uint64_t RenderQueue::GetKey(unsigned variation, const Material* material,
+                             const Mesh* mesh) {
+    return ((variation & Mask(VARIATION_BITS)) << VARIATION_SHIFT) |
+           (HashPointer(material, MATERIAL_BITS) << MATERIAL_SHIFT) |
+           (HashPointer(mesh, MESH_BITS) << MESH_SHIFT);
+}
+
+uint64_t RenderQueue::GetKey(uint64_t nodeKey, float depth, unsigned pass) {
+    auto quantizedDepth =
+        (uint64_t)(Clamp(depth, 0.f, 1.f) * Mask(DEPTH_BITS));
+    return ((pass & Mask(PASS_BITS)) << PASS_SHIFT) | nodeKey | quantizedDepth;
+}
+
+uint64_t RenderQueue::GetDepthFirstKey(uint64_t nodeKey, float depth,
+                                       unsigned pass) {
+    auto quantizedDepth =
+        (uint64_t)(Clamp(depth, 0.f, 1.f) * Mask(DEPTH_BITS));
+    return ((pass & Mask(PASS_BITS)) << PASS_SHIFT) |
+           (quantizedDepth << (PASS_SHIFT - DEPTH_BITS)) |
+           (nodeKey >> DEPTH_BITS);
+}
+
+void RenderQueue::Clear() {
+    items_.clear();
+    batches_.clear();
+}
+
+void RenderQueue::Add(SceneNode* node, float depth, unsigned pass) {
+    if (node->GetMaterial() && node->GetMesh()) {
+        if (depthFirst_) {
+            items_.push_back(
+                {GetDepthFirstKey(node->GetRenderKey(), depth, pass), node});
+            return;
+        }
+        auto key = GetKey(node->GetRenderKey(), depth, pass);
+        // The armatures of a crowd are sorted by pose instead of by depth:
+        // each pose is a batch drawn instanced (see AnimationCrowd)
+        auto armature = node->GetArmature();
+        auto pose = armature ? armature->GetSharedPose() : nullptr;
+        if (pose)
+            key = (key & ~Mask(DEPTH_BITS)) | HashPointer(pose, DEPTH_BITS);
+        items_.push_back({key, node});
+    }
+}
+
+void RenderQueue::Sort() {
+    // LSD radix sort, one byte per pass. Bytes shared by all the keys (as the
+    // pass or the variation in a queue with a single material) are skipped.
+    auto n = items_.size();
+    sorted_.resize(n);
+    for (int shift = 0; n && shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (auto& item : items_)
+            ++offsets[(item.key_ >> shift) & 0xff];
+        if (offsets[(items_[0].key_ >> shift) & 0xff] == n)
+            continue;
+        size_t offset = 0;
+        for (auto& count : offsets) {
+            auto bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+        for (auto& item : items_)
+            sorted_[offsets[(item.key_ >> shift) & 0xff]++] = item;
+        items_.swap(sorted_);
+    }
+
+    nodes_.resize(n);
+    for (size_t i = 0; i < n; i++)
+        nodes_[i] = items_[i].node_;
+
+    batches_.clear();
+    size_t first = 0;
+    for (size_t i = 1; i <= n; i++) {
+        auto material = nodes_[first]->GetMaterial().get();
+        auto mesh = nodes_[first]->GetMesh().get();
+        if (i < n && i - first < Batch::MaxNodesInBatch &&
+            items_[i].key_ >> PASS_SHIFT == items_[first].key_ >> PASS_SHIFT &&
+            nodes_[i]->GetMaterial().get() == material &&
+            nodes_[i]->GetMesh().get() == mesh &&
+            nodes_[i]->GetPaletteNode() == nodes_[first]->GetPaletteNode())
+            continue;
+        batches_.push_back(Batch(material, mesh, &nodes_[first], i - first));
+        first = i;
+    }
+}
+}
@@ -0,0 +1,74 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Batch.h"
+#include "Types.h"
+#include <cstdint>
+#include <vector>
+
+namespace NSG {
+// Drawables sorted by a packed 64 bits key and split in batches.
+// From the most to the least significant bits the key holds:
+// pass | program variation | material | mesh | depth
+// A depth first queue (for blending) holds instead:
+// pass | depth | program variation | material | mesh
+// The arrays are reused between frames, so once they have grown filling and
+// sorting the queue does not allocate. The batches are ranges of the sorted
+// nodes: they are valid until the queue is cleared.
+class RenderQueue {
+public:
+    static const int PASS_BITS = 4;
+    static const int VARIATION_BITS = 12;
+    static const int MATERIAL_BITS = 16;
+    static const int MESH_BITS = 16;
+    static const int DEPTH_BITS = 16;
+    explicit RenderQueue(bool depthFirst = false);
+    ~RenderQueue();
+    void Clear();
+    // depth in [0, 1] is drawn front to back (use 1 - depth for back to front)
+    void Add(SceneNode* node, float depth, unsigned pass = 0);
+    void Sort();
+    const std::vector<Batch>& GetBatches() const { return batches_; }
+    size_t GetSize() const { return items_.size(); }
+    // Material, mesh and variation part of the key (see SceneNode)
+    static uint64_t GetKey(unsigned variation, const Material* material,
+                           const Mesh* mesh);
+    static uint64_t GetKey(uint64_t nodeKey, float depth, unsigned pass);
+    static uint64_t GetDepthFirstKey(uint64_t nodeKey, float depth,
+                                     unsigned pass);
+
+private:
+    bool depthFirst_;
+    struct Item {
+        uint64_t key_;
+        SceneNode* node_;
+    };
+    std::vector<Item> items_;
+    std::vector<Item> sorted_;
+    std::vector<SceneNode*> nodes_;
+    std::vector<Batch> batches_;
+};
+}
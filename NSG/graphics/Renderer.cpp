@@ -27,14 +27,18 @@ misrepresented as being the original software.
 #include "FrameBuffer.h"
 #include "Frustum.h"
 #include "InstanceBuffer.h"
+#include "Light.h"
 #include "LinesMesh.h"
 #include "Material.h"
 #include "Maths.h"
 #include "Node.h"
+#include "ParticleSystem.h"
 #include "Pass.h"
 #include "PhysicsWorld.h"
+#include "Profiler.h"
 #include "Program.h"
 #include "QuadMesh.h"
+#include "RenderingCapabilities.h"
 #include "RenderingContext.h"
 #include "Scene.h"
 #include "SceneNode.h"
@@ -42,6 +46,7 @@ misrepresented as being the original software.
 #include "SharedFromPointer.h"
 #include "Texture.h"
 #include "Window.h"
+#include <algorithm>
 
 namespace NSG {
 Renderer::Renderer()
@@ -52,7 +57,8 @@ Renderer::Renderer()
       debugRenderer_(std::make_shared<DebugRenderer>()),
       contextType_(RendererContext::DEFAULT),
       overlaysCamera_(std::make_shared<Camera>("NSGOverlays")),
-      instanceBuffer_(new InstanceBuffer()) {
+      instanceBuffer_(new InstanceBuffer()),
+      transparentQueue_(true) { // blended back to front across materials
     CHECK_CONDITION(instanceBuffer_->IsReady());
     debugMaterial_->SetSerializable(false);
 
@@ -109,9 +115,9 @@ Renderer::Renderer()
 
 Renderer::~Renderer() {}
 
-inline std::vector<SceneNode*>
-Renderer::ExtractTransparent(const std::vector<SceneNode*>& objs) {
-    std::vector<SceneNode*> result;
+inline FrameVector<SceneNode*>
+Renderer::ExtractTransparent(const FrameVector<SceneNode*>& objs) {
+    FrameVector<SceneNode*> result;
     for (auto& node : objs) {
         auto material = node->GetMaterial();
         if (material && material->IsTransparent())
@@ -120,8 +126,8 @@ Renderer::ExtractTransparent(const std::vector<SceneNode*>& objs) {
     return result;
 }
 
-inline void Renderer::RemoveFrom(std::vector<SceneNode*>& from,
-                                 const std::vector<SceneNode*>& objs) {
+inline void Renderer::RemoveFrom(FrameVector<SceneNode*>& from,
+                                 const FrameVector<SceneNode*>& objs) {
     auto condition = [&](SceneNode* node) {
         return objs.end() != std::find(objs.begin(), objs.end(), node);
     };
@@ -129,9 +135,9 @@ inline void Renderer::RemoveFrom(std::vector<SceneNode*>& from,
     from.erase(std::remove_if(from.begin(), from.end(), condition), from.end());
 }
 
-inline std::vector<SceneNode*>
-Renderer::ExtractFiltered(const std::vector<SceneNode*>& objs) {
-    std::vector<SceneNode*> result;
+inline FrameVector<SceneNode*>
+Renderer::ExtractFiltered(const FrameVector<SceneNode*>& objs) {
+    FrameVector<SceneNode*> result;
     for (auto& node : objs) {
         if (node->HasFilter())
             result.push_back(node);
@@ -139,26 +145,6 @@ Renderer::ExtractFiltered(const std::vector<SceneNode*>& objs) {
     return result;
 }
 
-void Renderer::GetLightedBatches(const std::vector<Batch>& iBatches,
-                                 std::vector<const Batch*>& result) const {
-    CHECK_ASSERT(result.empty());
-    for (auto& batch : iBatches)
-        if (batch.GetMaterial()->IsLighted())
-            result.push_back(&batch);
-}
-
-void Renderer::SortTransparentBackToFront(std::vector<SceneNode*>& objs) {
-    Vector3 cameraPos;
-    if (camera_)
-        cameraPos = camera_->GetGlobalPosition();
-    std::sort(objs.begin(), objs.end(),
-              [&](const SceneNode* a, const SceneNode* b) -> bool {
-                  auto da = a->GetGlobalPosition().Distance2(cameraPos);
-                  auto db = b->GetGlobalPosition().Distance2(cameraPos);
-                  return db < da;
-              });
-}
-
 void Renderer::SortOverlaysBackToFront(std::vector<SceneNode*>& objs) {
     Vector3 cameraPos(overlaysCamera_->GetGlobalPosition());
     std::sort(objs.begin(), objs.end(),
@@ -169,98 +155,51 @@ void Renderer::SortOverlaysBackToFront(std::vector<SceneNode*>& objs) {
               });
 }
 
-void Renderer::SortSolidFrontToBack(std::vector<SceneNode*>& objs) {
+// The depth goes in the lowest bits of the keys, so it only orders the nodes
+// sharing material and mesh
+void Renderer::FillQueue(RenderQueue& queue, SceneNode* const* objs,
+                         size_t nObjs, const Camera* camera,
+                         bool backToFront) {
+    queue.Clear();
     Vector3 cameraPos;
-    if (camera_)
-        cameraPos = camera_->GetGlobalPosition();
-    std::sort(objs.begin(), objs.end(),
-              [&](const SceneNode* a, const SceneNode* b) -> bool {
-                  auto da = a->GetGlobalPosition().Distance2(cameraPos);
-                  auto db = b->GetGlobalPosition().Distance2(cameraPos);
-                  return da < db;
-              });
+    float invFar = 0;
+    if (camera) {
+        cameraPos = camera->GetGlobalPosition();
+        if (camera->GetZFar() > 0)
+            invFar = 1.f / camera->GetZFar();
+    }
+    for (size_t i = 0; i < nObjs; i++) {
+        auto node = objs[i];
+        auto depth = node->GetGlobalPosition().Distance(cameraPos) * invFar;
+        queue.Add(node, backToFront ? 1.f - depth : depth);
+    }
+    queue.Sort();
 }
 
-void Renderer::GenerateBatches(std::vector<SceneNode*>& visibles,
+void Renderer::GenerateBatches(const std::vector<SceneNode*>& visibles,
                                std::vector<Batch>& batches) {
-    batches.clear();
-
-    struct MeshNode {
-        PMesh mesh_;
-        SceneNode* node_;
-    };
-
-    struct MaterialData {
-        PMaterial material_;
-        std::vector<MeshNode> data_;
-    };
-
-    std::sort(visibles.begin(), visibles.end(),
-              [](const SceneNode* a, const SceneNode* b) -> bool {
-                  return a->GetMaterial().get() < b->GetMaterial().get();
-              });
-
-    std::vector<MaterialData> materials;
-    PMaterial usedMaterial;
-    for (auto& node : visibles) {
-        PMaterial material = node->GetMaterial();
-        if (!material)
-            continue;
-        auto mesh = node->GetMesh();
-        if (usedMaterial != material) {
-            usedMaterial = material;
-            MaterialData materialData;
-            materialData.material_ = material;
-            materialData.data_.push_back({mesh, node});
-            if (!materials.empty()) {
-                MaterialData& lastMaterialData = materials.back();
-                std::sort(lastMaterialData.data_.begin(),
-                          lastMaterialData.data_.end(),
-                          [](const MeshNode& a, const MeshNode& b) -> bool {
-                              return a.mesh_.get() < b.mesh_.get();
-                          });
-            }
-            materials.push_back(materialData);
-        } else {
-            MaterialData& lastMaterial = materials.back();
-            lastMaterial.data_.push_back({mesh, node});
-        }
-    }
-
-    for (auto& material : materials) {
-        PMesh usedMesh;
-        for (auto& obj : material.data_) {
-            bool limitReached =
-                batches.size() &&
-                batches.back().GetNodes().size() >= Batch::MaxNodesInBatch;
-            if (obj.mesh_ != usedMesh || !obj.mesh_ || limitReached) {
-                usedMesh = obj.mesh_;
-                Batch batch(material.material_.get(), usedMesh.get());
-                batch.Add(obj.node_);
-                batches.push_back(batch);
-            } else {
-                auto& lastBatch = batches.back();
-                lastBatch.Add(obj.node_);
-            }
-        }
-    }
+    FillQueue(batchesQueue_, visibles.data(), visibles.size(), camera_, false);
+    batches = batchesQueue_.GetBatches();
 }
 
-void Renderer::DrawShadowPass(Batch* batch, const Light* light,
+void Renderer::DrawShadowPass(const Batch* batch, const Light* light,
                               const ShadowCamera* camera) {
     Draw(batch, &shadowPass_, light, camera);
 }
 
 void Renderer::Draw(const Batch* batch, const Pass* pass, const Light* light,
                     const Camera* camera) {
+    PROFILE_COUNT(BATCHES, 1);
     context_->SetMesh(batch->GetMesh());
     if (batch->AllowInstancing()) {
-        if (context_->SetupProgram(pass, scene_, camera, nullptr,
-                                   batch->GetMaterial(), light))
+        // skinned instances share the palette of the first one
+        auto first = *batch->begin();
+        auto node = first->GetPaletteNode() ? first : nullptr;
+        if (context_->SetupProgram(pass, scene_, camera, node,
+                                   batch->GetMaterial(), light, true))
             context_->DrawInstancedActiveMesh(*batch, instanceBuffer_.get());
     } else {
-        auto& nodes = batch->GetNodes();
-        for (auto& node : nodes) {
+        for (auto node : *batch) {
             if (context_->SetupProgram(pass, scene_, camera, node,
                                        batch->GetMaterial(), light))
                 context_->DrawActiveMesh();
@@ -317,12 +256,12 @@ int Renderer::CalculateSplits(const Camera* camera,
 
 void Renderer::GenerateShadowMapCubeFace(const Light* light) {
     auto shadowCamera = light->GetShadowCamera(0);
-    std::vector<SceneNode*> shadowCasters;
-    shadowCamera->GetVisiblesShadowCasters(shadowCasters);
-    std::vector<Batch> batches;
-    GenerateBatches(shadowCasters, batches);
+    shadowCasters_.clear();
+    shadowCamera->GetVisiblesShadowCasters(shadowCasters_);
+    FillQueue(shadowQueue_, shadowCasters_.data(), shadowCasters_.size(),
+              shadowCamera, false);
     context_->ClearBuffers(true, true, false);
-    for (auto& batch : batches)
+    for (auto& batch : shadowQueue_.GetBatches())
         if (batch.GetMaterial()->CastShadow())
             DrawShadowPass(&batch, light, shadowCamera);
 }
@@ -355,20 +294,29 @@ void Renderer::GenerateCubeShadowMap(const Camera* camera, const Light* light) {
     }
 }
 
-void Renderer::Generate2DShadowMap(int split, const Light* light) {
+void Renderer::Generate2DShadowMap(int split, const Light* light,
+                                   const std::vector<SceneNode*>* visibles) {
     auto shadowFrameBuffer = light->GetShadowFrameBuffer(split);
     auto splitMapsize = GetShadowFrameBufferSize(split);
     shadowFrameBuffer->SetSize(splitMapsize, splitMapsize);
     if (shadowFrameBuffer->IsReady()) {
         auto shadowCamera = light->GetShadowCamera(split);
-        std::vector<SceneNode*> shadowCasters;
-        shadowCamera->GetVisiblesShadowCasters(shadowCasters);
+        auto& shadowCasters = shadowCasters_;
+        shadowCasters.clear();
+        if (visibles) {
+            for (auto visible : *visibles) {
+                auto& material = visible->GetMaterial();
+                if (material && material->IsShadowCaster())
+                    shadowCasters.push_back(visible);
+            }
+        } else
+            shadowCamera->GetVisiblesShadowCasters(shadowCasters);
         auto oldFrameBuffer = context_->SetFrameBuffer(shadowFrameBuffer);
         context_->ClearBuffers(true, true, false);
         if (!shadowCamera->IsDisabled()) {
-            std::vector<Batch> batches;
-            GenerateBatches(shadowCasters, batches);
-            for (auto& batch : batches)
+            FillQueue(shadowQueue_, shadowCasters.data(), shadowCasters.size(),
+                      shadowCamera, false);
+            for (auto& batch : shadowQueue_.GetBatches())
                 if (batch.GetMaterial()->CastShadow())
                     DrawShadowPass(&batch, light, shadowCamera);
         }
@@ -379,7 +327,6 @@ void Renderer::Generate2DShadowMap(int split, const Light* light) {
 void Renderer::GenerateShadowMaps(const Camera* camera, const Light* light) {
     switch (light->GetType()) {
     case LightType::POINT: {
-        std::vector<SceneNode*> shadowCasters;
         auto shadowCamera = light->GetShadowCamera(0);
         shadowCamera->SetupPoint(camera);
         GenerateCubeShadowMap(camera, light);
@@ -413,66 +360,162 @@ void Renderer::GenerateShadowMaps(const Camera* camera, const Light* light) {
             camera, splits, camFullFrustumViewBox, receiversViewBox);
         light->SetShadowSplits(shadowSplits);
         int split = 0;
+        const Frustum* frustums[ShadowCamera::MAX_SPLITS];
         // Setup the shadow camera for each split
         while (split < shadowSplits) {
             if (nearSplit > farZ)
                 break;
             auto farSplit = std::min(farZ, splits[split]);
             auto shadowCamera = light->GetShadowCamera(split);
-            shadowCamera->SetupDirectional(camera, nearSplit, farSplit);
+            shadowCamera->SetupDirectionalSplit(camera, nearSplit, farSplit);
+            frustums[split] = shadowCamera->GetFrustumPointer();
             nearSplit = farSplit;
             ++split;
         }
 
+        // One octree traversal for the receivers and casters bounds of all
+        // the splits and another one for the casters of the final frustums
+        auto scene = light->GetScene().get();
+        auto& results = shadowQueryResults_;
+        scene->GetVisibleNodes(frustums, split, results, false);
+        for (int i = 0; i < split; i++) {
+            auto shadowCamera = light->GetShadowCamera(i);
+            shadowCamera->SetupDirectionalBounds(results[i].receiversBox_,
+                                                 results[i].castersBox_);
+            frustums[i] = shadowCamera->GetFrustumPointer();
+        }
+        scene->GetVisibleNodes(frustums, split, results);
+
         for (int i = 0; i < shadowSplits; i++)
-            Generate2DShadowMap(i, light);
+            Generate2DShadowMap(i, light,
+                                i < split ? &results[i].nodes_ : nullptr);
     } break;
     }
 }
 
 void Renderer::ShadowGenerationPass() {
-    auto lights = scene_->GetLights();
+    PROFILE_ZONE("Renderer::ShadowGenerationPass");
+    auto& lights = scene_->GetLights();
     for (auto light : lights)
         if (light->DoShadows())
             GenerateShadowMaps(camera_, light);
 }
 
-void Renderer::OpaquePasses(std::vector<SceneNode*>& objs) {
-    std::vector<Batch> batches;
-    GenerateBatches(objs, batches);
+void Renderer::GetLightedBatches(const Scene* scene, const Light* light,
+                                 const std::vector<Batch>& batches,
+                                 FrameVector<SceneNode*>& nodes,
+                                 FrameVector<Batch>& result) {
+    PROFILE_ZONE("Renderer::GetLightedBatches");
+    nodes.clear();
+    result.clear();
+    if (LightType::DIRECTIONAL == light->GetType()) {
+        for (auto& batch : batches)
+            if (batch.GetMaterial()->IsLighted())
+                result.push_back(batch);
+        return;
+    }
+    FrameVector<SceneNode*> lighted;
+    scene->GetLightedNodes(light, lighted);
+    if (lighted.empty())
+        return;
+    std::sort(lighted.begin(), lighted.end());
+    size_t nNodes = 0;
+    for (auto& batch : batches)
+        nNodes += batch.GetNodesCount();
+    nodes.reserve(nNodes); // the rebuilt batches point to it
+    for (auto& batch : batches) {
+        if (!batch.GetMaterial()->IsLighted())
+            continue;
+        auto first = nodes.size();
+        for (auto node : batch)
+            if (std::binary_search(lighted.begin(), lighted.end(), node))
+                nodes.push_back(node);
+        auto count = nodes.size() - first;
+        if (count == batch.GetNodesCount()) {
+            nodes.resize(first);
+            result.push_back(batch);
+        } else if (count)
+            result.push_back(Batch(batch.GetMaterial(), batch.GetMesh(),
+                                   &nodes[first], count));
+    }
+}
+
+void Renderer::OpaquePasses(const FrameVector<SceneNode*>& objs) {
+    PROFILE_ZONE("Renderer::OpaquePasses");
+    FillQueue(opaqueQueue_, objs.data(), objs.size(), camera_, false);
+    auto& batches = opaqueQueue_.GetBatches();
     for (auto& batch : batches)
         Draw(&batch, &defaultOpaquePass_, nullptr, camera_);
-    auto lights = scene_->GetLights();
+    FrameVector<SceneNode*> nodes;
+    FrameVector<Batch> lightedBatches;
+    auto& lights = scene_->GetLights();
     for (auto light : lights) {
         if (light->GetOnlyShadow())
             continue;
-        std::vector<const Batch*> litBatches;
-        GetLightedBatches(batches, litBatches);
-        for (auto batch : litBatches)
-            Draw(batch, &litOpaquePass_, light, camera_);
+        GetLightedBatches(scene_, light, batches, nodes, lightedBatches);
+        for (auto& batch : lightedBatches)
+            Draw(&batch, &litOpaquePass_, light, camera_);
     }
 }
 
-void Renderer::TransparentPasses(std::vector<SceneNode*>& objs) {
-    std::vector<Batch> batches;
-    GenerateBatches(objs, batches);
+void Renderer::TransparentPasses(const FrameVector<SceneNode*>& objs) {
+    PROFILE_ZONE("Renderer::TransparentPasses");
+    FillQueue(transparentQueue_, objs.data(), objs.size(), camera_, true);
+    auto& batches = transparentQueue_.GetBatches();
     for (auto& batch : batches)
         Draw(&batch, &defaultTransparentPass_, nullptr, camera_);
-    auto lights = scene_->GetLights();
+    FrameVector<SceneNode*> nodes;
+    FrameVector<Batch> lightedBatches;
+    auto& lights = scene_->GetLights();
     for (auto light : lights) {
         if (light->GetOnlyShadow())
             continue;
-        std::vector<const Batch*> litBatches;
-        GetLightedBatches(batches, litBatches);
-        for (auto batch : litBatches)
-            Draw(batch, &litTransparentPass_, light, camera_);
+        GetLightedBatches(scene_, light, batches, nodes, lightedBatches);
+        for (auto& batch : lightedBatches)
+            Draw(&batch, &litTransparentPass_, light, camera_);
     }
 }
 
-void Renderer::FilterPass(std::vector<SceneNode*>& objs) {
-    std::vector<Batch> batches;
-    GenerateBatches(objs, batches);
-    for (auto& batch : batches)
+// Draws the particle systems simulated in arrays: one instanced draw per system
+void Renderer::ParticlesPass(bool transparent) {
+    if (!RenderingCapabilities::GetPtr()->HasInstancedArrays())
+        return;
+    auto& particleSystems = scene_->GetParticleSystems();
+    for (auto ps : particleSystems) {
+        if (ps->GetMode() != ParticleSystemMode::ARRAYS ||
+            !ps->GetActiveParticles())
+            continue;
+        auto material = ps->GetParticleMaterial();
+        if (!material || material->IsTransparent() != transparent)
+            continue;
+        if (camera_ && Intersection::OUTSIDE ==
+                           camera_->GetFrustum()->IsInside(
+                               ps->GetParticlesBoundingBox()))
+            continue;
+        context_->SetMesh(ps->GetParticleMesh().get());
+        auto defaultPass =
+            transparent ? &defaultTransparentPass_ : &defaultOpaquePass_;
+        if (context_->SetupProgram(defaultPass, scene_, camera_, nullptr,
+                                   material.get(), nullptr))
+            context_->DrawInstancedActiveMesh(*ps, instanceBuffer_.get());
+        if (!material->IsLighted())
+            continue;
+        auto litPass = transparent ? &litTransparentPass_ : &litOpaquePass_;
+        auto& lights = scene_->GetLights();
+        for (auto light : lights) {
+            if (light->GetOnlyShadow() ||
+                !light->CanLight(ps->GetParticlesBoundingBox()))
+                continue;
+            if (context_->SetupProgram(litPass, scene_, camera_, nullptr,
+                                       material.get(), light))
+                context_->DrawInstancedActiveMesh(*ps, instanceBuffer_.get());
+        }
+    }
+}
+
+void Renderer::FilterPass(const FrameVector<SceneNode*>& objs) {
+    FillQueue(filterQueue_, objs.data(), objs.size(), camera_, false);
+    for (auto& batch : filterQueue_.GetBatches())
         Draw(&batch, &filterPass_, nullptr, camera_);
 }
 
@@ -507,18 +550,16 @@ void Renderer::DebugRendererPass() {
 void Renderer::RenderOverlays() {
     auto overlays = scene_->GetOverlays();
     if (overlays && overlays->GetDrawablesNumber()) {
-        std::vector<SceneNode*> visibles;
+        FrameVector<SceneNode*> visibles;
         overlays->GetVisibleNodes(camera_, visibles);
         auto transparent = ExtractTransparent(visibles);
         RemoveFrom(visibles, transparent);
         if (!visibles.empty()) {
-            SortSolidFrontToBack(visibles);
             OpaquePasses(visibles);
             for (auto& obj : visibles)
                 obj->ClearUniform();
         }
         if (!transparent.empty()) {
-            SortTransparentBackToFront(transparent);
             TransparentPasses(transparent);
             for (auto& obj : transparent)
                 obj->ClearUniform();
@@ -526,7 +567,7 @@ void Renderer::RenderOverlays() {
     }
 }
 
-void Renderer::RenderFiltered(const std::vector<SceneNode*>& objs) {
+void Renderer::RenderFiltered(const FrameVector<SceneNode*>& objs) {
     if (filterFrameBuffer_->IsReady()) {
         auto oldFrameBuffer = context_->GetFrameBuffer();
         auto filtered = objs;
@@ -540,7 +581,7 @@ void Renderer::RenderFiltered(const std::vector<SceneNode*>& objs) {
                     return obj->GetFilter().get() == filter.get();
                 });
 
-            std::vector<SceneNode*> nodesSameFilter(filtered.begin(), it);
+            FrameVector<SceneNode*> nodesSameFilter(filtered.begin(), it);
             FilterPass(nodesSameFilter);
             filtered.erase(filtered.begin(), it);
             context_->SetFrameBuffer(oldFrameBuffer);
@@ -611,6 +652,10 @@ void Renderer::Render(FrameBuffer* frameBuffer, Scene* scene) {
 }
 
 void Renderer::Render(Window* window, Scene* scene, Camera* camera) {
+    PROFILE_ZONE("Renderer::Render");
+    context_->NewFrame();
+    // the temporaries of the frame are released when leaving
+    FrameArena::Scope frameScope;
     bool useFrameBuffer = false;
     int width = 0;
     int height = 0;
@@ -631,13 +676,19 @@ void Renderer::Render(Window* window, Scene* scene, Camera* camera) {
     if (!scene)
         context_->ClearAllBuffers();
     else if (scene->GetDrawablesNumber()) {
-        std::vector<SceneNode*> visibles;
+        FrameVector<SceneNode*> visibles;
         if (camera_) {
-            scene->GetVisibleNodes(camera_, visibles);
+            {
+                PROFILE_ZONE("Renderer::Culling");
+                scene->GetVisibleNodes(camera_, visibles);
+            }
             context_->SetClearColor(Color(1));
             ShadowGenerationPass();
-        } else
-            visibles = scene->GetDrawables();
+        } else {
+            auto& drawables = scene->GetDrawables();
+            visibles.assign(drawables.begin(), drawables.end());
+        }
+        PROFILE_COUNT(VISIBLE_NODES, (unsigned)visibles.size());
         if (!visibles.empty()) {
             bool hasPostProcessing = camera && camera->HasPostProcessing();
             auto filtered = ExtractFiltered(visibles);
@@ -655,17 +706,17 @@ void Renderer::Render(Window* window, Scene* scene, Camera* camera) {
             context_->SetClearColor(scene->GetHorizonColor());
             context_->ClearAllBuffers();
             if (!visibles.empty()) {
-                SortSolidFrontToBack(visibles);
                 OpaquePasses(visibles);
                 for (auto& obj : visibles)
                     obj->ClearUniform();
             }
+            ParticlesPass(false);
             if (!transparent.empty()) {
-                SortTransparentBackToFront(transparent);
                 TransparentPasses(transparent);
                 for (auto& obj : transparent)
                     obj->ClearUniform();
             }
+            ParticlesPass(true);
             if (!filtered.empty()) {
                 RenderFiltered(filtered);
                 for (auto& obj : filtered)
@@ -20,7 +20,10 @@ misrepresented as being the original software.
 -------------------------------------------------------------------------------
 */
 #pragma once
+#include "OctreeQuery.h"
 #include "Pass.h"
+#include "RenderQueue.h"
+#include "FrameArena.h"
 #include "ShadowCamera.h"
 #include "Singleton.h"
 #include "Types.h"
@@ -34,8 +37,16 @@ public:
     void Render(FrameBuffer* frameBuffer, Scene* scene, Camera* camera);
     void Render(FrameBuffer* frameBuffer, Scene* scene);
     void Render(Window* window, Scene* scene, Camera* camera);
-    void GenerateBatches(std::vector<SceneNode*>& visibles,
+    // The batches are valid until the next call
+    void GenerateBatches(const std::vector<SceneNode*>& visibles,
                          std::vector<Batch>& batches);
+    // Lighted batches with the nodes reached by light (see
+    // Scene::GetLightedNodes). The batches losing nodes are rebuilt with
+    // the remaining ones copied to nodes.
+    static void GetLightedBatches(const Scene* scene, const Light* light,
+                                  const std::vector<Batch>& batches,
+                                  FrameVector<SceneNode*>& nodes,
+                                  FrameVector<Batch>& result);
     void EnableDebugPhysics(bool enable) { debugPhysics_ = enable; }
     PDebugRenderer GetDebugRenderer() const { return debugRenderer_; }
     static SignalDebugRenderer::PSignal SigDebugRenderer();
@@ -46,11 +57,11 @@ private:
     void Render(const Pass* pass, Mesh* mesh, Material* material);
     void Render(const Pass* pass, const Scene* scene, const Camera* camera,
                 SceneNode* node, const Light* light);
-    void DrawShadowPass(Batch* batch, const Light* light,
+    void DrawShadowPass(const Batch* batch, const Light* light,
                         const ShadowCamera* camera);
-    void SortTransparentBackToFront(std::vector<SceneNode*>& objs);
-    void SortSolidFrontToBack(std::vector<SceneNode*>& objs);
     void SortOverlaysBackToFront(std::vector<SceneNode*>& objs);
+    void FillQueue(RenderQueue& queue, SceneNode* const* objs, size_t nObjs,
+                   const Camera* camera, bool backToFront);
     void Draw(const Batch* batch, const Pass* pass, const Light* light,
               const Camera* camera);
     int GetShadowFrameBufferSize(int split) const;
@@ -59,7 +70,9 @@ private:
                         const BoundingBox& camFrustumViewBox,
                         const BoundingBox& receiversViewBox) const;
     void GenerateShadowMapCubeFace(const Light* light);
-    void Generate2DShadowMap(int split, const Light* light);
+    // visibles: nodes inside the split frustum (queried if null)
+    void Generate2DShadowMap(int split, const Light* light,
+                             const std::vector<SceneNode*>* visibles = nullptr);
     void GenerateCubeShadowMap(const Camera* camera, const Light* light);
     void GenerateShadowMaps(const Camera* camera, const Light* light);
     void Generate2DShadowMap(const Light* light,
@@ -71,23 +84,22 @@ private:
                                std::vector<SceneNode*>& shadowCasters);
     void GenerateShadowMap(Light* light,
                            const std::vector<SceneNode*>& drawables);
-    std::vector<SceneNode*>
-    ExtractTransparent(const std::vector<SceneNode*>& objs);
-    std::vector<SceneNode*>
-    ExtractFiltered(const std::vector<SceneNode*>& objs);
-    void RemoveFrom(std::vector<SceneNode*>& from,
-                    const std::vector<SceneNode*>& objs);
-    void GetLightedBatches(const std::vector<Batch>& iBatches,
-                           std::vector<const Batch*>& result) const;
+    FrameVector<SceneNode*>
+    ExtractTransparent(const FrameVector<SceneNode*>& objs);
+    FrameVector<SceneNode*>
+    ExtractFiltered(const FrameVector<SceneNode*>& objs);
+    void RemoveFrom(FrameVector<SceneNode*>& from,
+                    const FrameVector<SceneNode*>& objs);
     void ShadowGenerationPass();
-    void OpaquePasses(std::vector<SceneNode*>& objs);
-    void TransparentPasses(std::vector<SceneNode*>& objs);
-    void FilterPass(std::vector<SceneNode*>& objs);
+    void OpaquePasses(const FrameVector<SceneNode*>& objs);
+    void TransparentPasses(const FrameVector<SceneNode*>& objs);
+    void ParticlesPass(bool transparent);
+    void FilterPass(const FrameVector<SceneNode*>& objs);
     void SetShadowFrameBufferSize(FrameBuffer* frameBuffer);
     void DebugPhysicsPass();
     void DebugRendererPass();
     void RenderOverlays();
-    void RenderFiltered(const std::vector<SceneNode*>& objs);
+    void RenderFiltered(const FrameVector<SceneNode*>& objs);
     void ApplyPostProcessing();
     PRenderingContext context_;
     Scene* scene_;
@@ -111,5 +123,12 @@ private:
     PInstanceBuffer instanceBuffer_;
     PFrameBuffer filterFrameBuffer_;
     PFrameBuffer frameBuffer_;
+    RenderQueue opaqueQueue_;
+    RenderQueue transparentQueue_;
+    RenderQueue shadowQueue_;
+    RenderQueue filterQueue_;
+    RenderQueue batchesQueue_; // for GenerateBatches
+    std::vector<FrustumQueryResult> shadowQueryResults_;
+    std::vector<SceneNode*> shadowCasters_;
 };
 }
@@ -105,7 +105,9 @@ RenderingCapabilities::RenderingCapabilities()
       has_texture_compression_dxt3_ext_(false),
       has_texture_compression_dxt5_ext_(false),
       has_compressed_ETC1_RGB8_texture_ext_(false),
-      has_texture_compression_pvrtc_ext_(false), maxVaryingVectors_(0),
+      has_texture_compression_pvrtc_ext_(false),
+      has_element_index_uint_ext_(false), has_half_float_vertex_ext_(false),
+      has_vertex_type_2_10_10_10_ext_(false), maxVaryingVectors_(0),
       maxTexturesCombined_(0), maxVertexUniformVectors_(0),
       maxFragmentUniformVectors_(0), maxVertexAttribs_(0), maxTextureSize_(64) {
 
@@ -298,6 +300,26 @@ RenderingCapabilities::RenderingCapabilities()
         LOGI("Has extension: IMG_texture_compression_pvrtc");
     }
 
+#if defined(GLES2)
+    if (CheckExtension("OES_element_index_uint")) {
+        has_element_index_uint_ext_ = true;
+        LOGI("Using extension: OES_element_index_uint");
+    }
+#else
+    has_element_index_uint_ext_ = true; // core since OpenGL 1.1
+#endif
+
+    if (CheckExtension("GL_ARB_half_float_vertex") ||
+        CheckExtension("OES_vertex_half_float")) {
+        has_half_float_vertex_ext_ = true;
+        LOGI("Using extension: half_float_vertex");
+    }
+
+    if (CheckExtension("GL_ARB_vertex_type_2_10_10_10_rev")) {
+        has_vertex_type_2_10_10_10_ext_ = true;
+        LOGI("Using extension: vertex_type_2_10_10_10_rev");
+    }
+
     if (CheckExtension("EXT_discard_framebuffer")) {
         has_discard_framebuffer_ext_ = true;
         LOGI("Using extension: EXT_discard_framebuffer");
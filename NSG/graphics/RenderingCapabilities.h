@@ -57,6 +57,13 @@ public:
         return has_texture_compression_pvrtc_ext_;
     }
     bool HasDiscardFramebuffer() const { return has_discard_framebuffer_ext_; }
+    bool HasElementIndexUint() const { return has_element_index_uint_ext_; }
+    // Emulates a device without 32 bits indexes (the meshes get split)
+    void DisableElementIndexUint() { has_element_index_uint_ext_ = false; }
+    bool HasHalfFloatVertex() const { return has_half_float_vertex_ext_; }
+    bool HasVertexType2101010() const {
+        return has_vertex_type_2_10_10_10_ext_;
+    }
     GLint GetMaxVaryingVectors() const { return maxVaryingVectors_; }
     GLint GetMaxTexturesCombined() const { return maxTexturesCombined_; }
     GLint GetMaxVertexUniformVectors() const {
@@ -86,6 +93,9 @@ private:
     bool has_texture_compression_dxt5_ext_;
     bool has_compressed_ETC1_RGB8_texture_ext_;
     bool has_texture_compression_pvrtc_ext_;
+    bool has_element_index_uint_ext_;
+    bool has_half_float_vertex_ext_;
+    bool has_vertex_type_2_10_10_10_ext_;
     GLint maxVaryingVectors_;
     GLint maxTexturesCombined_;
     GLint maxVertexUniformVectors_;
@@ -31,7 +31,9 @@ misrepresented as being the original software.
 #include "Material.h"
 #include "Maths.h"
 #include "Mesh.h"
+#include "ParticleSystem.h"
 #include "Pass.h"
+#include "Profiler.h"
 #include "Program.h"
 #include "RenderingCapabilities.h"
 #include "Scene.h"
@@ -40,6 +42,7 @@ misrepresented as being the original software.
 #include "Util.h"
 #include "VertexArrayObj.h"
 #include "VertexBuffer.h"
+#include "VertexFormat.h"
 #include "Window.h"
 #include "imgui.h"
 #include <functional>
@@ -72,7 +75,8 @@ RenderingContext::RenderingContext()
       lastMesh_(nullptr), lastProgram_(nullptr), activeMesh_(nullptr),
       cullFaceMode_(CullFaceMode::DEFAULT),
       frontFaceMode_(FrontFaceMode::DEFAULT), depthFunc_(DepthFunc::LESS),
-      slopeScaledDepthBias_(0), capabilities_(RenderingCapabilities::Create()) {
+      slopeScaledDepthBias_(0), frame_(0),
+      capabilities_(RenderingCapabilities::Create()) {
     glGetIntegerv(GL_FRAMEBUFFER_BINDING,
                   &systemFbo_); // On IOS default FBO is not zero
     textures_ =
@@ -602,6 +606,7 @@ bool RenderingContext::SetProgram(Program* program) {
             if (!program->IsReady())
                 return false;
             glUseProgram(program->GetId());
+            PROFILE_COUNT(PROGRAM_SWITCHES, 1);
         } else
             glUseProgram(0);
         activeProgram_ = program;
@@ -683,46 +688,36 @@ void RenderingContext::SetInstanceAttrPointers(Program* program) {
     CHECK_GL_STATUS();
 }
 
-void RenderingContext::SetVertexAttrPointers() {
-    glVertexAttribPointer(
-        (int)AttributesLoc::POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData),
-        reinterpret_cast<void*>(offsetof(VertexData, position_)));
-
-    glVertexAttribPointer(
-        (int)AttributesLoc::NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData),
-        reinterpret_cast<void*>(offsetof(VertexData, normal_)));
-
-    glVertexAttribPointer(
-        (int)AttributesLoc::TEXTURECOORD0, 2, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData),
-        reinterpret_cast<void*>(offsetof(VertexData, uv_[0])));
-
-    glVertexAttribPointer(
-        (int)AttributesLoc::TEXTURECOORD1, 2, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData),
-        reinterpret_cast<void*>(offsetof(VertexData, uv_[1])));
-
-    glVertexAttribPointer(
-        (int)AttributesLoc::COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData),
-        reinterpret_cast<void*>(offsetof(VertexData, color_)));
-
-    glVertexAttribPointer(
-        (int)AttributesLoc::TANGENT, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData),
-        reinterpret_cast<void*>(offsetof(VertexData, tangent_)));
-
-    glVertexAttribPointer(
-        (int)AttributesLoc::BONES_ID, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData),
-        reinterpret_cast<void*>(offsetof(VertexData, bonesID_)));
-
-    glVertexAttribPointer(
-        (int)AttributesLoc::BONES_WEIGHT, 4, GL_FLOAT, GL_FALSE,
-        sizeof(VertexData),
-        reinterpret_cast<void*>(offsetof(VertexData, bonesWeight_)));
+void RenderingContext::SetVertexAttrPointers(const VertexFormat& format) {
+    for (int i = 0; i < VertexFormat::MAX_ATTRIBUTES; i++) {
+        auto att = (AttributesLoc)i;
+        if (format.Has(att)) {
+            GLint size;
+            GLenum type;
+            GLboolean normalized;
+            format.GetGLFormat(att, size, type, normalized);
+            glVertexAttribPointer(
+                i, size, type, normalized, format.GetStride(),
+                reinterpret_cast<void*>((size_t)format.GetOffset(att)));
+        } else {
+            // attribute not stored: use the VertexData default value
+            if (att == AttributesLoc::NORMAL)
+                glVertexAttrib4f(i, 0, 0, 1, 1);
+            else if (att == AttributesLoc::COLOR)
+                glVertexAttrib4f(i, 1, 1, 1, 1);
+            else
+                glVertexAttrib4f(i, 0, 0, 0, 0);
+        }
+    }
 }
 
 void RenderingContext::SetAttributes(
     SetAttPointersFunction setAttPointersCallBack) {
     if (lastMesh_ != activeMesh_ || lastProgram_ != activeProgram_) {
+        static const VertexFormat floatFormat;
+        auto& format = setAttPointersCallBack
+                           ? floatFormat
+                           : activeMesh_->GetVertexBuffer()->GetFormat();
         auto position_loc = activeProgram_->GetAttPositionLoc();
         auto texcoord_loc0 = activeProgram_->GetAttTextCoordLoc0();
         auto texcoord_loc1 = activeProgram_->GetAttTextCoordLoc1();
@@ -734,7 +729,7 @@ void RenderingContext::SetAttributes(
 
         unsigned newAttributes = 0;
 
-        if (position_loc != -1) {
+        if (position_loc != -1 && format.Has(AttributesLoc::POSITION)) {
             unsigned positionBit = 1 << position_loc;
             newAttributes |= positionBit;
 
@@ -744,7 +739,7 @@ void RenderingContext::SetAttributes(
             }
         }
 
-        if (normal_loc != -1) {
+        if (normal_loc != -1 && format.Has(AttributesLoc::NORMAL)) {
             unsigned positionBit = 1 << normal_loc;
             newAttributes |= positionBit;
 
@@ -754,7 +749,7 @@ void RenderingContext::SetAttributes(
             }
         }
 
-        if (texcoord_loc0 != -1) {
+        if (texcoord_loc0 != -1 && format.Has(AttributesLoc::TEXTURECOORD0)) {
             unsigned positionBit = 1 << texcoord_loc0;
             newAttributes |= positionBit;
 
@@ -764,7 +759,7 @@ void RenderingContext::SetAttributes(
             }
         }
 
-        if (texcoord_loc1 != -1) {
+        if (texcoord_loc1 != -1 && format.Has(AttributesLoc::TEXTURECOORD1)) {
             unsigned positionBit = 1 << texcoord_loc1;
             newAttributes |= positionBit;
 
@@ -774,7 +769,7 @@ void RenderingContext::SetAttributes(
             }
         }
 
-        if (color_loc != -1) {
+        if (color_loc != -1 && format.Has(AttributesLoc::COLOR)) {
             unsigned positionBit = 1 << color_loc;
             newAttributes |= positionBit;
 
@@ -784,7 +779,7 @@ void RenderingContext::SetAttributes(
             }
         }
 
-        if (tangent_loc != -1) {
+        if (tangent_loc != -1 && format.Has(AttributesLoc::TANGENT)) {
             unsigned positionBit = 1 << tangent_loc;
             newAttributes |= positionBit;
 
@@ -794,7 +789,7 @@ void RenderingContext::SetAttributes(
             }
         }
 
-        if (bones_id_loc != -1) {
+        if (bones_id_loc != -1 && format.Has(AttributesLoc::BONES_ID)) {
             unsigned positionBit = 1 << bones_id_loc;
             newAttributes |= positionBit;
 
@@ -804,7 +799,7 @@ void RenderingContext::SetAttributes(
             }
         }
 
-        if (bones_weight != -1) {
+        if (bones_weight != -1 && format.Has(AttributesLoc::BONES_WEIGHT)) {
             unsigned positionBit = 1 << bones_weight;
             newAttributes |= positionBit;
 
@@ -817,7 +812,7 @@ void RenderingContext::SetAttributes(
         if (setAttPointersCallBack)
             setAttPointersCallBack();
         else
-            SetVertexAttrPointers();
+            SetVertexAttrPointers(format);
 
         {
             /////////////////////////////
@@ -872,7 +867,8 @@ void RenderingContext::SetupPass(const Pass* pass) {
 
 bool RenderingContext::SetupProgram(const Pass* pass, const Scene* scene,
                                     const Camera* camera, SceneNode* sceneNode,
-                                    Material* material, const Light* light) {
+                                    Material* material, const Light* light,
+                                    bool instanced) {
     SetupPass(pass);
 
     if (material) {
@@ -884,9 +880,9 @@ bool RenderingContext::SetupProgram(const Pass* pass, const Scene* scene,
             EnableCullFace(false);
     }
 
-    auto shaderdefines = Program::GetShaderVariation(
-        pass, scene, camera, activeMesh_, material, light, sceneNode);
-    auto program = Program::GetOrCreate(shaderdefines);
+    auto program =
+        Program::GetOrCreateVariation(pass, scene, camera, activeMesh_,
+                                      material, light, sceneNode, instanced);
     program->Set(sceneNode);
     program->Set(material);
     program->Set(light);
@@ -904,18 +900,20 @@ bool RenderingContext::SetupProgram(const Pass* pass, const Scene* scene,
 void RenderingContext::DrawElements(GLenum mode, GLsizei count, GLenum type,
                                     const GLvoid* indices) {
     glDrawElements(mode, count, type, indices);
+    PROFILE_COUNT(DRAW_CALLS, 1);
     lastMesh_ = activeMesh_;
     lastProgram_ = activeProgram_;
 }
 
 void RenderingContext::DrawArrays(GLenum mode, GLint first, GLsizei count) {
     glDrawArrays(mode, first, count);
+    PROFILE_COUNT(DRAW_CALLS, 1);
     lastMesh_ = activeMesh_;
     lastProgram_ = activeProgram_;
 }
 
 void RenderingContext::DrawActiveMesh() {
-    if (!activeMesh_->IsReady())
+    if (!activeMesh_->IsReady() || activeMesh_->NeedsSplit())
         return;
     CHECK_GL_STATUS();
     bool solid =
@@ -927,9 +925,11 @@ void RenderingContext::DrawActiveMesh() {
     const VertexsData& vertexsData = activeMesh_->GetVertexsData();
     const Indexes& indexes = activeMesh_->GetIndexes(solid);
     if (!indexes.empty())
-        glDrawElements(mode, GLsizei(indexes.size()), GL_UNSIGNED_SHORT, 0);
+        glDrawElements(mode, GLsizei(indexes.size()),
+                       activeMesh_->GetIndexBuffer(solid)->GetIndexType(), 0);
     else
         glDrawArrays(mode, 0, GLsizei(vertexsData.size()));
+    PROFILE_COUNT(DRAW_CALLS, 1);
     SetVertexArrayObj(nullptr);
     lastMesh_ = activeMesh_;
     lastProgram_ = activeProgram_;
@@ -939,7 +939,7 @@ void RenderingContext::DrawActiveMesh() {
 void RenderingContext::DrawInstancedActiveMesh(
     const Batch& batch, InstanceBuffer* instancesBuffer) {
     CHECK_ASSERT(capabilities_->HasInstancedArrays());
-    if (!activeMesh_->IsReady())
+    if (!activeMesh_->IsReady() || activeMesh_->NeedsSplit())
         return;
     CHECK_GL_STATUS();
     bool solid =
@@ -948,15 +948,39 @@ void RenderingContext::DrawInstancedActiveMesh(
     SetBuffers(solid, instancesBuffer);
     GLenum mode = solid ? activeMesh_->GetSolidDrawMode()
                         : activeMesh_->GetWireFrameDrawMode();
-    GLsizei instances = (GLsizei)batch.GetNodes().size();
+    GLsizei instances = (GLsizei)batch.GetNodesCount();
+    DrawInstances(mode, solid, instances);
+}
+
+void RenderingContext::DrawInstancedActiveMesh(
+    const ParticleSystem& ps, InstanceBuffer* instancesBuffer) {
+    CHECK_ASSERT(capabilities_->HasInstancedArrays());
+    if (!activeMesh_->IsReady() || activeMesh_->NeedsSplit() ||
+        !ps.GetActiveParticles())
+        return;
+    CHECK_GL_STATUS();
+    bool solid =
+        activeProgram_->GetMaterial()->GetFillMode() == FillMode::SOLID;
+    instancesBuffer->UpdateParticlesBuffer(ps);
+    SetBuffers(solid, instancesBuffer);
+    GLenum mode = solid ? activeMesh_->GetSolidDrawMode()
+                        : activeMesh_->GetWireFrameDrawMode();
+    GLsizei instances = (GLsizei)ps.GetActiveParticles();
+    DrawInstances(mode, solid, instances);
+}
+
+void RenderingContext::DrawInstances(GLenum mode, bool solid,
+                                     GLsizei instances) {
     const Indexes& indexes = activeMesh_->GetIndexes(solid);
     if (!indexes.empty())
-        glDrawElementsInstanced(mode, (GLsizei)indexes.size(),
-                                GL_UNSIGNED_SHORT, 0, instances);
+        glDrawElementsInstanced(
+            mode, (GLsizei)indexes.size(),
+            activeMesh_->GetIndexBuffer(solid)->GetIndexType(), 0, instances);
     else {
         const VertexsData& vertexsData = activeMesh_->GetVertexsData();
         glDrawArraysInstanced(mode, 0, (GLsizei)vertexsData.size(), instances);
     }
+    PROFILE_COUNT(DRAW_CALLS, 1);
     SetVertexArrayObj(nullptr);
     lastMesh_ = activeMesh_;
     lastProgram_ = activeProgram_;
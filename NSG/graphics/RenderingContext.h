@@ -28,6 +28,7 @@ misrepresented as being the original software.
 
 namespace NSG {
 class RenderingCapabilities;
+class VertexFormat;
 // Keeps OpenGL's context
 class RenderingContext : public Singleton<RenderingContext> {
 public:
@@ -72,10 +73,12 @@ public:
     void DrawActiveMesh();
     void DrawInstancedActiveMesh(const Batch& batch,
                                  InstanceBuffer* instancesBuffer);
+    void DrawInstancedActiveMesh(const ParticleSystem& ps,
+                                 InstanceBuffer* instancesBuffer);
     void DiscardFramebuffer();
     void SetBuffers(bool solid, InstanceBuffer* instancesBuffer);
     void SetInstanceAttrPointers(Program* program);
-    void SetVertexAttrPointers();
+    void SetVertexAttrPointers(const VertexFormat& format);
     typedef std::function<void()> SetAttPointersFunction;
     void SetAttributes(SetAttPointersFunction setAttPointersCallBack);
     void SetMesh(Mesh* mesh) { activeMesh_ = mesh; }
@@ -85,14 +88,19 @@ public:
     bool NeedsDecompress(TextureFormat format) const;
     bool SetupProgram(const Pass* pass, const Scene* scene,
                       const Camera* camera, SceneNode* sceneNode,
-                      Material* material, const Light* light);
+                      Material* material, const Light* light,
+                      bool instanced = false);
     void SetupPass(const Pass* pass);
     void SetSlopeScaledBias(float slopeScaledBias);
     static std::string GetExtensions();
     void SetViewport(const Window& window);
+    // Stamp of the frame being rendered, changed by Renderer::Render
+    void NewFrame() { ++frame_; }
+    unsigned GetFrame() const { return frame_; }
 
 private:
     void SetViewport(const Vector4& viewport, bool force);
+    void DrawInstances(GLenum mode, bool solid, GLsizei instances);
     RenderingContext();
     Vector4 viewport_;
     Vector4 windowViewport_;
@@ -113,6 +121,7 @@ private:
     FrontFaceMode frontFaceMode_;
     DepthFunc depthFunc_;
     float slopeScaledDepthBias_;
+    unsigned frame_;
     std::string extensions_;
     std::shared_ptr<RenderingCapabilities> capabilities_;
     friend class Singleton<RenderingContext>;
@@ -40,7 +40,8 @@ std::map<std::string, PWeakSkeleton>
     WeakFactory<std::string, Skeleton>::objsMap_ =
         std::map<std::string, PWeakSkeleton>{};
 
-Skeleton::Skeleton(const std::string& name) : Object(name) {}
+Skeleton::Skeleton(const std::string& name)
+    : Object(name), variationStamp_(NewVariationStamp()) {}
 
 Skeleton::~Skeleton() {}
 
@@ -69,6 +70,7 @@ void Skeleton::Load(const pugi::xml_node& node) {
     CHECK_ASSERT(name == name_);
     shaderOrder_.clear();
     offsets_.clear();
+    shaderOffsets_.clear();
     rootBones_.clear();
     {
         auto boneNode = node.child("ShaderOrder").child("Bone");
@@ -78,6 +80,7 @@ void Skeleton::Load(const pugi::xml_node& node) {
                 name,
                 ToMatrix4(boneNode.attribute("offsetMatrix").as_string()));
             shaderOrder_.push_back(name);
+            shaderOffsets_.push_back(GetBoneOffsetMatrix(name));
             boneNode = boneNode.next_sibling("Bone");
         }
     }
@@ -92,6 +95,8 @@ void Skeleton::Load(const pugi::xml_node& node) {
             boneNode = boneNode.next_sibling("Bone");
         }
     }
+
+    variationStamp_ = NewVariationStamp();
 }
 
 void Skeleton::SetBoneOffsetMatrix(const std::string& name,
@@ -123,5 +128,16 @@ void Skeleton::CreateBonesFor(PSceneNode sceneNode) const {
         CreateBonesFor(sceneNode, node);
 }
 
+PBone Skeleton::GetBone(const std::string& name) const {
+    for (auto& root : rootBones_) {
+        if (root->GetName() == name)
+            return root;
+        auto bone = root->GetChild<Bone>(name, true);
+        if (bone)
+            return bone;
+    }
+    return nullptr;
+}
+
 size_t Skeleton::GetNumberOfBones() const { return shaderOrder_.size(); }
 }
\ No newline at end of file
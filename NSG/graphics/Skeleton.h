@@ -44,10 +44,17 @@ public:
         return shaderOrder_;
     }
     const Matrix4& GetBoneOffsetMatrix(const std::string& name) const;
+    // Offset matrices in the shader order
+    const std::vector<Matrix4>& GetBoneOffsetMatrices() const {
+        return shaderOffsets_;
+    }
     bool IsEmpty() const { return shaderOrder_.empty(); }
     static void SaveSkeletons(pugi::xml_node& node);
     void Set(PResource resource);
     void CreateBonesFor(PSceneNode sceneNode) const;
+    // Bone of the skeleton (not the ones created for the armatures)
+    PBone GetBone(const std::string& name) const;
+    unsigned GetVariationStamp() const { return variationStamp_; }
 
 private:
     void SetBoneOffsetMatrix(const std::string& name, const Matrix4& offset);
@@ -55,6 +62,8 @@ private:
     std::vector<std::string> shaderOrder_;
     // Offset matrix that converts from vertex space to bone space
     std::map<std::string, Matrix4> offsets_;
+    std::vector<Matrix4> shaderOffsets_;
     std::vector<PBone> rootBones_;
+    unsigned variationStamp_; // changes with the number of bones
 };
 }
\ No newline at end of file
@@ -0,0 +1,301 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "VertexFormat.h"
+#include "Check.h"
+#include "Maths.h"
+#include "RenderingCapabilities.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace NSG {
+static const unsigned Components[VertexFormat::MAX_ATTRIBUTES] = {
+    3, // POSITION
+    3, // NORMAL
+    2, // TEXTURECOORD0
+    2, // TEXTURECOORD1
+    4, // COLOR
+    3, // TANGENT
+    4, // BONES_ID
+    4, // BONES_WEIGHT
+};
+
+static const size_t SourceOffsets[VertexFormat::MAX_ATTRIBUTES] = {
+    offsetof(VertexData, position_), offsetof(VertexData, normal_),
+    offsetof(VertexData, uv_[0]),    offsetof(VertexData, uv_[1]),
+    offsetof(VertexData, color_),    offsetof(VertexData, tangent_),
+    offsetof(VertexData, bonesID_),  offsetof(VertexData, bonesWeight_),
+};
+
+#define ENCODING_BIT(e) (1 << (int)VertexEncoding::e)
+static const unsigned AllowedEncodings[VertexFormat::MAX_ATTRIBUTES] = {
+    // POSITION
+    ENCODING_BIT(FLOAT),
+    // NORMAL
+    ENCODING_BIT(FLOAT) | ENCODING_BIT(NONE) | ENCODING_BIT(HALF) |
+        ENCODING_BIT(SNORM16) | ENCODING_BIT(INT_2_10_10_10),
+    // TEXTURECOORD0
+    ENCODING_BIT(FLOAT) | ENCODING_BIT(NONE) | ENCODING_BIT(HALF),
+    // TEXTURECOORD1
+    ENCODING_BIT(FLOAT) | ENCODING_BIT(NONE) | ENCODING_BIT(HALF),
+    // COLOR
+    ENCODING_BIT(FLOAT) | ENCODING_BIT(NONE) | ENCODING_BIT(HALF) |
+        ENCODING_BIT(UNORM8),
+    // TANGENT
+    ENCODING_BIT(FLOAT) | ENCODING_BIT(NONE) | ENCODING_BIT(HALF) |
+        ENCODING_BIT(SNORM16) | ENCODING_BIT(INT_2_10_10_10),
+    // BONES_ID
+    ENCODING_BIT(FLOAT) | ENCODING_BIT(NONE) | ENCODING_BIT(UINT8),
+    // BONES_WEIGHT
+    ENCODING_BIT(FLOAT) | ENCODING_BIT(NONE) | ENCODING_BIT(HALF) |
+        ENCODING_BIT(UNORM8),
+};
+#undef ENCODING_BIT
+
+static unsigned RoundUp4(unsigned bytes) { return (bytes + 3) & ~3u; }
+
+static unsigned GetEncodedBytes(VertexEncoding encoding, unsigned components) {
+    switch (encoding) {
+    case VertexEncoding::FLOAT:
+        return components * sizeof(float);
+    case VertexEncoding::NONE:
+        return 0;
+    case VertexEncoding::HALF:
+    case VertexEncoding::SNORM16:
+        return RoundUp4(components * sizeof(uint16_t));
+    case VertexEncoding::INT_2_10_10_10:
+        return sizeof(uint32_t);
+    case VertexEncoding::UNORM8:
+    case VertexEncoding::UINT8:
+        return RoundUp4(components);
+    default:
+        CHECK_ASSERT(!"Unknown vertex encoding");
+        return 0;
+    }
+}
+
+static uint16_t ToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return (uint16_t)sign; // too small: signed zero
+        mantissa |= 0x800000;      // denormalized half
+        return (uint16_t)(sign | (mantissa >> (14 - exponent)));
+    }
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7c00); // overflow: infinity
+    uint16_t half = (uint16_t)(sign | (exponent << 10) | (mantissa >> 13));
+    if (mantissa & 0x1000)
+        ++half; // round to nearest, carry goes to the exponent
+    return half;
+}
+
+static uint32_t ToInt2101010(const float* values, unsigned components) {
+    uint32_t packed = 0;
+    for (unsigned i = 0; i < components && i < 3; i++) {
+        auto value = (int)std::round(Clamp(values[i], -1.f, 1.f) * 511.f);
+        packed |= ((uint32_t)value & 0x3ff) << (10 * i);
+    }
+    return packed;
+}
+
+static void Encode(VertexEncoding encoding, const float* values,
+                   unsigned components, char* target) {
+    switch (encoding) {
+    case VertexEncoding::FLOAT:
+        memcpy(target, values, components * sizeof(float));
+        break;
+    case VertexEncoding::HALF:
+        for (unsigned i = 0; i < components; i++) {
+            auto half = ToHalf(values[i]);
+            memcpy(target + i * sizeof(half), &half, sizeof(half));
+        }
+        break;
+    case VertexEncoding::SNORM16:
+        for (unsigned i = 0; i < components; i++) {
+            auto value = (int16_t)std::round(
+                Clamp(values[i], -1.f, 1.f) * 32767.f);
+            memcpy(target + i * sizeof(value), &value, sizeof(value));
+        }
+        break;
+    case VertexEncoding::INT_2_10_10_10: {
+        auto packed = ToInt2101010(values, components);
+        memcpy(target, &packed, sizeof(packed));
+        break;
+    }
+    case VertexEncoding::UNORM8:
+        for (unsigned i = 0; i < components; i++)
+            target[i] =
+                (char)(uint8_t)std::round(Clamp(values[i], 0.f, 1.f) * 255.f);
+        break;
+    case VertexEncoding::UINT8:
+        for (unsigned i = 0; i < components; i++)
+            target[i] = (char)(uint8_t)Clamp(values[i], 0.f, 255.f);
+        break;
+    default:
+        break;
+    }
+}
+
+VertexFormat::VertexFormat() : stride_(0) {
+    for (int i = 0; i < MAX_ATTRIBUTES; i++)
+        encodings_[i] = VertexEncoding::FLOAT;
+    Update();
+}
+
+VertexFormat VertexFormat::Compact(bool skinned) {
+    VertexFormat format;
+    format.SetEncoding(AttributesLoc::NORMAL, VertexEncoding::INT_2_10_10_10);
+    format.SetEncoding(AttributesLoc::TEXTURECOORD0, VertexEncoding::HALF);
+    format.SetEncoding(AttributesLoc::TEXTURECOORD1, VertexEncoding::HALF);
+    format.SetEncoding(AttributesLoc::COLOR, VertexEncoding::UNORM8);
+    format.SetEncoding(AttributesLoc::TANGENT, VertexEncoding::INT_2_10_10_10);
+    format.SetEncoding(AttributesLoc::BONES_ID, skinned ? VertexEncoding::UINT8
+                                                        : VertexEncoding::NONE);
+    format.SetEncoding(AttributesLoc::BONES_WEIGHT,
+                       skinned ? VertexEncoding::UNORM8 : VertexEncoding::NONE);
+    return format;
+}
+
+VertexFormat VertexFormat::FromKey(unsigned key) {
+    VertexFormat format;
+    for (int i = 0; i < MAX_ATTRIBUTES; i++)
+        format.SetEncoding((AttributesLoc)i,
+                           (VertexEncoding)((key >> (4 * i)) & 0xf));
+    return format;
+}
+
+void VertexFormat::SetEncoding(AttributesLoc att, VertexEncoding encoding) {
+    auto index = (int)att;
+    CHECK_CONDITION(index < MAX_ATTRIBUTES);
+    CHECK_CONDITION(AllowedEncodings[index] & (1 << (int)encoding));
+    encodings_[index] = encoding;
+    Update();
+}
+
+VertexEncoding VertexFormat::GetEncoding(AttributesLoc att) const {
+    CHECK_ASSERT((int)att < MAX_ATTRIBUTES);
+    return encodings_[(int)att];
+}
+
+bool VertexFormat::Has(AttributesLoc att) const {
+    return GetEncoding(att) != VertexEncoding::NONE;
+}
+
+unsigned VertexFormat::GetOffset(AttributesLoc att) const {
+    CHECK_ASSERT((int)att < MAX_ATTRIBUTES);
+    return offsets_[(int)att];
+}
+
+unsigned VertexFormat::GetKey() const {
+    unsigned key = 0;
+    for (int i = 0; i < MAX_ATTRIBUTES; i++)
+        key |= (unsigned)encodings_[i] << (4 * i);
+    return key;
+}
+
+VertexFormat VertexFormat::Resolve() const {
+    auto caps = RenderingCapabilities::GetPtr();
+    VertexFormat format(*this);
+    for (int i = 0; i < MAX_ATTRIBUTES; i++) {
+        auto& encoding = format.encodings_[i];
+        if (encoding == VertexEncoding::HALF && !caps->HasHalfFloatVertex())
+            encoding = VertexEncoding::FLOAT;
+        else if (encoding == VertexEncoding::INT_2_10_10_10 &&
+                 !caps->HasVertexType2101010())
+            encoding = VertexEncoding::SNORM16;
+    }
+    format.Update();
+    return format;
+}
+
+void VertexFormat::GetGLFormat(AttributesLoc att, GLint& size, GLenum& type,
+                               GLboolean& normalized) const {
+    auto index = (int)att;
+    CHECK_ASSERT(index < MAX_ATTRIBUTES);
+    size = Components[index];
+    normalized = GL_FALSE;
+    switch (encodings_[index]) {
+    case VertexEncoding::FLOAT:
+        type = GL_FLOAT;
+        break;
+    case VertexEncoding::HALF:
+        type = GL_HALF_FLOAT;
+        break;
+    case VertexEncoding::SNORM16:
+        type = GL_SHORT;
+        normalized = GL_TRUE;
+        break;
+    case VertexEncoding::INT_2_10_10_10:
+        size = 4;
+        type = GL_INT_2_10_10_10_REV;
+        normalized = GL_TRUE;
+        break;
+    case VertexEncoding::UNORM8:
+        type = GL_UNSIGNED_BYTE;
+        normalized = GL_TRUE;
+        break;
+    case VertexEncoding::UINT8:
+        type = GL_UNSIGNED_BYTE;
+        break;
+    default:
+        size = 0;
+        type = GL_FLOAT;
+        break;
+    }
+}
+
+void VertexFormat::Pack(const VertexsData& vertexes,
+                        std::vector<char>& data) const {
+    data.assign(vertexes.size() * stride_, 0);
+    auto target = data.empty() ? nullptr : &data[0];
+    for (auto& vertex : vertexes) {
+        auto source = (const char*)&vertex;
+        for (int i = 0; i < MAX_ATTRIBUTES; i++)
+            if (encodings_[i] != VertexEncoding::NONE)
+                Encode(encodings_[i],
+                       (const float*)(source + SourceOffsets[i]),
+                       Components[i], target + offsets_[i]);
+        target += stride_;
+    }
+}
+
+bool VertexFormat::operator==(const VertexFormat& obj) const {
+    return GetKey() == obj.GetKey();
+}
+
+void VertexFormat::Update() {
+    stride_ = 0;
+    for (int i = 0; i < MAX_ATTRIBUTES; i++) {
+        offsets_[i] = stride_;
+        stride_ += GetEncodedBytes(encodings_[i], Components[i]);
+    }
+}
+}
@@ -0,0 +1,75 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "GLIncludes.h"
+#include "Types.h"
+#include "VertexData.h"
+#include <vector>
+
+namespace NSG {
+enum class VertexEncoding {
+    FLOAT,          // 32 bits float per component (as in VertexData)
+    NONE,           // attribute is not stored
+    HALF,           // 16 bits float per component
+    SNORM16,        // normalized signed 16 bits per component
+    INT_2_10_10_10, // normalized signed 10-10-10-2 packed in 32 bits
+    UNORM8,         // normalized unsigned 8 bits per component
+    UINT8,          // unsigned 8 bits integer per component
+};
+
+// Describes which VertexData attributes are uploaded to the GPU and how they
+// are encoded. The default format keeps every attribute as float, so the
+// vertex buffer is the VertexData array itself.
+class VertexFormat {
+public:
+    static const int MAX_ATTRIBUTES = (int)AttributesLoc::BONES_WEIGHT + 1;
+    VertexFormat();
+    // position as float, normals and tangents as 10-10-10-2,
+    // UVs as half floats, colors as unorm8 and bones as 8 bits
+    static VertexFormat Compact(bool skinned = false);
+    static VertexFormat FromKey(unsigned key);
+    void SetEncoding(AttributesLoc att, VertexEncoding encoding);
+    VertexEncoding GetEncoding(AttributesLoc att) const;
+    bool Has(AttributesLoc att) const;
+    unsigned GetOffset(AttributesLoc att) const;
+    unsigned GetStride() const { return stride_; }
+    unsigned GetKey() const; // 4 bits per attribute, 0 means all floats
+    bool IsFloat() const { return GetKey() == 0; }
+    // Replaces the encodings not supported by the current context
+    VertexFormat Resolve() const;
+    void GetGLFormat(AttributesLoc att, GLint& size, GLenum& type,
+                     GLboolean& normalized) const;
+    void Pack(const VertexsData& vertexes, std::vector<char>& data) const;
+    bool operator==(const VertexFormat& obj) const;
+    bool operator!=(const VertexFormat& obj) const { return !(*this == obj); }
+
+private:
+    void Update();
+    VertexEncoding encodings_[MAX_ATTRIBUTES];
+    unsigned offsets_[MAX_ATTRIBUTES];
+    unsigned stride_;
+};
+}
@@ -27,13 +27,19 @@ misrepresented as being the original software.
 #include "Animation.h"
 #include "Check.h"
 #include "Engine.h"
+#include "Image.h"
+#include "JobSystem.h"
 #include "Material.h"
 #include "ModelMesh.h"
+#include "RenderingContext.h"
 #include "ResourceFile.h"
 #include "Scene.h"
 #include "Shape.h"
 #include "Skeleton.h"
+#include "Texture.h"
+#include <chrono>
 #include <iterator>
+#include <map>
 
 namespace NSG {
 template <>
@@ -43,9 +49,10 @@ std::map<std::string, PLoaderXML>
 
 LoaderXML::LoaderXML(const std::string& name)
     : Object(name), loaded_(false), signalLoaded_(new SignalEmpty),
-      signalProgress_(new SignalFloat) {}
+      signalProgress_(new SignalFloat), totalObjects_(0),
+      frameBudget_(4) {}
 
-LoaderXML::~LoaderXML() {}
+LoaderXML::~LoaderXML() { WaitJobs(); }
 
 void LoaderXML::Set(PResource resource) {
     if (resource != resource_) {
@@ -66,7 +73,10 @@ void LoaderXML::AllocateResources() {
     }
 }
 
-void LoaderXML::ReleaseResources() { loaded_ = false; }
+void LoaderXML::ReleaseResources() {
+    WaitJobs(); // the jobs read doc_
+    loaded_ = false;
+}
 
 pugi::xml_node LoaderXML::GetNode(const std::string& type,
                                   const std::string& name) const {
@@ -78,21 +88,235 @@ pugi::xml_node LoaderXML::GetNode(const std::string& type,
     return node;
 }
 
+// Jobs of some objects and what the main thread does once they are done
+struct LoaderXML::Stage {
+    Task::JobCounter* done_;
+    std::vector<PObject> objects_; // preparing until then
+    std::function<void()> complete_;
+};
+
+// Private data of the jobs: they do not touch the objects of the app
+struct FileData {
+    Path path_;
+    std::string buffer_;
+    PResource resource_; // private copy to decode the images
+    std::vector<std::pair<PImage, PImage>> images_; // and their private copy
+};
+
+struct ShapeData {
+    PhysicsShape type_;
+    Vector3 scale_;
+    Shape::Cooked cooked_;
+};
+
+struct MeshData {
+    pugi::xml_node node_;
+    PModelMesh mesh_; // private copy
+    std::vector<ShapeData> shapes_;
+};
+
 bool LoaderXML::AreReady() {
-    auto total = objects_.size();
-    if (total) {
-        auto obj = *objects_.begin();
-        if (obj->IsReady())
-            objects_.erase(obj);
-        SigProgress()->Run(100.f / total);
-        return false;
+    CompleteStages();
+    if (objects_.empty())
+        return true;
+    // the objects being prepared by the jobs return at once
+    auto start = std::chrono::steady_clock::now();
+    auto it = objects_.begin();
+    while (it != objects_.end()) {
+        if ((*it)->IsReady())
+            it = objects_.erase(it);
+        else
+            ++it;
+        if (std::chrono::steady_clock::now() - start >= frameBudget_)
+            break;
+    }
+    auto done = totalObjects_ - objects_.size();
+    SigProgress()->Run(100.f * done / totalObjects_);
+    return objects_.empty();
+}
+
+Task::JobCounter* LoaderXML::NewCounter() {
+    counters_.push_back(
+        std::unique_ptr<Task::JobCounter>(new Task::JobCounter));
+    return counters_.back().get();
+}
+
+void LoaderXML::AddStage(Task::JobCounter* done, std::vector<PObject> objects,
+                         std::function<void()> complete) {
+    for (auto& obj : objects)
+        obj->SetPreparing(true);
+    stages_.push_back(std::unique_ptr<Stage>(
+        new Stage{done, std::move(objects), std::move(complete)}));
+}
+
+void LoaderXML::CompleteStages() {
+    auto it = stages_.begin();
+    while (it != stages_.end()) {
+        auto& stage = **it;
+        if (stage.done_->IsDone()) {
+            stage.complete_();
+            for (auto& obj : stage.objects_)
+                obj->SetPreparing(false);
+            it = stages_.erase(it);
+        } else
+            ++it;
+    }
+}
+
+void LoaderXML::WaitJobs() {
+    auto jobs = Task::JobSystem::GetPtr();
+    if (jobs) {
+        for (auto& counter : counters_)
+            jobs->Wait(*counter);
+    }
+    counters_.clear();
+    // cancelled: the objects load in the main thread if they are needed
+    for (auto& stage : stages_)
+        for (auto& obj : stage->objects_)
+            obj->SetPreparing(false);
+    stages_.clear();
+}
+
+void LoaderXML::StartJobs() {
+    // Materials create their textures and shapes find their meshes: the
+    // factories are not thread safe
+    for (auto& material : materials_)
+        material->LoadNode();
+    for (auto& shape : shapes_)
+        shape->LoadNode();
+
+    auto jobs = Task::JobSystem::GetPtr();
+    if (!jobs)
+        return; // the main thread does everything
+
+    // The jobs only capture raw pointers to their private data, which is
+    // released with the stage in the main thread.
+    std::map<Resource*, std::set<PImage>> images;
+    if (RenderingContext::GetPtr()) {
+        for (auto& material : materials_) {
+            for (int i = 0; i < MaterialTexture::MAX_MAPS; i++) {
+                auto texture = material->GetTexture((MaterialTexture)i);
+                auto image = texture ? texture->GetImage() : nullptr;
+                if (image)
+                    images[image->GetResource().get()].insert(image);
+            }
+        }
+    }
+
+    // I/O -> decompression -> image decoding
+    for (auto& resource : resources_) {
+        auto file = std::dynamic_pointer_cast<ResourceFile>(resource);
+        if (!file || !file->IsLocal())
+            continue;
+        file->LoadNode(); // sets the path
+        auto data = std::make_shared<FileData>();
+        data->path_ = file->GetPath();
+        auto& users = images[file.get()];
+        if (!users.empty())
+            data->resource_ = std::make_shared<Resource>(file->GetName());
+        for (auto& image : users)
+            data->images_.push_back(
+                {image, std::make_shared<Image>(data->resource_)});
+
+        auto read = NewCounter();
+        auto done = NewCounter();
+        auto p = data.get();
+        jobs->Run([p]() { ResourceFile::ReadFile(p->path_, p->buffer_); },
+                  read);
+        if (data->images_.empty())
+            jobs->Run(
+                [p]() { ResourceFile::DecompressFile(p->path_, p->buffer_); },
+                *read, done);
+        else {
+            auto decompressed = NewCounter();
+            jobs->Run(
+                [p]() {
+                    ResourceFile::DecompressFile(p->path_, p->buffer_);
+                    p->resource_->SwapBuffer(p->buffer_);
+                },
+                *read, decompressed);
+            for (auto& image : data->images_) {
+                auto decoded = image.second.get();
+                jobs->Run(
+                    [p, decoded]() {
+                        if (p->resource_->GetBytes() > 4)
+                            decoded->Decode();
+                    },
+                    *decompressed, done);
+            }
+        }
+        AddStage(done, {file}, [file, data]() {
+            if (data->resource_)
+                data->resource_->SwapBuffer(data->buffer_);
+            for (auto& image : data->images_)
+                image.first->SetDecoded(*image.second);
+            file->SetPrepared(data->buffer_);
+        });
+    }
+
+    std::map<Mesh*, std::vector<PShape>> meshShapes;
+    for (auto& shape : shapes_) {
+        auto mesh = shape->GetMesh();
+        if (mesh)
+            meshShapes[mesh.get()].push_back(shape);
+    }
+
+    // parsing -> cooking (tangents, bounds and collision shapes)
+    for (auto& mesh : meshes_) {
+        auto node = GetNode("Meshes", mesh->GetName());
+        if (!node)
+            continue;
+        auto data = std::make_shared<MeshData>();
+        data->node_ = node;
+        data->mesh_ = std::make_shared<ModelMesh>(mesh->GetName());
+        auto& shapes = meshShapes[mesh.get()];
+        for (auto& shape : shapes)
+            data->shapes_.push_back(
+                {shape->GetType(), shape->GetScale(), Shape::Cooked()});
+
+        auto parsed = NewCounter();
+        auto cooked = NewCounter();
+        auto p = data.get();
+        jobs->Run([p]() { p->mesh_->Load(p->node_); }, parsed);
+        jobs->Run(
+            [p]() {
+                if (!p->mesh_->GetVertexsData().empty())
+                    p->mesh_->Cook();
+            },
+            *parsed, cooked);
+        auto done = cooked;
+        if (!shapes.empty()) {
+            done = NewCounter();
+            for (auto& shape : data->shapes_) {
+                auto s = &shape;
+                jobs->Run(
+                    [p, s]() {
+                        auto& mesh = *p->mesh_;
+                        if (!mesh.GetVertexsData().empty())
+                            s->cooked_ = Shape::Cook(s->type_, s->scale_,
+                                                     mesh.GetBB(), &mesh);
+                    },
+                    *cooked, done);
+            }
+        }
+        std::vector<PObject> objects(shapes.begin(), shapes.end());
+        objects.push_back(mesh);
+        AddStage(done, objects, [mesh, shapes, data]() {
+            mesh->SetCooked(*data->mesh_);
+            mesh->SetNodeLoaded();
+            for (size_t i = 0; i < shapes.size(); i++) {
+                auto& cooked = data->shapes_[i].cooked_;
+                if (cooked.shape_)
+                    shapes[i]->SetCooked(cooked);
+            }
+        });
     }
-    return true;
 }
 
 void LoaderXML::Load() {
     if (!loaded_) {
         if (IsReady()) {
+            WaitJobs();
             resources_ =
                 Object::LoadAll<Resource, ResourceFile>(this, "Resources");
             objects_.insert(resources_.begin(), resources_.end());
@@ -107,6 +331,8 @@ void LoaderXML::Load() {
             animations_ =
                 Object::LoadAll<Animation, Animation>(this, "Animations");
             objects_.insert(animations_.begin(), animations_.end());
+            totalObjects_ = objects_.size();
+            StartJobs();
             auto appNode = doc_.child("App");
             if (appNode) {
                 pugi::xml_node child = appNode.child("Scene");
@@ -123,6 +349,7 @@ void LoaderXML::Load() {
     } else if (AreReady()) {
         slotUpdate_ = nullptr;
         signalLoaded_->Run();
+        WaitJobs(); // they are done but can still be finishing
         doc_.reset(); // free mem
     }
 }
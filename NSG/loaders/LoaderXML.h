@@ -28,10 +28,19 @@ misrepresented as being the original software.
 #include "StrongFactory.h"
 #include "Types.h"
 #include "pugixml.hpp"
+#include <functional>
+#include <memory>
 #include <set>
 #include <string>
 
 namespace NSG {
+namespace Task {
+class JobCounter;
+}
+// Loads the objects in stages: the workers read, decompress, decode and
+// cook their data in private buffers (see StartJobs) while the main thread
+// gives it to the objects and makes them ready (GL uploads) during at most
+// the frame budget each frame.
 class LoaderXML : public Object, public StrongFactory<std::string, LoaderXML> {
 public:
     LoaderXML(const std::string& name);
@@ -45,6 +54,8 @@ public:
     pugi::xml_node GetNode(const std::string& type,
                            const std::string& name) const;
     PResource GetResource() const { return resource_; }
+    void SetFrameBudget(Milliseconds budget) { frameBudget_ = budget; }
+    Milliseconds GetFrameBudget() const { return frameBudget_; }
 
 private:
     void Load();
@@ -52,6 +63,13 @@ private:
     void AllocateResources() override;
     void ReleaseResources() override;
     bool AreReady();
+    struct Stage;
+    void StartJobs();
+    void CompleteStages();
+    void WaitJobs();
+    Task::JobCounter* NewCounter();
+    void AddStage(Task::JobCounter* done, std::vector<PObject> objects,
+                  std::function<void()> complete);
     PResource resource_;
     pugi::xml_document doc_;
     bool loaded_;
@@ -66,5 +84,9 @@ private:
     std::vector<PSkeleton> skeletons_;
     std::vector<PAnimation> animations_;
     std::set<PObject> objects_;
+    size_t totalObjects_;
+    Milliseconds frameBudget_;
+    std::vector<std::unique_ptr<Task::JobCounter>> counters_;
+    std::vector<std::unique_ptr<Stage>> stages_;
 };
 }
@@ -0,0 +1,71 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Cone.h"
+#include "BoundingBox.h"
+#include "Check.h"
+#include "Maths.h"
+#include "Sphere.h"
+#include <algorithm>
+#include <cmath>
+
+namespace NSG {
+Cone::Cone(const Vector3& apex, const Vector3& direction, float range,
+           float halfAngle)
+    : apex_(apex), direction_(direction), range_(range) {
+    CHECK_ASSERT(halfAngle >= 0 && halfAngle <= PI90 + EPSILON);
+    halfAngle = std::min(halfAngle, PI90);
+    cos_ = std::cos(halfAngle);
+    sin_ = std::sin(halfAngle);
+}
+
+Intersection Cone::IsInside(const BoundingBox& box) const {
+    auto res = Sphere(apex_, range_).IsInside(box);
+    if (res == Intersection::OUTSIDE)
+        return Intersection::OUTSIDE;
+
+    // bounding sphere of the box against the lateral surface
+    auto center = box.Center() - apex_;
+    auto radius = 0.5f * box.Size().Length();
+    auto axial = center.Dot(direction_);
+    auto radial = std::sqrt(std::max(0.f, center.Length2() - axial * axial));
+    if (axial < -radius || cos_ * radial - sin_ * axial > radius)
+        return Intersection::OUTSIDE;
+
+    if (res == Intersection::INSIDE) {
+        // the cone is convex: inside when the eight corners are
+        for (int i = 0; i < 8; i++) {
+            Vector3 corner(i & 1 ? box.max_.x : box.min_.x,
+                           i & 2 ? box.max_.y : box.min_.y,
+                           i & 4 ? box.max_.z : box.min_.z);
+            auto v = corner - apex_;
+            if (v.Dot(direction_) < cos_ * v.Length())
+                return Intersection::INTERSECTS;
+        }
+        return Intersection::INSIDE;
+    }
+    return Intersection::INTERSECTS;
+}
+}
@@ -105,6 +105,13 @@ float Quaternion::Dot(const Quaternion& q) const {
     return tmp.x + tmp.y + tmp.z + tmp.w;
 }
 
+float Quaternion::Angle(const Quaternion& q) const {
+    // atan2 keeps the precision of small angles (acos of the dot does not)
+    auto d = Inverse() * q;
+    auto s = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+    return 2 * std::atan2(s, std::abs(d.w));
+}
+
 Quaternion Quaternion::Inverse() const {
     Quaternion conjugate(w, -x, -y, -z);
     return conjugate / Dot(*this);
@@ -42,6 +42,8 @@ struct Quaternion {
     const Quaternion& operator*=(const Quaternion& q);
     bool IsNaN() const;
     float Dot(const Quaternion& q) const;
+    // Angle in radians of the rotation between both
+    float Angle(const Quaternion& q) const;
     Quaternion Inverse() const;
     Quaternion Slerp(const Quaternion& b, float t) const;
     float Roll() const;
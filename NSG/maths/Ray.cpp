@@ -26,6 +26,7 @@
 #include "Check.h"
 #include "Maths.h"
 #include "Mesh.h"
+#include "MeshBVH.h"
 #include "SceneNode.h"
 
 namespace NSG {
@@ -174,32 +175,41 @@ float Ray::HitDistance(const BoundingBox& box) const {
     return distance;
 }
 
+static float GetMaxScale(const SceneNode* node) {
+    Vector3 scale = node->GetGlobalScale();
+    CHECK_ASSERT(Abs(scale.x) > EPSILON);
+    return std::max(std::max(scale.x, scale.y), scale.z);
+}
+
 float Ray::HitDistance(const SceneNode* node) const {
     const float MAX_DISTANCE = std::numeric_limits<float>::max();
     float nearest = MAX_DISTANCE;
-    PMesh mesh = node->GetMesh();
-    if (mesh) {
+    auto& mesh = node->GetMesh();
+    auto bvh = mesh ? mesh->GetBVH() : nullptr;
+    if (bvh) {
         auto& m = node->GetGlobalModelInvMatrix();
         Ray localRay = Transformed(m);
-        size_t n = mesh->GetNumberOfTriangles();
-        for (size_t i = 0; i < n; i++) {
-            const Vector3& v0 = mesh->GetTriangleVertex(i, 0).position_;
-            const Vector3& v1 = mesh->GetTriangleVertex(i, 1).position_;
-            const Vector3& v2 = mesh->GetTriangleVertex(i, 2).position_;
-            nearest = Min(nearest, localRay.HitDistance(v0, v1, v2));
-        }
-
+        nearest = bvh->ClosestHit(localRay);
         if (nearest < MAX_DISTANCE) {
             // multiply per scale to have correct distance
-            Vector3 scale = node->GetGlobalScale();
-            CHECK_ASSERT(Abs(scale.x) > EPSILON);
-            auto maxScale = std::max(std::max(scale.x, scale.y), scale.z);
-            nearest *= maxScale;
+            nearest *= GetMaxScale(node);
         }
     }
     return nearest;
 }
 
+bool Ray::Hits(const SceneNode* node) const {
+    auto& mesh = node->GetMesh();
+    auto bvh = mesh ? mesh->GetBVH() : nullptr;
+    if (!bvh)
+        return false;
+    auto localRay = Transformed(node->GetGlobalModelInvMatrix());
+    auto maxDistance = maxDistance_;
+    if (maxDistance < std::numeric_limits<float>::max())
+        maxDistance /= GetMaxScale(node);
+    return bvh->AnyHit(localRay, maxDistance);
+}
+
 Vertex3 Ray::GetPoint(float distance) const {
     return origin_ + direction_ * distance;
 }
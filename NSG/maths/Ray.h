@@ -42,7 +42,10 @@ public:
                       Vector3* outNormal = nullptr) const;
     float HitDistance(const BoundingBox& box) const;
     Intersection IsInside(const BoundingBox& box) const;
+    // Nearest triangle of the node's mesh (see Mesh::GetBVH)
     float HitDistance(const SceneNode* node) const;
+    // Any triangle of the node's mesh closer than GetMaxDistance()
+    bool Hits(const SceneNode* node) const;
     float GetMaxDistance() const { return maxDistance_; }
     Vertex3 GetPoint(float distance) const;
     const Vector3& GetDirection() const { return direction_; }
@@ -88,29 +88,28 @@ Intersection Sphere::IsInside(const BoundingBox& box) const {
     max = max - center_;
 
     Vector3 tempVec = min; // - - -
-    auto length2 = tempVec.Length2();
-    if (length2 >= radiusSquared)
+    if (tempVec.Length2() >= radiusSquared)
         return Intersection::INTERSECTS;
     tempVec.x = max.x; // + - -
-    if (length2 >= radiusSquared)
+    if (tempVec.Length2() >= radiusSquared)
         return Intersection::INTERSECTS;
     tempVec.y = max.y; // + + -
-    if (length2 >= radiusSquared)
+    if (tempVec.Length2() >= radiusSquared)
         return Intersection::INTERSECTS;
     tempVec.x = min.x; // - + -
-    if (length2 >= radiusSquared)
+    if (tempVec.Length2() >= radiusSquared)
         return Intersection::INTERSECTS;
     tempVec.z = max.z; // - + +
-    if (length2 >= radiusSquared)
+    if (tempVec.Length2() >= radiusSquared)
         return Intersection::INTERSECTS;
     tempVec.y = min.y; // - - +
-    if (length2 >= radiusSquared)
+    if (tempVec.Length2() >= radiusSquared)
         return Intersection::INTERSECTS;
     tempVec.x = max.x; // + - +
-    if (length2 >= radiusSquared)
+    if (tempVec.Length2() >= radiusSquared)
         return Intersection::INTERSECTS;
     tempVec.y = max.y; // + + +
-    if (length2 >= radiusSquared)
+    if (tempVec.Length2() >= radiusSquared)
         return Intersection::INTERSECTS;
 
     return Intersection::INSIDE;
@@ -29,13 +29,25 @@ misrepresented as being the original software.
 #include "InstanceBuffer.h"
 #include "InstanceData.h"
 #include "Log.h"
+#include "MappedFile.h"
+#include "Maths.h"
+#include "MeshBVH.h"
+#include "MeshFormat.h"
+#include "MeshOptimizer.h"
 #include "ModelMesh.h"
+#include "Path.h"
+#include "RenderingCapabilities.h"
 #include "RenderingContext.h"
 #include "StringConverter.h"
 #include "Util.h"
 #include "VertexArrayObj.h"
 #include "Window.h"
 #include "pugixml.hpp"
+#include <cstddef>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
 #include <sstream>
 
 namespace NSG {
@@ -43,10 +55,49 @@ template <>
 std::map<std::string, PWeakMesh> WeakFactory<std::string, Mesh>::objsMap_ =
     std::map<std::string, PWeakMesh>{};
 
+static const MeshFileAttribute VertexLayout[] = {
+    {(uint32_t)AttributesLoc::POSITION, 3, offsetof(VertexData, position_)},
+    {(uint32_t)AttributesLoc::NORMAL, 3, offsetof(VertexData, normal_)},
+    {(uint32_t)AttributesLoc::TEXTURECOORD0, 2, offsetof(VertexData, uv_[0])},
+    {(uint32_t)AttributesLoc::TEXTURECOORD1, 2, offsetof(VertexData, uv_[1])},
+    {(uint32_t)AttributesLoc::COLOR, 4, offsetof(VertexData, color_)},
+    {(uint32_t)AttributesLoc::TANGENT, 3, offsetof(VertexData, tangent_)},
+    {(uint32_t)AttributesLoc::BONES_ID, 4, offsetof(VertexData, bonesID_)},
+    {(uint32_t)AttributesLoc::BONES_WEIGHT, 4,
+     offsetof(VertexData, bonesWeight_)},
+};
+
+static const uint32_t VertexLayoutSize =
+    sizeof(VertexLayout) / sizeof(VertexLayout[0]);
+
+// Interleaves 10 bits of each coordinate (x in the lowest bit)
+static unsigned MortonCode(const Vector3& normalized) {
+    auto spread = [](unsigned value) {
+        value &= 0x3ff;
+        value = (value | (value << 16)) & 0x030000ff;
+        value = (value | (value << 8)) & 0x0300f00f;
+        value = (value | (value << 4)) & 0x030c30c3;
+        value = (value | (value << 2)) & 0x09249249;
+        return value;
+    };
+    auto x = (unsigned)Clamp(normalized.x * 1023.f, 0.f, 1023.f);
+    auto y = (unsigned)Clamp(normalized.y * 1023.f, 0.f, 1023.f);
+    auto z = (unsigned)Clamp(normalized.z * 1023.f, 0.f, 1023.f);
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+static uint64_t AlignMeshFileOffset(uint64_t offset) {
+    return (offset + MESH_FILE_ALIGNMENT - 1) &
+           ~(uint64_t)(MESH_FILE_ALIGNMENT - 1);
+}
+
 Mesh::Mesh(const std::string& name, bool dynamic)
     : Object(name), boundingSphereRadius_(0), isStatic_(!dynamic),
       areTangentsCalculated_(false), serializable_(true),
-      hasDeformBones_(false) {
+      hasDeformBones_(false), hasStoredBounds_(false), needsSplit_(false),
+      optimize_(false), optimizeOverdraw_(false), isOptimized_(false),
+      cooked_(false),
+      variationStamp_(NewVariationStamp()) {
     if (name_.empty())
         name_ = GetUniqueName("Mesh");
 }
@@ -58,6 +109,14 @@ void Mesh::SetDynamic(bool dynamic) {
     Invalidate();
 }
 
+void Mesh::SetVertexFormat(const VertexFormat& format) {
+    if (vertexFormat_ != format) {
+        vertexFormat_ = format;
+        Invalidate();
+        pVBuffer_ = nullptr; // dynamic buffers keep the old layout
+    }
+}
+
 bool Mesh::IsValid() {
     auto mainWindow = Window::GetMainWindow();
     return mainWindow && mainWindow->IsReady() && !vertexsData_.empty();
@@ -66,8 +125,9 @@ bool Mesh::IsValid() {
 void Mesh::AllocateResources() {
     CHECK_GL_STATUS();
 
-    if (!areTangentsCalculated_)
-        CalculateTangents();
+    if (!cooked_)
+        Cook();
+    cooked_ = false;
 
     CHECK_ASSERT(!isStatic_ || pVBuffer_ == nullptr);
     CHECK_ASSERT(!isStatic_ || pIBuffer_ == nullptr);
@@ -77,12 +137,23 @@ void Mesh::AllocateResources() {
     CHECK_ASSERT(GetSolidDrawMode() != GL_TRIANGLES ||
                  indexes_.size() % 3 == 0);
 
+    auto hasIndexUint = RenderingCapabilities::GetPtr()->HasElementIndexUint();
+    needsSplit_ = !hasIndexUint && GetSolidDrawMode() == GL_TRIANGLES &&
+                  IndexBuffer::Needs32Bits(indexes_);
+    if (needsSplit_) {
+        // The scene nodes will draw it with chunks (see SceneNode::SplitMesh)
+        LOGW("Mesh %s needs 32 bits indexes: splitting it", name_.c_str());
+        for (auto& node : sceneNodes_)
+            node->OnDirty(); // the scene splits them in Scene::UpdateAll
+        return;
+    }
+
     if (isStatic_)
-        pVBuffer_ =
-            PVertexBuffer(new VertexBuffer(vertexsData_, GL_STATIC_DRAW));
+        pVBuffer_ = PVertexBuffer(
+            new VertexBuffer(vertexsData_, vertexFormat_, GL_STATIC_DRAW));
     else if (!pVBuffer_)
-        pVBuffer_ =
-            PVertexBuffer(new VertexBuffer(vertexsData_, GL_DYNAMIC_DRAW));
+        pVBuffer_ = PVertexBuffer(
+            new VertexBuffer(vertexsData_, vertexFormat_, GL_DYNAMIC_DRAW));
     else
         pVBuffer_->UpdateData();
 
@@ -100,6 +171,11 @@ void Mesh::AllocateResources() {
         CHECK_CONDITION(pIBuffer_->IsReady());
     }
 
+    if (!hasIndexUint && IndexBuffer::Needs32Bits(indexesWireframe_)) {
+        LOGW("Mesh %s: wireframe needs 32 bits indexes", name_.c_str());
+        indexesWireframe_.clear();
+    }
+
     if (!indexesWireframe_.empty()) {
         if (isStatic_)
             pIWireBuffer_ = PIndexBuffer(
@@ -113,13 +189,46 @@ void Mesh::AllocateResources() {
         CHECK_CONDITION(pIWireBuffer_->IsReady());
     }
 
-    for (auto& vertex : vertexsData_) {
-        bb_.Merge(vertex.position_);
-        boundingSphereRadius_ =
-            std::max(boundingSphereRadius_, vertex.position_.Length());
+    CHECK_GL_STATUS();
+}
+
+void Mesh::Cook() {
+    if (optimize_ && !isOptimized_)
+        Optimize(optimizeOverdraw_);
+
+    if (!areTangentsCalculated_) {
+        CalculateTangents();
+        areTangentsCalculated_ = true;
     }
 
-    CHECK_GL_STATUS();
+    if (!hasStoredBounds_) {
+        for (auto& vertex : vertexsData_) {
+            bb_.Merge(vertex.position_);
+            boundingSphereRadius_ =
+                std::max(boundingSphereRadius_, vertex.position_.Length());
+        }
+    }
+    cooked_ = true;
+}
+
+void Mesh::SetCooked(Mesh& cooked) {
+    vertexFormat_ = cooked.vertexFormat_;
+    optimize_ = cooked.optimize_;
+    optimizeOverdraw_ = cooked.optimizeOverdraw_;
+    isOptimized_ = cooked.isOptimized_;
+    for (int i = 0; i < MAX_UVS; i++)
+        uvNames_[i] = cooked.uvNames_[i];
+    variationStamp_ = NewVariationStamp();
+    vertexsData_.swap(cooked.vertexsData_);
+    indexes_.swap(cooked.indexes_);
+    indexesWireframe_.swap(cooked.indexesWireframe_);
+    areTangentsCalculated_ = cooked.areTangentsCalculated_;
+    hasDeformBones_ = cooked.hasDeformBones_;
+    hasStoredBounds_ = cooked.hasStoredBounds_;
+    bb_ = cooked.bb_;
+    boundingSphereRadius_ = cooked.boundingSphereRadius_;
+    bvh_ = nullptr;
+    cooked_ = cooked.cooked_;
 }
 
 void Mesh::ReleaseResources() {
@@ -136,6 +245,10 @@ void Mesh::ReleaseResources() {
     }
 
     areTangentsCalculated_ = false;
+    hasStoredBounds_ = false;
+    needsSplit_ = false;
+    isOptimized_ = false;
+    bvh_ = nullptr;
 
     for (auto& node : sceneNodes_)
         node->OnDirty(); // due text meshes can change with window resize
@@ -149,6 +262,13 @@ void Mesh::Save(pugi::xml_node& node) {
     child.append_attribute("wireFrameDrawMode")
         .set_value(GetWireFrameDrawMode());
     child.append_attribute("solidDrawMode").set_value(GetSolidDrawMode());
+    if (!vertexFormat_.IsFloat())
+        child.append_attribute("vertexFormat")
+            .set_value(vertexFormat_.GetKey());
+    if (optimize_) {
+        child.append_attribute("optimize").set_value(true);
+        child.append_attribute("optimizeOverdraw").set_value(optimizeOverdraw_);
+    }
     for (int i = 0; i < MAX_UVS; i++) {
         std::string attName = "uv" + ToString(i) + "Name";
         child.append_attribute(attName.c_str()).set_value(uvNames_[i].c_str());
@@ -178,7 +298,7 @@ void Mesh::Save(pugi::xml_node& node) {
         pugi::xml_node indexesNode = child.append_child("Indexes");
         std::string s;
         for (auto& obj : indexes_)
-            s += ToString(obj) + " ";
+            s += ToString((size_t)obj) + " ";
         indexesNode.append_child(pugi::node_pcdata).set_value(s.c_str());
     }
 }
@@ -188,11 +308,24 @@ void Mesh::Load(const pugi::xml_node& node) {
     indexes_.clear();
 
     name_ = node.attribute("name").as_string();
+    vertexFormat_ =
+        VertexFormat::FromKey(node.attribute("vertexFormat").as_uint());
+    optimize_ = node.attribute("optimize").as_bool();
+    optimizeOverdraw_ = node.attribute("optimizeOverdraw").as_bool();
+
+    auto fileAtt = node.attribute("file");
+    if (fileAtt) {
+        if (!LoadBinary(Path(fileAtt.as_string())))
+            LOGE("Cannot load mesh %s from %s", name_.c_str(),
+                 fileAtt.as_string());
+        return;
+    }
 
     for (int i = 0; i < MAX_UVS; i++) {
         std::string attName = "uv" + ToString(i) + "Name";
         uvNames_[i] = node.attribute(attName.c_str()).as_string();
     }
+    variationStamp_ = NewVariationStamp();
 
     pugi::xml_node vertexesNode = node.child("Vertexes");
     if (vertexesNode) {
@@ -305,6 +438,7 @@ void Mesh::AddQuad(const VertexData& v0, const VertexData& v1,
 
         if (calcFaceNormal)
             AverageNormals(vidx, true);
+        isOptimized_ = false;
         Invalidate();
     } else {
         LOGW("Too many vertices. Limit is %d",
@@ -327,6 +461,7 @@ void Mesh::AddTriangle(const VertexData& v0, const VertexData& v1,
         if (averageFaceNormal)
             AverageNormals(vidx, false);
 
+        isOptimized_ = false;
         Invalidate();
     } else {
         LOGW("Too many vertices. Limit is %d",
@@ -350,6 +485,7 @@ void Mesh::AddTriangle(const VertexData& v0, const VertexData& v1,
         vertexsData_[vidx + 1].normal_ = normal;
         vertexsData_[vidx + 2].normal_ = normal;
 
+        isOptimized_ = false;
         Invalidate();
     } else {
         LOGW("Too many vertices. Limit is %d",
@@ -392,18 +528,331 @@ void Mesh::SaveMeshes(pugi::xml_node& node) {
         obj->Save(child);
 }
 
+bool Mesh::SaveBinary(const Path& path) {
+    if (vertexsData_.empty()) {
+        LOGE("Cannot save empty mesh %s", name_.c_str());
+        return false;
+    }
+
+    if (!areTangentsCalculated_) {
+        CalculateTangents();
+        areTangentsCalculated_ = true;
+    }
+
+    MeshFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic_, MESH_FILE_MAGIC, sizeof(header.magic_));
+    header.version_ = MESH_FILE_VERSION;
+    header.flags_ = MF_TANGENTS | (hasDeformBones_ ? MF_DEFORM_BONES : 0);
+    header.solidDrawMode_ = GetSolidDrawMode();
+    header.attributes_ = VertexLayoutSize;
+    header.vertexSize_ = sizeof(VertexData);
+    // 16 bits indexes when possible, as the GPU gets them
+    bool shortIndexes = !IndexBuffer::Needs32Bits(indexes_);
+    header.indexSize_ = shortIndexes ? sizeof(uint16_t) : sizeof(IndexType);
+    header.vertexCount_ = (uint32_t)vertexsData_.size();
+    header.indexCount_ = (uint32_t)indexes_.size();
+    header.vertexFormat_ = vertexFormat_.GetKey();
+    header.vertexOffset_ = AlignMeshFileOffset(
+        sizeof(MeshFileHeader) + sizeof(VertexLayout));
+    header.indexOffset_ = AlignMeshFileOffset(
+        header.vertexOffset_ + vertexsData_.size() * sizeof(VertexData));
+
+    BoundingBox bb;
+    float radius = 0;
+    for (auto& vertex : vertexsData_) {
+        bb.Merge(vertex.position_);
+        radius = std::max(radius, vertex.position_.Length());
+    }
+    for (int i = 0; i < 3; i++) {
+        header.bbMin_[i] = bb.min_[i];
+        header.bbMax_[i] = bb.max_[i];
+    }
+    header.boundingSphereRadius_ = radius;
+
+    for (int i = 0; i < MAX_UVS; i++) {
+        CHECK_CONDITION(uvNames_[i].size() < MESH_FILE_MAX_UV_NAME);
+        strcpy(header.uvNames_[i], uvNames_[i].c_str());
+    }
+
+    std::ofstream os(path.GetFullAbsoluteFilePath(), std::ios::binary);
+    if (!os.is_open()) {
+        LOGE("Cannot save file: %s", path.GetFilePath().c_str());
+        return false;
+    }
+
+    static const char padding[MESH_FILE_ALIGNMENT] = {0};
+    os.write((const char*)&header, sizeof(header));
+    os.write((const char*)VertexLayout, sizeof(VertexLayout));
+    os.write(padding, header.vertexOffset_ - (uint64_t)os.tellp());
+    os.write((const char*)&vertexsData_[0],
+             vertexsData_.size() * sizeof(VertexData));
+    if (!indexes_.empty()) {
+        os.write(padding, header.indexOffset_ - (uint64_t)os.tellp());
+        if (shortIndexes) {
+            std::vector<uint16_t> indexes(indexes_.begin(), indexes_.end());
+            os.write((const char*)&indexes[0],
+                     indexes.size() * sizeof(uint16_t));
+        } else
+            os.write((const char*)&indexes_[0],
+                     indexes_.size() * sizeof(IndexType));
+    }
+    return os.good();
+}
+
+bool Mesh::LoadBinary(const Path& path) {
+    MappedFile file(path);
+    if (!file.IsOpen())
+        return false;
+
+    auto data = file.GetData();
+    auto size = (uint64_t)file.GetSize();
+    auto filename = path.GetFilePath();
+
+    MeshFileHeader header;
+    if (size < sizeof(header)) {
+        LOGE("Invalid mesh file: %s", filename.c_str());
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic_, MESH_FILE_MAGIC, sizeof(header.magic_)) != 0) {
+        LOGE("Invalid mesh file: %s", filename.c_str());
+        return false;
+    }
+
+    if (header.version_ != MESH_FILE_VERSION) {
+        LOGE("Mesh file %s has version %u. Expected version is %u",
+             filename.c_str(), header.version_, MESH_FILE_VERSION);
+        return false;
+    }
+
+    if (header.solidDrawMode_ != (uint32_t)GetSolidDrawMode()) {
+        LOGE("Mesh file %s has an unexpected draw mode", filename.c_str());
+        return false;
+    }
+
+    // The blobs are copied as they are so the layout has to match VertexData
+    bool sameLayout = header.vertexSize_ == sizeof(VertexData) &&
+                      (header.indexSize_ == sizeof(IndexType) ||
+                       header.indexSize_ == sizeof(uint16_t)) &&
+                      header.attributes_ == VertexLayoutSize &&
+                      size >= sizeof(header) + sizeof(VertexLayout) &&
+                      memcmp(data + sizeof(header), VertexLayout,
+                             sizeof(VertexLayout)) == 0;
+    if (!sameLayout) {
+        LOGE("Mesh file %s has an incompatible vertex layout",
+             filename.c_str());
+        return false;
+    }
+
+    uint64_t vertexBytes = (uint64_t)header.vertexCount_ * header.vertexSize_;
+    uint64_t indexBytes = (uint64_t)header.indexCount_ * header.indexSize_;
+    if (header.vertexOffset_ + vertexBytes > size ||
+        (indexBytes && header.indexOffset_ + indexBytes > size)) {
+        LOGE("Mesh file %s is truncated", filename.c_str());
+        return false;
+    }
+
+    auto vertexes = (const VertexData*)(data + header.vertexOffset_);
+    vertexsData_.assign(vertexes, vertexes + header.vertexCount_);
+    if (header.indexSize_ == sizeof(uint16_t)) {
+        auto indexes = (const uint16_t*)(data + header.indexOffset_);
+        indexes_.assign(indexes, indexes + header.indexCount_);
+    } else {
+        auto indexes = (const IndexType*)(data + header.indexOffset_);
+        indexes_.assign(indexes, indexes + header.indexCount_);
+    }
+
+    areTangentsCalculated_ = (header.flags_ & MF_TANGENTS) != 0;
+    isOptimized_ = false;
+    hasDeformBones_ = (header.flags_ & MF_DEFORM_BONES) != 0;
+    vertexFormat_ = VertexFormat::FromKey(header.vertexFormat_);
+
+    for (int i = 0; i < MAX_UVS; i++) {
+        header.uvNames_[i][MESH_FILE_MAX_UV_NAME - 1] = 0;
+        uvNames_[i] = header.uvNames_[i];
+    }
+    variationStamp_ = NewVariationStamp();
+
+    bb_ = BoundingBox(Vector3(header.bbMin_[0], header.bbMin_[1],
+                              header.bbMin_[2]),
+                      Vector3(header.bbMax_[0], header.bbMax_[1],
+                              header.bbMax_[2]));
+    boundingSphereRadius_ = header.boundingSphereRadius_;
+    hasStoredBounds_ = true;
+    return true;
+}
+
+void Mesh::SaveExternal(pugi::xml_node& node, const Path& path,
+                        const Path& outputDir) {
+    if (!serializable_)
+        return;
+
+    Path newPath;
+    newPath.SetPath(path.GetPath());
+    newPath.SetFileName(name_ + ".nsgmesh");
+    if (!SaveBinary(newPath))
+        return;
+
+    pugi::xml_node child = node.append_child("Mesh");
+    child.append_attribute("name").set_value(name_.c_str());
+    child.append_attribute("wireFrameDrawMode")
+        .set_value(GetWireFrameDrawMode());
+    child.append_attribute("solidDrawMode").set_value(GetSolidDrawMode());
+
+    std::vector<std::string> dirs = Path::GetDirs(outputDir.GetPath());
+    Path relativePath;
+    if (!dirs.empty())
+        relativePath.SetPath(dirs.back());
+    relativePath.SetFileName(newPath.GetFilename());
+    child.append_attribute("file").set_value(
+        relativePath.GetFilePath().c_str());
+}
+
+void Mesh::SaveMeshesExternally(pugi::xml_node& node, const Path& path,
+                                const Path& outputDir) {
+    pugi::xml_node child = node.append_child("Meshes");
+    auto meshes = Mesh::GetObjs();
+    for (auto& obj : meshes)
+        obj->SaveExternal(child, path, outputDir);
+}
+
 void Mesh::SetMeshData(const VertexsData& vertexsData, const Indexes& indexes) {
     // if (vertexsData_ != vertexsData || indexes_ != indexes)
     {
         vertexsData_ = vertexsData;
         indexes_ = indexes;
+        isOptimized_ = false;
+        Invalidate();
+    }
+}
+
+void Mesh::Optimize(bool overdraw) {
+    if (GetSolidDrawMode() != GL_TRIANGLES || vertexsData_.empty())
+        return;
+
+    if (indexes_.empty()) {
+        indexes_.resize(vertexsData_.size());
+        std::iota(indexes_.begin(), indexes_.end(), 0);
+    }
+    CHECK_ASSERT(indexes_.size() % 3 == 0);
+
+#if (defined(DEBUG) || defined(_DEBUG)) && !defined(NDEBUG)
+    // only for the log
+    auto nVertexes = vertexsData_.size();
+    auto before = AnalyzeVertexCache(indexes_, nVertexes);
+#endif
+    RemapIndexes(WeldVertexes(vertexsData_, indexes_), indexesWireframe_);
+    OptimizeVertexCache(indexes_, vertexsData_.size());
+    if (overdraw)
+        OptimizeOverdraw(vertexsData_, indexes_);
+    RemapIndexes(OptimizeVertexFetch(vertexsData_, indexes_),
+                 indexesWireframe_);
+    bvh_ = nullptr;
+    isOptimized_ = true;
+#if (defined(DEBUG) || defined(_DEBUG)) && !defined(NDEBUG)
+    auto after = AnalyzeVertexCache(indexes_, vertexsData_.size());
+    LOGI("Mesh %s optimized: vertexes %u->%u, ACMR %.3f->%.3f, "
+         "ATVR %.3f->%.3f",
+         name_.c_str(), (unsigned)nVertexes, (unsigned)vertexsData_.size(),
+         before.acmr_, after.acmr_, before.atvr_, after.atvr_);
+#endif
+}
+
+void Mesh::SetOptimizeOnLoad(bool optimize, bool overdraw) {
+    if (optimize_ != optimize || optimizeOverdraw_ != overdraw) {
+        optimize_ = optimize;
+        optimizeOverdraw_ = overdraw;
         Invalidate();
     }
 }
 
+const MeshBVH* Mesh::GetBVH() {
+    if (!bvh_ && IsReady()) {
+        bvh_ = PMeshBVH(new MeshBVH(*this));
+        LOGI("Mesh %s: BVH with %u nodes for %u triangles", name_.c_str(),
+             (unsigned)bvh_->GetNodesCount(),
+             (unsigned)bvh_->GetTrianglesCount());
+    }
+    return bvh_.get();
+}
+
+std::vector<PModelMesh> Mesh::Split(size_t maxVertexes) const {
+    CHECK_CONDITION(GetSolidDrawMode() == GL_TRIANGLES && !indexes_.empty());
+    CHECK_CONDITION(maxVertexes >= 3);
+    CHECK_ASSERT(indexes_.size() % 3 == 0);
+
+    // Triangles sorted along a Morton curve: neighbours end up in the same
+    // chunk, keeping the chunks compact and the vertexes cache friendly
+    BoundingBox bb;
+    for (auto& vertex : vertexsData_)
+        bb.Merge(vertex.position_);
+    auto size = bb.Size();
+    auto scale = Vector3(size.x > 0 ? 1.f / size.x : 0.f,
+                         size.y > 0 ? 1.f / size.y : 0.f,
+                         size.z > 0 ? 1.f / size.z : 0.f);
+    auto nTriangles = indexes_.size() / 3;
+    std::vector<std::pair<unsigned, size_t>> triangles(nTriangles);
+    for (size_t i = 0; i < nTriangles; i++) {
+        auto center = (vertexsData_[indexes_[3 * i]].position_ +
+                       vertexsData_[indexes_[3 * i + 1]].position_ +
+                       vertexsData_[indexes_[3 * i + 2]].position_) /
+                      3.f;
+        triangles[i] = {MortonCode((center - bb.min_) * scale), i};
+    }
+    std::sort(triangles.begin(), triangles.end());
+
+    std::vector<PModelMesh> chunks;
+    VertexsData vertexes;
+    Indexes indexes;
+    auto flush = [&]() {
+        auto chunk = std::make_shared<ModelMesh>(name_ + "_chunk" +
+                                                 ToString(chunks.size()));
+        chunk->SetSerializable(false);
+        chunk->isStatic_ = isStatic_;
+        chunk->hasDeformBones_ = hasDeformBones_;
+        chunk->vertexFormat_ = vertexFormat_;
+        for (int i = 0; i < MAX_UVS; i++)
+            chunk->SetUVName(i, uvNames_[i]);
+        chunk->SetMeshData(vertexes, indexes);
+        chunks.push_back(chunk);
+        vertexes.clear();
+        indexes.clear();
+    };
+
+    const size_t unused = std::numeric_limits<size_t>::max();
+    std::vector<size_t> vertexChunk(vertexsData_.size(), unused);
+    std::vector<IndexType> chunkIndex(vertexsData_.size());
+    for (auto& triangle : triangles) {
+        auto first = &indexes_[3 * triangle.second];
+        size_t newVertexes = 0;
+        for (int i = 0; i < 3; i++)
+            if (vertexChunk[first[i]] != chunks.size())
+                ++newVertexes;
+        if (vertexes.size() + newVertexes > maxVertexes)
+            flush();
+        for (int i = 0; i < 3; i++) {
+            auto index = first[i];
+            if (vertexChunk[index] != chunks.size()) {
+                vertexChunk[index] = chunks.size();
+                chunkIndex[index] = (IndexType)vertexes.size();
+                vertexes.push_back(vertexsData_[index]);
+            }
+            indexes.push_back(chunkIndex[index]);
+        }
+    }
+    if (!indexes.empty())
+        flush();
+    return chunks;
+}
+
 void Mesh::SetUVName(int index, const std::string& name) {
     CHECK_CONDITION(index >= 0 && index < MAX_UVS);
-    uvNames_[index] = name;
+    if (uvNames_[index] != name) {
+        uvNames_[index] = name;
+        variationStamp_ = NewVariationStamp();
+    }
 }
 
 const std::string& Mesh::GetUVName(int index) const {
@@ -423,12 +872,12 @@ int Mesh::GetUVIndex(const std::string& name) const {
 }
 
 const BoundingBox& Mesh::GetBB() const {
-    CHECK_CONDITION(((Mesh*)this)->Mesh::IsReady());
+    CHECK_CONDITION(cooked_ || ((Mesh*)this)->Mesh::IsReady());
     return bb_;
 }
 
 float Mesh::GetBoundingSphereRadius() const {
-    CHECK_CONDITION(((Mesh*)this)->IsReady());
+    CHECK_CONDITION(cooked_ || ((Mesh*)this)->IsReady());
     return boundingSphereRadius_;
 }
 }
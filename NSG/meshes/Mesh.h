@@ -32,6 +32,7 @@ misrepresented as being the original software.
 #include "Resource.h"
 #include "Types.h"
 #include "VertexBuffer.h"
+#include "VertexFormat.h"
 #include "WeakFactory.h"
 #include <memory>
 #include <set>
@@ -46,6 +47,9 @@ public:
     virtual ~Mesh();
     void SetDynamic(bool dynamic);
     bool IsStatic() const { return isStatic_; }
+    // Attributes and encodings uploaded to the GPU (all floats by default)
+    void SetVertexFormat(const VertexFormat& format);
+    const VertexFormat& GetVertexFormat() const { return vertexFormat_; }
     virtual GLenum GetWireFrameDrawMode() const = 0;
     virtual GLenum GetSolidDrawMode() const = 0;
     virtual size_t GetNumberOfTriangles() const = 0;
@@ -83,6 +87,12 @@ public:
     const VertexData& GetTriangleVertex(size_t triangleIdx,
                                         size_t vertexIndex) const;
     static void SaveMeshes(pugi::xml_node& node);
+    // Stores the mesh data in the binary format (see MeshFormat.h)
+    bool SaveBinary(const Path& path);
+    void SaveExternal(pugi::xml_node& node, const Path& path,
+                      const Path& outputDir);
+    static void SaveMeshesExternally(pugi::xml_node& node, const Path& path,
+                                     const Path& outputDir);
     void SetMeshData(const VertexsData& vertexsData, const Indexes& indexes);
     virtual PhysicsShape GetShapeType() const {
         return SH_CONVEX_TRIMESH;
@@ -91,9 +101,32 @@ public:
     const std::string& GetUVName(int index) const;
     int GetUVIndex(const std::string& name) const;
     bool HasDeformBones() const { return hasDeformBones_; }
+    unsigned GetVariationStamp() const { return variationStamp_; }
+    // The indexes need 32 bits but the context does not support them
+    bool NeedsSplit() const { return needsSplit_; }
+    // Partitions the triangles in spatially coherent meshes of at most
+    // maxVertexes vertexes, so each one can be culled by itself
+    std::vector<PModelMesh> Split(
+        size_t maxVertexes = MAX_CHUNK_VERTEXES) const;
+    static const size_t MAX_CHUNK_VERTEXES = 65536; // 16 bits indexes
+    // Welds the vertexes and reorders triangles and vertexes for the GPU
+    // caches (see MeshOptimizer.h). Call it before the mesh is ready.
+    void Optimize(bool overdraw = false);
+    // Optimizes the data every time it is loaded or generated
+    void SetOptimizeOnLoad(bool optimize, bool overdraw = false);
+    // Triangles hierarchy for ray queries, built the first time it is
+    // needed and released with the mesh data. Null if not ready.
+    const MeshBVH* GetBVH();
+    // Cooking stage (optimization, tangents and bounds). AllocateResources
+    // skips it and the bounds can be used since it has been done.
+    void Cook();
+    // Takes the data of a private mesh loaded and cooked by a worker (see
+    // LoaderXML). Main thread only.
+    virtual void SetCooked(Mesh& cooked);
 
 protected:
     void Load(const pugi::xml_node& node) override;
+    bool LoadBinary(const Path& path);
     bool IsValid() override;
     void AllocateResources() override;
     void ReleaseResources() override;
@@ -117,5 +150,14 @@ protected:
     static const int MAX_UVS = 2;
     std::string uvNames_[MAX_UVS];
     bool hasDeformBones_;
+    bool hasStoredBounds_; // bb_ comes from a binary file
+    VertexFormat vertexFormat_;
+    bool needsSplit_;
+    bool optimize_;
+    bool optimizeOverdraw_;
+    bool isOptimized_; // cleared when the data is released
+    PMeshBVH bvh_;
+    bool cooked_;
+    unsigned variationStamp_; // changes with the UV names
 };
 }
@@ -0,0 +1,275 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "MeshBVH.h"
+#include "Check.h"
+#include "Mesh.h"
+#include "Ray.h"
+#include <algorithm>
+#include <limits>
+
+namespace NSG {
+// Deeper nodes stay as leaves, so the traversal can use a fixed stack
+static const size_t MAX_DEPTH = 64;
+static const float NO_HIT = std::numeric_limits<float>::max();
+
+struct BVHBounds {
+    float min_[3] = {NO_HIT, NO_HIT, NO_HIT};
+    float max_[3] = {-NO_HIT, -NO_HIT, -NO_HIT};
+    void Merge(const Vertex3& point) {
+        for (int axis = 0; axis < 3; axis++) {
+            min_[axis] = std::min(min_[axis], point[axis]);
+            max_[axis] = std::max(max_[axis], point[axis]);
+        }
+    }
+    void Merge(const BVHBounds& bounds) {
+        for (int axis = 0; axis < 3; axis++) {
+            min_[axis] = std::min(min_[axis], bounds.min_[axis]);
+            max_[axis] = std::max(max_[axis], bounds.max_[axis]);
+        }
+    }
+    float Center(int axis) const { return .5f * (min_[axis] + max_[axis]); }
+    float Area() const {
+        if (min_[0] > max_[0])
+            return 0; // empty
+        auto x = max_[0] - min_[0];
+        auto y = max_[1] - min_[1];
+        auto z = max_[2] - min_[2];
+        return x * y + y * z + z * x;
+    }
+};
+
+MeshBVH::MeshBVH(const Mesh& mesh) {
+    auto n = mesh.GetNumberOfTriangles();
+    CHECK_CONDITION(n < std::numeric_limits<uint32_t>::max());
+    triangles_.resize(n);
+    std::vector<BVHBounds> bounds(n);
+    for (size_t i = 0; i < n; i++) {
+        auto& triangle = triangles_[i];
+        triangle.v0_ = mesh.GetTriangleVertex(i, 0).position_;
+        triangle.v1_ = mesh.GetTriangleVertex(i, 1).position_;
+        triangle.v2_ = mesh.GetTriangleVertex(i, 2).position_;
+        triangle.index_ = (uint32_t)i;
+        bounds[i].Merge(triangle.v0_);
+        bounds[i].Merge(triangle.v1_);
+        bounds[i].Merge(triangle.v2_);
+    }
+    if (!n)
+        return;
+    nodes_.reserve(2 * n - 1);
+    nodes_.push_back(Node{{0, 0, 0}, 0, {0, 0, 0}, (uint32_t)n});
+    // (node, depth) pairs pending to be subdivided
+    std::vector<std::pair<uint32_t, size_t>> pending{{0, 0}};
+    while (!pending.empty()) {
+        auto item = pending.back();
+        pending.pop_back();
+        if (Subdivide(item.first, item.second + 1 < MAX_DEPTH, &bounds[0])) {
+            auto left = nodes_[item.first].first_;
+            pending.push_back({left, item.second + 1});
+            pending.push_back({left + 1, item.second + 1});
+        }
+    }
+}
+
+MeshBVH::~MeshBVH() {}
+
+bool MeshBVH::Subdivide(uint32_t nodeIndex, bool split,
+                        BVHBounds* triangleBounds) {
+    auto first = nodes_[nodeIndex].first_;
+    auto count = nodes_[nodeIndex].count_;
+    BVHBounds bounds, centroids;
+    for (auto i = first; i < first + count; i++) {
+        auto& box = triangleBounds[i];
+        bounds.Merge(box);
+        centroids.Merge(Vertex3(box.Center(0), box.Center(1), box.Center(2)));
+    }
+    auto& node = nodes_[nodeIndex];
+    for (int axis = 0; axis < 3; axis++) {
+        node.min_[axis] = bounds.min_[axis];
+        node.max_[axis] = bounds.max_[axis];
+    }
+    if (!split || count <= MAX_LEAF_TRIANGLES)
+        return false;
+
+    // Binned surface area heuristic
+    int bestAxis = -1;
+    size_t bestSplit = 0;
+    float bestCost = count * bounds.Area();
+    for (int axis = 0; axis < 3; axis++) {
+        auto minC = centroids.min_[axis];
+        auto extent = centroids.max_[axis] - minC;
+        if (extent <= 0)
+            continue;
+        auto scale = SAH_BINS / extent;
+        BVHBounds bins[SAH_BINS];
+        size_t counts[SAH_BINS] = {};
+        for (auto i = first; i < first + count; i++) {
+            auto& box = triangleBounds[i];
+            auto bin = std::min(SAH_BINS - 1,
+                                (size_t)((box.Center(axis) - minC) * scale));
+            bins[bin].Merge(box);
+            counts[bin]++;
+        }
+        float rightCosts[SAH_BINS];
+        BVHBounds right;
+        size_t rightCount = 0;
+        for (size_t bin = SAH_BINS - 1; bin > 0; bin--) {
+            right.Merge(bins[bin]);
+            rightCount += counts[bin];
+            rightCosts[bin] = rightCount * right.Area();
+        }
+        BVHBounds left;
+        size_t leftCount = 0;
+        for (size_t bin = 1; bin < SAH_BINS; bin++) {
+            left.Merge(bins[bin - 1]);
+            leftCount += counts[bin - 1];
+            auto cost = leftCount * left.Area() + rightCosts[bin];
+            if (leftCount && leftCount < count && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = bin;
+            }
+        }
+    }
+    if (bestAxis < 0)
+        return false; // splitting does not pay off
+
+    auto minC = centroids.min_[bestAxis];
+    auto scale = SAH_BINS / (centroids.max_[bestAxis] - minC);
+    auto i = first;
+    auto j = first + count;
+    while (i < j) {
+        auto center = triangleBounds[i].Center(bestAxis);
+        auto bin = std::min(SAH_BINS - 1, (size_t)((center - minC) * scale));
+        if (bin < bestSplit)
+            i++;
+        else {
+            j--;
+            std::swap(triangles_[i], triangles_[j]);
+            std::swap(triangleBounds[i], triangleBounds[j]);
+        }
+    }
+    auto leftCount = i - first;
+    CHECK_ASSERT(leftCount > 0 && leftCount < count);
+    auto left = (uint32_t)nodes_.size();
+    nodes_.push_back(Node{{0, 0, 0}, first, {0, 0, 0}, leftCount});
+    nodes_.push_back(Node{{0, 0, 0}, i, {0, 0, 0}, count - leftCount});
+    nodes_[nodeIndex].first_ = left;
+    nodes_[nodeIndex].count_ = 0;
+    return true;
+}
+
+// Entry distance of the ray in the node or NO_HIT
+static inline float HitNode(const float* min, const float* max,
+                            const Vertex3& origin, const Vector3& invDir,
+                            float maxDistance) {
+    auto tMin = 0.f;
+    auto tMax = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        auto t0 = (min[axis] - origin[axis]) * invDir[axis];
+        auto t1 = (max[axis] - origin[axis]) * invDir[axis];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+    return tMin <= tMax ? tMin : NO_HIT;
+}
+
+template <bool ANY>
+float MeshBVH::Traverse(const Ray& ray, float maxDistance, size_t* triangle,
+                        Vector3* outNormal) const {
+    if (nodes_.empty())
+        return NO_HIT;
+    auto& origin = ray.GetOrigin();
+    auto& dir = ray.GetDirection();
+    Vector3 invDir(1.f / dir.x, 1.f / dir.y, 1.f / dir.z);
+    auto nearest = maxDistance;
+    auto found = false;
+    uint32_t stack[MAX_DEPTH];
+    size_t stackSize = 0;
+    auto node = &nodes_[0];
+    if (HitNode(node->min_, node->max_, origin, invDir, nearest) == NO_HIT)
+        return NO_HIT;
+    for (;;) {
+        if (node->count_) {
+            for (auto i = node->first_; i < node->first_ + node->count_; i++) {
+                auto& tri = triangles_[i];
+                Vector3 normal;
+                auto t = ray.HitDistance(tri.v0_, tri.v1_, tri.v2_,
+                                         outNormal ? &normal : nullptr);
+                if (t >= 0 && t < nearest) {
+                    nearest = t;
+                    found = true;
+                    if (ANY)
+                        return t;
+                    if (triangle)
+                        *triangle = tri.index_;
+                    if (outNormal)
+                        *outNormal = normal;
+                }
+            }
+        } else {
+            // visit the nearest child first
+            auto left = &nodes_[node->first_];
+            auto right = left + 1;
+            auto tLeft =
+                HitNode(left->min_, left->max_, origin, invDir, nearest);
+            auto tRight =
+                HitNode(right->min_, right->max_, origin, invDir, nearest);
+            if (tLeft > tRight) {
+                std::swap(tLeft, tRight);
+                std::swap(left, right);
+            }
+            if (tLeft != NO_HIT) {
+                if (tRight != NO_HIT) {
+                    CHECK_ASSERT(stackSize < MAX_DEPTH);
+                    stack[stackSize++] = (uint32_t)(right - &nodes_[0]);
+                }
+                node = left;
+                continue;
+            }
+        }
+        // pop nodes that can still be closer than the nearest hit
+        node = nullptr;
+        while (stackSize && !node) {
+            auto candidate = &nodes_[stack[--stackSize]];
+            if (HitNode(candidate->min_, candidate->max_, origin, invDir,
+                        nearest) != NO_HIT)
+                node = candidate;
+        }
+        if (!node)
+            break;
+    }
+    return found ? nearest : NO_HIT;
+}
+
+float MeshBVH::ClosestHit(const Ray& ray, size_t* triangle,
+                          Vector3* outNormal) const {
+    return Traverse<false>(ray, NO_HIT, triangle, outNormal);
+}
+
+bool MeshBVH::AnyHit(const Ray& ray, float maxDistance) const {
+    return Traverse<true>(ray, maxDistance, nullptr, nullptr) != NO_HIT;
+}
+}
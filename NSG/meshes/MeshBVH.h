@@ -0,0 +1,73 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Types.h"
+#include "Vector3.h"
+#include <cstdint>
+#include <vector>
+
+namespace NSG {
+class Ray;
+struct BVHBounds;
+// Bounding volume hierarchy over the triangles of a mesh (in mesh space),
+// built with binned SAH and stored as a flat array of nodes.
+// Use Mesh::GetBVH to get the one shared by all the scene nodes.
+class MeshBVH {
+public:
+    MeshBVH(const Mesh& mesh);
+    ~MeshBVH();
+    // Distance to the nearest front facing triangle hit by the ray or
+    // std::numeric_limits<float>::max()
+    float ClosestHit(const Ray& ray, size_t* triangle = nullptr,
+                     Vector3* outNormal = nullptr) const;
+    // Stops at the first triangle hit closer than maxDistance
+    bool AnyHit(const Ray& ray, float maxDistance) const;
+    size_t GetTrianglesCount() const { return triangles_.size(); }
+    size_t GetNodesCount() const { return nodes_.size(); }
+    static const size_t MAX_LEAF_TRIANGLES = 4;
+    static const size_t SAH_BINS = 16;
+
+private:
+    struct Node {
+        float min_[3];
+        uint32_t first_; // first triangle (leaf) or left child (inner)
+        float max_[3];
+        uint32_t count_; // triangles in the leaf, 0 for inner nodes
+    };
+    struct Triangle {
+        Vertex3 v0_, v1_, v2_;
+        uint32_t index_; // triangle index in the mesh
+    };
+    // Computes the node bounds and splits it if allowed and worth it
+    bool Subdivide(uint32_t nodeIndex, bool split,
+                   BVHBounds* triangleBounds);
+    template <bool ANY>
+    float Traverse(const Ray& ray, float maxDistance, size_t* triangle,
+                   Vector3* outNormal) const;
+    std::vector<Node> nodes_;
+    std::vector<Triangle> triangles_;
+};
+}
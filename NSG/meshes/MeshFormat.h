@@ -0,0 +1,68 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include <cstdint>
+
+namespace NSG {
+// Binary mesh container (.nsgmesh). All values are little endian.
+// [MeshFileHeader][MeshFileAttribute x attributes_][vertexes][indexes]
+// Vertex and index blobs are 16 bytes aligned and stored exactly as they are
+// uploaded to the GPU, so loading is a memory copy without any parsing.
+static const char MESH_FILE_MAGIC[4] = {'N', 'S', 'G', 'M'};
+static const uint32_t MESH_FILE_VERSION = 1;
+static const uint32_t MESH_FILE_ALIGNMENT = 16;
+static const uint32_t MESH_FILE_MAX_UV_NAME = 32;
+
+enum MeshFileFlags {
+    MF_TANGENTS = 1 << 0,      // tangents are already calculated
+    MF_DEFORM_BONES = 1 << 1,  // some vertex has bone weights
+};
+
+struct MeshFileHeader {
+    char magic_[4];
+    uint32_t version_;
+    uint32_t flags_;
+    uint32_t solidDrawMode_;
+    uint32_t attributes_; // number of MeshFileAttribute after the header
+    uint32_t vertexSize_; // stride in bytes
+    uint32_t indexSize_;  // bytes per index
+    uint32_t vertexCount_;
+    uint32_t indexCount_;
+    uint32_t vertexFormat_; // VertexFormat key, 0 = all floats
+    uint64_t vertexOffset_; // from the beginning of the file
+    uint64_t indexOffset_;
+    float bbMin_[3];
+    float bbMax_[3];
+    float boundingSphereRadius_;
+    char uvNames_[2][MESH_FILE_MAX_UV_NAME];
+};
+
+struct MeshFileAttribute {
+    uint32_t location_; // AttributesLoc
+    uint32_t components_;
+    uint32_t offset_; // in bytes inside the vertex
+};
+}
@@ -0,0 +1,303 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "MeshOptimizer.h"
+#include "Check.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <tuple>
+
+namespace NSG {
+static const IndexType NO_INDEX = std::numeric_limits<IndexType>::max();
+static const size_t CACHE_SIZE = 32;
+
+VertexCacheStats AnalyzeVertexCache(const Indexes& indexes, size_t nVertexes,
+                                    size_t cacheSize) {
+    VertexCacheStats stats{0, 0, 0};
+    std::vector<size_t> stamps(nVertexes, 0);
+    size_t time = cacheSize + 1;
+    size_t used = 0;
+    for (auto index : indexes) {
+        CHECK_ASSERT(index < nVertexes);
+        if (!stamps[index])
+            ++used;
+        if (time - stamps[index] > cacheSize) {
+            stamps[index] = time++;
+            ++stats.misses_;
+        }
+    }
+    if (indexes.size() >= 3)
+        stats.acmr_ = (float)stats.misses_ / (indexes.size() / 3);
+    if (used)
+        stats.atvr_ = (float)stats.misses_ / used;
+    return stats;
+}
+
+void RemapIndexes(const std::vector<IndexType>& remap, Indexes& indexes) {
+    for (auto& index : indexes)
+        index = remap[index];
+}
+
+std::vector<IndexType> WeldVertexes(VertexsData& vertexes, Indexes& indexes) {
+    auto n = vertexes.size();
+    std::vector<IndexType> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    auto key = [&](IndexType i) {
+        auto& p = vertexes[i].position_;
+        return std::make_tuple(p.x, p.y, p.z);
+    };
+    std::sort(order.begin(), order.end(), [&](IndexType a, IndexType b) {
+        auto ka = key(a);
+        auto kb = key(b);
+        return ka < kb || (ka == kb && a < b);
+    });
+
+    // equal vertexes have equal positions: search only in the same run
+    std::vector<IndexType> representative(n);
+    std::vector<IndexType> uniques;
+    for (size_t i = 0; i < n; i++) {
+        auto index = order[i];
+        if (i == 0 || key(order[i - 1]) != key(index))
+            uniques.clear();
+        representative[index] = index;
+        for (auto unique : uniques)
+            if (vertexes[unique] == vertexes[index]) {
+                representative[index] = unique;
+                break;
+            }
+        if (representative[index] == index)
+            uniques.push_back(index);
+    }
+
+    // representatives have lower indexes, so keep the original order
+    std::vector<IndexType> remap(n);
+    IndexType next = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (representative[i] == i) {
+            vertexes[next] = vertexes[i];
+            remap[i] = next++;
+        } else
+            remap[i] = remap[representative[i]];
+    }
+    vertexes.resize(next);
+    RemapIndexes(remap, indexes);
+    return remap;
+}
+
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" scoring
+static float VertexScore(int cachePosition, unsigned remainingTriangles) {
+    if (!remainingTriangles)
+        return -1.f;
+    float score = 0;
+    if (cachePosition >= 3) {
+        const float scaler = 1.f / (CACHE_SIZE - 3);
+        score = std::pow(1.f - (cachePosition - 3) * scaler, 1.5f);
+    } else if (cachePosition >= 0)
+        score = 0.75f; // last triangle: avoid using it again right away
+    return score + 2.f * std::pow((float)remainingTriangles, -0.5f);
+}
+
+void OptimizeVertexCache(Indexes& indexes, size_t nVertexes) {
+    auto nTriangles = indexes.size() / 3;
+    if (nTriangles < 2)
+        return;
+
+    // triangles using each vertex: adjacency[offsets[v]...]
+    std::vector<unsigned> remaining(nVertexes, 0);
+    for (auto index : indexes)
+        ++remaining[index];
+    std::vector<unsigned> offsets(nVertexes + 1, 0);
+    for (size_t v = 0; v < nVertexes; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned> adjacency(indexes.size());
+    std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indexes.size(); i++)
+        adjacency[fill[indexes[i]]++] = (unsigned)(i / 3);
+
+    std::vector<int> cachePosition(nVertexes, -1);
+    std::vector<float> vertexScores(nVertexes);
+    for (size_t v = 0; v < nVertexes; v++)
+        vertexScores[v] = VertexScore(-1, remaining[v]);
+    std::vector<float> triangleScores(nTriangles);
+    std::vector<bool> emitted(nTriangles, false);
+    int best = 0;
+    for (size_t t = 0; t < nTriangles; t++) {
+        triangleScores[t] = vertexScores[indexes[3 * t]] +
+                            vertexScores[indexes[3 * t + 1]] +
+                            vertexScores[indexes[3 * t + 2]];
+        if (triangleScores[t] > triangleScores[best])
+            best = (int)t;
+    }
+
+    Indexes result;
+    result.reserve(indexes.size());
+    std::vector<IndexType> cache, newCache;
+    size_t nextUnemitted = 0;
+    while (best >= 0) {
+        emitted[best] = true;
+        newCache.clear();
+        for (int k = 0; k < 3; k++) {
+            auto v = indexes[3 * best + k];
+            result.push_back(v);
+            newCache.push_back(v);
+            // remove the triangle from the vertex adjacency
+            auto first = adjacency.begin() + offsets[v];
+            auto last = first + remaining[v];
+            std::iter_swap(std::find(first, last, (unsigned)best), last - 1);
+            --remaining[v];
+        }
+        for (auto v : cache)
+            if (std::find(newCache.begin(), newCache.begin() + 3, v) ==
+                newCache.begin() + 3)
+                newCache.push_back(v);
+
+        // evicted vertexes (beyond CACHE_SIZE) need their scores updated too
+        for (size_t i = 0; i < newCache.size(); i++) {
+            auto v = newCache[i];
+            cachePosition[v] = i < CACHE_SIZE ? (int)i : -1;
+            vertexScores[v] = VertexScore(cachePosition[v], remaining[v]);
+        }
+
+        best = -1;
+        float bestScore = -1.f;
+        for (auto v : newCache) {
+            for (unsigned i = 0; i < remaining[v]; i++) {
+                auto t = adjacency[offsets[v] + i];
+                triangleScores[t] = vertexScores[indexes[3 * t]] +
+                                    vertexScores[indexes[3 * t + 1]] +
+                                    vertexScores[indexes[3 * t + 2]];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = (int)t;
+                }
+            }
+        }
+
+        if (newCache.size() > CACHE_SIZE)
+            newCache.resize(CACHE_SIZE);
+        cache.swap(newCache);
+
+        if (best < 0) {
+            // nothing connected to the cache: start a new strip
+            while (nextUnemitted < nTriangles && emitted[nextUnemitted])
+                ++nextUnemitted;
+            if (nextUnemitted < nTriangles)
+                best = (int)nextUnemitted;
+        }
+    }
+    indexes.swap(result);
+}
+
+void OptimizeOverdraw(const VertexsData& vertexes, Indexes& indexes,
+                      float threshold) {
+    auto nTriangles = indexes.size() / 3;
+    if (nTriangles < 2)
+        return;
+
+    // Clusters start where the cache has been flushed (the triangle does not
+    // share vertexes with the cache), so reordering them keeps the ACMR
+    auto acmr = AnalyzeVertexCache(indexes, vertexes.size(), CACHE_SIZE).acmr_;
+    std::vector<size_t> clusters{0};
+    std::vector<size_t> stamps(vertexes.size(), 0);
+    size_t time = CACHE_SIZE + 1;
+    size_t clusterMisses = 0;
+    for (size_t t = 0; t < nTriangles; t++) {
+        unsigned misses = 0;
+        for (int k = 0; k < 3; k++) {
+            auto v = indexes[3 * t + k];
+            if (time - stamps[v] > CACHE_SIZE) {
+                stamps[v] = time++;
+                ++misses;
+            }
+        }
+        auto start = clusters.back();
+        if (t > start && misses == 3 &&
+            (float)clusterMisses / (t - start) <= threshold * acmr) {
+            clusters.push_back(t);
+            clusterMisses = 0;
+        }
+        clusterMisses += misses;
+    }
+    clusters.push_back(nTriangles);
+    auto nClusters = clusters.size() - 1;
+    if (nClusters < 2)
+        return;
+
+    // Draw first the clusters facing away from the mesh center,
+    // they are more likely to occlude the others
+    std::vector<Vector3> centroids(nClusters);
+    std::vector<Vector3> normals(nClusters);
+    Vector3 meshCentroid;
+    for (size_t c = 0; c < nClusters; c++) {
+        for (auto t = clusters[c]; t < clusters[c + 1]; t++) {
+            auto& p0 = vertexes[indexes[3 * t]].position_;
+            auto& p1 = vertexes[indexes[3 * t + 1]].position_;
+            auto& p2 = vertexes[indexes[3 * t + 2]].position_;
+            centroids[c] = centroids[c] + (p0 + p1 + p2) / 3.f;
+            normals[c] = normals[c] + (p1 - p0).Cross(p2 - p0);
+        }
+        meshCentroid = meshCentroid + centroids[c];
+        centroids[c] /= (float)(clusters[c + 1] - clusters[c]);
+    }
+    meshCentroid /= (float)nTriangles;
+
+    std::vector<float> keys(nClusters, 0);
+    for (size_t c = 0; c < nClusters; c++)
+        if (!normals[c].IsZeroLength())
+            keys[c] = (centroids[c] - meshCentroid).Dot(normals[c].Normalize());
+    std::vector<size_t> order(nClusters);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    Indexes result;
+    result.reserve(indexes.size());
+    for (auto c : order)
+        result.insert(result.end(), indexes.begin() + 3 * clusters[c],
+                      indexes.begin() + 3 * clusters[c + 1]);
+    indexes.swap(result);
+}
+
+std::vector<IndexType> OptimizeVertexFetch(VertexsData& vertexes,
+                                           Indexes& indexes) {
+    std::vector<IndexType> remap(vertexes.size(), NO_INDEX);
+    IndexType next = 0;
+    for (auto index : indexes)
+        if (remap[index] == NO_INDEX)
+            remap[index] = next++;
+    for (auto& index : remap)
+        if (index == NO_INDEX)
+            index = next++;
+
+    VertexsData result(vertexes.size());
+    for (size_t i = 0; i < vertexes.size(); i++)
+        result[remap[i]] = vertexes[i];
+    vertexes.swap(result);
+    RemapIndexes(remap, indexes);
+    return remap;
+}
+}
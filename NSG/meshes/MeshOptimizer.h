@@ -0,0 +1,55 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Types.h"
+#include "VertexData.h"
+#include <vector>
+
+namespace NSG {
+// Post-transform vertex cache efficiency of a triangle list,
+// simulated on the CPU with a FIFO cache
+struct VertexCacheStats {
+    size_t misses_;
+    float acmr_; // average cache miss ratio: misses per triangle
+    float atvr_; // average transformed vertex ratio: misses per vertex
+};
+VertexCacheStats AnalyzeVertexCache(const Indexes& indexes, size_t nVertexes,
+                                    size_t cacheSize = 32);
+// Merges equal vertexes (VertexData::operator==). Returns the remap table
+// (old index to new index) to apply on other index lists.
+std::vector<IndexType> WeldVertexes(VertexsData& vertexes, Indexes& indexes);
+// Reorders the triangles for the post-transform vertex cache (Forsyth)
+void OptimizeVertexCache(Indexes& indexes, size_t nVertexes);
+// Reorders clusters of cache optimized triangles to draw first the ones
+// facing outwards. threshold is the ACMR that can be lost in the process.
+void OptimizeOverdraw(const VertexsData& vertexes, Indexes& indexes,
+                      float threshold = 1.05f);
+// Reorders the vertexes in the order they are used by the triangles.
+// Unused vertexes are kept at the end. Returns the remap table.
+std::vector<IndexType> OptimizeVertexFetch(VertexsData& vertexes,
+                                           Indexes& indexes);
+void RemapIndexes(const std::vector<IndexType>& remap, Indexes& indexes);
+}
@@ -55,4 +55,9 @@ void ModelMesh::Load(const pugi::xml_node& node) {
         SetFaceMode(node.attribute("solidDrawMode").as_int());
     Mesh::Load(node);
 }
+
+void ModelMesh::SetCooked(Mesh& cooked) {
+    SetFaceMode(cooked.GetSolidDrawMode());
+    Mesh::SetCooked(cooked);
+}
 }
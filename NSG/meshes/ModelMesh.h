@@ -38,6 +38,7 @@ public:
     void SetFaceMode(GLenum face_mode) { face_mode_ = face_mode; }
     PhysicsShape GetShapeType() const override { return SH_CONVEX_TRIMESH; }
     void Load(const pugi::xml_node& node) override;
+    void SetCooked(Mesh& cooked) override;
 
 private:
     GLenum face_mode_;
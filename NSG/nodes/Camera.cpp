@@ -439,6 +439,13 @@ void Camera::FillShaderDefines(std::string& defines, PassType passType) const {
         defines += "COLOR_SPLITS\n";
 }
 
+unsigned Camera::GetVariationFlags(PassType passType) const {
+    unsigned flags = GetMaxShadowSplits() << 1;
+    if (PassType::LIT == passType && colorSplits_)
+        flags |= 1 << 0;
+    return flags;
+}
+
 void Camera::EnableColorSplits(bool enable) {
     if (colorSplits_ != enable) {
         colorSplits_ = enable;
@@ -455,7 +462,8 @@ float Camera::GetShadowSplitLogFactor() const { return shadowSplitLogFactor_; }
 BoundingBox Camera::GetViewBox(const Frustum* frustum, const Scene* scene,
                                bool receivers, bool casters) {
     BoundingBox result;
-    std::vector<SceneNode*> visibles;
+    FrameArena::Scope frameScope;
+    FrameVector<SceneNode*> visibles;
     scene->GetVisibleNodes(frustum, visibles);
     for (auto& visible : visibles) {
         auto material = visible->GetMaterial().get();
@@ -99,6 +99,7 @@ public:
     int GetMaxShadowSplits() const;
     void EnableColorSplits(bool enable);
     void FillShaderDefines(std::string& defines, PassType passType) const;
+    unsigned GetVariationFlags(PassType passType) const;
     // This is a logarithmic factor to make the (shadow) splits.
     // For 4 splits:
     // factor=0 => 25% 50% 75% 100%
@@ -218,6 +218,20 @@ void Light::FillShaderDefines(std::string& defines, PassType passType,
     }
 }
 
+unsigned Light::GetVariationFlags(PassType passType,
+                                  const Material* material) const {
+    if (PassType::DEFAULT == passType)
+        return 0;
+    unsigned flags = (unsigned)type_ + 1;
+    if (PassType::LIT == passType && material) {
+        if (DoShadows() && material->ReceiveShadows())
+            flags |= 1 << 2;
+        if (HasSpecularColor() && material->HasSpecularColor())
+            flags |= 1 << 3;
+    }
+    return flags;
+}
+
 void Light::CalculateColor() {
     diffuseColor_ = diffuse_ ? color_ * energy_ : Color(0);
     specularColor_ = specular_ ? color_ * energy_ : Color(0);
@@ -237,6 +251,23 @@ void Light::SetDistance(float distance) {
 
 bool Light::DoShadows() const { return shadows_; }
 
+Sphere Light::GetSphere() const {
+    return Sphere(GetGlobalPosition(), GetRange());
+}
+
+Cone Light::GetCone() const {
+    return Cone(GetGlobalPosition(), GetLookAtDirection(), GetRange(),
+                Radians(0.5f * Clamp(spotCutOff_, 0.f, 180.f)));
+}
+
+bool Light::CanLight(const BoundingBox& box) const {
+    if (LightType::POINT == type_)
+        return GetSphere().IsInside(box) != Intersection::OUTSIDE;
+    else if (LightType::SPOT == type_)
+        return GetCone().IsInside(box) != Intersection::OUTSIDE;
+    return true;
+}
+
 FrameBuffer* Light::GetShadowFrameBuffer(int idx) const {
     CHECK_ASSERT(idx < ShadowCamera::MAX_SPLITS);
     return shadowFrameBuffer_[idx].get();
@@ -25,9 +25,11 @@ misrepresented as being the original software.
 */
 #pragma once
 #include "Color.h"
+#include "Cone.h"
 #include "GLIncludes.h"
 #include "SceneNode.h"
 #include "ShadowCamera.h"
+#include "Sphere.h"
 
 namespace NSG {
 class Light : public SceneNode {
@@ -48,6 +50,8 @@ public:
     void Load(const pugi::xml_node& node) override;
     void FillShaderDefines(std::string& defines, PassType passType,
                            const Material* material) const;
+    unsigned GetVariationFlags(PassType passType,
+                               const Material* material) const;
     SignalLight::PSignal SignalSetType() { return signalSetType_; }
     const Color& GetDiffuseColor() const { return diffuseColor_; }
     const Color& GetSpecularColor() const { return specularColor_; }
@@ -75,6 +79,12 @@ public:
     void SetShadowSplits(int splits) const { shadowSplits_ = splits; }
     int GetShadowSplits() const { return shadowSplits_; }
     float GetInvRange() const { return invRange_; }
+    // Volumes reached by point and spot lights
+    float GetRange() const { return 1.f / invRange_; }
+    Sphere GetSphere() const;
+    Cone GetCone() const;
+    // Whether the box can be lit (always for directional lights)
+    bool CanLight(const BoundingBox& box) const;
     bool IsDiffuseEnabled() const { return diffuse_; }
     bool IsSpecularEnabled() const { return specular_; }
     FrameBuffer* GetShadowFrameBuffer(int idx) const;
@@ -34,6 +34,7 @@ misrepresented as being the original software.
 #include "Scene.h"
 #include "SharedFromPointer.h"
 #include "StringConverter.h"
+#include "TransformHierarchy.h"
 #include "Util.h"
 #include "imgui.h"
 #include "pugixml.hpp"
@@ -42,9 +43,13 @@ misrepresented as being the original software.
 
 namespace NSG {
 Node::Node(const std::string& name)
-    : name_(name), signalUpdated_(new SignalEmpty()), scale_(1, 1, 1),
+    : name_(name), signalUpdated_(new SignalEmpty()),
+      globalModelInvDirty_(true), globalModelInvTranspDirty_(true),
+      scale_(1, 1, 1),
       globalScale_(1, 1, 1), inheritScale_(true), dirty_(true), hide_(false),
-      isScaleUniform_(true), userData_(nullptr) {}
+      isScaleUniform_(true), userData_(nullptr),
+      transformHierarchy_(nullptr),
+      flatIndex_(TransformHierarchy::InvalidIndex) {}
 
 Node::~Node() { ClearAllChildren(); }
 
@@ -65,8 +70,13 @@ void Node::RemoveFromParent() {
 
 void Node::ClearAllChildren() {
     childrenHash_.clear();
+    if (transformHierarchy_ && !children_.empty())
+        transformHierarchy_->Invalidate();
     for (auto i = children_.size() - 1; i < children_.size(); --i) {
         Node* childNode = children_[i].get();
+        childNode->transformHierarchy_ = nullptr;
+        childNode->flatIndex_ = TransformHierarchy::InvalidIndex;
+        childNode->dirty_ = true;
         childNode->ClearAllChildren();
         children_.erase(children_.begin() + i);
     }
@@ -76,6 +86,10 @@ void Node::RemoveChild(Node* node) {
     int idx = 0;
     for (auto& child : children_) {
         if (child.get() == node) {
+            if (node->transformHierarchy_) {
+                node->transformHierarchy_->Invalidate();
+                node->SetTransformHierarchy(nullptr);
+            }
             children_.erase(children_.begin() + idx);
             auto range = childrenHash_.equal_range(node->name_);
             auto it = range.first;
@@ -100,6 +114,10 @@ void Node::AddChild(PNode node) {
     childrenHash_.insert(std::make_pair(node->name_, node));
     PNode thisNode = SharedFromPointerNode(this);
     node->parent_ = thisNode;
+    if (transformHierarchy_) {
+        node->SetTransformHierarchy(transformHierarchy_);
+        transformHierarchy_->Invalidate();
+    }
     PScene scene = scene_.lock();
     if (!scene)
         scene = std::dynamic_pointer_cast<Scene>(thisNode);
@@ -331,7 +349,21 @@ void Node::SetGlobalPositionAndLookAt(const Vertex3& newPosition,
     SetGlobalLookAtPosition(lookAtPosition, up);
 }
 
+void Node::SetTransformHierarchy(TransformHierarchy* hierarchy) {
+    transformHierarchy_ = hierarchy;
+    flatIndex_ = TransformHierarchy::InvalidIndex;
+    if (!hierarchy)
+        dirty_ = true; // world data is not tracked anymore
+    for (auto& child : children_)
+        child->SetTransformHierarchy(hierarchy);
+}
+
 void Node::Update() const {
+    if (transformHierarchy_) {
+        transformHierarchy_->Update();
+        return;
+    }
+
     if (!dirty_ || hide_)
         return;
 
@@ -352,8 +384,8 @@ void Node::Update() const {
     }
 
     isScaleUniform_ = globalScale_.IsUniform();
-    globalModelInv_ = globalModel_.Inverse();
-    globalModelInvTransp_ = Matrix3(globalModel_).Inverse().Transpose();
+    globalModelInvDirty_ = true;
+    globalModelInvTranspDirty_ = true;
     lookAtDirection_ = globalOrientation_ * Vector3::LookAt;
     upDirection_ = globalOrientation_ * Vector3::Up;
     rightDirection_ = globalOrientation_ * Vector3::Right;
@@ -370,18 +402,38 @@ void Node::SetTransform(const Matrix4& transform) {
     MarkAsDirty(true, true);
 }
 
+void Node::SetTransform(const Vertex3& position, const Quaternion& q,
+                        const Vertex3& scale) {
+    auto scaleChange = scale_ != scale;
+    if (scaleChange || position_ != position || q_ != q) {
+        position_ = position;
+        q_ = q;
+        scale_ = scale;
+        MarkAsDirty(true, scaleChange);
+    }
+}
+
 const Matrix4& Node::GetGlobalModelMatrix() const {
     Update();
     return globalModel_;
 }
 
+// Inverses are only computed when requested
 const Matrix3& Node::GetGlobalModelInvTranspMatrix() const {
     Update();
+    if (globalModelInvTranspDirty_) {
+        globalModelInvTransp_ = Matrix3(globalModel_).Inverse().Transpose();
+        globalModelInvTranspDirty_ = false;
+    }
     return globalModelInvTransp_;
 }
 
 const Matrix4& Node::GetGlobalModelInvMatrix() const {
     Update();
+    if (globalModelInvDirty_) {
+        globalModelInv_ = globalModel_.Inverse();
+        globalModelInvDirty_ = false;
+    }
     return globalModelInv_;
 }
 
@@ -414,6 +466,11 @@ void Node::MarkAsDirty(bool recursive, bool scaleChange) {
     if (scaleChange)
         OnScaleChange();
 
+    // descendants are visited by the hierarchy's forward pass
+    if (transformHierarchy_ &&
+        transformHierarchy_->MarkDirty(flatIndex_, scaleChange))
+        return;
+
     if (recursive)
         for (auto child : children_)
             child->MarkAsDirty(recursive, scaleChange);
@@ -424,6 +481,8 @@ void Node::Hide(bool hide, bool recursive) {
         hide_ = hide;
         SetUniformsNeedUpdate();
         OnHide(hide);
+        if (!hide && transformHierarchy_)
+            transformHierarchy_->OnShow();
     }
 
     if (recursive)
@@ -154,6 +154,9 @@ public:
     void MarkAsDirty(bool recursive = true, bool scaleChange = false);
     Matrix4 GetTransform() const;
     void SetTransform(const Matrix4& transform);
+    // Marks as dirty once for the three of them
+    void SetTransform(const Vertex3& position, const Quaternion& q,
+                      const Vertex3& scale);
     virtual void Load(const pugi::xml_node& node);
     virtual void Save(pugi::xml_node& node) const;
     SignalEmpty::PSignal SigUpdated() { return signalUpdated_; }
@@ -161,6 +164,7 @@ public:
     void* GetUserData() const { return userData_; }
 
 protected:
+    void SetTransformHierarchy(TransformHierarchy* hierarchy);
     std::string name_;
     std::vector<PNode> children_;
     std::unordered_map<std::string, PWeakNode> childrenHash_;
@@ -175,6 +179,8 @@ private:
     mutable Matrix4 globalModel_;
     mutable Matrix4 globalModelInv_;
     mutable Matrix3 globalModelInvTransp_;
+    mutable bool globalModelInvDirty_;
+    mutable bool globalModelInvTranspDirty_;
     Vertex3 position_;
     Quaternion q_;
     Vector3 scale_;
@@ -190,5 +196,8 @@ private:
     mutable bool isScaleUniform_;
     Vector3 guiRotation_;
     void* userData_;
+    TransformHierarchy* transformHierarchy_;
+    size_t flatIndex_;
+    friend class TransformHierarchy;
 };
 }
@@ -26,6 +26,7 @@ misrepresented as being the original software.
 #include "ParticleSystem.h"
 #include "AppConfiguration.h"
 #include "Check.h"
+#include "InstanceData.h"
 #include "Material.h"
 #include "Particle.h"
 #include "Pass.h"
@@ -45,6 +46,62 @@ ParticleSystem::VelocityParams::VelocityParams()
 
 ParticleSystem::PhysicsParams::PhysicsParams() : mass_(1), shape_(SH_EMPTY){};
 
+void ParticleSystem::ParticleArrays::Reserve(size_t n) {
+    px_.reserve(n);
+    py_.reserve(n);
+    pz_.reserve(n);
+    vx_.reserve(n);
+    vy_.reserve(n);
+    vz_.reserve(n);
+    age_.reserve(n);
+    lifetime_.reserve(n);
+}
+
+void ParticleSystem::ParticleArrays::Clear() {
+    px_.clear();
+    py_.clear();
+    pz_.clear();
+    vx_.clear();
+    vy_.clear();
+    vz_.clear();
+    age_.clear();
+    lifetime_.clear();
+}
+
+void ParticleSystem::ParticleArrays::Push(const Vector3& position,
+                                          const Vector3& velocity,
+                                          float lifetime) {
+    px_.push_back(position.x);
+    py_.push_back(position.y);
+    pz_.push_back(position.z);
+    vx_.push_back(velocity.x);
+    vy_.push_back(velocity.y);
+    vz_.push_back(velocity.z);
+    age_.push_back(0);
+    lifetime_.push_back(lifetime);
+}
+
+// Swaps with the last particle so the arrays stay contiguous
+void ParticleSystem::ParticleArrays::Remove(size_t index) {
+    auto last = Size() - 1;
+    px_[index] = px_[last];
+    py_[index] = py_[last];
+    pz_[index] = pz_[last];
+    vx_[index] = vx_[last];
+    vy_[index] = vy_[last];
+    vz_[index] = vz_[last];
+    age_[index] = age_[last];
+    lifetime_[index] = lifetime_[last];
+    px_.pop_back();
+    py_.pop_back();
+    pz_.pop_back();
+    vx_.pop_back();
+    vy_.pop_back();
+    vz_.pop_back();
+    age_.pop_back();
+    lifetime_.pop_back();
+}
+
 ParticleSystem::ParticleSystem(const std::string& name)
     : SceneNode(name), emitFrom_(PS_EF_VERTS), amount_(1500), start_(0),
       end_(2), animationEndTime_(5), lifetime_(3), lifetimeRandom_(0.0f),
@@ -53,7 +110,8 @@ ParticleSystem::ParticleSystem(const std::string& name)
       collisionMask_((int)CollisionMask::ALL & ~(int)CollisionMask::PARTICLE),
       currentVertex_(0), triggerParticles_(0),
       distribution_(ParticleSystemDistribution::RANDOM),
-      gravity_(0, -9.81f, 0) {
+      gravity_(0, -9.81f, 0), mode_(ParticleSystemMode::NODES),
+      restitution_(0.3f) {
     particleMesh_ = Mesh::CreateClass<QuadMesh>("NSGParticleMesh");
     particleMesh_->Set(1.f);
     particleMaterial_ =
@@ -77,6 +135,26 @@ void ParticleSystem::SetParticleMaterial(PMaterial material) {
     }
 }
 
+void ParticleSystem::SetMode(ParticleSystemMode mode) {
+    if (mode_ != mode) {
+        mode_ = mode;
+        Invalidate();
+    }
+}
+
+void ParticleSystem::SetAmount(size_t amount) {
+    if (amount_ != amount) {
+        amount_ = amount;
+        Invalidate();
+    }
+}
+
+size_t ParticleSystem::GetActiveParticles() const {
+    if (mode_ == ParticleSystemMode::ARRAYS)
+        return arrays_.Size();
+    return particles_.size() - disabled_.size();
+}
+
 float ParticleSystem::GetParticlesPerFrame(float deltaTime) {
     auto remainingTime = end_ - start_ - currentTime_;
     auto remainingFrames = remainingTime / deltaTime;
@@ -91,7 +169,10 @@ void ParticleSystem::Try2GenerateParticles(float deltaTime) {
     if (currentTime_ >= start_ && currentTime_ < end_ && generated_ < amount_) {
         triggerParticles_ += GetParticlesPerFrame(deltaTime);
         while (triggerParticles_ >= 1) {
-            GenerateParticle();
+            if (mode_ == ParticleSystemMode::ARRAYS)
+                GenerateArrayParticle();
+            else
+                GenerateParticle();
             ++generated_;
             --triggerParticles_;
         }
@@ -129,7 +210,14 @@ void ParticleSystem::RemoveParticle(PParticle particle) {
 
 void ParticleSystem::Invalidate() {
     particles_.clear();
+    disabled_.clear();
     ClearAllChildren();
+    arrays_.Clear();
+    arraysBB_ = BoundingBox();
+    if (mode_ == ParticleSystemMode::ARRAYS)
+        arrays_.Reserve(amount_);
+    else
+        particles_.reserve(amount_);
     ReStartLoop();
 }
 
@@ -152,14 +240,18 @@ void ParticleSystem::ReStartLoop() {
 void ParticleSystem::Update(float deltaTime) {
     if (mesh_ && mesh_->IsReady()) {
         Try2GenerateParticles(deltaTime);
-        for (auto& particle : particles_) {
-            if (!particle->IsHidden()) {
-                auto lifeTime = GetLifeTime();
-                auto age = particle->GetAge();
-                if (age < lifeTime)
-                    particle->Update(deltaTime);
-                else
-                    RemoveParticle(particle);
+        if (mode_ == ParticleSystemMode::ARRAYS)
+            UpdateArrays(deltaTime);
+        else {
+            for (auto& particle : particles_) {
+                if (!particle->IsHidden()) {
+                    auto lifeTime = GetLifeTime();
+                    auto age = particle->GetAge();
+                    if (age < lifeTime)
+                        particle->Update(deltaTime);
+                    else
+                        RemoveParticle(particle);
+                }
             }
         }
 
@@ -170,30 +262,27 @@ void ParticleSystem::Update(float deltaTime) {
     }
 }
 
-void ParticleSystem::Initialize(PParticle particle) {
-    if (emitFrom_ == PS_EF_VERTS) {
-        auto mesh = GetMesh();
-        auto& vertexes = mesh->GetConstVertexsData();
-        if (distribution_ == ParticleSystemDistribution::RANDOM) {
-            CHECK_ASSERT(vertexes.size() < std::numeric_limits<float>::max());
-            std::uniform_real_distribution<float> dis(0,
-                                                      (float)vertexes.size());
-            currentVertex_ = (size_t)dis(randGenerator_);
-        } else {
-            ++currentVertex_;
-            if (currentVertex_ >= vertexes.size())
-                currentVertex_ = 0;
-        }
-
-        auto& vertex = vertexes[currentVertex_];
-        auto& position = vertex.position_;
-        particle->SetPosition(position);
+const VertexData& ParticleSystem::NextEmitterVertex() {
+    auto& vertexes = GetMesh()->GetConstVertexsData();
+    if (distribution_ == ParticleSystemDistribution::RANDOM) {
+        CHECK_ASSERT(vertexes.size() < std::numeric_limits<float>::max());
+        std::uniform_real_distribution<float> dis(0, (float)vertexes.size());
+        currentVertex_ = (size_t)dis(randGenerator_);
+    } else {
+        ++currentVertex_;
+        if (currentVertex_ >= vertexes.size())
+            currentVertex_ = 0;
     }
+    return vertexes[currentVertex_];
+}
 
-    SetInitialVelocity(particle);
+void ParticleSystem::Initialize(PParticle particle) {
+    if (emitFrom_ == PS_EF_VERTS)
+        particle->SetPosition(NextEmitterVertex().position_);
+    particle->SetVelocity(GetInitialVelocity());
 }
 
-void ParticleSystem::SetInitialVelocity(PParticle particle) {
+Vector3 ParticleSystem::GetInitialVelocity() {
     Vector3 velocity(velocityParams_.initialSpeed_);
     if (velocityParams_.objectSpeed_) {
         auto rb = GetRigidBody();
@@ -225,6 +314,128 @@ void ParticleSystem::SetInitialVelocity(PParticle particle) {
         }
     }
 
-    particle->SetVelocity(velocity);
+    return velocity;
+}
+
+void ParticleSystem::GenerateArrayParticle() {
+    Vector3 position;
+    if (emitFrom_ == PS_EF_VERTS)
+        position = NextEmitterVertex().position_;
+    // arrays are kept in world space (as the nodes' rigid bodies)
+    position = Vector3(GetGlobalModelMatrix() * Vector4(position, 1));
+    auto velocity = GetInitialVelocity();
+    arrays_.Push(position, velocity, GetLifeTime());
+}
+
+void ParticleSystem::UpdateArrays(float deltaTime) {
+    size_t index = 0;
+    while (index < arrays_.Size()) {
+        if (arrays_.age_[index] < arrays_.lifetime_[index])
+            ++index;
+        else
+            arrays_.Remove(index);
+    }
+
+    auto n = arrays_.Size();
+    arraysBB_ = BoundingBox();
+    if (!n)
+        return;
+
+    auto scene = GetScene();
+    auto world = scene ? scene->GetPhysicsWorld() : nullptr;
+    bool collide = world && world->GetNumCollisionObjects() > 0;
+
+    float* px = &arrays_.px_[0];
+    float* py = &arrays_.py_[0];
+    float* pz = &arrays_.pz_[0];
+    float* vx = &arrays_.vx_[0];
+    float* vy = &arrays_.vy_[0];
+    float* vz = &arrays_.vz_[0];
+    float* age = &arrays_.age_[0];
+
+    if (collide) {
+        rayFrom_.resize(n);
+        for (size_t i = 0; i < n; i++)
+            rayFrom_[i] = Vector3(px[i], py[i], pz[i]);
+    }
+
+    // keep these loops free of branches and calls so they can be vectorized
+    auto gx = gravity_.x * deltaTime;
+    auto gy = gravity_.y * deltaTime;
+    auto gz = gravity_.z * deltaTime;
+    for (size_t i = 0; i < n; i++) {
+        vx[i] += gx;
+        vy[i] += gy;
+        vz[i] += gz;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        px[i] += vx[i] * deltaTime;
+        py[i] += vy[i] * deltaTime;
+        pz[i] += vz[i] * deltaTime;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        age[i] += deltaTime;
+
+    if (collide)
+        CollideArrays();
+
+    Vector3 minPos(px[0], py[0], pz[0]);
+    Vector3 maxPos(minPos);
+    for (size_t i = 1; i < n; i++) {
+        minPos.x = std::min(minPos.x, px[i]);
+        minPos.y = std::min(minPos.y, py[i]);
+        minPos.z = std::min(minPos.z, pz[i]);
+        maxPos.x = std::max(maxPos.x, px[i]);
+        maxPos.y = std::max(maxPos.y, py[i]);
+        maxPos.z = std::max(maxPos.z, pz[i]);
+    }
+    auto halfSize = 0.5f * GetGlobalScale();
+    arraysBB_ = BoundingBox(minPos - halfSize, maxPos + halfSize);
+}
+
+void ParticleSystem::CollideArrays() {
+    auto world = GetScene()->GetPhysicsWorld();
+    auto n = arrays_.Size();
+    rayTo_.resize(n);
+    for (size_t i = 0; i < n; i++)
+        rayTo_[i] = Vector3(arrays_.px_[i], arrays_.py_[i], arrays_.pz_[i]);
+
+    if (!world->RayCast(rayFrom_, rayTo_, rayResults_, collisionMask_))
+        return;
+
+    ICollision* emitter = GetRigidBody().get();
+    for (size_t i = 0; i < n; i++) {
+        auto& result = rayResults_[i];
+        if (!result.HasCollided() || result.collider_ == emitter)
+            continue;
+        auto& normal = result.normal_;
+        Vector3 velocity(arrays_.vx_[i], arrays_.vy_[i], arrays_.vz_[i]);
+        velocity = velocity.Reflect(normal) * restitution_;
+        auto position = result.position_ + normal * 0.01f;
+        arrays_.px_[i] = position.x;
+        arrays_.py_[i] = position.y;
+        arrays_.pz_[i] = position.z;
+        arrays_.vx_[i] = velocity.x;
+        arrays_.vy_[i] = velocity.y;
+        arrays_.vz_[i] = velocity.z;
+    }
+}
+
+void ParticleSystem::FillInstancesData(std::vector<InstanceData>& data) const {
+    auto n = arrays_.Size();
+    data.resize(n);
+    // billboards: only translation and scale are needed
+    auto scale = GetGlobalScale();
+    for (size_t i = 0; i < n; i++) {
+        auto& obj = data[i];
+        obj.modelMatrixRow0_ = Vector4(scale.x, 0, 0, arrays_.px_[i]);
+        obj.modelMatrixRow1_ = Vector4(0, scale.y, 0, arrays_.py_[i]);
+        obj.modelMatrixRow2_ = Vector4(0, 0, scale.z, arrays_.pz_[i]);
+        obj.normalMatrixCol0_ = Vector3(1, 0, 0);
+        obj.normalMatrixCol1_ = Vector3(0, 1, 0);
+        obj.normalMatrixCol2_ = Vector3(0, 0, 1);
+    }
 }
 }
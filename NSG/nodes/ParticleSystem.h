@@ -24,6 +24,8 @@ misrepresented as being the original software.
 -------------------------------------------------------------------------------
 */
 #pragma once
+#include "BoundingBox.h"
+#include "PhysicsWorld.h"
 #include "SceneNode.h"
 #include "Types.h"
 #include <random>
@@ -31,6 +33,8 @@ misrepresented as being the original software.
 #include <vector>
 
 namespace NSG {
+struct InstanceData;
+struct VertexData;
 class ParticleSystem : public SceneNode {
 public:
     ParticleSystem(const std::string& name);
@@ -39,15 +43,31 @@ public:
     float GetLifeTime() const;
     void SetParticleMaterial(PMaterial material);
     PMaterial GetParticleMaterial() { return particleMaterial_; }
+    PQuadMesh GetParticleMesh() const { return particleMesh_; }
+    void SetMode(ParticleSystemMode mode);
+    ParticleSystemMode GetMode() const { return mode_; }
+    void SetAmount(size_t amount);
+    size_t GetAmount() const { return amount_; }
+    size_t GetActiveParticles() const;
+    // velocity kept after a collision in ParticleSystemMode::ARRAYS
+    void SetRestitution(float restitution) { restitution_ = restitution; }
+    float GetRestitution() const { return restitution_; }
+    // only valid in ParticleSystemMode::ARRAYS
+    const BoundingBox& GetParticlesBoundingBox() const { return arraysBB_; }
+    void FillInstancesData(std::vector<InstanceData>& data) const;
 
 private:
     void Invalidate();
     void Initialize(PParticle particle);
+    const VertexData& NextEmitterVertex();
+    Vector3 GetInitialVelocity();
+    void GenerateArrayParticle();
+    void UpdateArrays(float deltaTime);
+    void CollideArrays();
     float GetParticlesPerFrame(float deltaTime);
     PParticle GenerateParticle();
     void Try2GenerateParticles(float deltaTime);
     void RemoveParticle(PParticle particle);
-    void SetInitialVelocity(PParticle particle);
     void ReStartLoop();
     PQuadMesh particleMesh_;
     PMaterial particleMaterial_;
@@ -89,5 +109,26 @@ private:
     std::set<PParticle> disabled_;
     ParticleSystemDistribution distribution_;
     Vector3 gravity_;
+    ParticleSystemMode mode_;
+
+    // ParticleSystemMode::ARRAYS state (world space)
+    struct ParticleArrays {
+        std::vector<float> px_, py_, pz_;
+        std::vector<float> vx_, vy_, vz_;
+        std::vector<float> age_;
+        std::vector<float> lifetime_;
+        size_t Size() const { return age_.size(); }
+        void Reserve(size_t n);
+        void Clear();
+        void Push(const Vector3& position, const Vector3& velocity,
+                  float lifetime);
+        void Remove(size_t index);
+    };
+    ParticleArrays arrays_;
+    BoundingBox arraysBB_;
+    float restitution_;
+    std::vector<Vector3> rayFrom_;
+    std::vector<Vector3> rayTo_;
+    std::vector<PhysicsRaycastResult> rayResults_;
 };
 }
\ No newline at end of file
@@ -6,15 +6,18 @@
 #include "Material.h"
 #include "Mesh.h"
 #include "ModelMesh.h"
+#include "OcclusionBuffer.h"
 #include "Octree.h"
 #include "OctreeQuery.h"
 #include "ParticleSystem.h"
 #include "PhysicsWorld.h"
+#include "Profiler.h"
 #include "RenderingContext.h"
 #include "SceneNode.h"
 #include "SharedFromPointer.h"
 #include "Skeleton.h"
 #include "StringConverter.h"
+#include "TransformHierarchy.h"
 #include "Util.h"
 #include "Window.h"
 #include "pugixml.hpp"
@@ -35,7 +38,31 @@ Scene::Scene(const std::string& name)
     physicsWorld_ = std::make_shared<PhysicsWorld>(this);
 }
 
-Scene::~Scene() {}
+Scene::~Scene() {
+    if (flatTransforms_)
+        SetTransformHierarchy(nullptr);
+}
+
+void Scene::EnableFlatTransforms(bool enable) {
+    if (enable == (flatTransforms_ != nullptr))
+        return;
+    if (enable) {
+        flatTransforms_ = PTransformHierarchy(new TransformHierarchy(this));
+        SetTransformHierarchy(flatTransforms_.get());
+    } else {
+        SetTransformHierarchy(nullptr);
+        flatTransforms_ = nullptr;
+        MarkAsDirty();
+    }
+}
+
+void Scene::EnableOcclusionCulling(bool enable, int width, int height) {
+    if (!enable)
+        occlusionBuffer_ = nullptr;
+    else if (!occlusionBuffer_ || occlusionBuffer_->GetWidth() != width ||
+             occlusionBuffer_->GetHeight() != height)
+        occlusionBuffer_ = std::make_shared<OcclusionBuffer>(width, height);
+}
 
 void Scene::SetWindow(PWindow window) {
     if (window_.lock() != window) {
@@ -102,13 +129,25 @@ void Scene::SetHorizonColor(const Color& horizon) {
 }
 
 void Scene::UpdateAll(float deltaTime) {
+    PROFILE_ZONE("Scene::UpdateAll");
+    if (flatTransforms_)
+        flatTransforms_->Update();
     physicsWorld_->StepSimulation(deltaTime);
     UpdateParticleSystems(deltaTime);
+    if (!needsSplit_.empty()) {
+        std::set<SceneNode*> nodes;
+        nodes.swap(needsSplit_);
+        for (auto& obj : nodes)
+            obj->SplitMesh();
+    }
     signalUpdate_->Run(deltaTime);
+    if (flatTransforms_)
+        flatTransforms_->Update();
 }
 
 bool Scene::GetFastRayNodesIntersection(const Ray& ray,
                                         std::vector<SceneNode*>& nodes) const {
+    PrepareOctree();
     RayOctreeQuery query(nodes, ray);
     octree_->Execute(query);
     return !nodes.empty();
@@ -117,6 +156,7 @@ bool Scene::GetFastRayNodesIntersection(const Ray& ray,
 bool Scene::GetPreciseRayNodesIntersection(
     const Ray& ray, std::vector<RayNodeResult>& result) const {
     std::vector<SceneNode*> tmpNodes;
+    PrepareOctree();
     RayOctreeQuery query(tmpNodes, ray);
     octree_->Execute(query);
     result.clear();
@@ -137,6 +177,17 @@ bool Scene::GetPreciseRayNodesIntersection(
     return !result.empty();
 }
 
+bool Scene::IsRayBlocked(const Ray& ray) const {
+    std::vector<SceneNode*> tmpNodes;
+    PrepareOctree();
+    RayOctreeQuery query(tmpNodes, ray);
+    octree_->Execute(query);
+    for (auto& obj : tmpNodes)
+        if (!obj->IsBillboard() && ray.Hits(obj))
+            return true;
+    return false;
+}
+
 bool Scene::GetClosestRayNodeIntersection(const Ray& ray,
                                           RayNodeResult& closest) const {
     std::vector<RayNodeResult> results;
@@ -160,29 +211,119 @@ bool Scene::GetClosestRayNodeIntersection(const Ray& ray,
     return false;
 }
 
-void Scene::GetVisibleNodes(const Camera* camera,
-                            std::vector<SceneNode*>& visibles) const {
-    for (auto& obj : octreeNeedsUpdate_)
+void Scene::PrepareOctree() const {
+    if (flatTransforms_)
+        flatTransforms_->Update();
+    for (auto& obj : octreeNeedsUpdate_) {
         octree_->InsertUpdate(obj);
+        UpdateOccluder(obj);
+    }
     octreeNeedsUpdate_.clear();
-    FrustumOctreeQuery query(visibles, camera->GetFrustum().get());
+}
+
+void Scene::UpdateOccluder(SceneNode* node) const {
+    if (node->IsOccluder())
+        occluders_.insert(node);
+    else
+        occluders_.erase(node);
+}
+
+void Scene::RasterizeOccluders(const Camera* camera) const {
+    PROFILE_ZONE("Scene::RasterizeOccluders");
+    auto frustum = camera->GetFrustumPointer();
+    occlusionBuffer_->SetView(camera->GetViewProjection());
+    for (auto& occluder : occluders_)
+        if (frustum->IsInside(occluder->GetWorldBoundingBox()) !=
+            Intersection::OUTSIDE)
+            occlusionBuffer_->AddOccluder(occluder);
+    occlusionBuffer_->BuildHierarchy();
+}
+
+void Scene::QueryVisibleNodes(const Camera* camera,
+                              QueryResult visibles) const {
+    auto frustum = camera->GetFrustumPointer();
+    PrepareOctree();
+    if (!occlusionBuffer_) {
+        FrustumOctreeQuery query(visibles, frustum);
+        octree_->Execute(query);
+        return;
+    }
+    RasterizeOccluders(camera);
+    OcclusionOctreeQuery query(visibles, frustum, occlusionBuffer_.get());
     octree_->Execute(query);
+    PROFILE_COUNT(OCCLUDED_NODES, query.GetCulledNodes());
+}
+
+void Scene::GetVisibleNodes(const Camera* camera,
+                            std::vector<SceneNode*>& visibles) const {
+    QueryVisibleNodes(camera, visibles);
 }
 
 void Scene::GetVisibleNodes(const Frustum* frustum,
                             std::vector<SceneNode*>& visibles) const {
-    for (auto& obj : octreeNeedsUpdate_)
-        octree_->InsertUpdate(obj);
-    octreeNeedsUpdate_.clear();
+    PrepareOctree();
     FrustumOctreeQuery query(visibles, frustum);
     octree_->Execute(query);
 }
 
+void Scene::GetVisibleNodes(const Camera* camera,
+                            FrameVector<SceneNode*>& visibles) const {
+    QueryVisibleNodes(camera, visibles);
+}
+
+void Scene::GetVisibleNodes(const Frustum* frustum,
+                            FrameVector<SceneNode*>& visibles) const {
+    PrepareOctree();
+    FrustumOctreeQuery query(visibles, frustum);
+    octree_->Execute(query);
+}
+
+void Scene::QueryLightedNodes(const Light* light, QueryResult nodes) const {
+    PrepareOctree();
+    if (LightType::POINT == light->GetType()) {
+        SphereOctreeQuery query(nodes, light->GetSphere());
+        octree_->Execute(query);
+    } else if (LightType::SPOT == light->GetType()) {
+        ConeOctreeQuery query(nodes, light->GetCone());
+        octree_->Execute(query);
+    } else {
+        nodes.Clear();
+        for (auto obj : octree_->GetDrawables())
+            if (obj->CanBeVisible())
+                nodes.Add(obj);
+    }
+}
+
+void Scene::GetLightedNodes(const Light* light,
+                            std::vector<SceneNode*>& nodes) const {
+    QueryLightedNodes(light, nodes);
+}
+
+void Scene::GetLightedNodes(const Light* light,
+                            FrameVector<SceneNode*>& nodes) const {
+    QueryLightedNodes(light, nodes);
+}
+
+void Scene::GetVisibleNodes(const Frustum* const* frustums, size_t nFrustums,
+                            std::vector<FrustumQueryResult>& results,
+                            bool collectNodes) const {
+    PrepareOctree();
+    MultiFrustumOctreeQuery query(frustums, nFrustums, results, collectNodes);
+    octree_->Execute(query);
+}
+
 void Scene::NeedUpdate(SceneNode* obj) {
-    if (obj->GetMesh() != nullptr && !obj->IsHidden())
-        octreeNeedsUpdate_.insert(obj);
+    auto& mesh = obj->GetMesh();
+    if (mesh != nullptr && !obj->IsHidden() && !obj->IsMeshSplit()) {
+        if (mesh->NeedsSplit())
+            NeedSplit(obj);
+        else
+            octreeNeedsUpdate_.insert(obj);
+    }
 }
 
+void Scene::NeedSplit(SceneNode* obj) { needsSplit_.insert(obj); }
+
 void Scene::SavePhysics(pugi::xml_node& node) const {
     pugi::xml_node child = node.append_child("Physics");
     child.append_attribute("gravity").set_value(
@@ -236,7 +377,8 @@ void Scene::Save(pugi::xml_node& node) const {
 }
 
 bool Scene::GetVisibleBoundingBox(const Camera* camera, BoundingBox& bb) const {
-    std::vector<SceneNode*> visibles;
+    FrameArena::Scope frameScope;
+    FrameVector<SceneNode*> visibles;
     GetVisibleNodes(camera, visibles);
     if (!visibles.empty()) {
         bb = BoundingBox();
@@ -296,12 +438,16 @@ void Scene::RemoveParticleSystem(ParticleSystem* ps) {
 }
 
 void Scene::UpdateOctree(SceneNode* node) {
-    if (node->GetMesh())
+    if (node->GetMesh() && !node->IsMeshSplit()) {
         octree_->InsertUpdate(node);
+        UpdateOccluder(node);
+    }
 }
 
 void Scene::RemoveFromOctree(SceneNode* node) {
     octreeNeedsUpdate_.erase(node);
+    needsSplit_.erase(node);
+    occluders_.erase(node);
     octree_->Remove(node);
 }
 
@@ -379,6 +525,16 @@ void Scene::FillShaderDefines(std::string& defines, PassType passType) const {
     }
 }
 
+unsigned Scene::GetVariationFlags(PassType passType) const {
+    unsigned flags = 0;
+    if (enableFog_ && PassType::SHADOW != passType) {
+        flags |= 1 << 0;
+        if (fogHeight_ != 0)
+            flags |= 1 << 1;
+    }
+    return flags;
+}
+
 float Scene::GetFogMinIntensity() const { return fogMinIntensity_; }
 
 float Scene::GetFogStart() const { return fogStart_; }
@@ -25,6 +25,7 @@ misrepresented as being the original software.
 */
 #pragma once
 #include "BoundingBox.h"
+#include "FrameArena.h"
 #include "Light.h"
 #include "Overlay.h"
 #include "SceneNode.h"
@@ -34,6 +35,8 @@ misrepresented as being the original software.
 #include <set>
 
 namespace NSG {
+struct FrustumQueryResult;
+class QueryResult;
 class Scene : public SceneNode {
 public:
     Scene(const std::string& name = GetUniqueName("scene"));
@@ -46,11 +49,32 @@ public:
     const std::vector<Light*>& GetLights() const;
     std::vector<Camera*> GetCameras() const;
     void UpdateAll(float deltaTime);
+    // Also called for the nodes of a mesh found to need a split when it
+    // gets ready (see Mesh::AllocateResources)
     void NeedUpdate(SceneNode* obj);
+    // obj's mesh has to be split (see SceneNode::SplitMesh) in UpdateAll
+    void NeedSplit(SceneNode* obj);
+    // With occlusion culling the camera queries skip the nodes hidden
+    // behind the occluders (the frustum ones never do it)
     void GetVisibleNodes(const Camera* camera,
                          std::vector<SceneNode*>& visibles) const;
     void GetVisibleNodes(const Frustum* frustum,
                          std::vector<SceneNode*>& visibles) const;
+    void GetVisibleNodes(const Camera* camera,
+                         FrameVector<SceneNode*>& visibles) const;
+    void GetVisibleNodes(const Frustum* frustum,
+                         FrameVector<SceneNode*>& visibles) const;
+    // Visible nodes and shadow bounds of several frustums in a single
+    // octree traversal (see MultiFrustumOctreeQuery)
+    void GetVisibleNodes(const Frustum* const* frustums, size_t nFrustums,
+                         std::vector<FrustumQueryResult>& results,
+                         bool collectNodes = true) const;
+    // Nodes reached by a point or spot light (see Light::CanLight), all of
+    // them for directional lights
+    void GetLightedNodes(const Light* light,
+                         std::vector<SceneNode*>& nodes) const;
+    void GetLightedNodes(const Light* light,
+                         FrameVector<SceneNode*>& nodes) const;
     void Save(pugi::xml_node& node) const override;
     void Load(const pugi::xml_node& node) override;
     bool GetFastRayNodesIntersection(const Ray& ray,
@@ -60,6 +84,8 @@ public:
                                    std::vector<RayNodeResult>& result) const;
     bool GetClosestRayNodeIntersection(const Ray& ray,
                                        RayNodeResult& closest) const;
+    // Precise test that stops at the first triangle hit (line of sight)
+    bool IsRayBlocked(const Ray& ray) const;
     bool GetVisibleBoundingBox(const Camera* camera, BoundingBox& bb) const;
     PPhysicsWorld GetPhysicsWorld() const { return physicsWorld_; }
     SceneNode* GetClosestNode(const Camera* camera, float screenX,
@@ -81,6 +107,7 @@ public:
     PCamera GetMainCamera() const;
     void SetMainCamera(PCamera camera);
     const std::vector<SceneNode*>& GetDrawables() const;
+    Octree* GetOctree() const { return octree_.get(); }
     void EnableFog(bool enable);
     void SetFogMinIntensity(
         float intensity); // same as density (so far not used by the shader)
@@ -93,6 +120,7 @@ public:
     float GetFogDepth() const;
     float GetFogHeight() const;
     void FillShaderDefines(std::string& defines, PassType passType) const;
+    unsigned GetVariationFlags(PassType passType) const;
     POverlay CreateOverlay(const std::string& name);
     POverlay GetOverlay(const std::string& name);
     POverlay GetOrCreateOverlay(const std::string& name);
@@ -101,6 +129,21 @@ public:
     void RemoveLight(Light* light);
     void RemoveCamera(Camera* camera);
     void RemoveParticleSystem(ParticleSystem* ps);
+    // Opt-in: keep the scene transforms in flattened arrays
+    void EnableFlatTransforms(bool enable);
+    TransformHierarchy* GetFlatTransforms() const {
+        return flatTransforms_.get();
+    }
+    const std::vector<ParticleSystem*>& GetParticleSystems() const {
+        return particleSystems_;
+    }
+    // Opt-in: the nodes flagged as SceneNodeFlag::OCCLUDER are rasterized
+    // in a CPU depth buffer of width x height before each camera query
+    void EnableOcclusionCulling(bool enable, int width = 256,
+                                int height = 128);
+    OcclusionBuffer* GetOcclusionBuffer() const {
+        return occlusionBuffer_.get();
+    }
     static constexpr float MAX_WORLD_SIZE = 5000.f;
 
 protected:
@@ -114,6 +157,12 @@ protected:
 
 private:
     void UpdateParticleSystems(float deltaTime);
+    // Updates the transforms and the octree before a query
+    void PrepareOctree() const;
+    void UpdateOccluder(SceneNode* node) const;
+    void RasterizeOccluders(const Camera* camera) const;
+    void QueryVisibleNodes(const Camera* camera, QueryResult visibles) const;
+    void QueryLightedNodes(const Light* light, QueryResult nodes) const;
 
 private:
     Camera* mainCamera_;
@@ -124,7 +173,11 @@ private:
     Color horizon_;
     POctree octree_;
     mutable std::set<SceneNode*> octreeNeedsUpdate_;
+    std::set<SceneNode*> needsSplit_;
+    mutable std::set<SceneNode*> occluders_;
+    POcclusionBuffer occlusionBuffer_;
     PPhysicsWorld physicsWorld_;
+    PTransformHierarchy flatTransforms_;
     PWeakWindow window_;
     SignalNodeMouseMoved::PSignal signalNodeMouseMoved_;
     SignalNodeMouseButton::PSignal signalNodeMouseDown_;
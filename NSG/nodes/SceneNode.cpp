@@ -33,6 +33,9 @@ misrepresented as being the original software.
 #include "Material.h"
 #include "ModelMesh.h"
 #include "Octree.h"
+#include "Pass.h"
+#include "Program.h"
+#include "RenderQueue.h"
 #include "RenderingContext.h"
 #include "RigidBody.h"
 #include "Scene.h"
@@ -41,16 +44,24 @@ misrepresented as being the original software.
 #include "StringConverter.h"
 #include "Util.h"
 #include "pugixml.hpp"
+#include <algorithm>
+#if defined(__SSE__) || defined(_M_X64) ||                                     \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NSG_PALETTE_SSE
+#endif
 #include <sstream>
 #include <string>
 #include <thread>
 
 namespace NSG {
 SceneNode::SceneNode(const std::string& name)
-    : Node(name), octant_(nullptr), worldBBNeedsUpdate_(true),
+    : Node(name), octant_(nullptr), octantIndex_(0), worldBBNeedsUpdate_(true),
       serializable_(true), signalMeshSet_(new SignalEmpty()),
       signalMaterialSet_(new SignalEmpty()),
-      signalCollision_(new Signal<const ContactPoint&>()) {
+      signalCollision_(new Signal<const ContactPoint&>()), renderKey_(0),
+      renderKeyMaterial_(nullptr), renderKeyMesh_(nullptr),
+      renderKeyStamp_(0), bonesStamp_(0), bonePaletteFrame_(0) {
     flags_ = (int)SceneNodeFlag::ALLOW_RAY_QUERY;
 }
 
@@ -68,6 +79,8 @@ bool SceneNode::CanBeVisible() const { return mesh_ != nullptr; }
 void SceneNode::SetMaterial(PMaterial material) {
     if (material_ != material) {
         material_ = material;
+        for (auto& chunk : meshChunks_)
+            chunk->SetMaterial(material);
         signalMaterialSet_->Run();
     }
 }
@@ -77,6 +90,8 @@ void SceneNode::SetMesh(PMesh mesh) {
         if (mesh_)
             mesh_->RemoveSceneNode(this);
 
+        ClearMeshChunks();
+        slotMeshReleased_ = nullptr;
         mesh_ = mesh;
         worldBB_ = BoundingBox();
 
@@ -96,6 +111,39 @@ void SceneNode::SetMesh(PMesh mesh) {
     }
 }
 
+void SceneNode::SplitMesh(size_t maxVertexes) {
+    CHECK_CONDITION(mesh_ && mesh_->IsReady());
+    ClearMeshChunks();
+    auto chunks = mesh_->Split(maxVertexes);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        auto chunk = CreateChild<SceneNode>(name_ + "_chunk" + ToString(i));
+        chunk->SetSerializable(false);
+        chunk->SetMaterial(material_);
+        chunk->SetArmature(GetArmature()); // keeps the skinning
+        chunk->SetMesh(chunks[i]);
+        meshChunks_.push_back(chunk);
+    }
+    auto scene = GetScene();
+    if (scene)
+        scene->RemoveFromOctree(this);
+    slotMeshReleased_ =
+        mesh_->SigReleased()->Connect([this]() { ClearMeshChunks(); });
+}
+
+void SceneNode::ClearMeshChunks() {
+    if (meshChunks_.empty())
+        return;
+    for (auto& chunk : meshChunks_) {
+        chunk->SetMesh(nullptr);
+        chunk->SetParent(nullptr);
+    }
+    meshChunks_.clear();
+    worldBBNeedsUpdate_ = true;
+    auto scene = GetScene();
+    if (scene)
+        scene->NeedUpdate(this); // back to the octree until split again
+}
+
 PRigidBody SceneNode::GetOrCreateRigidBody() {
     CHECK_ASSERT(character_ == nullptr);
     if (!rigidBody_)
@@ -149,6 +197,7 @@ void SceneNode::OnDirty() const {
 }
 
 const BoundingBox& SceneNode::GetWorldBoundingBox() const {
+    Update();
     if (worldBBNeedsUpdate_) {
         if (mesh_ && mesh_->IsReady()) {
             worldBB_ = mesh_->GetBB();
@@ -295,7 +344,11 @@ void SceneNode::OnCollision(const ContactPoint& contactInfo) {
 
 void SceneNode::SetFlags(const SceneNodeFlags& flags) {
     if (flags_ != flags) {
+        auto occluder = IsOccluder();
         flags_ = flags;
+        auto scene = GetScene();
+        if (scene && occluder != IsOccluder())
+            scene->NeedUpdate(this);
     }
 }
 
@@ -317,7 +370,120 @@ void SceneNode::SetSkeleton(PSkeleton skeleton) {
             CHECK_CONDITION(skeleton_->IsReady());
             skeleton_->CreateBonesFor(thisSceneNode);
         }
+        BindBones();
+    }
+}
+
+void SceneNode::BindBones() {
+    bones_.clear();
+    bonePalette_.clear();
+    if (!skeleton_)
+        return;
+    for (auto& name : skeleton_->GetShaderOrder()) {
+        auto bone = GetChild<Node>(name, true);
+        CHECK_ASSERT(bone);
+        bones_.push_back(bone);
+    }
+    bonesStamp_ = skeleton_->GetVariationStamp();
+}
+
+// result = m1 * m2, with the same operations order than operator*
+static void Multiply(const Matrix4& m1, const Matrix4& m2, Matrix4& result) {
+#if defined(NSG_PALETTE_SSE)
+    auto a0 = _mm_loadu_ps(&m1[0].x);
+    auto a1 = _mm_loadu_ps(&m1[1].x);
+    auto a2 = _mm_loadu_ps(&m1[2].x);
+    auto a3 = _mm_loadu_ps(&m1[3].x);
+    for (int i = 0; i < 4; i++) {
+        auto& b = m2[i];
+        auto sum = _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b.x)),
+                              _mm_mul_ps(a1, _mm_set1_ps(b.y)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(b.z)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(b.w)));
+        _mm_storeu_ps(&result[i].x, sum);
+    }
+#else
+    result = m1 * m2;
+#endif
+}
+
+const std::vector<Matrix4>& SceneNode::GetBonePalette(unsigned frame) {
+    if (sharedPose_)
+        return sharedPose_->GetBonePalette(frame);
+    CHECK_ASSERT(skeleton_);
+    if (bonesStamp_ != skeleton_->GetVariationStamp())
+        BindBones();
+    else if (frame == bonePaletteFrame_ &&
+             bonePalette_.size() == bones_.size())
+        return bonePalette_;
+    auto& offsets = skeleton_->GetBoneOffsetMatrices();
+    CHECK_ASSERT(offsets.size() == bones_.size());
+    bonePalette_.resize(bones_.size());
+    // relative to the armature
+    auto& inverse = GetGlobalModelInvMatrix();
+    auto& names = skeleton_->GetShaderOrder();
+    Matrix4 boneMatrix;
+    for (size_t i = 0; i < bones_.size(); i++) {
+        auto bone = bones_[i].lock();
+        if (!bone) {
+            // the bone node was destroyed: look for it again by name
+            bone = GetChild<Node>(names[i], true);
+            bones_[i] = bone;
+        }
+        if (!bone) {
+            bonePalette_[i] = Matrix4();
+            continue;
+        }
+        Multiply(inverse, bone->GetGlobalModelMatrix(), boneMatrix);
+        Multiply(boneMatrix, offsets[i], bonePalette_[i]);
+    }
+    bonePaletteFrame_ = frame;
+    return bonePalette_;
+}
+
+const SceneNode* SceneNode::GetPaletteNode() const {
+    auto armature = armature_.lock();
+    if (!armature)
+        return nullptr;
+    auto pose = armature->GetSharedPose();
+    return pose ? pose : armature.get();
+}
+
+unsigned SceneNode::GetVariationStamp() const {
+    auto armature = GetArmature();
+    if (armature) {
+        auto skeleton = armature->GetSkeleton();
+        if (skeleton)
+            return skeleton->GetVariationStamp();
+    }
+    return 0;
+}
+
+uint64_t SceneNode::GetRenderKey() const {
+    auto materialStamp = material_ ? material_->GetVariationStamp() : 0;
+    auto meshStamp = mesh_ ? mesh_->GetVariationStamp() : 0;
+    auto nodeStamp = GetVariationStamp();
+    // stamps only grow: the newest one changes when any of them changes
+    auto stamp = std::max(std::max(materialStamp, meshStamp), nodeStamp);
+    if (renderKeyMaterial_ != material_.get() ||
+        renderKeyMesh_ != mesh_.get() || renderKeyStamp_ != stamp) {
+        renderKeyMaterial_ = material_.get();
+        renderKeyMesh_ = mesh_.get();
+        renderKeyStamp_ = stamp;
+        // the program drawing the node: the scene, camera and light parts
+        // of the variation are the same for all the nodes of a queue
+        static const Pass pass;
+        unsigned variation = 0;
+        if (material_ && mesh_)
+            variation = Program::GetOrCreateVariation(&pass, nullptr, nullptr,
+                                                      renderKeyMesh_,
+                                                      renderKeyMaterial_,
+                                                      nullptr, this)
+                            ->GetSortId();
+        renderKey_ = RenderQueue::GetKey(variation, renderKeyMaterial_,
+                                         renderKeyMesh_);
     }
+    return renderKey_;
 }
 
 void SceneNode::FillShaderDefines(std::string& defines) const {
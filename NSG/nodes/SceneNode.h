@@ -25,9 +25,11 @@ misrepresented as being the original software.
 */
 #pragma once
 #include "BoundingBox.h"
+#include "Mesh.h"
 #include "Node.h"
 #include "SignalSlots.h"
 #include "Types.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -40,19 +42,26 @@ public:
     SceneNode(const std::string& name);
     ~SceneNode();
     virtual bool CanBeVisible() const;
-    PMaterial GetMaterial() const { return material_; }
+    const PMaterial& GetMaterial() const { return material_; }
     void SetMaterial(PMaterial material);
     void SetMesh(PMesh mesh);
+    // Draws the mesh with child nodes holding chunks of it (see Mesh::Split).
+    // Done by the scene when the mesh needs unsupported 32 bits indexes.
+    void SplitMesh(size_t maxVertexes = Mesh::MAX_CHUNK_VERTEXES);
+    bool IsMeshSplit() const { return !meshChunks_.empty(); }
     PRigidBody GetOrCreateRigidBody();
     PCharacter GetOrCreateCharacter();
     PRigidBody GetRigidBody() const { return rigidBody_; }
     PCharacter GetCharacter() const { return character_; }
     PAnimationController GetOrCreateAnimationController();
-    PMesh GetMesh() const { return mesh_; }
+    const PMesh& GetMesh() const { return mesh_; }
     void SetOctant(Octant* octant) const { octant_ = octant; }
     const BoundingBox& GetWorldBoundingBox() const;
     BoundingBox GetWorldBoundingBoxBut(const SceneNode* node) const;
     Octant* GetOctant() const { return octant_; }
+    // Position in the drawables of the octant
+    void SetOctantIndex(unsigned index) const { octantIndex_ = index; }
+    unsigned GetOctantIndex() const { return octantIndex_; }
     virtual void OnDirty() const override;
     void OnScaleChange() override;
     virtual void OnCollision(const ContactPoint& contactInfo);
@@ -74,9 +83,26 @@ public:
     bool AllowRayQuery() const {
         return flags_ & (int)SceneNodeFlag::ALLOW_RAY_QUERY;
     }
+    bool IsOccluder() const { return flags_ & (int)SceneNodeFlag::OCCLUDER; }
+    // Simplified mesh rasterized instead of the mesh by an occluder
+    void SetOccluderMesh(PMesh mesh) { occluderMesh_ = mesh; }
+    const PMesh& GetOccluderMesh() const { return occluderMesh_; }
     void SetSkeleton(PSkeleton skeleton);
     PSkeleton GetSkeleton() const { return skeleton_; }
+    // Skinning matrices of the armature (in the shader order of its
+    // skeleton), relative to the armature. Evaluated once per frame.
+    const std::vector<Matrix4>& GetBonePalette(unsigned frame);
+    // Crowd mode (see AnimationCrowd): the armature is skinned with the
+    // palette of pose, evaluated once for all the armatures sharing it
+    void SetSharedPose(PSceneNode pose) { sharedPose_ = pose; }
+    SceneNode* GetSharedPose() const { return sharedPose_.get(); }
+    // Armature (or its shared pose) with the palette that skins this node
+    const SceneNode* GetPaletteNode() const;
     void FillShaderDefines(std::string& defines) const;
+    unsigned GetVariationStamp() const;
+    // Material, mesh and variation part of the RenderQueue key.
+    // Kept between frames while they do not change.
+    uint64_t GetRenderKey() const;
     PSceneNode GetArmature() const;
     void SetArmature(PSceneNode armature);
     bool IsBillboard() const;
@@ -90,11 +116,14 @@ protected:
     PSkeleton skeleton_;
 
 private:
+    void ClearMeshChunks();
+    void BindBones();
     PWeakSceneNode armature_;
     PRigidBody rigidBody_;
     PCharacter character_;
     PAnimationController animationController_;
     mutable Octant* octant_;
+    mutable unsigned octantIndex_;
     mutable BoundingBox worldBB_;
     mutable bool worldBBNeedsUpdate_;
     bool serializable_;
@@ -103,5 +132,18 @@ private:
     SignalEmpty::PSignal signalMaterialSet_;
     SignalCollision::PSignal signalCollision_;
     PMaterial filter_;
+    std::vector<PSceneNode> meshChunks_;
+    SignalEmpty::PSlot slotMeshReleased_;
+    mutable uint64_t renderKey_;
+    mutable const Material* renderKeyMaterial_;
+    mutable const Mesh* renderKeyMesh_;
+    mutable unsigned renderKeyStamp_;
+    // bones of the skeleton resolved when binding it
+    std::vector<PWeakNode> bones_;
+    unsigned bonesStamp_;
+    std::vector<Matrix4> bonePalette_;
+    unsigned bonePaletteFrame_;
+    PSceneNode sharedPose_;
+    PMesh occluderMesh_;
 };
 }
@@ -79,11 +79,21 @@ void ShadowCamera::SetupSpot(const Camera* camera) {
 
 void ShadowCamera::SetupDirectional(const Camera* camera, float nearSplit,
                                     float farSplit) {
+    SetupDirectionalSplit(camera, nearSplit, farSplit);
+    auto camSplitFrustum = GetFrustum();
+    auto scene = light_->GetScene().get();
+    auto receiversBox =
+        Camera::GetViewBox(camSplitFrustum.get(), scene, true, false);
+    auto castersBox =
+        Camera::GetViewBox(camSplitFrustum.get(), scene, false, true);
+    SetupDirectionalBounds(receiversBox, castersBox);
+}
+
+void ShadowCamera::SetupDirectionalSplit(const Camera* camera, float nearSplit,
+                                         float farSplit) {
     farSplit_ = farSplit;
 
     CHECK_ASSERT(!GetParent());
-
-    auto scene = light_->GetScene().get();
     CHECK_ASSERT(light_->GetType() == LightType::DIRECTIONAL);
 
     EnableOrtho();
@@ -109,18 +119,15 @@ void ShadowCamera::SetupDirectional(const Camera* camera, float nearSplit,
         viewCenter.z = 0;
         Translate(viewCenter);
     }
+}
+
+void ShadowCamera::SetupDirectionalBounds(BoundingBox receiversBox,
+                                          BoundingBox castersBox) {
     {
-        // Calculate receivers for current split
-        auto camSplitFrustum = GetFrustum();
-        auto receiversBox =
-            Camera::GetViewBox(camSplitFrustum.get(), scene, true, false);
         if (!receiversBox.IsDefined()) {
             disabled_ = true;
             return; // no receivers for this split => nothing to do
         }
-        // Calculate casters for current split
-        auto castersBox =
-            Camera::GetViewBox(camSplitFrustum.get(), scene, false, true);
         if (!castersBox.IsDefined()) {
             disabled_ = true;
             return; // no casters for this split => nothing to do
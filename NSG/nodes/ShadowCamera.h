@@ -33,6 +33,14 @@ public:
     void SetupPoint(const Camera* camera);
     void SetupDirectional(const Camera* camera, float nearSplit,
                           float farSplit);
+    // SetupDirectional in two steps, so the receivers and casters bounds of
+    // all the splits can be found with a single octree query: first fit the
+    // camera split, then fit the receivers and casters (in world space)
+    // found inside the resulting frustum.
+    void SetupDirectionalSplit(const Camera* camera, float nearSplit,
+                               float farSplit);
+    void SetupDirectionalBounds(BoundingBox receiversBox,
+                                BoundingBox castersBox);
     void SetCurrentCubeShadowMapFace(TextureTarget target);
     bool GetVisiblesShadowCasters(std::vector<SceneNode*>& result) const;
     float GetFarSplit() const { return farSplit_; }
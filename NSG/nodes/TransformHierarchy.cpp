@@ -0,0 +1,174 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "TransformHierarchy.h"
+#include "Check.h"
+#include "Node.h"
+#include <algorithm>
+
+namespace NSG {
+TransformHierarchy::TransformHierarchy(Node* root)
+    : root_(root), begin_(0), end_(0), updatedNodes_(0), pending_(true),
+      structureDirty_(true), updating_(false) {
+    CHECK_ASSERT(root_);
+}
+
+TransformHierarchy::~TransformHierarchy() {}
+
+void TransformHierarchy::Invalidate() {
+    structureDirty_ = true;
+    pending_ = true;
+}
+
+bool TransformHierarchy::MarkDirty(size_t index, bool scaleChange) {
+    pending_ = true;
+    if (structureDirty_ || index == InvalidIndex)
+        return false; // the caller has to propagate it (as before)
+    CHECK_ASSERT(index < nodes_.size());
+    flags_[index] |= MARKED | DIRTY | (scaleChange ? SCALE : 0);
+    begin_ = std::min(begin_, index);
+    end_ = std::max(end_, ends_[index]);
+    return true;
+}
+
+void TransformHierarchy::Rebuild() {
+    nodes_.clear();
+    parents_.clear();
+    std::vector<std::pair<Node*, int>> stack;
+    stack.push_back({root_, -1});
+    while (!stack.empty()) {
+        auto obj = stack.back();
+        stack.pop_back();
+        auto index = (int)nodes_.size();
+        nodes_.push_back(obj.first);
+        parents_.push_back(obj.second);
+        auto& children = obj.first->GetChildren();
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+            stack.push_back({it->get(), index});
+    }
+
+    auto n = nodes_.size();
+    ends_.assign(n, 1);
+    for (auto i = n - 1; i > 0; --i)
+        ends_[parents_[i]] += ends_[i];
+    for (size_t i = 0; i < n; i++)
+        ends_[i] += i;
+
+    locals_.resize(n);
+    worlds_.resize(n);
+    orientations_.resize(n);
+    flags_.assign(n, 0);
+    updated_.assign(n, 0);
+    begin_ = n;
+    end_ = 0;
+    for (size_t i = 0; i < n; i++) {
+        auto node = nodes_[i];
+        node->flatIndex_ = i;
+        locals_[i] = Matrix4(node->position_, node->q_, node->scale_);
+        worlds_[i] = node->globalModel_;
+        orientations_[i] = node->globalOrientation_;
+        if (node->dirty_) {
+            flags_[i] = MARKED | DIRTY;
+            begin_ = std::min(begin_, i);
+            end_ = std::max(end_, ends_[i]);
+        }
+    }
+    structureDirty_ = false;
+}
+
+void TransformHierarchy::Update() {
+    if (!pending_ || updating_)
+        return;
+    updating_ = true;
+    if (structureDirty_)
+        Rebuild();
+    pending_ = false;
+    auto begin = begin_;
+    auto end = end_;
+    begin_ = nodes_.size();
+    end_ = 0;
+    updatedNodes_ = 0;
+    for (auto i = begin; i < end; i++) {
+        auto flags = flags_[i];
+        auto parent = parents_[i];
+        if (parent >= 0)
+            flags |= updated_[parent];
+        if ((flags & DIRTY) && nodes_[i]->hide_) {
+            // keep the flags of the subtree for the update after OnShow
+            flags_[i] = flags;
+            begin_ = std::min(begin_, i);
+            end_ = std::max(end_, ends_[i]);
+            i = ends_[i] - 1;
+            continue;
+        }
+        flags_[i] = 0;
+        if (flags & DIRTY) {
+            UpdateNode(i, flags);
+            updated_[i] = flags & (DIRTY | SCALE);
+            ++updatedNodes_;
+        }
+    }
+    if (begin < end)
+        std::fill(updated_.begin() + begin, updated_.begin() + end, 0);
+    updating_ = false;
+}
+
+void TransformHierarchy::UpdateNode(size_t index, unsigned char flags) {
+    auto node = nodes_[index];
+    if (flags & MARKED)
+        locals_[index] = Matrix4(node->position_, node->q_, node->scale_);
+    auto parent = parents_[index];
+    auto& world = worlds_[index];
+    auto& orientation = orientations_[index];
+    if (parent >= 0) {
+        world = worlds_[parent] * locals_[index];
+        orientation = orientations_[parent] * node->q_;
+        node->globalPosition_ = world.Translation();
+        node->globalScale_ = world.Scale();
+    } else {
+        world = locals_[index];
+        orientation = node->q_;
+        node->globalPosition_ = node->position_;
+        node->globalScale_ = node->scale_;
+    }
+    node->globalModel_ = world;
+    node->globalOrientation_ = orientation;
+    node->isScaleUniform_ = node->globalScale_.IsUniform();
+    node->globalModelInvDirty_ = true;
+    node->globalModelInvTranspDirty_ = true;
+    node->lookAtDirection_ = orientation * Vector3::LookAt;
+    node->upDirection_ = orientation * Vector3::Up;
+    node->rightDirection_ = orientation * Vector3::Right;
+    node->dirty_ = false;
+    if (!(flags & MARKED)) {
+        // descendants were not visited by MarkAsDirty
+        node->SetUniformsNeedUpdate();
+        node->OnDirty();
+        if (flags & SCALE)
+            node->OnScaleChange();
+    }
+    node->signalUpdated_->Run();
+}
+}
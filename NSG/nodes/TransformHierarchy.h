@@ -0,0 +1,70 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Matrix4.h"
+#include "Quaternion.h"
+#include "Types.h"
+#include <vector>
+
+namespace NSG {
+// Scene-wide transforms stored in parent-before-child arrays.
+// Node::MarkAsDirty only flags the node; Update() recomputes the dirty
+// ranges (and their descendants) in a single forward pass. As in
+// Node::Update, a dirty hidden node and its subtree wait until it is shown.
+// Inverse matrices are left to the nodes that ask for them.
+class TransformHierarchy {
+public:
+    TransformHierarchy(Node* root);
+    ~TransformHierarchy();
+    void Invalidate();
+    bool MarkDirty(size_t index, bool scaleChange);
+    void Update();
+    void OnShow() { pending_ = true; } // resumes the waiting subtrees
+    size_t GetSize() const { return nodes_.size(); }
+    size_t GetUpdatedNodes() const { return updatedNodes_; }
+    static const size_t InvalidIndex = size_t(-1);
+
+private:
+    void Rebuild();
+    void UpdateNode(size_t index, unsigned char flags);
+    enum Flags { MARKED = 1, DIRTY = 2, SCALE = 4 };
+    Node* root_;
+    std::vector<Node*> nodes_;
+    std::vector<int> parents_;
+    std::vector<size_t> ends_; // index after the last descendant
+    std::vector<Matrix4> locals_;
+    std::vector<Matrix4> worlds_;
+    std::vector<Quaternion> orientations_;
+    std::vector<unsigned char> flags_;
+    std::vector<unsigned char> updated_;
+    size_t begin_;
+    size_t end_;
+    size_t updatedNodes_;
+    bool pending_;
+    bool structureDirty_;
+    bool updating_;
+};
+}
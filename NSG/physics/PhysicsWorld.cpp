@@ -26,11 +26,13 @@ misrepresented as being the original software.
 #include "PhysicsWorld.h"
 #include "BulletCollision/CollisionDispatch/btGhostObject.h"
 #include "Camera.h"
+#include "Check.h"
 #include "Color.h"
 #include "DebugRenderer.h"
 #include "ICollision.h"
 #include "Log.h"
 #include "Maths.h"
+#include "Profiler.h"
 #include "Ray.h"
 #include "Scene.h"
 #include "btBulletDynamicsCommon.h"
@@ -80,6 +82,7 @@ void PhysicsWorld::SetGravity(const Vector3& gravity) {
 }
 
 void PhysicsWorld::StepSimulation(float timeStep) {
+    PROFILE_ZONE("PhysicsWorld::StepSimulation");
     float internalTimeStep = 1.0f / fps_;
     int maxSubSteps = (int)(timeStep * fps_) + 1;
     if (maxSubSteps_ < 0) {
@@ -239,4 +242,42 @@ PhysicsRaycastResult PhysicsWorld::RayCast(const Vector3& origin,
     }
     return result;
 }
+
+int PhysicsWorld::GetNumCollisionObjects() const {
+    return dynamicsWorld_->getNumCollisionObjects();
+}
+
+size_t PhysicsWorld::RayCast(const std::vector<Vector3>& from,
+                             const std::vector<Vector3>& to,
+                             std::vector<PhysicsRaycastResult>& results,
+                             int collisionMask) {
+    CHECK_ASSERT(from.size() == to.size());
+    auto n = from.size();
+    results.resize(n);
+    size_t hits = 0;
+    if (!GetNumCollisionObjects()) {
+        for (auto& result : results)
+            result.collider_ = nullptr;
+        return hits;
+    }
+    for (size_t i = 0; i < n; i++) {
+        auto& result = results[i];
+        result.collider_ = nullptr;
+        btCollisionWorld::ClosestRayResultCallback rayCallback(
+            ToBtVector3(from[i]), ToBtVector3(to[i]));
+        rayCallback.m_collisionFilterGroup = (short)0xffff;
+        rayCallback.m_collisionFilterMask = collisionMask;
+        dynamicsWorld_->rayTest(rayCallback.m_rayFromWorld,
+                                rayCallback.m_rayToWorld, rayCallback);
+        if (rayCallback.hasHit()) {
+            result.position_ = ToVector3(rayCallback.m_hitPointWorld);
+            result.normal_ = ToVector3(rayCallback.m_hitNormalWorld);
+            result.distance_ = (result.position_ - from[i]).Length();
+            result.collider_ = static_cast<ICollision*>(
+                rayCallback.m_collisionObject->getUserPointer());
+            ++hits;
+        }
+    }
+    return hits;
+}
 }
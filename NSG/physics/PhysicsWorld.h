@@ -64,6 +64,7 @@ public:
     int GetFps() const { return fps_; }
     void SetMaxSubSteps(int steps);
     int GetMaxSubSteps() const { return maxSubSteps_; }
+    int GetNumCollisionObjects() const;
     ///////////////////////////////////////////////////////////////////////////////////////
     // Bullet btIDebugDraw
     // bool isVisible(const btVector3& aabbMin, const btVector3& aabbMax)
@@ -89,6 +90,11 @@ public:
     PhysicsRaycastResult RayCast(const Vector3& origin,
                                  const Vector3& direction, float maxDistance,
                                  int collisionMask = (int)CollisionMask::ALL);
+    // Casts the segments from[i]->to[i]. Returns the number of hits.
+    size_t RayCast(const std::vector<Vector3>& from,
+                   const std::vector<Vector3>& to,
+                   std::vector<PhysicsRaycastResult>& results,
+                   int collisionMask = (int)CollisionMask::ALL);
     PDebugRenderer GetDebugRenderer() const { return debugRenderer_; }
 
 private:
@@ -75,7 +75,8 @@ void ShapeKey::GetData(PMesh& mesh, Vector3& scale, PhysicsShape& type) const {
 }
 
 Shape::Shape(const std::string& name)
-    : Object(name), type_(SH_EMPTY), margin_(.06f), scale_(1) {
+    : Object(name), type_(SH_EMPTY), margin_(.06f), scale_(1),
+      cooked_(false) {
     PMesh mesh;
     ShapeKey(name).GetData(mesh, scale_, type_);
     mesh_ = mesh;
@@ -84,7 +85,7 @@ Shape::Shape(const std::string& name)
 Shape::~Shape() {}
 
 bool Shape::IsValid() {
-    if (type_ == PhysicsShape::SH_EMPTY)
+    if (cooked_ || type_ == PhysicsShape::SH_EMPTY)
         return true;
     auto mesh = mesh_.lock();
     if (mesh) {
@@ -97,89 +98,109 @@ bool Shape::IsValid() {
 }
 
 void Shape::AllocateResources() {
-    Vector3 halfSize(bb_.Size() * 0.5f);
+    if (!cooked_)
+        SetCooked(Cook(type_, scale_, bb_, mesh_.lock().get()));
+    cooked_ = false;
+}
+
+void Shape::SetCooked(const Cooked& cooked) {
+    bb_ = cooked.bb_;
+    shape_ = cooked.shape_;
+    triMesh_ = cooked.triMesh_;
+    shape_->setMargin(margin_);
+    shape_->setUserPointer(this);
+    cooked_ = true;
+}
+
+Shape::Cooked Shape::Cook(PhysicsShape type, const Vector3& scale,
+                          const BoundingBox& bb, const Mesh* mesh) {
+    Cooked cooked;
+    cooked.bb_ = bb;
+    auto& shape = cooked.shape_;
+    Vector3 halfSize(bb.Size() * 0.5f);
 
-    switch (type_) {
+    switch (type) {
     case SH_SPHERE: {
-        if (!scale_.IsUniform()) {
+        if (!scale.IsUniform()) {
             btVector3 position(0.f, 0.f, 0.f);
             btScalar radi =
                 std::max(halfSize.x, std::max(halfSize.y, halfSize.z));
             // only way to have non-uniform scaling
-            shape_ = std::make_shared<btMultiSphereShape>(&position, &radi, 1);
+            shape = std::make_shared<btMultiSphereShape>(&position, &radi, 1);
         } else
-            shape_ = std::make_shared<btSphereShape>(
+            shape = std::make_shared<btSphereShape>(
                 std::max(halfSize.x, std::max(halfSize.y, halfSize.z)));
         break;
     }
 
     case SH_BOX:
-        shape_ = std::make_shared<btBoxShape>(ToBtVector3(halfSize));
+        shape = std::make_shared<btBoxShape>(ToBtVector3(halfSize));
         break;
 
     case SH_CONE_Z: {
         auto c_radius = std::max(halfSize.x, halfSize.y);
-        shape_ = std::make_shared<btConeShapeZ>(c_radius, 2 * halfSize.z);
+        shape = std::make_shared<btConeShapeZ>(c_radius, 2 * halfSize.z);
         break;
     }
 
     case SH_CONE_Y: {
         auto c_radius = std::max(halfSize.x, halfSize.z);
-        shape_ = std::make_shared<btConeShape>(c_radius, 2 * halfSize.y);
+        shape = std::make_shared<btConeShape>(c_radius, 2 * halfSize.y);
         break;
     }
 
     case SH_CONE_X: {
         auto c_radius = std::max(halfSize.y, halfSize.z);
-        shape_ = std::make_shared<btConeShapeX>(c_radius, 2 * halfSize.x);
+        shape = std::make_shared<btConeShapeX>(c_radius, 2 * halfSize.x);
         break;
     }
 
     case SH_CYLINDER_Z:
-        shape_ = std::make_shared<btCylinderShapeZ>(ToBtVector3(halfSize));
+        shape = std::make_shared<btCylinderShapeZ>(ToBtVector3(halfSize));
         break;
 
     case SH_CYLINDER_Y:
-        shape_ = std::make_shared<btCylinderShape>(ToBtVector3(halfSize));
+        shape = std::make_shared<btCylinderShape>(ToBtVector3(halfSize));
         break;
 
     case SH_CYLINDER_X:
-        shape_ = std::make_shared<btCylinderShapeX>(ToBtVector3(halfSize));
+        shape = std::make_shared<btCylinderShapeX>(ToBtVector3(halfSize));
         break;
 
     case SH_CAPSULE_Z: {
         auto c_radius = std::max(halfSize.x, halfSize.y);
-        shape_ = std::make_shared<btCapsuleShapeZ>(
+        shape = std::make_shared<btCapsuleShapeZ>(
             c_radius - 0.05f, (halfSize.z - 0.05f) * 2 - c_radius);
         break;
     }
 
     case SH_CAPSULE_Y: {
         auto c_radius = std::max(halfSize.x, halfSize.z);
-        shape_ = std::make_shared<btCapsuleShape>(
+        shape = std::make_shared<btCapsuleShape>(
             c_radius - 0.05f, (halfSize.y - 0.05f) * 2 - c_radius);
         break;
     }
 
     case SH_CAPSULE_X: {
         auto c_radius = std::max(halfSize.y, halfSize.z);
-        shape_ = std::make_shared<btCapsuleShapeX>(
+        shape = std::make_shared<btCapsuleShapeX>(
             c_radius - 0.05f, (halfSize.x - 0.05f) * 2 - c_radius);
         break;
     }
 
     case SH_CONVEX_TRIMESH:
-        shape_ = GetConvexHullTriangleMesh();
+        shape = GetConvexHullTriangleMesh(mesh);
         break;
 
     case SH_TRIMESH: {
-        CreateTriangleMesh();
-        shape_ = std::make_shared<btBvhTriangleMeshShape>(triMesh_.get(), true);
+        cooked.triMesh_ = CreateTriangleMesh(mesh);
+        shape = std::make_shared<btBvhTriangleMeshShape>(
+            cooked.triMesh_.get(), true);
         break;
     }
 
     case SH_EMPTY:
-        shape_ = std::make_shared<btEmptyShape>();
+        shape = std::make_shared<btEmptyShape>();
         break;
 
     default:
@@ -187,10 +208,9 @@ void Shape::AllocateResources() {
         break;
     }
 
-    CHECK_ASSERT(shape_);
-    shape_->setLocalScaling(ToBtVector3(scale_));
-    shape_->setMargin(margin_);
-    shape_->setUserPointer(this);
+    CHECK_ASSERT(shape);
+    shape->setLocalScaling(ToBtVector3(scale));
+    return cooked;
 }
 
 void Shape::ReleaseResources() {
@@ -214,12 +234,11 @@ void Shape::SetMargin(float margin) {
     }
 }
 
-void Shape::CreateTriangleMesh() {
-    auto mesh = mesh_.lock();
-    CHECK_CONDITION(mesh->IsReady());
-    auto vertexData = mesh->GetVertexsData();
-    auto indices = mesh->GetIndexes(true);
-    triMesh_ = std::make_shared<btTriangleMesh>();
+std::shared_ptr<btTriangleMesh> Shape::CreateTriangleMesh(const Mesh* mesh) {
+    CHECK_CONDITION(mesh);
+    auto& vertexData = mesh->GetVertexsData();
+    auto& indices = mesh->GetIndexes(true);
+    auto triMesh = std::make_shared<btTriangleMesh>();
     auto index_count = indices.size();
     CHECK_ASSERT(index_count % 3 == 0);
     for (size_t i = 0; i < index_count; i += 3) {
@@ -227,7 +246,7 @@ void Shape::CreateTriangleMesh() {
         auto i1 = indices[i + 1];
         auto i2 = indices[i + 2];
 
-        triMesh_->addTriangle(
+        triMesh->addTriangle(
             btVector3(vertexData[i0].position_.x, vertexData[i0].position_.y,
                       vertexData[i0].position_.z),
             btVector3(vertexData[i1].position_.x, vertexData[i1].position_.y,
@@ -236,12 +255,13 @@ void Shape::CreateTriangleMesh() {
                       vertexData[i2].position_.z));
     }
 
-    CHECK_ASSERT(triMesh_->getNumTriangles() > 0);
+    CHECK_ASSERT(triMesh->getNumTriangles() > 0);
+    return triMesh;
 }
 
-std::shared_ptr<btConvexHullShape> Shape::GetConvexHullTriangleMesh() const {
-    auto mesh = mesh_.lock();
-    CHECK_CONDITION(mesh->IsReady());
+std::shared_ptr<btConvexHullShape>
+Shape::GetConvexHullTriangleMesh(const Mesh* mesh) {
+    CHECK_CONDITION(mesh);
     auto& vertexData = mesh->GetVertexsData();
 
     if (vertexData.size()) {
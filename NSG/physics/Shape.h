@@ -56,13 +56,26 @@ public:
     static void SaveShapes(pugi::xml_node& node);
     const Vector3& GetScale() const { return scale_; }
     PMesh GetMesh() const { return mesh_.lock(); }
+    struct Cooked {
+        std::shared_ptr<btCollisionShape> shape_;
+        std::shared_ptr<btTriangleMesh> triMesh_;
+        BoundingBox bb_;
+    };
+    // Builds a collision shape only from its arguments, so a worker can cook
+    // it with a private mesh (see LoaderXML)
+    static Cooked Cook(PhysicsShape type, const Vector3& scale,
+                       const BoundingBox& bb, const Mesh* mesh);
+    // Takes a shape cooked by a worker. Main thread only.
+    void SetCooked(const Cooked& cooked);
 
 private:
     bool IsValid() override;
     void AllocateResources() override;
     void ReleaseResources() override;
-    void CreateTriangleMesh();
-    std::shared_ptr<btConvexHullShape> GetConvexHullTriangleMesh() const;
+    static std::shared_ptr<btTriangleMesh>
+    CreateTriangleMesh(const Mesh* mesh);
+    static std::shared_ptr<btConvexHullShape>
+    GetConvexHullTriangleMesh(const Mesh* mesh);
 
     PWeakMesh mesh_;
     BoundingBox bb_;
@@ -71,6 +84,7 @@ private:
     PhysicsShape type_;
     float margin_;
     Vector3 scale_;
+    bool cooked_;
     SignalEmpty::PSlot slotReleased_;
 };
 }
@@ -38,6 +38,7 @@ public:
     Resource(const std::string& name);
     virtual ~Resource();
     void SetBuffer(const std::string& buffer) { buffer_ = buffer; }
+    void SwapBuffer(std::string& buffer) { buffer_.swap(buffer); }
     const char* GetData() const { return buffer_.c_str(); }
     int GetBytes() const;
     void ReleaseResources() override;
@@ -38,7 +38,8 @@ extern android_app* androidApp;
 #endif
 
 ResourceFile::ResourceFile(const Path& path)
-    : Resource(path.GetFullAbsoluteFilePath()), path_(path) {
+    : Resource(path.GetFullAbsoluteFilePath()), path_(path),
+      prepared_(false) {
     EnableInvalidation();
 #if defined(EMSCRIPTEN)
     isLocal_ = false;
@@ -91,46 +92,60 @@ bool ResourceFile::IsValid() {
 }
 
 void ResourceFile::AllocateResources() {
-    if (!get_) {
+    if (!prepared_) {
+        if (!get_)
+            ReadFile(path_, buffer_);
+        DecompressFile(path_, buffer_);
+    }
+    prepared_ = false;
+}
+
+void ResourceFile::ReadFile(const Path& path, std::string& buffer) {
 #if defined(IS_TARGET_ANDROID)
-        CHECK_ASSERT(androidApp->activity->assetManager);
-        auto filename = path_.GetFilePath();
-        AAsset* pAsset =
-            AAssetManager_open(androidApp->activity->assetManager,
-                               filename.c_str(), AASSET_MODE_BUFFER);
-        if (pAsset) {
-            off_t filelength = AAsset_getLength(pAsset);
-            buffer_.resize((int)filelength);
-            AAsset_read(pAsset, &buffer_[0], filelength);
-            AAsset_close(pAsset);
-        }
+    CHECK_ASSERT(androidApp->activity->assetManager);
+    auto filename = path.GetFilePath();
+    AAsset* pAsset = AAssetManager_open(androidApp->activity->assetManager,
+                                        filename.c_str(), AASSET_MODE_BUFFER);
+    if (pAsset) {
+        off_t filelength = AAsset_getLength(pAsset);
+        buffer.resize((int)filelength);
+        AAsset_read(pAsset, &buffer[0], filelength);
+        AAsset_close(pAsset);
+    }
 #else
-        auto filename = path_.GetFullAbsoluteFilePath(); //.GetFilePath();
-        std::ifstream file(filename.c_str(), std::ios::binary);
-        if (file.is_open()) {
-            file.seekg(0, std::ios::end);
-            std::streampos filelength = file.tellg();
-            file.seekg(0, std::ios::beg);
-            buffer_.resize((int)filelength);
-            file.read(&buffer_[0], filelength);
-            CHECK_ASSERT(file.gcount() == filelength);
-            file.close();
-            LOGI("%s has been loaded with size=%u", filename.c_str(),
-                 (unsigned)buffer_.size());
-        }
+    auto filename = path.GetFullAbsoluteFilePath(); //.GetFilePath();
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (file.is_open()) {
+        file.seekg(0, std::ios::end);
+        std::streampos filelength = file.tellg();
+        file.seekg(0, std::ios::beg);
+        buffer.resize((int)filelength);
+        file.read(&buffer[0], filelength);
+        CHECK_ASSERT(file.gcount() == filelength);
+        file.close();
+        LOGI("%s has been loaded with size=%u", filename.c_str(),
+             (unsigned)buffer.size());
+    }
 #endif
-        else {
-            LOGE("Cannot load %s", filename.c_str());
-        }
+    else {
+        LOGE("Cannot load %s", filename.c_str());
     }
+}
+
+void ResourceFile::DecompressFile(const Path& path, std::string& buffer) {
+    if (path.GetExtension() == "lz4")
+        buffer = DecompressBuffer(buffer);
+}
 
-    if (path_.GetExtension() == "lz4")
-        buffer_ = DecompressBuffer(buffer_);
+void ResourceFile::SetPrepared(std::string& buffer) {
+    buffer_.swap(buffer);
+    prepared_ = true;
 }
 
 void ResourceFile::ReleaseResources() {
     LOGI("Releasing memory for file: %s", name_.c_str());
     Resource::ReleaseResources();
     get_ = nullptr;
+    prepared_ = false;
 }
 }
@@ -37,6 +37,14 @@ public:
     ~ResourceFile();
     const Path& GetPath() const { return path_; }
     void SetPath(const Path& path) { path_ = path; }
+    bool IsLocal() const { return isLocal_; }
+    // I/O and decompression stages of a local file. They only fill buffer,
+    // so a worker can run them (see LoaderXML).
+    static void ReadFile(const Path& path, std::string& buffer);
+    static void DecompressFile(const Path& path, std::string& buffer);
+    // Takes the buffer of the stages above, then AllocateResources skips
+    // them. Main thread only.
+    void SetPrepared(std::string& buffer);
 
 private:
     bool IsValid() override;
@@ -48,5 +56,6 @@ private:
     HTTPRequest::OnErrorFunction onError_;
     HTTPRequest::OnProgressFunction onProgress_;
     bool isLocal_;
+    bool prepared_;
 };
 }
\ No newline at end of file
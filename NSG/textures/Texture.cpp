@@ -47,7 +47,8 @@ Texture::Texture(const std::string& name)
       serializable_(false), wrapMode_(TextureWrapMode::CLAMP_TO_EDGE),
       mipmapLevels_(0), filterMode_(TextureFilterMode::BILINEAR),
       blendType_(TextureBlend::NONE), mapType_(TextureType::COL),
-      useAlpha_(false), uvTransform_(1, 1, 0, 0) {}
+      useAlpha_(false), uvTransform_(1, 1, 0, 0),
+      variationStamp_(NewVariationStamp()) {}
 
 Texture::Texture(PResource resource, const TextureFlags& flags)
     : Object(resource->GetName() + "Texture"),
@@ -58,7 +59,8 @@ Texture::Texture(PResource resource, const TextureFlags& flags)
       serializable_(true), wrapMode_(TextureWrapMode::CLAMP_TO_EDGE),
       mipmapLevels_(0), filterMode_(TextureFilterMode::BILINEAR),
       blendType_(TextureBlend::NONE), mapType_(TextureType::COL),
-      useAlpha_(false), uvTransform_(1, 1, 0, 0) {}
+      useAlpha_(false), uvTransform_(1, 1, 0, 0),
+      variationStamp_(NewVariationStamp()) {}
 
 Texture::~Texture() { Invalidate(); }
 
@@ -101,6 +103,8 @@ void Texture::AllocateResources() {
     if (!ctx->IsTextureSizeCorrect(width_, height_))
         GetPowerOfTwoValues(width_, height_);
 
+    auto channels = channels_;
+
     if (image_) {
         channels_ = image_->GetChannels();
         width_ = image_->GetWidth();
@@ -132,6 +136,9 @@ void Texture::AllocateResources() {
         }
     }
 
+    if (channels != channels_)
+        variationStamp_ = NewVariationStamp();
+
     if (GetTarget() == GL_TEXTURE_CUBE_MAP) {
         auto value = std::max(width_, height_);
         width_ = height_ = value;
@@ -164,14 +171,19 @@ void Texture::AllocateResources() {
 
     mipmapLevels_ = 0;
     if (flags_ & (int)TextureFlag::GENERATE_MIPMAPS) {
+        // calculate mipmap levels based on texture size
+        int levels = 0;
+        unsigned maxSize = std::max(width_, height_);
+        while (maxSize) {
+            maxSize >>= 1;
+            ++levels;
+        }
         if (!image_ || !image_->IsCompressed()) {
-            // calculate mipmap levels based on texture size
-            unsigned maxSize = std::max(width_, height_);
-            while (maxSize) {
-                maxSize >>= 1;
-                ++mipmapLevels_;
-            }
+            mipmapLevels_ = levels;
             glGenerateMipmap(GetTarget());
+        } else if (image_->GetCompressedLevels() == (unsigned)levels) {
+            // the file has all of them (see Texture2D::Define)
+            mipmapLevels_ = levels;
         }
     }
 
@@ -292,4 +304,25 @@ void Texture::SetFilterMode(TextureFilterMode mode) {
 void Texture::SetUVTransform(const Vector4& uvTransform) {
     uvTransform_ = uvTransform;
 }
+
+void Texture::SetUVName(const std::string& name) {
+    if (uvName_ != name) {
+        uvName_ = name;
+        variationStamp_ = NewVariationStamp();
+    }
+}
+
+void Texture::SetMapType(TextureType mapType) {
+    if (mapType_ != mapType) {
+        mapType_ = mapType;
+        variationStamp_ = NewVariationStamp();
+    }
+}
+
+void Texture::SetUseAlpha(bool useAlpha) {
+    if (useAlpha_ != useAlpha) {
+        useAlpha_ = useAlpha;
+        variationStamp_ = NewVariationStamp();
+    }
+}
 }
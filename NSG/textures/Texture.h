@@ -46,20 +46,22 @@ public:
     void SetWrapMode(TextureWrapMode mode);
     void SetFilterMode(TextureFilterMode mode);
     PResource GetResource() const { return pResource_; }
+    PImage GetImage() const { return image_; }
     void SetSize(GLsizei width, GLsizei height);
     void SetName(const std::string& name) { name_ = name; }
-    void SetUVName(const std::string& name) { uvName_ = name; }
+    void SetUVName(const std::string& name);
     const std::string& GetUVName() const { return uvName_; }
     std::string TranslateFlags() const;
     void SetBlendType(TextureBlend blendType) { blendType_ = blendType; }
     TextureBlend GetBlendType() const { return blendType_; }
-    void SetMapType(TextureType mapType) { mapType_ = mapType; }
+    void SetMapType(TextureType mapType);
     TextureType GetMapType() const { return mapType_; }
     int GetChannels() const { return channels_; }
     virtual GLenum GetTarget() const = 0;
     virtual void Define() = 0;
-    void SetUseAlpha(bool useAlpha) { useAlpha_ = useAlpha; }
+    void SetUseAlpha(bool useAlpha);
     bool GetUseAlpha() const { return useAlpha_; }
+    unsigned GetVariationStamp() const { return variationStamp_; }
     const Vector4& GetUVTransform() const { return uvTransform_; };
     void SetUVTransform(const Vector4& uvTransform);
 
@@ -91,5 +93,6 @@ protected:
     TextureType mapType_;
     bool useAlpha_;
     Vector4 uvTransform_;
+    unsigned variationStamp_; // changes with state affecting shader defines
 };
 }
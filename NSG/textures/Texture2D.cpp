@@ -74,9 +74,13 @@ void Texture2D::Define() {
     CHECK_GL_STATUS();
 
     if (image_ && image_->IsCompressed()) {
-        glCompressedTexImage2D(GL_TEXTURE_2D, 0, format_, width_, height_, 0,
-                               image_->GetCompressedDataSize(),
-                               image_->GetData());
+        // the mip levels of the file are not generated by GL
+        for (unsigned i = 0; i < image_->GetCompressedLevels(); i++) {
+            auto level = image_->GetCompressedLevel(i);
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, format_, level.width_,
+                                   level.height_, 0, level.dataSize_,
+                                   level.data_);
+        }
     } else if (image_) {
         glTexImage2D(GL_TEXTURE_2D, 0, format_, width_, height_, 0, format_,
                      type_, image_->GetData());
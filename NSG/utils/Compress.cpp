@@ -0,0 +1,618 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Compress.h"
+#include "Check.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Block encoders for the layouts that Decompress.cpp decodes.
+
+namespace NSG {
+// Same modifiers as the ETC1 decoder
+static const int MODIFIERS_ETC[8][4] = {
+    {2, 8, -2, -8},     {5, 17, -5, -17},   {9, 29, -9, -29},
+    {13, 42, -13, -42}, {18, 60, -18, -60}, {24, 80, -24, -80},
+    {33, 106, -33, -106}, {47, 183, -47, -183}};
+
+struct BlockPixels {
+    int rgba[16][4]; // 4 * y + x
+};
+
+// Pixels outside of the image repeat the last row or column
+static void ReadBlock(const unsigned char* rgba, int width, int height, int x,
+                      int y, BlockPixels& block) {
+    for (int py = 0; py < 4; ++py) {
+        int sy = std::min(y + py, height - 1);
+        for (int px = 0; px < 4; ++px) {
+            int sx = std::min(x + px, width - 1);
+            auto pixel = rgba + 4 * ((size_t)width * sy + sx);
+            for (int c = 0; c < 4; ++c)
+                block.rgba[4 * py + px][c] = pixel[c];
+        }
+    }
+}
+
+static inline int Distance(const int* a, const int* b) {
+    int r = a[0] - b[0];
+    int g = a[1] - b[1];
+    int bl = a[2] - b[2];
+    return r * r + g * g + bl * bl;
+}
+
+static inline int Quantize(float value, int bits) {
+    int max = (1 << bits) - 1;
+    return (int)(std::min(std::max(value, 0.f), 255.f) * max / 255 + 0.5f);
+}
+
+static inline int Expand5(int value) { return (value << 3) | (value >> 2); }
+
+static inline int Expand6(int value) { return (value << 2) | (value >> 4); }
+
+static uint16_t To565(const float colour[3]) {
+    return (uint16_t)((Quantize(colour[0], 5) << 11) |
+                      (Quantize(colour[1], 6) << 5) | Quantize(colour[2], 5));
+}
+
+// Same colours as DecompressColourDXT
+static void PaletteDXT(uint16_t a, uint16_t b, bool fourColours,
+                       int palette[4][3]) {
+    int c[2][3];
+    for (int i = 0; i < 2; ++i) {
+        int value = i ? b : a;
+        c[i][0] = Expand5((value >> 11) & 0x1f);
+        c[i][1] = Expand6((value >> 5) & 0x3f);
+        c[i][2] = Expand5(value & 0x1f);
+    }
+    for (int k = 0; k < 3; ++k) {
+        palette[0][k] = c[0][k];
+        palette[1][k] = c[1][k];
+        if (fourColours) {
+            palette[2][k] = (2 * c[0][k] + c[1][k]) / 3;
+            palette[3][k] = (c[0][k] + 2 * c[1][k]) / 3;
+        } else {
+            palette[2][k] = (c[0][k] + c[1][k]) / 2;
+            palette[3][k] = 0;
+        }
+    }
+}
+
+struct ColourFit {
+    uint16_t a;
+    uint16_t b;
+    unsigned char indices[16];
+    int error;
+};
+
+// The nearest palette colour of each pixel. In the three colours mode of
+// DXT1 the index 3 (transparent black) is kept for the transparent pixels.
+static void FitIndicesDXT(const BlockPixels& block, uint16_t a, uint16_t b,
+                          bool isDxt1, unsigned transparent, ColourFit& fit) {
+    bool fourColours = !isDxt1 || a > b;
+    int palette[4][3];
+    PaletteDXT(a, b, fourColours, palette);
+    int colours = fourColours ? 4 : 3;
+    fit.a = a;
+    fit.b = b;
+    fit.error = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (transparent & (1 << i)) {
+            fit.indices[i] = 3;
+            continue;
+        }
+        int best = INT_MAX;
+        for (int j = 0; j < colours; ++j) {
+            int error = Distance(block.rgba[i], palette[j]);
+            if (error < best) {
+                best = error;
+                fit.indices[i] = (unsigned char)j;
+            }
+        }
+        fit.error += best;
+    }
+}
+
+static void TryEndPointsDXT(const BlockPixels& block, const float start[3],
+                            const float end[3], bool isDxt1,
+                            unsigned transparent, bool threeColours,
+                            ColourFit& best) {
+    uint16_t a = To565(start);
+    uint16_t b = To565(end);
+    // a > b selects the four colours mode in DXT1
+    if (threeColours ? a > b : a < b)
+        std::swap(a, b);
+    ColourFit fit;
+    FitIndicesDXT(block, a, b, isDxt1, transparent, fit);
+    if (fit.error < best.error)
+        best = fit;
+}
+
+// End points that minimize the error of the current indices
+static bool LeastSquaresDXT(const BlockPixels& block, const ColourFit& fit,
+                            bool isDxt1, unsigned transparent, float start[3],
+                            float end[3]) {
+    static const float WEIGHTS4[4] = {1, 0, 2.f / 3, 1.f / 3};
+    static const float WEIGHTS3[4] = {1, 0, 0.5f, 0};
+    auto weights = !isDxt1 || fit.a > fit.b ? WEIGHTS4 : WEIGHTS3;
+    float aa = 0, ab = 0, bb = 0;
+    float ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; ++i) {
+        if (transparent & (1 << i))
+            continue;
+        float alpha = weights[fit.indices[i]];
+        float beta = 1 - alpha;
+        aa += alpha * alpha;
+        ab += alpha * beta;
+        bb += beta * beta;
+        for (int c = 0; c < 3; ++c) {
+            ax[c] += alpha * block.rgba[i][c];
+            bx[c] += beta * block.rgba[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f)
+        return false;
+    for (int c = 0; c < 3; ++c) {
+        start[c] = (ax[c] * bb - bx[c] * ab) / det;
+        end[c] = (bx[c] * aa - ax[c] * ab) / det;
+    }
+    return true;
+}
+
+// Extremes of the opaque pixels along their principal axis
+static void PrincipalEndPoints(const BlockPixels& block, unsigned transparent,
+                               int iterations, float start[3], float end[3]) {
+    float mean[3] = {};
+    int count = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (transparent & (1 << i))
+            continue;
+        for (int c = 0; c < 3; ++c)
+            mean[c] += block.rgba[i][c];
+        ++count;
+    }
+    for (int c = 0; c < 3; ++c)
+        mean[c] /= count;
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; ++i) {
+        if (transparent & (1 << i))
+            continue;
+        float d[3];
+        for (int c = 0; c < 3; ++c)
+            d[c] = block.rgba[i][c] - mean[c];
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c)
+                covariance[r][c] += d[r] * d[c];
+    }
+    // power iteration from the row of the largest variance
+    int row = 0;
+    for (int c = 1; c < 3; ++c)
+        if (covariance[c][c] > covariance[row][row])
+            row = c;
+    float axis[3] = {covariance[row][0], covariance[row][1],
+                     covariance[row][2]};
+    for (int it = 0; it < iterations; ++it) {
+        float next[3];
+        for (int r = 0; r < 3; ++r)
+            next[r] = covariance[r][0] * axis[0] + covariance[r][1] * axis[1] +
+                      covariance[r][2] * axis[2];
+        float length = std::max({std::abs(next[0]), std::abs(next[1]),
+                                 std::abs(next[2])});
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; ++c)
+            axis[c] = next[c] / length;
+    }
+    float length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float minT = 0, maxT = 0;
+    if (length2 > 1e-6f) {
+        minT = INFINITY;
+        maxT = -INFINITY;
+        for (int i = 0; i < 16; ++i) {
+            if (transparent & (1 << i))
+                continue;
+            float t = 0;
+            for (int c = 0; c < 3; ++c)
+                t += (block.rgba[i][c] - mean[c]) * axis[c];
+            minT = std::min(minT, t / length2);
+            maxT = std::max(maxT, t / length2);
+        }
+    }
+    for (int c = 0; c < 3; ++c) {
+        start[c] = mean[c] + axis[c] * maxT;
+        end[c] = mean[c] + axis[c] * minT;
+    }
+}
+
+static void EncodeColourDXT(const BlockPixels& block, bool isDxt1,
+                            CompressQuality quality, unsigned char* out) {
+    unsigned transparent = 0;
+    if (isDxt1)
+        for (int i = 0; i < 16; ++i)
+            if (block.rgba[i][3] < 128)
+                transparent |= 1 << i;
+
+    ColourFit best;
+    if (transparent == 0xffff) {
+        best.a = best.b = 0;
+        memset(best.indices, 3, sizeof(best.indices));
+    } else {
+        best.error = INT_MAX;
+        bool threeColours = transparent != 0;
+        float start[3], end[3];
+        PrincipalEndPoints(block, transparent,
+                           quality == CompressQuality::FAST ? 1 : 8, start,
+                           end);
+        TryEndPointsDXT(block, start, end, isDxt1, transparent, threeColours,
+                        best);
+        if (isDxt1 && !threeColours && quality == CompressQuality::HIGH)
+            TryEndPointsDXT(block, start, end, isDxt1, transparent, true,
+                            best);
+        int iterations = quality == CompressQuality::FAST
+                             ? 0
+                             : quality == CompressQuality::NORMAL ? 1 : 8;
+        for (int it = 0; it < iterations && best.error; ++it) {
+            if (!LeastSquaresDXT(block, best, isDxt1, transparent, start, end))
+                break;
+            int error = best.error;
+            TryEndPointsDXT(block, start, end, isDxt1, transparent,
+                            isDxt1 && best.a <= best.b, best);
+            if (best.error >= error)
+                break;
+        }
+    }
+
+    out[0] = (unsigned char)(best.a & 0xff);
+    out[1] = (unsigned char)(best.a >> 8);
+    out[2] = (unsigned char)(best.b & 0xff);
+    out[3] = (unsigned char)(best.b >> 8);
+    for (int row = 0; row < 4; ++row) {
+        auto indices = best.indices + 4 * row;
+        out[4 + row] = (unsigned char)(indices[0] | (indices[1] << 2) |
+                                       (indices[2] << 4) | (indices[3] << 6));
+    }
+}
+
+static void EncodeAlphaDXT3(const BlockPixels& block, unsigned char* out) {
+    for (int i = 0; i < 8; ++i) {
+        int lo = (block.rgba[2 * i][3] * 15 + 127) / 255;
+        int hi = (block.rgba[2 * i + 1][3] * 15 + 127) / 255;
+        out[i] = (unsigned char)(lo | (hi << 4));
+    }
+}
+
+// Same codes as DecompressAlphaDXT5
+static int FitAlphaDXT5(const BlockPixels& block, int alpha0, int alpha1,
+                        unsigned char indices[16]) {
+    int codes[8] = {alpha0, alpha1};
+    if (alpha0 <= alpha1) {
+        for (int i = 1; i < 5; ++i)
+            codes[1 + i] = ((5 - i) * alpha0 + i * alpha1) / 5;
+        codes[6] = 0;
+        codes[7] = 255;
+    } else {
+        for (int i = 1; i < 7; ++i)
+            codes[1 + i] = ((7 - i) * alpha0 + i * alpha1) / 7;
+    }
+    int error = 0;
+    for (int i = 0; i < 16; ++i) {
+        int best = INT_MAX;
+        for (int j = 0; j < 8; ++j) {
+            int d = block.rgba[i][3] - codes[j];
+            if (d * d < best) {
+                best = d * d;
+                indices[i] = (unsigned char)j;
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+static void EncodeAlphaDXT5(const BlockPixels& block, CompressQuality quality,
+                            unsigned char* out) {
+    int minAlpha = 255, maxAlpha = 0;
+    // range without 0 and 255 for the six codes mode
+    int minInner = 255, maxInner = 0;
+    for (int i = 0; i < 16; ++i) {
+        int alpha = block.rgba[i][3];
+        minAlpha = std::min(minAlpha, alpha);
+        maxAlpha = std::max(maxAlpha, alpha);
+        if (alpha != 0 && alpha != 255) {
+            minInner = std::min(minInner, alpha);
+            maxInner = std::max(maxInner, alpha);
+        }
+    }
+    int alpha0 = maxAlpha;
+    int alpha1 = minAlpha;
+    unsigned char indices[16];
+    int error = FitAlphaDXT5(block, alpha0, alpha1, indices);
+    if (error && quality != CompressQuality::FAST) {
+        if (minInner > maxInner)
+            minInner = maxInner = minAlpha;
+        unsigned char innerIndices[16];
+        if (FitAlphaDXT5(block, minInner, maxInner, innerIndices) < error) {
+            alpha0 = minInner;
+            alpha1 = maxInner;
+            memcpy(indices, innerIndices, sizeof(indices));
+        }
+    }
+    out[0] = (unsigned char)alpha0;
+    out[1] = (unsigned char)alpha1;
+    uint64_t bits = 0; // 16 x 3 bits
+    for (int i = 0; i < 16; ++i)
+        bits |= (uint64_t)indices[i] << (3 * i);
+    for (int i = 0; i < 6; ++i)
+        out[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+struct SubblockETC {
+    int base[3]; // quantized
+    int table;
+    unsigned char modifiers[8];
+    int error;
+};
+
+// Best table and modifiers of the eight pixels for an expanded base colour
+static void FitSubblockETC(const BlockPixels& block, const int pixels[8],
+                           const int base[3], SubblockETC& fit) {
+    fit.error = INT_MAX;
+    for (int table = 0; table < 8; ++table) {
+        unsigned char modifiers[8];
+        int error = 0;
+        for (int p = 0; p < 8 && error < fit.error; ++p) {
+            int best = INT_MAX;
+            for (int m = 0; m < 4; ++m) {
+                int modifier = MODIFIERS_ETC[table][m];
+                int colour[3];
+                for (int c = 0; c < 3; ++c)
+                    colour[c] = std::min(std::max(base[c] + modifier, 0), 255);
+                int d = Distance(block.rgba[pixels[p]], colour);
+                if (d < best) {
+                    best = d;
+                    modifiers[p] = (unsigned char)m;
+                }
+            }
+            error += best;
+        }
+        if (error < fit.error) {
+            fit.error = error;
+            fit.table = table;
+            memcpy(fit.modifiers, modifiers, sizeof(modifiers));
+        }
+    }
+}
+
+static inline int ExpandETC(int value, int bits) {
+    return bits == 4 ? value * 17 : Expand5(value);
+}
+
+// Steps from the quantized average tried by the search of base colours:
+// each channel alone and the brightness
+static const int STEPS_ETC[9][3] = {{0, 0, 0},  {1, 0, 0},  {-1, 0, 0},
+                                    {0, 1, 0},  {0, -1, 0}, {0, 0, 1},
+                                    {0, 0, -1}, {1, 1, 1},  {-1, -1, -1}};
+
+// The best base colour near the quantized average (just the average if not
+// search). Each channel of the candidates is limited by minimum and maximum,
+// that differential mode uses to keep the deltas in range.
+// Returns false if the average was out of the limits.
+static bool SearchBaseETC(const BlockPixels& block, const int pixels[8],
+                          int bits, bool search, const int minimum[3],
+                          const int maximum[3], SubblockETC& best) {
+    float average[3] = {};
+    for (int p = 0; p < 8; ++p)
+        for (int c = 0; c < 3; ++c)
+            average[c] += block.rgba[pixels[p]][c] / 8.f;
+    int centre[3];
+    bool inside = true;
+    for (int c = 0; c < 3; ++c) {
+        int value = Quantize(average[c], bits);
+        centre[c] = std::min(std::max(value, minimum[c]), maximum[c]);
+        inside = inside && centre[c] == value;
+    }
+    best.error = INT_MAX;
+    int steps = search ? 9 : 1;
+    for (int step = 0; step < steps; ++step) {
+        int base[3];
+        bool valid = true;
+        for (int c = 0; c < 3; ++c) {
+            base[c] = centre[c] + STEPS_ETC[step][c];
+            valid = valid && base[c] >= minimum[c] && base[c] <= maximum[c];
+        }
+        if (!valid)
+            continue;
+        int expanded[3];
+        for (int c = 0; c < 3; ++c)
+            expanded[c] = ExpandETC(base[c], bits);
+        SubblockETC fit;
+        FitSubblockETC(block, pixels, expanded, fit);
+        if (fit.error < best.error) {
+            best = fit;
+            memcpy(best.base, base, sizeof(base));
+        }
+    }
+    return inside;
+}
+
+struct BlockFitETC {
+    SubblockETC subblocks[2];
+    bool flip;
+    bool differential;
+    bool clamped; // a delta of the differential mode was out of range
+    int error;
+};
+
+static void EncodeModeETC(const BlockPixels& block, const int pixels[2][8],
+                          bool flip, bool differential, bool search,
+                          BlockFitETC& best) {
+    int bits = differential ? 5 : 4;
+    int max = (1 << bits) - 1;
+    const int minimum[3] = {0, 0, 0};
+    const int maximum[3] = {max, max, max};
+    BlockFitETC fit;
+    fit.flip = flip;
+    fit.differential = differential;
+    fit.clamped = false;
+    SearchBaseETC(block, pixels[0], bits, search, minimum, maximum,
+                  fit.subblocks[0]);
+    if (differential) {
+        // the second base is the first one plus a delta in [-4, 3]
+        int low[3], high[3];
+        for (int c = 0; c < 3; ++c) {
+            low[c] = std::max(fit.subblocks[0].base[c] - 4, 0);
+            high[c] = std::min(fit.subblocks[0].base[c] + 3, max);
+        }
+        fit.clamped = !SearchBaseETC(block, pixels[1], bits, search, low,
+                                     high, fit.subblocks[1]);
+    } else {
+        SearchBaseETC(block, pixels[1], bits, search, minimum, maximum,
+                      fit.subblocks[1]);
+    }
+    fit.error = fit.subblocks[0].error + fit.subblocks[1].error;
+    if (fit.error < best.error)
+        best = fit;
+}
+
+static void EncodeETC(const BlockPixels& block, CompressQuality quality,
+                      unsigned char* out) {
+    BlockFitETC best;
+    best.error = INT_MAX;
+    bool search = quality == CompressQuality::HIGH;
+    for (int flip = 0; flip < 2; ++flip) {
+        // pixels of each subblock: columns 0-1 and 2-3, or rows if flipped
+        int pixels[2][8];
+        int count[2] = {};
+        for (int y = 0; y < 4; ++y) {
+            for (int x = 0; x < 4; ++x) {
+                int subblock = flip ? y >= 2 : x >= 2;
+                pixels[subblock][count[subblock]++] = 4 * y + x;
+            }
+        }
+        EncodeModeETC(block, pixels, flip != 0, true, search, best);
+        if (best.clamped || quality != CompressQuality::FAST)
+            EncodeModeETC(block, pixels, flip != 0, false, search, best);
+    }
+
+    auto& first = best.subblocks[0];
+    auto& second = best.subblocks[1];
+    uint32_t top = ((uint32_t)first.table << 29) |
+                   ((uint32_t)second.table << 26);
+    if (best.flip)
+        top |= 0x01000000;
+    if (best.differential) {
+        top |= 0x02000000;
+        top |= (first.base[0] << 3) | ((second.base[0] - first.base[0]) & 7);
+        top |= (first.base[1] << 11) |
+               (((second.base[1] - first.base[1]) & 7) << 8);
+        top |= (first.base[2] << 19) |
+               (((second.base[2] - first.base[2]) & 7) << 16);
+    } else {
+        top |= (first.base[0] << 4) | second.base[0];
+        top |= (first.base[1] << 12) | (second.base[1] << 8);
+        top |= (first.base[2] << 20) | (second.base[2] << 16);
+    }
+    // modifier bits by columns, as the decoder reads them
+    uint32_t bottom = 0;
+    int count[2] = {};
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            int subblock = best.flip ? y >= 2 : x >= 2;
+            uint32_t modifier =
+                best.subblocks[subblock].modifiers[count[subblock]++];
+            int index = x * 4 + y;
+            if (index < 8)
+                bottom |= ((modifier & 1) << (index + 24)) |
+                          ((modifier >> 1) << (index + 8));
+            else
+                bottom |= ((modifier & 1) << (index + 8)) |
+                          ((modifier >> 1) << (index - 8));
+        }
+    }
+    memcpy(out, &top, sizeof(top));
+    memcpy(out + 4, &bottom, sizeof(bottom));
+}
+
+static size_t BytesPerBlock(TextureFormat format) {
+    switch (format) {
+    case TextureFormat::DXT1:
+    case TextureFormat::ETC1:
+        return 8;
+    case TextureFormat::DXT3:
+    case TextureFormat::DXT5:
+        return 16;
+    default:
+        CHECK_CONDITION(!"Cannot compress to this format!!!");
+        return 0;
+    }
+}
+
+size_t GetCompressedImageSize(int width, int height, TextureFormat format) {
+    return BytesPerBlock(format) * ((width + 3) / 4) * ((height + 3) / 4);
+}
+
+void CompressImage(unsigned char* blocks, const unsigned char* rgba,
+                   int width, int height, TextureFormat format,
+                   CompressQuality quality) {
+    auto bytesPerBlock = BytesPerBlock(format);
+    int blocksX = (width + 3) / 4;
+    size_t rows = (height + 3) / 4;
+    auto encodeRows = [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            for (int x = 0; x < blocksX; ++x) {
+                BlockPixels block;
+                ReadBlock(rgba, width, height, 4 * x, 4 * (int)row, block);
+                auto out = blocks + (row * blocksX + x) * bytesPerBlock;
+                switch (format) {
+                case TextureFormat::DXT1:
+                    EncodeColourDXT(block, true, quality, out);
+                    break;
+                case TextureFormat::DXT3:
+                    EncodeAlphaDXT3(block, out);
+                    EncodeColourDXT(block, false, quality, out + 8);
+                    break;
+                case TextureFormat::DXT5:
+                    EncodeAlphaDXT5(block, quality, out);
+                    EncodeColourDXT(block, false, quality, out + 8);
+                    break;
+                default:
+                    EncodeETC(block, quality, out);
+                    break;
+                }
+            }
+        }
+    };
+    // a row of blocks is already a good amount of work
+    auto jobs = Task::JobSystem::GetPtr();
+    if (jobs)
+        jobs->ParallelFor(rows, 1, encodeRows);
+    else if (rows)
+        encodeRows(0, rows);
+}
+}
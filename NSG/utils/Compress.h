@@ -0,0 +1,45 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Types.h"
+#include <cstddef>
+namespace NSG {
+enum class CompressQuality {
+    FAST,   // end points from the colour axis
+    NORMAL, // also least squares end points and both ETC1 modes
+    HIGH    // refines until the error stops improving
+};
+
+// Bytes of the blocks of a width x height image (DXT1, DXT3, DXT5 or ETC1)
+size_t GetCompressedImageSize(int width, int height, TextureFormat format);
+
+// Encodes width x height RGBA pixels (4 bytes per pixel) into blocks that
+// DecompressImageDXT/ETC decode. Rows of blocks are encoded in parallel by
+// the job system (if any).
+void CompressImage(unsigned char* blocks, const unsigned char* rgba,
+                   int width, int height, TextureFormat format,
+                   CompressQuality quality);
+}
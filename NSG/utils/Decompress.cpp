@@ -21,8 +21,17 @@
 //
 
 #include "Decompress.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NSG_DECOMPRESS_SSE2
+#endif
+
 // DXT decompression based on the Squish library, modified for Urho3D
 
 // NSG-library: changed all (unsigned long) to (unsigned int): this is because
@@ -208,8 +217,9 @@ static void DecompressDXT(unsigned char* rgba, const void* block,
         DecompressAlphaDXT5(rgba, alphaBock);
 }
 
-void DecompressImageDXT(unsigned char* rgba, const void* blocks, int width,
-                        int height, int depth, TextureFormat format) {
+void DecompressImageDXTReference(unsigned char* rgba, const void* blocks,
+                                 int width, int height, int depth,
+                                 TextureFormat format) {
     // initialise the block input
     unsigned char const* sourceBlock =
         reinterpret_cast<unsigned char const*>(blocks);
@@ -385,8 +395,8 @@ static void DecompressETC(unsigned char* pDestData, const void* pSrcData) {
     }
 }
 
-void DecompressImageETC(unsigned char* rgba, const void* blocks, int width,
-                        int height) {
+void DecompressImageETCReference(unsigned char* rgba, const void* blocks,
+                                 int width, int height) {
     // initialise the block input
     unsigned char const* sourceBlock =
         reinterpret_cast<unsigned char const*>(blocks);
@@ -735,8 +745,10 @@ static unsigned TwiddleUV(unsigned YSize, unsigned XSize, unsigned YPos,
     return Twiddled;
 }
 
-void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width,
-                          int height, TextureFormat format) {
+// Decodes the rows [yBegin, yEnd) of the image
+static void DecompressRowsPVRTC(unsigned char* dest, const void* blocks,
+                                int width, int height, TextureFormat format,
+                                int yBegin, int yEnd) {
     AMTC_BLOCK_STRUCT* pCompressedData = (AMTC_BLOCK_STRUCT*)blocks;
     int AssumeImageTiles = 1;
     int Do2bitMode = format == TextureFormat::PVRTC_RGB_2BPP ||
@@ -788,7 +800,7 @@ void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width,
     // Step through the pixels of the image decompressing each one in turn
     //
     // Note that this is a hideously inefficient way to do this!
-    for (y = 0; y < height; y++) {
+    for (y = yBegin; y < yEnd; y++) {
         for (x = 0; x < width; x++) {
             // Map this pixel to the top left neighbourhood of blocks
             BlkX = (x - XBlockSize / 2);
@@ -872,4 +884,346 @@ void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width,
         }
     }
 }
+
+void DecompressImagePVRTCReference(unsigned char* dest, const void* blocks,
+                                   int width, int height,
+                                   TextureFormat format) {
+    DecompressRowsPVRTC(dest, blocks, width, height, format, 0, height);
+}
+
+// Decoders by rows of blocks, run in parallel by the job system.
+// The pixels are written as little endian words, as DecompressETC does.
+
+static const size_t PIXELS_PER_JOB = 64 * 1024;
+
+static void ForEachRows(size_t rows, size_t pixelsPerRow,
+                        const Task::JobSystem::RangeFunction& function) {
+    auto jobs = Task::JobSystem::GetPtr();
+    if (jobs)
+        jobs->ParallelFor(
+            rows, std::max<size_t>(1, PIXELS_PER_JOB / pixelsPerRow),
+            function);
+    else if (rows)
+        function(0, rows);
+}
+
+static void StoreBlock(unsigned char* rgba, int width, int height, int x,
+                       int y, const uint32_t pixels[16]) {
+    int columns = std::min(4, width - x);
+    int rows = std::min(4, height - y);
+    for (int py = 0; py < rows; ++py)
+        memcpy(rgba + 4 * ((size_t)width * (y + py) + x), pixels + 4 * py,
+               4 * columns);
+}
+
+static inline uint32_t PackRGBA(int r, int g, int b, int a) {
+    return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) |
+           ((uint32_t)a << 24);
+}
+
+static const int PALETTE_BLOCKS = 8;
+
+// The four colours of PALETTE_BLOCKS colour blocks given their 565 end
+// points a and b. Same values as DecompressColourDXT.
+static void ColourPalettesDXT(const uint16_t* a, const uint16_t* b,
+                              bool isDxt1,
+                              uint32_t palettes[4][PALETTE_BLOCKS]) {
+#if defined(NSG_DECOMPRESS_SSE2)
+    // a channel of the eight blocks per vector, 16 bits per value
+    auto expand5 = [](__m128i v) {
+        v = _mm_and_si128(v, _mm_set1_epi16(0x1f));
+        return _mm_or_si128(_mm_slli_epi16(v, 3), _mm_srli_epi16(v, 2));
+    };
+    auto expand6 = [](__m128i v) {
+        v = _mm_and_si128(v, _mm_set1_epi16(0x3f));
+        return _mm_or_si128(_mm_slli_epi16(v, 2), _mm_srli_epi16(v, 4));
+    };
+    // v / 3 == (v * 0xAAAB) >> 17 for v < 98304
+    auto third = [](__m128i v) {
+        return _mm_srli_epi16(
+            _mm_mulhi_epu16(v, _mm_set1_epi16((short)0xAAAB)), 1);
+    };
+    auto va = _mm_loadu_si128((const __m128i*)a);
+    auto vb = _mm_loadu_si128((const __m128i*)b);
+    __m128i c[4][4]; // colour, channel
+    c[0][0] = expand5(_mm_srli_epi16(va, 11));
+    c[0][1] = expand6(_mm_srli_epi16(va, 5));
+    c[0][2] = expand5(va);
+    c[1][0] = expand5(_mm_srli_epi16(vb, 11));
+    c[1][1] = expand6(_mm_srli_epi16(vb, 5));
+    c[1][2] = expand5(vb);
+    auto zero = _mm_setzero_si128();
+    auto opaque = _mm_set1_epi16(255);
+    // a <= b in DXT1 selects the three colours mode
+    auto three =
+        isDxt1 ? _mm_cmpeq_epi16(_mm_subs_epu16(va, vb), zero) : zero;
+    for (int i = 0; i < 3; ++i) {
+        auto c0 = c[0][i];
+        auto c1 = c[1][i];
+        auto half = _mm_srli_epi16(_mm_add_epi16(c0, c1), 1);
+        auto twoThirds = third(_mm_add_epi16(_mm_add_epi16(c0, c0), c1));
+        auto oneThird = third(_mm_add_epi16(c0, _mm_add_epi16(c1, c1)));
+        c[2][i] = _mm_or_si128(_mm_and_si128(three, half),
+                               _mm_andnot_si128(three, twoThirds));
+        c[3][i] = _mm_andnot_si128(three, oneThird);
+    }
+    c[0][3] = c[1][3] = c[2][3] = opaque;
+    c[3][3] = _mm_andnot_si128(three, opaque);
+    for (int j = 0; j < 4; ++j) {
+        auto rg = _mm_or_si128(c[j][0], _mm_slli_epi16(c[j][1], 8));
+        auto ba = _mm_or_si128(c[j][2], _mm_slli_epi16(c[j][3], 8));
+        _mm_storeu_si128((__m128i*)palettes[j], _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i*)(palettes[j] + 4),
+                         _mm_unpackhi_epi16(rg, ba));
+    }
+#else
+    for (int k = 0; k < PALETTE_BLOCKS; ++k) {
+        int c[2][3];
+        for (int i = 0; i < 2; ++i) {
+            int value = i ? b[k] : a[k];
+            int red = (value >> 11) & 0x1f;
+            int green = (value >> 5) & 0x3f;
+            int blue = value & 0x1f;
+            c[i][0] = (red << 3) | (red >> 2);
+            c[i][1] = (green << 2) | (green >> 4);
+            c[i][2] = (blue << 3) | (blue >> 2);
+        }
+        palettes[0][k] = PackRGBA(c[0][0], c[0][1], c[0][2], 255);
+        palettes[1][k] = PackRGBA(c[1][0], c[1][1], c[1][2], 255);
+        if (isDxt1 && a[k] <= b[k]) {
+            palettes[2][k] = PackRGBA((c[0][0] + c[1][0]) / 2,
+                                      (c[0][1] + c[1][1]) / 2,
+                                      (c[0][2] + c[1][2]) / 2, 255);
+            palettes[3][k] = 0;
+        } else {
+            palettes[2][k] = PackRGBA((2 * c[0][0] + c[1][0]) / 3,
+                                      (2 * c[0][1] + c[1][1]) / 3,
+                                      (2 * c[0][2] + c[1][2]) / 3, 255);
+            palettes[3][k] = PackRGBA((c[0][0] + 2 * c[1][0]) / 3,
+                                      (c[0][1] + 2 * c[1][1]) / 3,
+                                      (c[0][2] + 2 * c[1][2]) / 3, 255);
+        }
+    }
+#endif
+}
+
+// Same values as DecompressAlphaDXT3, in the alpha bits of the pixels
+static void AlphaDXT3(uint32_t alphas[16], const unsigned char* bytes) {
+    for (int i = 0; i < 8; ++i) {
+        uint32_t lo = bytes[i] & 0x0f;
+        uint32_t hi = bytes[i] & 0xf0;
+        alphas[2 * i] = (lo | (lo << 4)) << 24;
+        alphas[2 * i + 1] = (hi | (hi >> 4)) << 24;
+    }
+}
+
+// Same values as DecompressAlphaDXT5, in the alpha bits of the pixels
+static void AlphaDXT5(uint32_t alphas[16], const unsigned char* bytes) {
+    int alpha0 = bytes[0];
+    int alpha1 = bytes[1];
+    uint32_t codes[8] = {(uint32_t)alpha0, (uint32_t)alpha1};
+    if (alpha0 <= alpha1) {
+        for (int i = 1; i < 5; ++i)
+            codes[1 + i] = ((5 - i) * alpha0 + i * alpha1) / 5;
+        codes[6] = 0;
+        codes[7] = 255;
+    } else {
+        for (int i = 1; i < 7; ++i)
+            codes[1 + i] = ((7 - i) * alpha0 + i * alpha1) / 7;
+    }
+    uint64_t indices = 0; // 16 x 3 bits
+    for (int i = 0; i < 6; ++i)
+        indices |= (uint64_t)bytes[2 + i] << (8 * i);
+    for (int i = 0; i < 16; ++i)
+        alphas[i] = codes[(indices >> (3 * i)) & 7] << 24;
+}
+
+// Rows of blocks [rowBegin, rowEnd), all the slices one after the other
+static void DecompressRowsDXT(unsigned char* rgba,
+                              const unsigned char* blocks, int width,
+                              int height, TextureFormat format,
+                              size_t rowBegin, size_t rowEnd) {
+    bool isDxt1 = format == TextureFormat::DXT1;
+    int bytesPerBlock = isDxt1 ? 8 : 16;
+    int colourOffset = isDxt1 ? 0 : 8;
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    for (size_t row = rowBegin; row < rowEnd; ++row) {
+        auto slice = rgba + (size_t)width * height * 4 * (row / blocksY);
+        int y = 4 * (int)(row % blocksY);
+        auto rowBlocks = blocks + row * blocksX * bytesPerBlock;
+        for (int first = 0; first < blocksX; first += PALETTE_BLOCKS) {
+            int count = std::min(PALETTE_BLOCKS, blocksX - first);
+            uint16_t a[PALETTE_BLOCKS] = {};
+            uint16_t b[PALETTE_BLOCKS] = {};
+            for (int k = 0; k < count; ++k) {
+                auto colour =
+                    rowBlocks + (first + k) * bytesPerBlock + colourOffset;
+                a[k] = (uint16_t)(colour[0] | (colour[1] << 8));
+                b[k] = (uint16_t)(colour[2] | (colour[3] << 8));
+            }
+            uint32_t palettes[4][PALETTE_BLOCKS];
+            ColourPalettesDXT(a, b, isDxt1, palettes);
+            for (int k = 0; k < count; ++k) {
+                auto block = rowBlocks + (first + k) * bytesPerBlock;
+                auto indices = block + colourOffset + 4;
+                uint32_t pixels[16];
+                for (int i = 0; i < 16; ++i)
+                    pixels[i] =
+                        palettes[(indices[i / 4] >> (2 * (i % 4))) & 3][k];
+                if (!isDxt1) {
+                    uint32_t alphas[16];
+                    if (format == TextureFormat::DXT3)
+                        AlphaDXT3(alphas, block);
+                    else
+                        AlphaDXT5(alphas, block);
+                    for (int i = 0; i < 16; ++i)
+                        pixels[i] = (pixels[i] & 0x00ffffff) | alphas[i];
+                }
+                StoreBlock(slice, width, height, 4 * (first + k), y, pixels);
+            }
+        }
+    }
+}
+
+void DecompressImageDXT(unsigned char* rgba, const void* blocks, int width,
+                        int height, int depth, TextureFormat format) {
+    auto source = reinterpret_cast<unsigned char const*>(blocks);
+    size_t rows = (size_t)depth * ((height + 3) / 4);
+    ForEachRows(rows, 4 * (size_t)width, [&](size_t begin, size_t end) {
+        DecompressRowsDXT(rgba, source, width, height, format, begin, end);
+    });
+}
+
+// Base colours and modifier tables of the subblocks, as DecompressETC
+struct BlockETC {
+    unsigned int blockBot;
+    unsigned char red1, green1, blue1, red2, green2, blue2;
+    bool bFlip;
+    int modtable1, modtable2;
+};
+
+static BlockETC ReadBlockETC(const void* pSrcData) {
+    unsigned int blockTop, blockBot, input[2];
+    unsigned char red1, green1, blue1, red2, green2, blue2;
+    bool bFlip, bDiff;
+    int modtable1, modtable2;
+
+    memcpy(input, pSrcData, sizeof(input));
+    blockTop = input[0];
+    blockBot = input[1];
+
+    // check flipbit
+    bFlip = (blockTop & ETC_FLIP) != 0;
+    bDiff = (blockTop & ETC_DIFF) != 0;
+
+    if (bDiff) { // differential mode 5 colour bits + 3 difference bits
+        // get base colour for subblock 1
+        blue1 = (unsigned char)((blockTop & 0xf80000) >> 16);
+        green1 = (unsigned char)((blockTop & 0xf800) >> 8);
+        red1 = (unsigned char)(blockTop & 0xf8);
+
+        // get differential colour for subblock 2
+        signed char blues = (signed char)(blue1 >> 3) +
+                            ((signed char)((blockTop & 0x70000) >> 11) >> 5);
+        signed char greens = (signed char)(green1 >> 3) +
+                             ((signed char)((blockTop & 0x700) >> 3) >> 5);
+        signed char reds = (signed char)(red1 >> 3) +
+                           ((signed char)((blockTop & 0x7) << 5) >> 5);
+
+        blue2 = (unsigned char)blues;
+        green2 = (unsigned char)greens;
+        red2 = (unsigned char)reds;
+
+        red1 = red1 + (red1 >> 5);       // copy bits to lower sig
+        green1 = green1 + (green1 >> 5); // copy bits to lower sig
+        blue1 = blue1 + (blue1 >> 5);    // copy bits to lower sig
+
+        red2 = (red2 << 3) + (red2 >> 2);       // copy bits to lower sig
+        green2 = (green2 << 3) + (green2 >> 2); // copy bits to lower sig
+        blue2 = (blue2 << 3) + (blue2 >> 2);    // copy bits to lower sig
+    } else { // individual mode 4 + 4 colour bits
+        // get base colour for subblock 1
+        blue1 = (unsigned char)((blockTop & 0xf00000) >> 16);
+        blue1 = blue1 + (blue1 >> 4); // copy bits to lower sig
+        green1 = (unsigned char)((blockTop & 0xf000) >> 8);
+        green1 = green1 + (green1 >> 4); // copy bits to lower sig
+        red1 = (unsigned char)(blockTop & 0xf0);
+        red1 = red1 + (red1 >> 4); // copy bits to lower sig
+
+        // get base colour for subblock 2
+        blue2 = (unsigned char)((blockTop & 0xf0000) >> 12);
+        blue2 = blue2 + (blue2 >> 4); // copy bits to lower sig
+        green2 = (unsigned char)((blockTop & 0xf00) >> 4);
+        green2 = green2 + (green2 >> 4); // copy bits to lower sig
+        red2 = (unsigned char)((blockTop & 0xf) << 4);
+        red2 = red2 + (red2 >> 4); // copy bits to lower sig
+    }
+    // get the modtables for each subblock
+    modtable1 = (blockTop >> 29) & 0x7;
+    modtable2 = (blockTop >> 26) & 0x7;
+
+    return BlockETC{blockBot, red1, green1, blue1, red2,
+                    green2, blue2, bFlip, modtable1, modtable2};
+}
+
+// The colour of a subblock for each modifier, as ModifyPixel computes them
+static void SubblockPaletteETC(int red, int green, int blue, int modTable,
+                               uint32_t palette[4]) {
+    for (int i = 0; i < 4; ++i) {
+        int pixelMod = mod[modTable][i];
+        palette[i] = PackRGBA(_CLAMP_(red + pixelMod, 0, 255),
+                              _CLAMP_(green + pixelMod, 0, 255),
+                              _CLAMP_(blue + pixelMod, 0, 255), 255);
+    }
+}
+
+static void DecompressBlockETC(uint32_t pixels[16], const void* source) {
+    auto block = ReadBlockETC(source);
+    uint32_t palettes[2][4];
+    SubblockPaletteETC(block.red1, block.green1, block.blue1,
+                       block.modtable1, palettes[0]);
+    SubblockPaletteETC(block.red2, block.green2, block.blue2,
+                       block.modtable2, palettes[1]);
+    unsigned int modBlock = block.blockBot;
+    unsigned int mostSig = modBlock << 1;
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            int index = x * 4 + y; // as ModifyPixel
+            int modIndex =
+                index < 8 ? ((modBlock >> (index + 24)) & 0x1) +
+                                ((mostSig >> (index + 8)) & 0x2)
+                          : ((modBlock >> (index + 8)) & 0x1) +
+                                ((mostSig >> (index - 8)) & 0x2);
+            int subblock = block.bFlip ? y >= 2 : x >= 2;
+            pixels[4 * y + x] = palettes[subblock][modIndex];
+        }
+    }
+}
+
+void DecompressImageETC(unsigned char* rgba, const void* blocks, int width,
+                        int height) {
+    auto source = reinterpret_cast<unsigned char const*>(blocks);
+    int blocksX = (width + 3) / 4;
+    size_t rows = (height + 3) / 4;
+    ForEachRows(rows, 4 * (size_t)width, [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            auto rowBlocks = source + row * blocksX * 8;
+            for (int x = 0; x < blocksX; ++x) {
+                uint32_t pixels[16];
+                DecompressBlockETC(pixels, rowBlocks + x * 8);
+                StoreBlock(rgba, width, height, 4 * x, 4 * (int)row, pixels);
+            }
+        }
+    });
+}
+
+void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width,
+                          int height, TextureFormat format) {
+    // each range starts with its own neighbourhood of blocks
+    ForEachRows(height, width, [&](size_t begin, size_t end) {
+        DecompressRowsPVRTC(dest, blocks, width, height, format, (int)begin,
+                            (int)end);
+    });
+}
 }
@@ -26,10 +26,22 @@ misrepresented as being the original software.
 #pragma once
 #include "Types.h"
 namespace NSG {
+// Rows of blocks are decoded in parallel by the job system (if any). The
+// DXT palettes are computed with SSE2 when available.
 void DecompressImageDXT(unsigned char* dest, const void* blocks, int width,
                         int height, int depth, TextureFormat format);
 void DecompressImageETC(unsigned char* dest, const void* blocks, int width,
                         int height);
 void DecompressImagePVRTC(unsigned char* dest, const void* blocks, int width,
                           int height, TextureFormat format);
+// Single threaded decoders, a block at a time. Same results as the ones
+// above, they are the reference for the tests.
+void DecompressImageDXTReference(unsigned char* dest, const void* blocks,
+                                 int width, int height, int depth,
+                                 TextureFormat format);
+void DecompressImageETCReference(unsigned char* dest, const void* blocks,
+                                 int width, int height);
+void DecompressImagePVRTCReference(unsigned char* dest, const void* blocks,
+                                   int width, int height,
+                                   TextureFormat format);
 }
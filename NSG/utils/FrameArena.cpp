@@ -0,0 +1,140 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "FrameArena.h"
+#include "Check.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace NSG {
+FrameArena::FrameArena(size_t blockSize)
+    : blockSize_(blockSize), current_(0), offset_(0), usedBefore_(0),
+      peak_(0), scopes_(0), systemAllocations_(0) {
+    CHECK_CONDITION(blockSize_ > 0);
+}
+
+FrameArena::~FrameArena() {
+    CHECK_ASSERT(!scopes_);
+    for (auto& block : blocks_)
+        std::free(block.data_);
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment) {
+    CHECK_ASSERT(alignment && !(alignment & (alignment - 1)));
+    for (;;) {
+        if (!blocks_.empty()) {
+            auto& block = blocks_[current_];
+            auto base = reinterpret_cast<uintptr_t>(block.data_);
+            auto start = ((base + offset_ + alignment - 1) & ~(alignment - 1)) -
+                         base;
+            if (start + bytes <= block.size_) {
+                offset_ = start + bytes;
+                peak_ = std::max(peak_, usedBefore_ + offset_);
+                return block.data_ + start;
+            }
+        }
+        NextBlock(bytes + alignment);
+    }
+}
+
+void FrameArena::NextBlock(size_t bytes) {
+    auto next = blocks_.empty() ? 0 : current_ + 1;
+    auto it = std::find_if(
+        blocks_.begin() + next, blocks_.end(),
+        [bytes](const Block& block) { return block.size_ >= bytes; });
+    if (it != blocks_.end())
+        std::swap(blocks_[next], *it);
+    else {
+        Block block{nullptr, std::max(blockSize_, bytes)};
+        block.data_ = static_cast<char*>(std::malloc(block.size_));
+        if (!block.data_)
+            throw std::bad_alloc();
+        ++systemAllocations_;
+        blocks_.insert(blocks_.begin() + next, block);
+    }
+    if (next)
+        usedBefore_ += blocks_[current_].size_;
+    current_ = next;
+    offset_ = 0;
+}
+
+void FrameArena::Release(void* ptr, size_t bytes) {
+    if (blocks_.empty())
+        return;
+    auto& block = blocks_[current_];
+    if (static_cast<char*>(ptr) + bytes == block.data_ + offset_)
+        offset_ -= bytes;
+}
+
+void FrameArena::Reset() {
+    CHECK_ASSERT(!scopes_);
+    if (blocks_.size() > 1) {
+        // the frame did not fit in one block: use a single one next time
+        auto size = GetCapacity();
+        for (auto& block : blocks_)
+            std::free(block.data_);
+        blocks_.clear();
+        Block block{static_cast<char*>(std::malloc(size)), size};
+        if (!block.data_)
+            throw std::bad_alloc();
+        ++systemAllocations_;
+        blocks_.push_back(block);
+    }
+    current_ = 0;
+    offset_ = 0;
+    usedBefore_ = 0;
+}
+
+size_t FrameArena::GetUsed() const { return usedBefore_ + offset_; }
+
+size_t FrameArena::GetCapacity() const {
+    size_t capacity = 0;
+    for (auto& block : blocks_)
+        capacity += block.size_;
+    return capacity;
+}
+
+FrameArena& FrameArena::GetFrame() {
+    static FrameArena arena;
+    return arena;
+}
+
+FrameArena::Scope::Scope(FrameArena& arena)
+    : arena_(arena), block_(arena.current_), offset_(arena.offset_) {
+    ++arena_.scopes_;
+}
+
+FrameArena::Scope::~Scope() {
+    CHECK_ASSERT(arena_.scopes_);
+    --arena_.scopes_;
+    arena_.current_ = block_;
+    arena_.offset_ = offset_;
+    arena_.usedBefore_ = 0;
+    for (size_t i = 0; i < block_; i++)
+        arena_.usedBefore_ += arena_.blocks_[i].size_;
+}
+}
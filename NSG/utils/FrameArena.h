@@ -0,0 +1,116 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace NSG {
+/// Linear allocator for the temporaries of a frame.
+/// Allocating bumps an offset and everything is released at once with Reset
+/// (done by Engine::RenderFrame) or at the end of a Scope. When a frame does
+/// not fit in one block, Reset merges the blocks into a bigger one, so after
+/// a few frames no memory is requested to the system. Not thread safe.
+class FrameArena {
+public:
+    static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+    FrameArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    void* Allocate(size_t bytes,
+                   size_t alignment = alignof(std::max_align_t));
+    // Gives back the memory if ptr is the last allocation (growing vectors)
+    void Release(void* ptr, size_t bytes);
+    void Reset();
+    size_t GetUsed() const;
+    size_t GetPeak() const { return peak_; }
+    size_t GetCapacity() const;
+    size_t GetBlocks() const { return blocks_.size(); }
+    // Number of blocks requested to the system since the creation (only the
+    // arena's own ones, see GetMemoryAllocations for the rest)
+    size_t GetSystemAllocations() const { return systemAllocations_; }
+    // Arena of the rendering thread
+    static FrameArena& GetFrame();
+
+    // Frees at the end of the scope what has been allocated inside it.
+    // Containers created before the scope must not grow inside it.
+    class Scope {
+    public:
+        Scope(FrameArena& arena = FrameArena::GetFrame());
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameArena& arena_;
+        size_t block_;
+        size_t offset_;
+    };
+
+private:
+    void NextBlock(size_t bytes);
+    struct Block {
+        char* data_;
+        size_t size_;
+    };
+    std::vector<Block> blocks_;
+    size_t blockSize_;
+    size_t current_; // block in use
+    size_t offset_; // in the current block
+    size_t usedBefore_; // bytes of the blocks before the current one
+    size_t peak_;
+    size_t scopes_;
+    size_t systemAllocations_;
+};
+
+/// STL allocator over a FrameArena
+template <typename T> class FrameAllocator {
+public:
+    typedef T value_type;
+    template <typename U> struct rebind { typedef FrameAllocator<U> other; };
+    FrameAllocator(FrameArena& arena = FrameArena::GetFrame())
+        : arena_(&arena) {}
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& other)
+        : arena_(other.GetArena()) {}
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, size_t n) { arena_->Release(p, n * sizeof(T)); }
+    FrameArena* GetArena() const { return arena_; }
+    template <typename U> bool operator==(const FrameAllocator<U>& o) const {
+        return arena_ == o.GetArena();
+    }
+    template <typename U> bool operator!=(const FrameAllocator<U>& o) const {
+        return arena_ != o.GetArena();
+    }
+
+private:
+    FrameArena* arena_;
+};
+
+template <typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+}
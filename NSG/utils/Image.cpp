@@ -77,6 +77,7 @@ void Image::ResetState() {
     depth_ = 0;
     width_ = 0;
     height_ = 0;
+    decoded_ = false;
 }
 
 bool Image::IsValid() {
@@ -135,6 +136,12 @@ void Image::Decompress() {
 }
 
 void Image::AllocateResources() {
+    if (!decoded_)
+        Decode();
+    decoded_ = false;
+}
+
+void Image::Decode() {
     ReadResource();
 
     if (compressed_ && RenderingContext::GetPtr()->NeedsDecompress(format_))
@@ -147,6 +154,27 @@ void Image::AllocateResources() {
     auto maxTextureSize = RenderingCapabilities::GetPtr()->GetMaxTextureSize();
     if (maxTextureSize < width_ || maxTextureSize < height_)
         Reduce(maxTextureSize);
+    decoded_ = true;
+}
+
+void Image::SetDecoded(Image& decoded) {
+    // data kept in the resource is read again, which is cheap
+    if (!decoded.allocated_)
+        return;
+    if (allocated_)
+        stbi_image_free((void*)imgData_); // same as free
+    compressed_ = decoded.compressed_;
+    numCompressedLevels_ = decoded.numCompressedLevels_;
+    format_ = decoded.format_;
+    imgData_ = decoded.imgData_;
+    imgDataSize_ = decoded.imgDataSize_;
+    allocated_ = true;
+    channels_ = decoded.channels_;
+    depth_ = decoded.depth_;
+    width_ = decoded.width_;
+    height_ = decoded.height_;
+    decoded_ = true;
+    decoded.ResetState(); // the pixels are ours
 }
 
 void Image::ReleaseResources() {
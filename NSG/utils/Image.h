@@ -48,11 +48,13 @@ public:
     TextureFormat GetFormat() const { return format_; }
     void Decompress();
     int GetChannels() const { return channels_; }
-
-private:
-    bool IsValid() override;
-    void AllocateResources() override;
-    void ReleaseResources() override;
+    PResource GetResource() const { return resource_; }
+    // Decoding stage (read, decompress and resize). AllocateResources skips
+    // it once done.
+    void Decode();
+    // Takes the pixels of a private image decoded by a worker (see
+    // LoaderXML). Main thread only.
+    void SetDecoded(Image& decoded);
     struct CompressedLevel {
         const unsigned char* data_;
         int width_;
@@ -63,6 +65,16 @@ private:
         unsigned rowSize_;
         unsigned rows_;
     };
+    // Mip levels stored in the file (DDS, KTX or PVR)
+    unsigned GetCompressedLevels() const { return numCompressedLevels_; }
+    CompressedLevel GetCompressedLevel(unsigned index) const {
+        return GetCompressedLevel(imgData_, imgDataSize_, index);
+    }
+
+private:
+    bool IsValid() override;
+    void AllocateResources() override;
+    void ReleaseResources() override;
     CompressedLevel GetCompressedLevel(const unsigned char* data,
                                        unsigned dataSize, unsigned index) const;
     static void FlipBlockVertical(unsigned char* dest, const unsigned char* src,
@@ -86,5 +98,6 @@ private:
     int depth_; // (1 => 2D texture) (>1 => 3D texture)
     int width_;
     int height_;
+    bool decoded_;
 };
 }
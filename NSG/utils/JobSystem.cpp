@@ -0,0 +1,342 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "JobSystem.h"
+#include "Check.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <string>
+
+namespace NSG {
+namespace Task {
+struct Job {
+    JobSystem::Function function_;
+    JobCounter* counter_;
+};
+
+// System and queue of the worker threads
+static thread_local JobSystem* tlsJobSystem = nullptr;
+static thread_local int tlsJobQueue = -1;
+
+static const int SPINS_BEFORE_SLEEP = 64;
+
+JobCounter::JobCounter() : pending_(0), finishing_(0) {}
+
+JobCounter::~JobCounter() { CHECK_ASSERT(IsDone() && waiting_.empty()); }
+
+JobQueue::JobQueue() : top_(0), bottom_(0) {
+    for (auto& job : jobs_)
+        job.store(nullptr, std::memory_order_relaxed);
+}
+
+bool JobQueue::Push(Job* job) {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto t = top_.load(std::memory_order_acquire);
+    if (b - t >= CAPACITY)
+        return false;
+    jobs_[b & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* JobQueue::Pop() {
+    auto b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top_.load(std::memory_order_relaxed);
+    Job* job = nullptr;
+    if (t <= b) {
+        job = jobs_[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // last job: race against the thieves
+            if (!top_.compare_exchange_strong(t, t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed))
+                job = nullptr;
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+    } else
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    return job;
+}
+
+Job* JobQueue::Steal() {
+    auto t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom_.load(std::memory_order_acquire);
+    if (t < b) {
+        auto job = jobs_[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if (top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed))
+            return job;
+    }
+    return nullptr;
+}
+
+JobSystem::JobSystem(int nWorkers)
+    : mainThread_(std::this_thread::get_id()), queuedJobs_(0),
+      sharedJobs_(0), stolenJobs_(0), sleeping_(0), alive_(true) {
+#if defined(EMSCRIPTEN)
+    nWorkers = 0;
+#else
+    if (nWorkers < 0)
+        nWorkers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+#endif
+    for (int i = 0; i <= nWorkers; i++)
+        queues_.push_back(std::unique_ptr<JobQueue>(new JobQueue));
+    for (int i = 1; i <= nWorkers; i++)
+        threads_.push_back(std::thread([this, i]() { WorkerLoop(i); }));
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx_);
+        alive_ = false;
+    }
+    sleepCondition_.notify_all();
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+int JobSystem::GetQueueIndex() const {
+    if (tlsJobSystem == this)
+        return tlsJobQueue;
+    if (std::this_thread::get_id() == mainThread_)
+        return 0;
+    return -1;
+}
+
+void JobSystem::Push(Job* job) {
+    if (threads_.empty()) {
+        Execute(job);
+        return;
+    }
+    auto queue = GetQueueIndex();
+    ++queuedJobs_;
+    if (queue < 0 || !queues_[queue]->Push(job))
+        PushShared(job);
+    Wake();
+}
+
+void JobSystem::PushShared(Job* job) {
+    std::lock_guard<std::mutex> lock(sharedMtx_);
+    sharedQueue_.push_back(job);
+    ++sharedJobs_;
+}
+
+void JobSystem::Wake() {
+    // see WorkerLoop: queuedJobs_ and sleeping_ are sequentially consistent
+    if (sleeping_.load()) {
+        std::lock_guard<std::mutex> lock(sleepMtx_);
+        sleepCondition_.notify_one();
+    }
+}
+
+Job* JobSystem::GetJob(int queue) {
+    Job* job = nullptr;
+    if (queue >= 0)
+        job = queues_[queue]->Pop();
+    if (!job && sharedJobs_.load()) {
+        std::lock_guard<std::mutex> lock(sharedMtx_);
+        if (!sharedQueue_.empty()) {
+            job = sharedQueue_.front();
+            sharedQueue_.pop_front();
+            --sharedJobs_;
+        }
+    }
+    if (!job) {
+        auto n = (int)queues_.size();
+        auto first = queue < 0 ? 0 : queue + 1;
+        for (int i = 0; i < n && !job; i++) {
+            auto victim = (first + i) % n;
+            if (victim != queue)
+                job = queues_[victim]->Steal();
+        }
+        if (job)
+            stolenJobs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (job)
+        --queuedJobs_;
+    return job;
+}
+
+Job* JobSystem::GetJob(int queue, JobCounter* counter) {
+    Job* job = nullptr;
+    if (queue >= 0) {
+        job = queues_[queue]->Pop();
+        if (job && job->counter_ != counter) {
+            // still queued: leave it to the workers
+            PushShared(job);
+            Wake();
+            job = nullptr;
+        }
+    }
+    if (!job && sharedJobs_.load()) {
+        std::lock_guard<std::mutex> lock(sharedMtx_);
+        auto it = std::find_if(
+            sharedQueue_.begin(), sharedQueue_.end(),
+            [counter](const Job* job) { return job->counter_ == counter; });
+        if (it != sharedQueue_.end()) {
+            job = *it;
+            sharedQueue_.erase(it);
+            --sharedJobs_;
+        }
+    }
+    if (job)
+        --queuedJobs_;
+    return job;
+}
+
+void JobSystem::Execute(Job* job) {
+    job->function_();
+    auto counter = job->counter_;
+    delete job;
+    if (counter)
+        Finish(counter);
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+    ++counter->finishing_;
+    if (--counter->pending_ == 0) {
+        std::vector<Job*> waiting;
+        {
+            std::lock_guard<std::mutex> lock(counter->mtx_);
+            if (counter->pending_.load() == 0)
+                waiting.swap(counter->waiting_);
+        }
+        for (auto job : waiting)
+            Push(job);
+    }
+    // the counter can be destroyed from now on
+    --counter->finishing_;
+}
+
+void JobSystem::WorkerLoop(int queue) {
+    tlsJobSystem = this;
+    tlsJobQueue = queue;
+    PROFILE_THREAD("worker " + std::to_string(queue));
+    int spins = 0;
+    for (;;) {
+        auto job = GetJob(queue);
+        if (job) {
+            Execute(job);
+            spins = 0;
+        } else if (++spins < SPINS_BEFORE_SLEEP)
+            std::this_thread::yield();
+        else {
+            std::unique_lock<std::mutex> lock(sleepMtx_);
+            ++sleeping_;
+            sleepCondition_.wait(
+                lock, [this]() { return queuedJobs_.load() || !alive_; });
+            --sleeping_;
+            if (!alive_ && !queuedJobs_.load())
+                break;
+            spins = 0;
+        }
+    }
+    tlsJobSystem = nullptr;
+    tlsJobQueue = -1;
+}
+
+void JobSystem::Run(Function function, JobCounter* counter) {
+    if (counter)
+        ++counter->pending_;
+    Push(new Job{std::move(function), counter});
+}
+
+void JobSystem::Run(Function function, JobCounter& dependency,
+                    JobCounter* counter) {
+    if (counter)
+        ++counter->pending_;
+    auto job = new Job{std::move(function), counter};
+    {
+        std::lock_guard<std::mutex> lock(dependency.mtx_);
+        if (dependency.pending_.load()) {
+            dependency.waiting_.push_back(job);
+            return;
+        }
+    }
+    Push(job);
+}
+
+void JobSystem::AddTask(PTask pTask, JobCounter* counter) {
+    Run(
+        [pTask]() {
+            try {
+                pTask->Run();
+            } catch (std::exception& e) {
+                pTask->Exception(e);
+            }
+        },
+        counter);
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+    auto queue = GetQueueIndex();
+    while (!counter.IsDone()) {
+        auto job = GetJob(queue, &counter);
+        if (job)
+            Execute(job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain,
+                            const RangeFunction& function) {
+    grain = std::max<size_t>(1, grain);
+    if (count <= grain || threads_.empty()) {
+        if (count)
+            function(0, count);
+        return;
+    }
+    JobCounter counter;
+    // the calling thread takes the first range
+    for (size_t begin = grain; begin < count; begin += grain) {
+        auto end = std::min(count, begin + grain);
+        Run([&function, begin, end]() { function(begin, end); }, &counter);
+    }
+    function(0, grain);
+    Wait(counter);
+}
+
+void JobSystem::RunOnMainThread(Function function) {
+    std::lock_guard<std::mutex> lock(mainThreadMtx_);
+    mainThreadJobs_.push_back(std::move(function));
+}
+
+void JobSystem::ProcessMainThreadJobs() {
+    CHECK_ASSERT(std::this_thread::get_id() == mainThread_);
+    std::vector<Function> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMtx_);
+        jobs.swap(mainThreadJobs_);
+    }
+    for (auto& job : jobs)
+        job();
+}
+}
+}
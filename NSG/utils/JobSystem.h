@@ -0,0 +1,138 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "NonCopyable.h"
+#include "Singleton.h"
+#include "Task.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NSG {
+namespace Task {
+struct Job;
+
+/// Counts the jobs not finished yet. A job can depend on a counter, then it
+/// is queued when the counter reaches zero.
+class JobCounter : NonCopyable {
+public:
+    JobCounter();
+    ~JobCounter();
+    // finishing_ keeps the counter alive until Finish leaves it
+    bool IsDone() const { return !pending_.load() && !finishing_.load(); }
+    int GetPending() const { return pending_.load(); }
+
+private:
+    std::atomic<int> pending_;
+    std::atomic<int> finishing_;
+    std::mutex mtx_;
+    std::vector<Job*> waiting_;
+    friend class JobSystem;
+};
+
+/// Chase-Lev deque: the owner pushes and pops at the bottom, the other
+/// threads steal from the top.
+class JobQueue : NonCopyable {
+public:
+    static const int64_t CAPACITY = 4096; // power of two
+    JobQueue();
+    bool Push(Job* job); // false if full
+    Job* Pop();
+    Job* Steal();
+
+private:
+    std::atomic<int64_t> top_;
+    char pad0_[64];
+    std::atomic<int64_t> bottom_;
+    char pad1_[64];
+    std::atomic<Job*> jobs_[CAPACITY];
+};
+
+/// Engine wide thread pool with a work-stealing queue per thread.
+/// Queue 0 belongs to the thread creating the system (the main thread). Jobs
+/// queued from any other thread go to a shared queue. A thread waiting for a
+/// counter only executes the jobs of that counter, so a long unrelated job
+/// (a loader task) never stalls the main thread. Without workers (emscripten) the jobs are
+/// executed as soon as they can run.
+class JobSystem : public Singleton<JobSystem>, NonCopyable {
+public:
+    typedef std::function<void()> Function;
+    typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+    // nWorkers < 0 uses a worker per core but the one of the main thread
+    JobSystem(int nWorkers = -1);
+    ~JobSystem();
+    // counter (optional) is incremented now and decremented once done
+    void Run(Function function, JobCounter* counter = nullptr);
+    // function runs after all the jobs counted by dependency
+    void Run(Function function, JobCounter& dependency,
+             JobCounter* counter = nullptr);
+    // Exceptions are given to the task as in QueuedTask
+    void AddTask(PTask pTask, JobCounter* counter = nullptr);
+    // Executes the jobs of counter in the calling thread until it is done
+    void Wait(JobCounter& counter);
+    // Calls function for ranges of grain elements in [0, count) and waits
+    void ParallelFor(size_t count, size_t grain,
+                     const RangeFunction& function);
+    // Queues function to be called by ProcessMainThreadJobs. Engine calls it
+    // at the beginning of each frame.
+    void RunOnMainThread(Function function);
+    void ProcessMainThreadJobs();
+    unsigned GetWorkersCount() const { return (unsigned)threads_.size(); }
+    size_t GetStolenJobs() const { return stolenJobs_.load(); }
+
+private:
+    void Push(Job* job);
+    void PushShared(Job* job);
+    void Wake();
+    Job* GetJob(int queue);
+    Job* GetJob(int queue, JobCounter* counter);
+    void Execute(Job* job);
+    void Finish(JobCounter* counter);
+    int GetQueueIndex() const;
+    void WorkerLoop(int queue);
+    std::vector<std::unique_ptr<JobQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::thread::id mainThread_;
+    std::mutex sharedMtx_;
+    std::deque<Job*> sharedQueue_;
+    std::atomic<int> queuedJobs_;
+    std::atomic<int> sharedJobs_;
+    std::atomic<size_t> stolenJobs_;
+    std::mutex sleepMtx_;
+    std::condition_variable sleepCondition_;
+    std::atomic<int> sleeping_;
+    std::atomic<bool> alive_;
+    std::mutex mainThreadMtx_;
+    std::vector<Function> mainThreadJobs_;
+};
+}
+}
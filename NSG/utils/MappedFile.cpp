@@ -0,0 +1,132 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "MappedFile.h"
+#include "Check.h"
+#include "Log.h"
+#if defined(IS_TARGET_WINDOWS)
+#include <windows.h>
+#elif defined(IS_TARGET_ANDROID)
+#include <android/asset_manager.h>
+#include <android_native_app_glue.h>
+#elif !defined(EMSCRIPTEN)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <fstream>
+
+namespace NSG {
+#if defined(IS_TARGET_ANDROID)
+extern android_app* androidApp;
+#endif
+
+MappedFile::MappedFile(const Path& path)
+    : data_(nullptr), size_(0)
+#if defined(IS_TARGET_WINDOWS)
+      ,
+      file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+#endif
+{
+    auto filename = path.GetFullAbsoluteFilePath();
+#if defined(IS_TARGET_WINDOWS)
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file_, &size) && size.QuadPart > 0) {
+            mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0,
+                                          nullptr);
+            if (mapping_) {
+                data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0,
+                                                   0, 0);
+                if (data_)
+                    size_ = (size_t)size.QuadPart;
+            }
+        }
+    }
+#elif defined(IS_TARGET_ANDROID)
+    CHECK_ASSERT(androidApp->activity->assetManager);
+    AAsset* pAsset =
+        AAssetManager_open(androidApp->activity->assetManager,
+                           path.GetFilePath().c_str(), AASSET_MODE_BUFFER);
+    if (pAsset) {
+        off_t filelength = AAsset_getLength(pAsset);
+        buffer_.resize((size_t)filelength);
+        AAsset_read(pAsset, &buffer_[0], filelength);
+        AAsset_close(pAsset);
+    }
+#elif !defined(EMSCRIPTEN)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd != -1) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p =
+                mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data_ = (const char*)p;
+                size_ = (size_t)st.st_size;
+            }
+        }
+        close(fd); // the mapping keeps its own reference
+    }
+#endif
+
+    if (!data_ && buffer_.empty()) {
+        std::ifstream file(filename.c_str(), std::ios::binary);
+        if (file.is_open()) {
+            file.seekg(0, std::ios::end);
+            auto filelength = (size_t)file.tellg();
+            file.seekg(0, std::ios::beg);
+            buffer_.resize(filelength);
+            if (filelength)
+                file.read(&buffer_[0], filelength);
+        }
+    }
+
+    if (!data_ && !buffer_.empty()) {
+        data_ = buffer_.c_str();
+        size_ = buffer_.size();
+    }
+
+    if (!data_)
+        LOGE("Cannot open file: %s", filename.c_str());
+}
+
+MappedFile::~MappedFile() {
+#if defined(IS_TARGET_WINDOWS)
+    if (data_ && buffer_.empty())
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+        CloseHandle(file_);
+#elif !defined(IS_TARGET_ANDROID) && !defined(EMSCRIPTEN)
+    if (data_ && buffer_.empty())
+        munmap((void*)data_, size_);
+#endif
+}
+}
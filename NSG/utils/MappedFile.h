@@ -0,0 +1,51 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "NonCopyable.h"
+#include "Path.h"
+#include <string>
+
+namespace NSG {
+// Read only view of a whole file.
+// Uses the OS memory mapping where available, otherwise reads the file.
+class MappedFile : NonCopyable {
+public:
+    MappedFile(const Path& path);
+    ~MappedFile();
+    bool IsOpen() const { return data_ != nullptr; }
+    const char* GetData() const { return data_; }
+    size_t GetSize() const { return size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+#if defined(IS_TARGET_WINDOWS)
+    void* file_;
+    void* mapping_;
+#endif
+    std::string buffer_; // when the file cannot be mapped
+};
+}
@@ -35,7 +35,6 @@ misrepresented as being the original software.
 #include <vector>
 
 namespace NSG {
-void AtExit();
 struct PoolData {
     size_t objSize_;
     IPool* pool_;
@@ -51,7 +50,7 @@ void* AllocateMemoryFromHeap(std::size_t count) {
     void* p = std::malloc(newSize);
     if (p) {
         MemHeader* header = (MemHeader*)p;
-        header->poolPointer_ = &AllocateMemoryFromHeap;
+        header->poolPointer_ = (void*)&AllocateMemoryFromHeap;
         void* memBlock = (char*)p + sizeof(MemHeader);
         return memBlock;
     }
@@ -62,120 +61,99 @@ void* AllocateMemoryFromHeap(std::size_t count) {
 void ReleaseMemoryFromHeap(void* ptr) {
     void* memObj = (char*)ptr - sizeof(MemHeader);
     MemHeader* header = (MemHeader*)memObj;
-    if (header->poolPointer_ == &AllocateMemoryFromHeap) {
+    if (header->poolPointer_ == (void*)&AllocateMemoryFromHeap) {
         // LOGI("Releasing memory to heap");
         std::free(memObj);
     }
 }
 
+// Chunks of 64KB approximately, the pools grow on demand
 struct Pools {
-    friend void AtExit();
-    static const size_t MinPoolSize = 1;
-    Pool<MinPoolSize << 0, 1000> pool1_;
-    Pool<MinPoolSize << 1, 1000> pool2_;
-    Pool<MinPoolSize << 2, 1000> pool4_;
-    Pool<MinPoolSize << 3, 50000> pool8_;
-    Pool<MinPoolSize << 4, 50000> pool16_;
-    Pool<MinPoolSize << 5, 50000> pool32_;
-    Pool<MinPoolSize << 6, 90000> pool64_;
-    Pool<MinPoolSize << 7, 90000> pool128_;
-    Pool<MinPoolSize << 8, 20000> pool256_;
-    Pool<MinPoolSize << 9, 20000> pool512_;
-    Pool<MinPoolSize << 10, 1000> pool1024_;
-    Pool<MinPoolSize << 11, 1000> pool2048_;
-    Pool<MinPoolSize << 12, 100> pool4096_;
-    Pool<MinPoolSize << 13, 100> pool8192_;
-    Pool<MinPoolSize << 14, 50> pool16384_;
-    Pool<MinPoolSize << 15, 2> pool32768_;
-    static const size_t MaxPoolSize = MinPoolSize << 15;
-    static const size_t MaxPools = 16;
-    PoolData* pools_;
-    size_t nPools_;
+    Pool<1 << 4, 4096> pool16_;
+    Pool<1 << 5, 2048> pool32_;
+    Pool<1 << 6, 1024> pool64_;
+    Pool<1 << 7, 512> pool128_;
+    Pool<1 << 8, 256> pool256_;
+    Pool<1 << 9, 128> pool512_;
+    Pool<1 << 10, 64> pool1024_;
+    Pool<1 << 11, 32> pool2048_;
+    Pool<1 << 12, 16> pool4096_;
+    Pool<1 << 13, 8> pool8192_;
+    Pool<1 << 14, 4> pool16384_;
+    Pool<1 << 15, 2> pool32768_;
+    static const size_t MaxPoolSize = 1 << 15;
+    static const size_t MaxPools = 12;
+    PoolData pools_[MaxPools];
     void* begin_;
     void* end_;
     Pools() {
         begin_ = this;
         end_ = (char*)this + sizeof(Pools);
 
-        PoolData pools[] = {pool1_,    pool2_,    pool4_,     pool8_,
-                            pool16_,   pool32_,   pool64_,    pool128_,
+        PoolData pools[] = {pool16_,   pool32_,   pool64_,    pool128_,
                             pool256_,  pool512_,  pool1024_,  pool2048_,
                             pool4096_, pool8192_, pool16384_, pool32768_};
         static_assert(MaxPools == sizeof(pools) / sizeof(PoolData),
                       "Number of pools is incorrect");
-        static char memPoolData[sizeof(PoolData) * MaxPools] = {0};
-        pools_ = new (memPoolData) PoolData;
-        int i = 0;
-        for (auto& obj : pools)
-            pools_[i++] = std::move(obj);
-        nPools_ = MaxPools;
-        std::sort(&pools_[0], &pools_[MaxPools],
-                  [](const PoolData& a, const PoolData& b) {
-                      return a.objSize_ < b.objSize_;
-                  });
+        std::copy(pools, pools + MaxPools, pools_);
         poolsObj = this;
-        //#if !defined(IOS) && !defined(ANDROID) && !defined(IS_TARGET_LINUX)
-        // std::atexit(AtExit);
-        //#endif
-    }
-
-    ~Pools() {
-        poolsObj = nullptr;
-        delete[] pools_;
     }
 
     IPool* GetBestPool(std::size_t count) {
-        assert(count >= 0);
-#if 0
-            size_t slot = (size_t)std::ceil(std::log2(count));
-            if (slot < nPools_)
-                return pools_[slot].pool_;
+        if (count > Pools::MaxPoolSize)
             return nullptr;
-#else
-        if (count <= Pools::MaxPoolSize)
-            for (size_t i = 0; i < nPools_; i++)
-                if (pools_[i].objSize_ > count)
-                    return pools_[i].pool_;
-        return nullptr;
-#endif
+        size_t i = 0;
+        for (count = count ? (count - 1) >> 4 : 0; count; count >>= 1)
+            i++; // log2 of the size class
+        return pools_[i].pool_;
     }
 
     inline bool IsPool(void* p) { return p >= begin_ && p < end_; }
+
+    void LogStats() {
+        for (auto& data : pools_) {
+            auto stats = data.pool_->GetStats();
+            if (!stats.chunks_)
+                continue;
+            LOGI("Pool %6u: chunks=%u capacity=%u allocated=%u peak=%u "
+                 "refills=%u flushes=%u",
+                 (unsigned)stats.objSize_, (unsigned)stats.chunks_,
+                 (unsigned)stats.capacity_, (unsigned)stats.allocated_,
+                 (unsigned)stats.peakAllocated_, (unsigned)stats.refills_,
+                 (unsigned)stats.flushes_);
+        }
+    }
 };
 
+// Created with the first allocation and never destroyed: static objects
+// can release pooled memory until the very end of the process.
+static Pools* GetPools() {
+    static char memPools[sizeof(Pools)];
+    static Pools* pools = new (&memPools[0]) Pools;
+    return pools;
+}
+
+// Constant initialized: valid for the allocations of the static objects
+static std::atomic<size_t> allocations(0);
+
 static void* AllocateMemory(std::size_t count) {
-#if 0
-		static struct Initializer
-		{
-			char memPools_[sizeof(Pools)];
-			Pools* p_;
-			Initializer()
-			{
-				p_ = new(&memPools_[0])Pools;
-			}
-			~Initializer()
-			{
-				p_->~Pools();
-			}
-		} initializer;
-#endif
-    if (poolsObj) {
-        IPool* pool = poolsObj->GetBestPool(count);
-        if (pool) {
-            void* p = pool->Allocate(count);
-            if (p)
-                return p;
-        }
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    Pools* pools = poolsObj ? poolsObj : GetPools();
+    IPool* pool = pools->GetBestPool(count);
+    if (pool) {
+        void* p = pool->Allocate(count);
+        if (p)
+            return p;
     }
     return AllocateMemoryFromHeap(count);
 }
 
-static void ReleaseMemory(void* ptr, std::size_t count) {
+static void ReleaseMemory(void* ptr) {
     if (ptr) {
         if (poolsObj) {
             void* memObj = (char*)ptr - sizeof(MemHeader);
             MemHeader* header = (MemHeader*)memObj;
-            if (header->poolPointer_ != &AllocateMemoryFromHeap) {
+            if (header->poolPointer_ != (void*)&AllocateMemoryFromHeap) {
                 IPool* pool = (IPool*)header->poolPointer_;
                 if (poolsObj->IsPool((void*)pool)) {
                     pool->DeAllocate(ptr);
@@ -187,22 +165,33 @@ static void ReleaseMemory(void* ptr, std::size_t count) {
     }
 }
 
-static Pools* memoryPools = nullptr;
-void InitilizeMemoryManager() {
-    static char memPools[sizeof(Pools)];
-    memoryPools = new (&memPools[0]) Pools;
-}
+void InitilizeMemoryManager() { GetPools(); }
 
 void DestroyMemoryManager() {
 #if (defined(DEBUG) || defined(_DEBUG)) && !defined(NDEBUG)
-    memoryPools->~Pools();
+    LogMemoryManagerStats();
 #endif
 }
+
+void LogMemoryManagerStats() { GetPools()->LogStats(); }
+
+size_t GetMemoryAllocations() { return allocations.load(); }
 }
 
 using namespace NSG;
 
-void* operator new(std::size_t count) { return AllocateMemory(count); }
+static void* AllocateOrThrow(std::size_t count) {
+    void* p = AllocateMemory(count);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t count) { return AllocateOrThrow(count); }
+
+void* operator new(std::size_t count, const std::nothrow_t&) noexcept {
+    return AllocateMemory(count);
+}
 
 #if _MSC_VER
 void operator delete(void* ptr)
@@ -210,7 +199,11 @@ void operator delete(void* ptr)
 void operator delete(void* ptr) noexcept
 #endif
 {
-    ReleaseMemory(ptr, 0);
+    ReleaseMemory(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    ReleaseMemory(ptr);
 }
 
 #if _MSC_VER
@@ -219,10 +212,14 @@ void operator delete(void* ptr, std::size_t count)
 void operator delete(void* ptr, std::size_t count) noexcept
 #endif
 {
-    ReleaseMemory(ptr, count);
+    ReleaseMemory(ptr);
 }
 
-void* operator new[](size_t count) { return AllocateMemory(count); }
+void* operator new[](size_t count) { return AllocateOrThrow(count); }
+
+void* operator new[](std::size_t count, const std::nothrow_t&) noexcept {
+    return AllocateMemory(count);
+}
 
 #if _MSC_VER
 void operator delete[](void* ptr)
@@ -230,17 +227,29 @@ void operator delete[](void* ptr)
 void operator delete[](void* ptr) noexcept
 #endif
 {
-    ReleaseMemory(ptr, 0);
+    ReleaseMemory(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    ReleaseMemory(ptr);
 }
-#else
-// void AtExit()
-//{
-//	LOGI("*** AtExit called ***");
-//}
 
+#if _MSC_VER
+void operator delete[](void* ptr, std::size_t count)
+#else
+void operator delete[](void* ptr, std::size_t count) noexcept
+#endif
+{
+    ReleaseMemory(ptr);
+}
+#else
 namespace NSG {
 void InitilizeMemoryManager() {}
 
 void DestroyMemoryManager() {}
+
+void LogMemoryManagerStats() {}
+
+size_t GetMemoryAllocations() { return 0; }
 }
 #endif
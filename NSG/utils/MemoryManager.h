@@ -24,12 +24,19 @@ misrepresented as being the original software.
 -------------------------------------------------------------------------------
 */
 #pragma once
+#include <cstddef>
 #if !defined(EMSCRIPTEN)
-//#define USE_POOLS
+// Replaces the global operator new/delete with the pools in Pool.h
+#define USE_POOLS
 #endif
 namespace NSG {
 extern void InitilizeMemoryManager();
 extern void DestroyMemoryManager();
+// Logs the statistics of every size class in use
+extern void LogMemoryManagerStats();
+// Calls to operator new of all the threads since the start (always 0
+// without USE_POOLS, where operator new is not replaced)
+extern size_t GetMemoryAllocations();
 
 struct MemoryManager {
     MemoryManager() { InitilizeMemoryManager(); }
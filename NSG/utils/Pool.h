@@ -28,11 +28,25 @@ misrepresented as being the original software.
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <mutex>
 #include <new>
 
 namespace NSG {
+// Per size class counters. Objects in the thread caches count as allocated.
+struct PoolStats {
+    size_t objSize_;
+    size_t chunks_;
+    size_t capacity_;
+    size_t allocated_;
+    size_t peakAllocated_;
+    size_t refills_; // batches moved from the shared list to a thread cache
+    size_t flushes_; // batches moved back
+};
+
 struct IPool {
     virtual void* Allocate(std::size_t count) = 0;
     virtual void DeAllocate(void* ptr) = 0;
@@ -40,25 +54,35 @@ struct IPool {
     virtual size_t GetObjSize() const = 0;
     virtual unsigned GetAllocatedObjects() const = 0;
     virtual bool PointerInPool(void* p) const = 0;
+    virtual PoolStats GetStats() const = 0;
 };
 
-struct MemHeader {
+// Keeps the memory blocks aligned as malloc does
+struct alignas(std::max_align_t) MemHeader {
     void* poolPointer_;
+    uint32_t index_; // object index in its pool
 };
 
-/// A lock-free thread safe pool that does not suffer the ABA problem
+/// A lock-free thread safe pool that grows by chunks.
+/// The shared free list links objects by index and its head carries a tag
+/// that changes with every update, so a compare and swap made with a stale
+/// head always fails (no ABA problem). Each thread keeps a small cache of
+/// free objects that is refilled and flushed in batches with a single
+/// compare and swap. The pool must outlive the threads using it.
 template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
 class Pool : public IPool {
 public:
     struct MemObj {
         MemHeader header_;
         union {
-            MemObj* nextMemObj_;
+            std::atomic<uint32_t> nextMemObj_; // index + 1, 0 ends the list
             char memBlock_[OBJECT_SIZE];
         };
     };
 
     static const size_t ChunkSize = sizeof(MemObj) * OBJECTS_PER_CHUNK;
+    static const size_t MaxChunks = 1024;
+    static const size_t CacheSize = 64;
 
     Pool();
     ~Pool();
@@ -66,84 +90,259 @@ public:
     Pool& operator=(const Pool&) = delete;
     void* Allocate(std::size_t count) override;
     void DeAllocate(void* ptr) override;
-    unsigned GetAllocatedObjects() const override { return allocatedObjs_; }
-    size_t GetObjSize() const override { return OBJECT_SIZE; }
-    bool PointerInPool(void* p) const override {
-        return p >= begin_ && p < end_;
+    unsigned GetAllocatedObjects() const override {
+        return (unsigned)allocatedObjs_;
     }
+    size_t GetObjSize() const override { return OBJECT_SIZE; }
+    bool PointerInPool(void* p) const override;
+    PoolStats GetStats() const override;
     void LogStatus();
 
 private:
     typedef MemObj* PMemObj;
-    std::atomic<PMemObj> freeList_;
-    void* begin_;
-    void* end_;
-    std::atomic<unsigned> allocatedObjs_;
+    struct ThreadCache {
+        Pool* owner_;
+        size_t count_;
+        MemObj* objs_[CacheSize];
+        bool alive_; // false once the thread is exiting
+        ~ThreadCache() {
+            SetOwner(nullptr);
+            alive_ = false;
+        }
+        void SetOwner(Pool* owner) {
+            if (owner_ && count_)
+                owner_->ReturnList(objs_, count_);
+            owner_ = owner;
+            count_ = 0;
+        }
+    };
+    static ThreadCache& GetThreadCache() {
+        static thread_local ThreadCache cache{nullptr, 0, {}, true};
+        return cache;
+    }
+    static uint32_t GetIndex(uint64_t head) { return (uint32_t)head; }
+    static uint64_t MakeHead(uint32_t index, uint64_t oldHead) {
+        return ((oldHead >> 32) + 1) << 32 | index;
+    }
+    PMemObj GetObj(uint32_t index) const;
+    size_t PopList(PMemObj* objs, size_t maxObjs);
+    void PushList(PMemObj const* objs, size_t nObjs);
+    void ReturnList(PMemObj const* objs, size_t nObjs);
+    bool Grow();
+    void UpdateAllocated(ptrdiff_t objs);
+    std::atomic<uint64_t> freeList_; // tag << 32 | index + 1
+    std::atomic<PMemObj> chunks_[MaxChunks];
+    std::atomic<size_t> nChunks_;
+    std::mutex growMutex_;
+    std::atomic<size_t> allocatedObjs_;
+    std::atomic<size_t> peakAllocatedObjs_;
+    std::atomic<size_t> refills_;
+    std::atomic<size_t> flushes_;
 };
 
 template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
 Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::Pool()
-    : freeList_(nullptr), allocatedObjs_(0) {
-    LOGI("Creating pool: object size=%lu objs/chunk=%lu", OBJECT_SIZE,
-         OBJECTS_PER_CHUNK);
-    void* p = std::malloc(ChunkSize);
-    if (!p)
-        exit(1);
-    begin_ = p;
-    end_ = (char*)p + ChunkSize;
+    : freeList_(0), nChunks_(0), allocatedObjs_(0), peakAllocatedObjs_(0),
+      refills_(0), flushes_(0) {
+    static_assert(OBJECT_SIZE >= sizeof(uint32_t), "Object size too small");
+    static_assert(MaxChunks * OBJECTS_PER_CHUNK < UINT32_MAX,
+                  "Too many objects per chunk");
+    // No allocations here: the pools are created inside operator new
+    for (auto& chunk : chunks_)
+        chunk.store(nullptr, std::memory_order_relaxed);
+}
 
-    // Constructs the empty list.
-    PMemObj next = (PMemObj)p;
-    PMemObj previous;
-    for (size_t i = 0; i < OBJECTS_PER_CHUNK; i++) {
-        previous = next;
-        next = (PMemObj)((char*)next + sizeof(MemObj));
-        previous->header_.poolPointer_ = this;
-        previous->nextMemObj_ = next;
+template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
+Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::~Pool() {
+    auto& cache = GetThreadCache();
+    if (cache.owner_ == this) {
+        cache.owner_ = nullptr;
+        cache.count_ = 0;
     }
-    previous->nextMemObj_ = nullptr;
+    for (size_t i = 0; i < nChunks_; i++)
+        std::free(chunks_[i].load());
+}
 
-    freeList_.store((PMemObj)p);
+template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
+bool Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::PointerInPool(void* p) const {
+    auto n = nChunks_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; i++) {
+        auto chunk = (char*)chunks_[i].load(std::memory_order_relaxed);
+        if (p >= chunk && p < chunk + ChunkSize)
+            return true;
+    }
+    return false;
 }
 
 template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
-Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::~Pool() {
-    LOGI("Destroying pool: object size=%lu objs/chunk=%lu", OBJECT_SIZE,
-         OBJECTS_PER_CHUNK);
-    std::free(begin_);
+PoolStats Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::GetStats() const {
+    return PoolStats{OBJECT_SIZE,      nChunks_,
+                     nChunks_ * OBJECTS_PER_CHUNK,
+                     allocatedObjs_,   peakAllocatedObjs_,
+                     refills_,         flushes_};
 }
 
 template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
 void Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::LogStatus() {
-    LOGI(
-        "Pool Status: object size=%lu  objs/chunk=%ld still allocated objs=%lu",
-        OBJECT_SIZE, OBJECTS_PER_CHUNK, allocatedObjs_);
+    auto stats = GetStats();
+    LOGI("Pool Status: object size=%u chunks=%u capacity=%u allocated=%u "
+         "peak=%u refills=%u flushes=%u",
+         (unsigned)stats.objSize_, (unsigned)stats.chunks_,
+         (unsigned)stats.capacity_, (unsigned)stats.allocated_,
+         (unsigned)stats.peakAllocated_, (unsigned)stats.refills_,
+         (unsigned)stats.flushes_);
+}
+
+template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
+typename Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::PMemObj
+Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::GetObj(uint32_t index) const {
+    // index + 1 as stored in the lists
+    auto chunk = (index - 1) / OBJECTS_PER_CHUNK;
+    if (!index || chunk >= MaxChunks)
+        return nullptr;
+    auto p = chunks_[chunk].load(std::memory_order_acquire);
+    return p ? p + (index - 1) % OBJECTS_PER_CHUNK : nullptr;
+}
+
+template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
+size_t Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::PopList(PMemObj* objs,
+                                                     size_t maxObjs) {
+    auto head = freeList_.load(std::memory_order_acquire);
+    for (;;) {
+        auto index = GetIndex(head);
+        if (!index)
+            return 0;
+        // Other threads may be popping the same objects: the links read
+        // here can be stale, then the tag check makes the swap fail.
+        size_t n = 0;
+        auto next = index;
+        while (next && n < maxObjs) {
+            auto p = GetObj(next);
+            if (!p)
+                break;
+            objs[n++] = p;
+            next = p->nextMemObj_.load(std::memory_order_relaxed);
+        }
+        if (n && freeList_.compare_exchange_weak(head, MakeHead(next, head),
+                                                 std::memory_order_acquire))
+            return n;
+        if (!n)
+            head = freeList_.load(std::memory_order_acquire);
+    }
+}
+
+template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
+void Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::PushList(PMemObj const* objs,
+                                                    size_t nObjs) {
+    for (size_t i = 0; i + 1 < nObjs; i++)
+        objs[i]->nextMemObj_.store(objs[i + 1]->header_.index_,
+                                   std::memory_order_relaxed);
+    auto first = objs[0]->header_.index_;
+    auto last = objs[nObjs - 1];
+    auto head = freeList_.load(std::memory_order_relaxed);
+    do {
+        last->nextMemObj_.store(GetIndex(head), std::memory_order_relaxed);
+    } while (!freeList_.compare_exchange_weak(head, MakeHead(first, head),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+}
+
+template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
+void Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::ReturnList(PMemObj const* objs,
+                                                      size_t nObjs) {
+    PushList(objs, nObjs);
+    ++flushes_;
+    UpdateAllocated(-(ptrdiff_t)nObjs);
+}
+
+template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
+bool Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::Grow() {
+    std::lock_guard<std::mutex> lock(growMutex_);
+    if (GetIndex(freeList_.load()))
+        return true; // another thread has released or grown meanwhile
+    auto n = nChunks_.load();
+    if (n == MaxChunks)
+        return false;
+    auto p = (PMemObj)std::malloc(ChunkSize);
+    if (!p)
+        return false;
+    // Constructs the list of the new chunk
+    auto base = (uint32_t)(n * OBJECTS_PER_CHUNK) + 1;
+    for (size_t i = 0; i < OBJECTS_PER_CHUNK; i++) {
+        auto obj = new (p + i) MemObj;
+        obj->header_.poolPointer_ = this;
+        obj->header_.index_ = base + (uint32_t)i;
+        obj->nextMemObj_.store(
+            i + 1 < OBJECTS_PER_CHUNK ? base + (uint32_t)i + 1 : 0,
+            std::memory_order_relaxed);
+    }
+    chunks_[n].store(p, std::memory_order_release);
+    nChunks_.store(n + 1, std::memory_order_release);
+    auto last = p + OBJECTS_PER_CHUNK - 1;
+    auto head = freeList_.load(std::memory_order_relaxed);
+    do {
+        last->nextMemObj_.store(GetIndex(head), std::memory_order_relaxed);
+    } while (!freeList_.compare_exchange_weak(head, MakeHead(base, head),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    return true;
+}
+
+template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
+void Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::UpdateAllocated(ptrdiff_t objs) {
+    auto allocated = allocatedObjs_.fetch_add(objs) + objs;
+    auto peak = peakAllocatedObjs_.load(std::memory_order_relaxed);
+    while (allocated > peak &&
+           !peakAllocatedObjs_.compare_exchange_weak(peak, allocated))
+        ;
 }
 
 template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
 void* Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::Allocate(std::size_t count) {
     assert(count <= OBJECT_SIZE);
-    PMemObj p;
-    do {
-        p = freeList_;
-        if (!p)
-            return nullptr;
-    } while (
-        !std::atomic_compare_exchange_weak(&freeList_, &p, p->nextMemObj_));
-    ++allocatedObjs_;
-    return (void*)(p->memBlock_);
+    auto& cache = GetThreadCache();
+    if (!cache.alive_) {
+        PMemObj p;
+        while (!PopList(&p, 1))
+            if (!Grow())
+                return nullptr;
+        UpdateAllocated(1);
+        return (void*)(p->memBlock_);
+    }
+    if (cache.owner_ != this)
+        cache.SetOwner(this);
+    if (!cache.count_) {
+        size_t n;
+        while (!(n = PopList(cache.objs_, CacheSize / 2)))
+            if (!Grow())
+                return nullptr;
+        cache.count_ = n;
+        ++refills_;
+        UpdateAllocated(n);
+    }
+    return (void*)(cache.objs_[--cache.count_]->memBlock_);
 }
 
 template <size_t OBJECT_SIZE, size_t OBJECTS_PER_CHUNK>
 void Pool<OBJECT_SIZE, OBJECTS_PER_CHUNK>::DeAllocate(void* obj) {
-    if (obj && obj >= begin_ && obj < end_) {
-        obj = (char*)obj - sizeof(MemHeader);
-        PMemObj p((PMemObj)obj);
-        do {
-            p->nextMemObj_ = freeList_;
-        } while (!std::atomic_compare_exchange_weak(&freeList_,
-                                                    &(p->nextMemObj_), p));
-        --allocatedObjs_;
+    if (!obj)
+        return;
+    auto p = (PMemObj)((char*)obj - sizeof(MemHeader));
+    assert(p->header_.poolPointer_ == this);
+    auto& cache = GetThreadCache();
+    if (!cache.alive_) {
+        ReturnList(&p, 1);
+        return;
+    }
+    if (cache.owner_ != this)
+        cache.SetOwner(this);
+    if (cache.count_ == CacheSize) {
+        // returns the oldest half to the shared list
+        const auto n = CacheSize / 2;
+        ReturnList(cache.objs_, n);
+        std::copy(cache.objs_ + n, cache.objs_ + CacheSize, cache.objs_);
+        cache.count_ -= n;
     }
+    cache.objs_[cache.count_++] = p;
 }
 }
@@ -0,0 +1,326 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Profiler.h"
+#include "Log.h"
+#ifdef USE_PROFILER
+#include "Check.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace NSG {
+struct ZoneEvent {
+    const char* name_;
+    uint64_t begin_;
+    uint64_t end_;
+    unsigned depth_;
+};
+
+struct ThreadBuffer {
+    std::mutex mtx_;
+    std::vector<ZoneEvent> events_; // ring
+    uint64_t written_;
+    uint64_t reported_; // written_ in the last NewFrame
+    std::string name_;
+    unsigned tid_;
+    // zones still open, only used by the owner thread
+    unsigned depth_;
+    const char* names_[Profiler::MAX_DEPTH];
+    uint64_t begins_[Profiler::MAX_DEPTH];
+    ThreadBuffer(unsigned tid)
+        : events_(Profiler::EVENTS_PER_THREAD), written_(0), reported_(0),
+          name_("thread " + std::to_string(tid)), tid_(tid), depth_(0) {}
+};
+
+static const int MAX_COUNTERS = (int)ProfileCounter::MAX_COUNTERS;
+
+struct ProfilerState {
+    std::mutex mtx_;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    std::atomic<unsigned> counters_[MAX_COUNTERS];
+    uint64_t frameBegin_;
+    Profiler::FrameStats last_;
+    std::deque<Profiler::FrameStats> frames_; // without zones
+    ProfilerState() : frameBegin_(Profiler::GetTime()), last_() {
+        for (auto& counter : counters_)
+            counter = 0;
+    }
+};
+
+static ProfilerState& GetState() {
+    static ProfilerState state;
+    return state;
+}
+
+static thread_local ThreadBuffer* tlsBuffer = nullptr;
+
+static ThreadBuffer* GetBuffer() {
+    if (!tlsBuffer) {
+        auto& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mtx_);
+        auto tid = (unsigned)state.buffers_.size() + 1;
+        state.buffers_.push_back(
+            std::unique_ptr<ThreadBuffer>(new ThreadBuffer(tid)));
+        tlsBuffer = state.buffers_.back().get();
+    }
+    return tlsBuffer;
+}
+
+uint64_t Profiler::GetTime() {
+    typedef std::chrono::steady_clock Clock;
+    static const Clock::time_point start = Clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                start)
+        .count();
+}
+
+void Profiler::BeginZone(const char* name) {
+    auto buffer = GetBuffer();
+    auto depth = buffer->depth_++;
+    if (depth < MAX_DEPTH) {
+        buffer->names_[depth] = name;
+        buffer->begins_[depth] = GetTime();
+    }
+}
+
+void Profiler::EndZone() {
+    auto buffer = GetBuffer();
+    CHECK_ASSERT(buffer->depth_ > 0);
+    auto depth = --buffer->depth_;
+    if (depth < MAX_DEPTH) {
+        ZoneEvent event{buffer->names_[depth], buffer->begins_[depth],
+                        GetTime(), depth};
+        std::lock_guard<std::mutex> lock(buffer->mtx_);
+        buffer->events_[buffer->written_++ % EVENTS_PER_THREAD] = event;
+    }
+}
+
+void Profiler::Count(ProfileCounter counter, unsigned n) {
+    GetState().counters_[(int)counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+unsigned Profiler::GetCount(ProfileCounter counter) {
+    return GetState().counters_[(int)counter].load(std::memory_order_relaxed);
+}
+
+const char* Profiler::GetCounterName(ProfileCounter counter) {
+    static const char* names[MAX_COUNTERS] = {
+        "draw calls", "program switches", "VAO binds",   "uniform uploads",
+        "batches",    "visible nodes",    "octree nodes", "occluded nodes"};
+    return names[(int)counter];
+}
+
+void Profiler::SetThreadName(const std::string& name) {
+    auto buffer = GetBuffer();
+    std::lock_guard<std::mutex> lock(buffer->mtx_);
+    buffer->name_ = name;
+}
+
+// Events not reported yet, the oldest ones are lost if the ring is full
+static void TakeEvents(ThreadBuffer& buffer, std::vector<ZoneEvent>& events) {
+    std::lock_guard<std::mutex> lock(buffer.mtx_);
+    auto first = std::max(buffer.reported_,
+                          buffer.written_ >= Profiler::EVENTS_PER_THREAD
+                              ? buffer.written_ - Profiler::EVENTS_PER_THREAD
+                              : 0);
+    for (auto i = first; i < buffer.written_; i++)
+        events.push_back(buffer.events_[i % Profiler::EVENTS_PER_THREAD]);
+    buffer.reported_ = buffer.written_;
+}
+
+static void AddZone(std::vector<Profiler::ZoneStats>& zones, size_t index,
+                    const ZoneEvent& event) {
+    if (index == zones.size())
+        zones.push_back(Profiler::ZoneStats{event.name_, event.depth_, 0, 0});
+    auto& zone = zones[index];
+    ++zone.calls_;
+    zone.ms_ += (event.end_ - event.begin_) / 1e6;
+}
+
+static bool BeginsBefore(const ZoneEvent& a, const ZoneEvent& b) {
+    return a.begin_ < b.begin_ || (a.begin_ == b.begin_ && a.depth_ < b.depth_);
+}
+
+// Adds the calls of the same zone with the same parent
+static void BuildCallTree(std::vector<ZoneEvent>& events,
+                          std::vector<Profiler::ZoneStats>& zones) {
+    std::sort(events.begin(), events.end(), BeginsBefore);
+    std::map<std::pair<int, std::string>, size_t> indexes;
+    std::vector<int> parents; // zone index of each depth
+    for (auto& event : events) {
+        parents.resize(std::min<size_t>(parents.size(), event.depth_));
+        auto parent = parents.empty() ? -1 : parents.back();
+        auto key = std::make_pair(parent, std::string(event.name_));
+        auto it = indexes.insert(std::make_pair(key, zones.size())).first;
+        AddZone(zones, it->second, event);
+        parents.push_back((int)it->second);
+    }
+}
+
+static void AddByName(std::vector<ZoneEvent>& events,
+                      std::vector<Profiler::ZoneStats>& zones) {
+    std::sort(events.begin(), events.end(), BeginsBefore);
+    std::map<std::pair<unsigned, std::string>, size_t> indexes;
+    for (auto& event : events) {
+        auto key = std::make_pair(event.depth_, std::string(event.name_));
+        auto it = indexes.insert(std::make_pair(key, zones.size())).first;
+        AddZone(zones, it->second, event);
+    }
+}
+
+void Profiler::NewFrame() {
+    auto& state = GetState();
+    auto owner = GetBuffer();
+    auto now = GetTime();
+    FrameStats stats;
+    stats.begin_ = state.frameBegin_;
+    stats.ms_ = (now - state.frameBegin_) / 1e6;
+    for (int i = 0; i < MAX_COUNTERS; i++)
+        stats.counters_[i] =
+            state.counters_[i].exchange(0, std::memory_order_relaxed);
+
+    std::vector<ZoneEvent> events;
+    std::vector<ZoneEvent> workerEvents;
+    {
+        std::lock_guard<std::mutex> lock(state.mtx_);
+        for (auto& buffer : state.buffers_)
+            TakeEvents(*buffer, buffer.get() == owner ? events : workerEvents);
+    }
+    BuildCallTree(events, stats.zones_);
+    AddByName(workerEvents, stats.workerZones_);
+
+    state.last_ = stats;
+    stats.zones_.clear();
+    stats.workerZones_.clear();
+    state.frames_.push_back(stats);
+    if (state.frames_.size() > MAX_FRAMES)
+        state.frames_.pop_front();
+    state.frameBegin_ = now;
+}
+
+const Profiler::FrameStats& Profiler::GetLastFrame() { return GetState().last_; }
+
+void Profiler::Clear() {
+    auto& state = GetState();
+    {
+        std::lock_guard<std::mutex> lock(state.mtx_);
+        for (auto& buffer : state.buffers_) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mtx_);
+            buffer->written_ = buffer->reported_ = 0;
+        }
+    }
+    for (auto& counter : state.counters_)
+        counter = 0;
+    state.frames_.clear();
+    state.last_ = FrameStats();
+    state.frameBegin_ = GetTime();
+}
+
+static void AppendString(std::string& json, const std::string& str) {
+    json += '"';
+    for (auto c : str) {
+        if (c == '"' || c == '\\')
+            json += '\\';
+        if ((unsigned char)c >= ' ')
+            json += c;
+    }
+    json += '"';
+}
+
+static void AppendTime(std::string& json, const char* key, uint64_t ns) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), ",\"%s\":%.3f", key, ns / 1000.0);
+    json += buffer;
+}
+
+std::string Profiler::GetChromeTrace() {
+    auto& state = GetState();
+    std::string json = "{\"traceEvents\":[";
+    bool first = true;
+    auto beginEvent = [&](const char* phase, const std::string& name,
+                          unsigned tid) {
+        json += first ? "\n{\"name\":" : ",\n{\"name\":";
+        first = false;
+        AppendString(json, name);
+        json += ",\"ph\":\"";
+        json += phase;
+        json += "\",\"pid\":0,\"tid\":" + std::to_string(tid);
+    };
+    {
+        std::lock_guard<std::mutex> lock(state.mtx_);
+        for (auto& buffer : state.buffers_) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mtx_);
+            beginEvent("M", "thread_name", buffer->tid_);
+            json += ",\"args\":{\"name\":";
+            AppendString(json, buffer->name_);
+            json += "}}";
+            auto oldest = buffer->written_ >= EVENTS_PER_THREAD
+                              ? buffer->written_ - EVENTS_PER_THREAD
+                              : 0;
+            for (auto i = oldest; i < buffer->written_; i++) {
+                auto& event = buffer->events_[i % EVENTS_PER_THREAD];
+                beginEvent("X", event.name_, buffer->tid_);
+                AppendTime(json, "ts", event.begin_);
+                AppendTime(json, "dur", event.end_ - event.begin_);
+                json += '}';
+            }
+        }
+    }
+    for (auto& frame : state.frames_) {
+        beginEvent("C", "counters", 0);
+        AppendTime(json, "ts", frame.begin_);
+        json += ",\"args\":{";
+        for (int i = 0; i < MAX_COUNTERS; i++) {
+            if (i)
+                json += ',';
+            AppendString(json, GetCounterName((ProfileCounter)i));
+            json += ':' + std::to_string(frame.counters_[i]);
+        }
+        json += "}}";
+    }
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return json;
+}
+
+bool Profiler::SaveChromeTrace(const std::string& path) {
+    std::ofstream file(path.c_str(), std::ios::binary);
+    auto json = GetChromeTrace();
+    file.write(json.c_str(), json.size());
+    if (!file.good()) {
+        LOGE("Cannot save profiler trace in %s", path.c_str());
+        return false;
+    }
+    LOGI("Profiler trace saved in %s", path.c_str());
+    return true;
+}
+}
+#endif
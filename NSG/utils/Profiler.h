@@ -0,0 +1,115 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+// Zones and counters are only collected when the build defines USE_PROFILER
+#ifdef USE_PROFILER
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace NSG {
+enum class ProfileCounter {
+    DRAW_CALLS,
+    PROGRAM_SWITCHES,
+    VAO_BINDS,
+    UNIFORM_UPLOADS,
+    BATCHES,
+    VISIBLE_NODES,
+    OCTREE_NODES,
+    OCCLUDED_NODES,
+    MAX_COUNTERS
+};
+
+/// Hierarchical CPU profiler.
+/// Every thread records its zones in its own ring buffer, so zones can be
+/// opened from the job system workers. Zone names must be string literals
+/// (only the pointer is stored). NewFrame closes the statistics of the frame
+/// and GetChromeTrace dumps the buffers in the JSON format of about:tracing.
+class Profiler {
+public:
+    static const size_t EVENTS_PER_THREAD = 16384; // ring buffer size
+    static const size_t MAX_FRAMES = 300; // frames kept for the trace
+    static const unsigned MAX_DEPTH = 64;
+
+    struct ZoneStats {
+        const char* name_;
+        unsigned depth_;
+        unsigned calls_;
+        double ms_;
+    };
+
+    struct FrameStats {
+        uint64_t begin_; // ns
+        double ms_;
+        unsigned counters_[(int)ProfileCounter::MAX_COUNTERS];
+        // zones of the thread calling NewFrame in call tree order
+        std::vector<ZoneStats> zones_;
+        // zones of the other threads added by name
+        std::vector<ZoneStats> workerZones_;
+    };
+
+    static void BeginZone(const char* name);
+    static void EndZone();
+    static void Count(ProfileCounter counter, unsigned n = 1);
+    // Value in the current frame
+    static unsigned GetCount(ProfileCounter counter);
+    static const char* GetCounterName(ProfileCounter counter);
+    // Name of the calling thread in the trace
+    static void SetThreadName(const std::string& name);
+    // Ends the current frame (to be called by the thread owning the frame)
+    static void NewFrame();
+    static const FrameStats& GetLastFrame();
+    // Removes the recorded zones and frames
+    static void Clear();
+    static std::string GetChromeTrace();
+    static bool SaveChromeTrace(const std::string& path);
+    // ns since the start of the profiler
+    static uint64_t GetTime();
+};
+
+class ProfileZone {
+public:
+    ProfileZone(const char* name) { Profiler::BeginZone(name); }
+    ~ProfileZone() { Profiler::EndZone(); }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+};
+}
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name)                                                     \
+    NSG::ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_COUNT(counter, n)                                              \
+    NSG::Profiler::Count(NSG::ProfileCounter::counter, n)
+#define PROFILE_FRAME() NSG::Profiler::NewFrame()
+#define PROFILE_THREAD(name) NSG::Profiler::SetThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_COUNT(counter, n) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
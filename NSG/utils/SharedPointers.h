@@ -64,6 +64,8 @@ typedef std::weak_ptr<Animation> PWeakAnimation;
 
 class AnimationController;
 typedef std::shared_ptr<AnimationController> PAnimationController;
+class AnimationCrowd;
+typedef std::shared_ptr<AnimationCrowd> PAnimationCrowd;
 
 struct AnimationControl;
 typedef std::shared_ptr<AnimationControl> PAnimationControl;
@@ -77,6 +79,9 @@ typedef std::shared_ptr<Ray> PRay;
 class Octree;
 typedef std::shared_ptr<Octree> POctree;
 
+class OcclusionBuffer;
+typedef std::shared_ptr<OcclusionBuffer> POcclusionBuffer;
+
 struct BoundingBox;
 typedef std::shared_ptr<BoundingBox> PBoundingBox;
 
@@ -178,6 +183,9 @@ typedef std::unique_ptr<FragmentShader> PFragmentShader;
 class IndexBuffer;
 typedef std::unique_ptr<IndexBuffer> PIndexBuffer;
 
+class MeshBVH;
+typedef std::unique_ptr<MeshBVH> PMeshBVH;
+
 class VertexArrayObj;
 typedef std::shared_ptr<VertexArrayObj> PVertexArrayObj;
 
@@ -236,6 +244,9 @@ class Node;
 typedef std::shared_ptr<Node> PNode;
 typedef std::weak_ptr<Node> PWeakNode;
 
+class TransformHierarchy;
+typedef std::unique_ptr<TransformHierarchy> PTransformHierarchy;
+
 class Bone;
 typedef std::shared_ptr<Bone> PBone;
 
@@ -105,7 +105,8 @@ typedef Clock::time_point TimePoint;
 
 enum class Intersection { OUTSIDE, INTERSECTS, INSIDE };
 
-typedef unsigned short IndexType;
+// 32 bits on the CPU side, IndexBuffer uploads 16 bits when the mesh allows it
+typedef unsigned IndexType;
 
 enum class AttributesLoc {
     POSITION,
@@ -327,9 +328,14 @@ enum ParticleSystemEmitFrom { PS_EF_VERTS, PS_EF_ORIGIN };
 
 enum ParticleSystemDistribution { LINEARY, RANDOM };
 
+// NODES: one SceneNode + RigidBody per particle
+// ARRAYS: particles simulated in contiguous arrays and drawn instanced
+enum class ParticleSystemMode { NODES, ARRAYS };
+
 enum class SceneNodeFlag {
     NONE = 0,
     ALLOW_RAY_QUERY = 1 << 0,
+    OCCLUDER = 1 << 1, // hides nodes (see Scene::EnableOcclusionCulling)
 };
 
 typedef FlagSet<SceneNodeFlag> SceneNodeFlags;
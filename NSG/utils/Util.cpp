@@ -32,6 +32,7 @@ misrepresented as being the original software.
 #include "lz4.h"
 #include "pugixml.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cstdio>
 #include <fstream>
@@ -88,6 +89,14 @@ std::string GetUniqueName(const std::string& name) {
     return buffer;
 }
 
+// Monotonically increasing: a stamp taken later is always greater, so
+// objects can detect that something they depend on changed after them.
+unsigned NewVariationStamp() {
+    // meshes get stamps while they are parsed in workers (see LoaderXML)
+    static std::atomic<unsigned> counter(0);
+    return ++counter;
+}
+
 unsigned short Transform(unsigned char selected[4]) {
     auto b3 = (unsigned short)selected[3] / 0x10;
     auto b2 = (unsigned short)selected[2] / 0x10;
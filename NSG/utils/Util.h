@@ -40,6 +40,7 @@ Vector3 ToVector3(const btVector3& obj);
 btQuaternion ToBtQuaternion(const Quaternion& q);
 Quaternion ToQuaternion(const btQuaternion& q);
 std::string GetUniqueName(const std::string& name = "");
+unsigned NewVariationStamp();
 unsigned short Transform(unsigned char selected[4]);
 Color Transform(unsigned short id);
 std::string CompressBuffer(const std::string& buf);
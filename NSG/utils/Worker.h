@@ -28,6 +28,9 @@ misrepresented as being the original software.
 #include <thread>
 
 namespace NSG {
+/// Dedicated thread of a QueuedTask. It is not a JobSystem job: the queue
+/// blocks on its condition for the whole application life and runs its tasks
+/// in FIFO order, which would stall a worker of the pool.
 class Worker {
 public:
     Worker(const std::string& name);
@@ -40,6 +40,7 @@ misrepresented as being the original software.
 #include "Material.h"
 #include "OSXWindow.h"
 #include "Pass.h"
+#include "Profiler.h"
 #include "Program.h"
 #include "QuadMesh.h"
 #include "Renderer.h"
@@ -333,6 +334,32 @@ bool Window::AreAllWindowsMinimized() {
     return true;
 }
 
+// Zones and counters of the last frame
+static void ShowStatistics() {
+#ifdef USE_PROFILER
+    auto& frame = Profiler::GetLastFrame();
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoTitleBar |
+                                   ImGuiWindowFlags_NoMove |
+                                   ImGuiWindowFlags_AlwaysAutoResize;
+    ImGui::SetNextWindowPos(ImVec2(10, 10));
+    if (ImGui::Begin("Statistics", nullptr, ImVec2(0, 0), 0.5f, flags)) {
+        ImGui::Text("frame %.2f ms", frame.ms_);
+        for (auto zones : {&frame.zones_, &frame.workerZones_}) {
+            if (!zones->empty())
+                ImGui::Separator();
+            for (auto& zone : *zones)
+                ImGui::Text("%*s%s %.2f ms (%u)", 2 * (int)zone.depth_, "",
+                            zone.name_, zone.ms_, zone.calls_);
+        }
+        ImGui::Separator();
+        for (int i = 0; i < (int)ProfileCounter::MAX_COUNTERS; i++)
+            ImGui::Text("%s %u", Profiler::GetCounterName((ProfileCounter)i),
+                        frame.counters_[i]);
+    }
+    ImGui::End();
+#endif
+}
+
 void Window::RenderFrame() {
     if (IsReady()) {
         if (render_)
@@ -340,9 +367,13 @@ void Window::RenderFrame() {
         else {
             auto scene = scene_.lock();
             renderer_->Render(this, scene.get());
-            if (SigDrawIMGUI()->HasSlots()) {
-                gui_->Render(SharedFromPointer(this),
-                             [this]() { SigDrawIMGUI()->Run(); });
+            auto statistics = Engine::GetAppConfiguration().showStatistics_;
+            if (statistics || SigDrawIMGUI()->HasSlots()) {
+                gui_->Render(SharedFromPointer(this), [this, statistics]() {
+                    if (statistics)
+                        ShowStatistics();
+                    SigDrawIMGUI()->Run();
+                });
             }
         }
         SwapWindowBuffers();
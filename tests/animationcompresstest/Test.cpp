@@ -0,0 +1,213 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+#include <cmath>
+using namespace NSG;
+
+static const float LENGTH = 10;
+static const int KEYS = 601; // 60 key frames per second
+
+static AnimationTrack CreateTrack(const std::string& name, int keys,
+                                  float phase) {
+    AnimationTrack track;
+    track.nodeName_ = name;
+    track.channelMask_ =
+        (int)AnimationChannel::POSITION | (int)AnimationChannel::ROTATION;
+    for (int k = 0; k < keys; k++) {
+        AnimationKeyFrame keyFrame;
+        keyFrame.time_ = k * LENGTH / (keys - 1);
+        auto angle = keyFrame.time_ + phase;
+        keyFrame.position_ =
+            Vector3(std::sin(angle), 0.5f * std::cos(2 * angle), phase);
+        keyFrame.rotation_ = Quaternion(std::sin(angle) * PI90,
+                                        Vector3(1, 2, 3).Normalize());
+        keyFrame.mask_ = track.channelMask_;
+        track.keyFrames_.push_back(keyFrame);
+    }
+    return track;
+}
+
+static PAnimation CreateAnimation(const std::string& name) {
+    auto animation = Animation::Create(name);
+    animation->SetLength(LENGTH);
+    for (int i = 0; i < 4; i++)
+        animation->AddTrack(CreateTrack("bone" + ToString(i), KEYS, 0.3f * i));
+    return animation;
+}
+
+struct Error {
+    float position_;
+    float rotation_;
+};
+
+// Maximum error of the samples of a clip at every quarter of frame
+static Error GetError(PAnimation original, PAnimation clip, bool looped) {
+    Error error{0, 0};
+    auto& tracks = original->GetTracks();
+    for (size_t i = 0; i < tracks.size(); i++) {
+        size_t cursor0 = 0, cursor1 = 0;
+        for (int k = 0; k < 4 * KEYS; k++) {
+            auto time = k * LENGTH / (4 * (KEYS - 1));
+            Vector3 position0, position1, scale;
+            Quaternion rotation0, rotation1;
+            tracks[i].Sample(time, LENGTH, looped, cursor0, position0,
+                             rotation0, scale);
+            clip->GetTracks()[i].Sample(time, LENGTH, looped, cursor1,
+                                        position1, rotation1, scale);
+            error.position_ =
+                std::max(error.position_, position0.Distance(position1));
+            error.rotation_ =
+                std::max(error.rotation_, rotation0.Angle(rotation1));
+        }
+    }
+    return error;
+}
+
+// Constant channels keep a single value
+static void Test01() {
+    auto animation = Animation::Create("constant");
+    animation->SetLength(LENGTH);
+    AnimationTrack track;
+    track.nodeName_ = "bone";
+    track.channelMask_ = (int)AnimationChannel::ALL;
+    for (int k = 0; k < KEYS; k++) {
+        AnimationKeyFrame keyFrame;
+        keyFrame.time_ = k * LENGTH / (KEYS - 1);
+        keyFrame.position_ = Vector3(1, 2, 3);
+        keyFrame.rotation_ = Quaternion(0.7f, Vector3(0, 1, 0));
+        keyFrame.scale_ = Vector3(2);
+        keyFrame.mask_ = track.channelMask_;
+        track.keyFrames_.push_back(keyFrame);
+    }
+    animation->AddTrack(track);
+    auto original = animation->Clone();
+    animation->Compress();
+    auto& compressed = animation->GetTracks()[0];
+    CHECK_CONDITION(compressed.keyFrames_.empty());
+    CHECK_CONDITION(compressed.HasKeyFrames());
+    CHECK_CONDITION(compressed.compressed_.position_.times_.empty());
+    CHECK_CONDITION(compressed.compressed_.rotation_.times_.empty());
+    CHECK_CONDITION(compressed.compressed_.scale_.times_.empty());
+    CHECK_CONDITION(100 * animation->GetSize() < original->GetSize());
+    size_t cursor = 0;
+    Vector3 position, scale;
+    Quaternion rotation;
+    compressed.Sample(3.3f, LENGTH, true, cursor, position, rotation, scale);
+    CHECK_CONDITION(position == Vector3(1, 2, 3));
+    CHECK_CONDITION(scale == Vector3(2));
+    CHECK_CONDITION(rotation.Angle(Quaternion(0.7f, Vector3(0, 1, 0))) < 1e-4f);
+}
+
+// The keys are reduced inside the errors of the settings and the values are
+// quantized, with and without looping
+static void Test02() {
+    auto animation = CreateAnimation("curves");
+    auto original = animation->Clone();
+    AnimationCompression settings;
+    animation->Compress(settings);
+    auto ratio = (float)original->GetSize() / animation->GetSize();
+    printf("%u -> %u bytes (%.1f:1)\n", (unsigned)original->GetSize(),
+           (unsigned)animation->GetSize(), ratio);
+    CHECK_CONDITION(ratio > 8);
+    for (auto looped : {false, true}) {
+        auto error = GetError(original, animation, looped);
+        printf("max error: position %g, rotation %g radians\n",
+               error.position_, error.rotation_);
+        CHECK_CONDITION(error.position_ < 2 * settings.positionError_);
+        CHECK_CONDITION(error.rotation_ < 2 * settings.rotationError_);
+    }
+    // a linear channel needs only its ends
+    AnimationTrack track;
+    track.channelMask_ = (int)AnimationChannel::POSITION;
+    for (int k = 0; k < KEYS; k++) {
+        AnimationKeyFrame keyFrame;
+        keyFrame.time_ = k * LENGTH / (KEYS - 1);
+        keyFrame.position_ = Vector3(keyFrame.time_, 0, 0);
+        track.keyFrames_.push_back(keyFrame);
+    }
+    track.Compress(LENGTH, settings);
+    CHECK_CONDITION(track.compressed_.position_.times_.size() == 2);
+}
+
+// The compressed streams are saved and loaded as they are
+static void Test03() {
+    auto animation = CreateAnimation("saved");
+    animation->Compress();
+    pugi::xml_document doc;
+    animation->Save(doc);
+    auto node = doc.child("Animation");
+    CHECK_CONDITION(node.child("Tracks").child("Track").child("Compressed"));
+    auto loaded = std::make_shared<Animation>("loaded");
+    loaded->Load(node);
+    CHECK_CONDITION(loaded->GetSize() == animation->GetSize());
+    auto error = GetError(animation, loaded, true);
+    CHECK_CONDITION(error.position_ == 0 && error.rotation_ == 0);
+}
+
+// Compressed clips are resolved for the bones of a skeleton inside the errors
+// of the settings: the pose is applied to the samples, not compressed again
+static void Test04() {
+    pugi::xml_document doc;
+    auto skeletonNode = doc.append_child("Skeleton");
+    skeletonNode.append_attribute("name").set_value("skeleton");
+    auto order = skeletonNode.append_child("ShaderOrder");
+    auto parent = skeletonNode.append_child("Bones");
+    for (int i = 0; i < 4; i++) {
+        auto name = "bone" + ToString(i);
+        auto boneNode = order.append_child("Bone");
+        boneNode.append_attribute("name").set_value(name.c_str());
+        boneNode.append_attribute("offsetMatrix")
+            .set_value(ToString(Matrix4(1)).c_str());
+        parent = parent.append_child("Bone");
+        parent.append_attribute("name").set_value(name.c_str());
+        parent.append_attribute("position")
+            .set_value(ToString(Vector3(0, 1, 0)).c_str());
+        parent.append_attribute("orientation")
+            .set_value(
+                ToString(Quaternion(0.1f * i, Vector3(1, 0, 0))).c_str());
+    }
+    auto skeleton = std::make_shared<Skeleton>("skeleton");
+    skeleton->Load(skeletonNode);
+
+    auto animation = CreateAnimation("resolved");
+    auto expected = animation->GetResolvedFor(skeleton)->Clone();
+    AnimationCompression settings;
+    animation->Compress(settings);
+    auto resolved = animation->GetResolvedFor(skeleton);
+    CHECK_CONDITION(resolved->GetTracks()[0].keyFrames_.empty());
+    for (auto looped : {false, true}) {
+        auto error = GetError(expected, resolved, looped);
+        CHECK_CONDITION(error.position_ < 2 * settings.positionError_);
+        CHECK_CONDITION(error.rotation_ < 2 * settings.rotationError_);
+    }
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+    Test04();
+}
@@ -0,0 +1,213 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+#include <cmath>
+using namespace NSG;
+
+static const int BONES = 8;
+static const int CHARACTERS = 200;
+static const float LENGTH = 1;
+static const float STEP = 1.f / 30.f;
+
+static std::string BoneName(int i) { return "bone" + ToString(i); }
+
+// A chain of bones, each one child of the previous one
+static PSkeleton CreateSkeleton(const std::string& name) {
+    pugi::xml_document doc;
+    auto skeletonNode = doc.append_child("Skeleton");
+    skeletonNode.append_attribute("name").set_value(name.c_str());
+    auto order = skeletonNode.append_child("ShaderOrder");
+    auto parent = skeletonNode.append_child("Bones");
+    for (int i = 0; i < BONES; i++) {
+        auto boneNode = order.append_child("Bone");
+        boneNode.append_attribute("name").set_value(BoneName(i).c_str());
+        boneNode.append_attribute("offsetMatrix")
+            .set_value(ToString(Matrix4(1)).c_str());
+        parent = parent.append_child("Bone");
+        parent.append_attribute("name").set_value(BoneName(i).c_str());
+        parent.append_attribute("position")
+            .set_value(ToString(Vector3(0, 1, 0)).c_str());
+    }
+    auto skeleton = std::make_shared<Skeleton>(name);
+    skeleton->Load(skeletonNode);
+    return skeleton;
+}
+
+static PAnimation CreateAnimation(const std::string& name) {
+    auto animation = Animation::Create(name);
+    animation->SetLength(LENGTH);
+    for (int i = 0; i < BONES; i++) {
+        AnimationTrack track;
+        track.nodeName_ = BoneName(i);
+        track.channelMask_ = (int)AnimationChannel::ROTATION;
+        for (int k = 0; k < 3; k++) {
+            AnimationKeyFrame keyFrame;
+            keyFrame.time_ = k * LENGTH / 2;
+            keyFrame.rotation_ =
+                Quaternion(k == 1 ? 0.5f : 0, Vector3(0, 0, 1));
+            keyFrame.mask_ = track.channelMask_;
+            track.keyFrames_.push_back(keyFrame);
+        }
+        animation->AddTrack(track);
+    }
+    return animation;
+}
+
+static bool Same(const std::vector<Matrix4>& a,
+                 const std::vector<Matrix4>& b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+        for (int c = 0; c < 4; c++)
+            if (a[i][c].Distance(b[i][c]) > 1e-5f)
+                return false;
+    return true;
+}
+
+// Palette of an armature animated at time
+static std::vector<Matrix4> Expected(PSceneNode armature, PAnimation animation,
+                                     float time) {
+    AnimationState state(animation->GetResolvedFor(armature->GetSkeleton()));
+    AnimationPose pose;
+    state.Bind(armature, pose);
+    state.SetLooped(true);
+    state.SetWeight(1);
+    state.SetTime(time);
+    pose.Read();
+    state.Update(pose);
+    pose.Write();
+    static unsigned frame = 1000;
+    return armature->GetBonePalette(++frame);
+}
+
+// Each time step is evaluated once and shared by the characters at that step
+static void Test01() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto skeleton = CreateSkeleton("skeleton1");
+    auto animation = CreateAnimation("walk");
+    AnimationCrowd crowd(scene, skeleton, STEP);
+    std::vector<PSceneNode> armatures;
+    for (int i = 0; i < CHARACTERS; i++) {
+        auto armature = scene->CreateChild<SceneNode>("armature");
+        armature->SetSkeleton(skeleton);
+        crowd.Play(armature, "walk", i * LENGTH / CHARACTERS);
+        armatures.push_back(armature);
+    }
+    const float DELTA = 0.1f;
+    scene->UpdateAll(DELTA);
+    auto steps = (size_t)std::ceil(LENGTH / STEP);
+    CHECK_CONDITION(crowd.GetPosesCount() == steps);
+
+    auto reference = std::make_shared<SceneNode>("reference");
+    reference->SetSkeleton(skeleton);
+    for (int i = 0; i < CHARACTERS; i++) {
+        auto armature = armatures[i];
+        auto pose = armature->GetSharedPose();
+        CHECK_CONDITION(pose);
+        auto& palette = armature->GetBonePalette(1);
+        CHECK_CONDITION(&palette == &pose->GetBonePalette(1));
+        auto time = std::fmod(DELTA + i * LENGTH / CHARACTERS, LENGTH);
+        auto step = (unsigned)(time / STEP) % steps;
+        CHECK_CONDITION(Same(palette, Expected(reference, animation,
+                                               step * STEP)));
+        // the bones of the character are not animated
+        auto bone = armature->GetChild<Node>(BoneName(BONES - 1), true);
+        CHECK_CONDITION(!(bone->GetOrientation() != Quaternion::Identity));
+    }
+
+    // characters in the same step share the pose
+    CHECK_CONDITION(armatures[1]->GetSharedPose() ==
+                    armatures[2]->GetSharedPose());
+    CHECK_CONDITION(armatures[1]->GetSharedPose() !=
+                    armatures[CHARACTERS / 2]->GetSharedPose());
+
+    // removed characters use their own bones again
+    crowd.Remove(armatures[0]);
+    CHECK_CONDITION(!armatures[0]->GetSharedPose());
+    CHECK_CONDITION(Same(armatures[0]->GetBonePalette(2),
+                         Expected(reference, animation, 0)));
+}
+
+// The poses of past steps are reused: the count follows the unique poses
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto skeleton = CreateSkeleton("skeleton2");
+    CreateAnimation("run");
+    AnimationCrowd crowd(scene, skeleton, STEP);
+    std::vector<PSceneNode> armatures;
+    for (int i = 0; i < CHARACTERS; i++) {
+        auto armature = scene->CreateChild<SceneNode>("armature");
+        armature->SetSkeleton(skeleton);
+        crowd.Play(armature, "run", (i % 4) * 0.25f);
+        armatures.push_back(armature);
+    }
+    for (int frame = 0; frame < 100; frame++) {
+        scene->UpdateAll(1.f / 60.f);
+        CHECK_CONDITION(crowd.GetPosesCount() == 4);
+    }
+}
+
+// The meshes of a crowd are batched by pose
+static void Test03() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto skeleton = CreateSkeleton("skeleton3");
+    CreateAnimation("idle");
+    AnimationCrowd crowd(scene, skeleton, STEP);
+    auto mesh = Mesh::Create<BoxMesh>();
+    auto material = Material::Create();
+    std::vector<PSceneNode> nodes;
+    for (int i = 0; i < CHARACTERS; i++) {
+        auto armature = scene->CreateChild<SceneNode>("armature");
+        armature->SetSkeleton(skeleton);
+        crowd.Play(armature, "idle", (i % 3) * 0.3f);
+        auto node = armature->CreateChild<SceneNode>("mesh");
+        node->SetMesh(mesh);
+        node->SetMaterial(material);
+        node->SetArmature(armature);
+        nodes.push_back(node);
+    }
+    scene->UpdateAll(0);
+    CHECK_CONDITION(crowd.GetPosesCount() == 3);
+    RenderQueue queue;
+    for (int i = 0; i < CHARACTERS; i++)
+        queue.Add(nodes[i].get(), (float)i / CHARACTERS);
+    queue.Sort();
+    auto& batches = queue.GetBatches();
+    CHECK_CONDITION(batches.size() == 3);
+    for (auto& batch : batches) {
+        auto pose = (*batch.begin())->GetPaletteNode();
+        CHECK_CONDITION(pose ==
+                        (*batch.begin())->GetArmature()->GetSharedPose());
+        for (auto node : batch)
+            CHECK_CONDITION(node->GetPaletteNode() == pose);
+    }
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+}
@@ -0,0 +1,198 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+#include <cmath>
+using namespace NSG;
+
+static const int BONES = 8;
+static const float LENGTH = 2;
+
+static std::string BoneName(int i) { return "bone" + ToString(i); }
+
+// A chain of bones with a pose, each one child of the previous one
+static PSkeleton CreateSkeleton(const std::string& name) {
+    pugi::xml_document doc;
+    auto skeletonNode = doc.append_child("Skeleton");
+    skeletonNode.append_attribute("name").set_value(name.c_str());
+    auto order = skeletonNode.append_child("ShaderOrder");
+    auto parent = skeletonNode.append_child("Bones");
+    for (int i = 0; i < BONES; i++) {
+        auto boneNode = order.append_child("Bone");
+        boneNode.append_attribute("name").set_value(BoneName(i).c_str());
+        boneNode.append_attribute("offsetMatrix")
+            .set_value(ToString(Matrix4(1)).c_str());
+        parent = parent.append_child("Bone");
+        parent.append_attribute("name").set_value(BoneName(i).c_str());
+        parent.append_attribute("position")
+            .set_value(ToString(Vector3(0, 1, 0)).c_str());
+        parent.append_attribute("orientation")
+            .set_value(
+                ToString(Quaternion(0.1f * i, Vector3(1, 0, 0))).c_str());
+    }
+    auto skeleton = std::make_shared<Skeleton>(name);
+    skeleton->Load(skeletonNode);
+    return skeleton;
+}
+
+static PAnimation CreateAnimation(const std::string& name, float angle) {
+    auto animation = Animation::Create(name);
+    animation->SetLength(LENGTH);
+    for (int i = 0; i < BONES; i++) {
+        AnimationTrack track;
+        track.nodeName_ = BoneName(i);
+        track.channelMask_ = (int)AnimationChannel::POSITION |
+                             (int)AnimationChannel::ROTATION;
+        for (int k = 0; k < 3; k++) {
+            AnimationKeyFrame keyFrame;
+            keyFrame.time_ = k * LENGTH / 2;
+            keyFrame.position_ = Vector3(0.1f * k, 0, 0);
+            keyFrame.rotation_ = Quaternion(angle * k, Vector3(0, 0, 1));
+            keyFrame.mask_ = track.channelMask_;
+            track.keyFrames_.push_back(keyFrame);
+        }
+        animation->AddTrack(track);
+    }
+    return animation;
+}
+
+static bool Near(const Vector3& a, const Vector3& b) {
+    return a.Distance(b) < 1e-4f;
+}
+
+static bool Near(const Quaternion& a, const Quaternion& b) {
+    return std::abs(std::abs(a.Dot(b)) - 1) < 1e-4f;
+}
+
+// Clips are resolved once per skeleton and shared by its armatures
+static void Test01() {
+    auto skeleton1 = CreateSkeleton("skeleton1");
+    auto skeleton2 = CreateSkeleton("skeleton2");
+    auto animation = CreateAnimation("anim1", 0.5f);
+    auto resolved = animation->GetResolvedFor(skeleton1);
+    CHECK_CONDITION(resolved != animation);
+    CHECK_CONDITION(animation->GetResolvedFor(skeleton1) == resolved);
+    CHECK_CONDITION(animation->GetResolvedFor(skeleton2) != resolved);
+    // the key frames are relative to the pose of the bones
+    auto bone = skeleton1->GetBone(BoneName(3));
+    CHECK_CONDITION(bone);
+    auto& keyFrame = animation->GetTracks()[3].keyFrames_[1];
+    Vector3 position, scale;
+    Quaternion rotation;
+    Matrix4 m = bone->GetPose() *
+                Matrix4(keyFrame.position_, keyFrame.rotation_, keyFrame.scale_);
+    m.Decompose(position, rotation, scale);
+    auto& resolvedKeyFrame = resolved->GetTracks()[3].keyFrames_[1];
+    CHECK_CONDITION(Near(resolvedKeyFrame.position_, position));
+    CHECK_CONDITION(Near(resolvedKeyFrame.rotation_, rotation));
+    // changing the animation resolves it again
+    animation->SetLength(LENGTH);
+    CHECK_CONDITION(animation->GetResolvedFor(skeleton1) != resolved);
+}
+
+// Expected transform of a bone blending the clip over the current one
+static void Expected(PAnimation clip, int track, float time, float weight,
+                     Vector3& position, Quaternion& rotation) {
+    size_t cursor = 0;
+    Vector3 samplePosition, sampleScale;
+    Quaternion sampleRotation;
+    clip->GetTracks()[track].Sample(time, clip->GetLength(), true, cursor,
+                                    samplePosition, sampleRotation,
+                                    sampleScale);
+    position = position.Lerp(samplePosition, weight);
+    rotation = rotation.Slerp(sampleRotation, weight);
+}
+
+// The states of a controller blend in the pose buffer
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto skeleton = CreateSkeleton("skeleton3");
+    auto armature = scene->CreateChild<SceneNode>("armature");
+    armature->SetSkeleton(skeleton);
+    auto walk = CreateAnimation("walk", 0.5f);
+    auto run = CreateAnimation("run", -0.3f);
+    std::vector<Vector3> positions;
+    std::vector<Quaternion> rotations;
+    for (int i = 0; i < BONES; i++) {
+        auto bone = armature->GetChild<Node>(BoneName(i), true);
+        positions.push_back(bone->GetPosition());
+        rotations.push_back(bone->GetOrientation());
+    }
+
+    auto controller = std::make_shared<AnimationController>(armature);
+    controller->Play("walk", true);
+    controller->Play("run", true);
+    controller->Blend("run", 0.25f, 0);
+    const float DELTA = 0.3f;
+    scene->UpdateAll(DELTA);
+    CHECK_CONDITION(controller->IsPlaying("walk"));
+    CHECK_CONDITION(controller->IsPlaying("run"));
+    auto walkClip = walk->GetResolvedFor(skeleton);
+    auto runClip = run->GetResolvedFor(skeleton);
+    for (int i = 0; i < BONES; i++) {
+        Expected(walkClip, i, DELTA, 1, positions[i], rotations[i]);
+        Expected(runClip, i, DELTA, 0.25f, positions[i], rotations[i]);
+        auto bone = armature->GetChild<Node>(BoneName(i), true);
+        CHECK_CONDITION(Near(bone->GetPosition(), positions[i]));
+        CHECK_CONDITION(Near(bone->GetOrientation(), rotations[i]));
+    }
+
+    // a second character with the same skeleton follows the same clip
+    auto other = scene->CreateChild<SceneNode>("other");
+    other->SetSkeleton(skeleton);
+    auto otherController = std::make_shared<AnimationController>(other);
+    otherController->Play("walk", true);
+    scene->UpdateAll(LENGTH / 2);
+    auto bone = other->GetChild<Node>(BoneName(BONES - 1), true);
+    auto& keyFrame = walkClip->GetTracks()[BONES - 1].keyFrames_[1];
+    CHECK_CONDITION(Near(bone->GetPosition(), keyFrame.position_));
+    CHECK_CONDITION(Near(bone->GetOrientation(), keyFrame.rotation_));
+}
+
+// The three channels are set with a single update of the node
+static void Test03() {
+    auto parent = std::make_shared<Node>("parent");
+    auto child = parent->CreateChild<Node>("child");
+    child->SetPosition(Vector3(1, 0, 0));
+    parent->SetTransform(Vector3(0, 2, 0), Quaternion(1, Vector3(0, 1, 0)),
+                         Vector3(2));
+    Matrix4 expected(Vector3(0, 2, 0), Quaternion(1, Vector3(0, 1, 0)),
+                     Vector3(2));
+    expected = expected * Matrix4(Vector3(1, 0, 0), Quaternion(), Vector3(1));
+    auto& global = child->GetGlobalModelMatrix();
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            CHECK_CONDITION(std::abs(global[i][j] - expected[i][j]) < 1e-5f);
+    CHECK_CONDITION(!child->IsDirty());
+    parent->SetTransform(parent->GetPosition(), parent->GetOrientation(),
+                         parent->GetScale());
+    CHECK_CONDITION(!child->IsDirty());
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+}
@@ -0,0 +1,157 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+#include <cmath>
+#include <cstring>
+using namespace NSG;
+
+static const int BONES = 32;
+
+static std::string BoneName(int i) { return "bone" + ToString(i); }
+
+// A chain of bones, each one child of the previous one
+static PSkeleton CreateSkeleton(const std::string& name) {
+    pugi::xml_document doc;
+    auto skeletonNode = doc.append_child("Skeleton");
+    skeletonNode.append_attribute("name").set_value(name.c_str());
+    auto order = skeletonNode.append_child("ShaderOrder");
+    auto parent = skeletonNode.append_child("Bones");
+    for (int i = 0; i < BONES; i++) {
+        Matrix4 offset(Vector3((float)i, 0, 0),
+                       Quaternion(0.1f * i, Vector3(0, 0, 1)), Vector3(1));
+        auto boneNode = order.append_child("Bone");
+        boneNode.append_attribute("name").set_value(BoneName(i).c_str());
+        boneNode.append_attribute("offsetMatrix")
+            .set_value(ToString(offset).c_str());
+
+        parent = parent.append_child("Bone");
+        parent.append_attribute("name").set_value(BoneName(i).c_str());
+        parent.append_attribute("position")
+            .set_value(ToString(Vector3(0, 1, 0)).c_str());
+        parent.append_attribute("orientation")
+            .set_value(
+                ToString(Quaternion(0.05f * i, Vector3(1, 0, 0))).c_str());
+    }
+    auto skeleton = std::make_shared<Skeleton>(name);
+    skeleton->Load(skeletonNode);
+    return skeleton;
+}
+
+static bool Near(const Matrix4& a, const Matrix4& b) {
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            if (std::abs(a[i][j] - b[i][j]) > 1e-4f)
+                return false;
+    return true;
+}
+
+static bool Same(const Matrix4& a, const Matrix4& b) {
+    return !memcmp(&a, &b, sizeof(Matrix4));
+}
+
+// The palette computed as the program did per draw
+static void CheckPalette(PSceneNode armature,
+                         const std::vector<Matrix4>& palette) {
+    auto skeleton = armature->GetSkeleton();
+    CHECK_CONDITION(palette.size() == BONES);
+    for (int i = 0; i < BONES; i++) {
+        auto name = BoneName(i);
+        auto bone = armature->GetChild<Node>(name, true);
+        CHECK_CONDITION(bone);
+        Matrix4 expected(armature->GetGlobalModelInvMatrix() *
+                         bone->GetGlobalModelMatrix() *
+                         skeleton->GetBoneOffsetMatrix(name));
+        CHECK_CONDITION(Near(palette[i], expected));
+    }
+}
+
+// The palette follows the shader order and is relative to the armature
+static void Test01() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto armature = scene->CreateChild<SceneNode>("armature");
+    armature->SetPosition(Vector3(10, 2, 3));
+    armature->SetOrientation(Quaternion(0.3f, Vector3(0, 1, 0)));
+    armature->SetSkeleton(CreateSkeleton("skeleton01"));
+    auto& palette = armature->GetBonePalette(1);
+    CheckPalette(armature, palette);
+}
+
+// Evaluated once per frame: changes are seen in the next frame
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto armature = scene->CreateChild<SceneNode>("armature");
+    armature->SetSkeleton(CreateSkeleton("skeleton02"));
+    auto before = armature->GetBonePalette(1);
+    auto bone = armature->GetChild<Node>(BoneName(BONES / 2), true);
+    bone->SetPosition(Vector3(5, 0, 0));
+    auto& sameFrame = armature->GetBonePalette(1);
+    for (int i = 0; i < BONES; i++)
+        CHECK_CONDITION(Same(sameFrame[i], before[i]));
+    auto& nextFrame = armature->GetBonePalette(2);
+    CheckPalette(armature, nextFrame);
+    for (int i = 0; i < BONES; i++)
+        CHECK_CONDITION(Same(nextFrame[i], before[i]) == (i < BONES / 2));
+}
+
+// Armatures sharing a skeleton have their own palette
+static void Test03() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto skeleton = CreateSkeleton("skeleton03");
+    auto armature1 = scene->CreateChild<SceneNode>("armature1");
+    armature1->SetSkeleton(skeleton);
+    auto armature2 = scene->CreateChild<SceneNode>("armature2");
+    armature2->SetSkeleton(skeleton);
+    armature2->GetChild<Node>(BoneName(0), true)
+        ->SetOrientation(Quaternion(1, Vector3(0, 1, 0)));
+    CheckPalette(armature1, armature1->GetBonePalette(1));
+    CheckPalette(armature2, armature2->GetBonePalette(1));
+    CHECK_CONDITION(!Near(armature1->GetBonePalette(1)[BONES - 1],
+                          armature2->GetBonePalette(1)[BONES - 1]));
+}
+
+// A destroyed bone gives an identity matrix until a node takes its name
+static void Test04() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto armature = scene->CreateChild<SceneNode>("armature");
+    armature->SetSkeleton(CreateSkeleton("skeleton04"));
+    CheckPalette(armature, armature->GetBonePalette(1));
+    auto name = BoneName(BONES - 1);
+    armature->GetChild<Node>(name, true)->SetParent(nullptr);
+    CHECK_CONDITION(!armature->GetChild<Node>(name, true));
+    auto& palette = armature->GetBonePalette(2);
+    CHECK_CONDITION(palette.size() == BONES);
+    CHECK_CONDITION(Same(palette[BONES - 1], Matrix4()));
+    auto parent = armature->GetChild<Node>(BoneName(BONES - 2), true);
+    parent->CreateChild<Node>(name)->SetPosition(Vector3(0, 2, 0));
+    CheckPalette(armature, armature->GetBonePalette(3));
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+    Test04();
+}
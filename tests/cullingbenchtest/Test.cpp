@@ -0,0 +1,165 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include <algorithm>
+#include <random>
+using namespace NSG;
+
+static const size_t BOXES = 100000;
+static const int ITERATIONS = 20;
+
+static BoundingBox RandomBox(std::mt19937& generator) {
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    std::uniform_real_distribution<float> size(0.1f, 5.f);
+    Vertex3 min(position(generator), position(generator), position(generator));
+    Vertex3 max(min + Vertex3(size(generator), size(generator),
+                              size(generator)));
+    return BoundingBox(min, max);
+}
+
+static PCamera CreateCamera(PScene scene) {
+    auto camera = scene->CreateChild<Camera>();
+    camera->SetPosition(Vertex3(0, 10, 50));
+    camera->SetGlobalLookAtPosition(Vector3(10, 0, -20));
+    camera->SetFarClip(120);
+    return camera;
+}
+
+// The SIMD kernel must agree with Frustum::IsInside and the scalar kernel.
+static void Test01() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto frustum = CreateCamera(scene)->GetFrustumPointer();
+    std::mt19937 generator(1234);
+    std::vector<BoundingBox> aos;
+    CullingBoxes soa;
+    for (size_t i = 0; i < BOXES; i++) {
+        aos.push_back(RandomBox(generator));
+        soa.Add(aos.back());
+    }
+
+    const size_t words = (BOXES + 31) / 32;
+    std::vector<uint32_t> reference(words, 0);
+    auto start = BenchClock::now();
+    for (int it = 0; it < ITERATIONS; it++)
+        for (size_t i = 0; i < BOXES; i++)
+            if (frustum->IsInside(aos[i]) != Intersection::OUTSIDE)
+                reference[i / 32] |= 1u << (i % 32);
+    auto aosMs = ElapsedMs(start) / ITERATIONS;
+
+    std::vector<uint32_t> scalar(words);
+    start = BenchClock::now();
+    for (int it = 0; it < ITERATIONS; it++)
+        CullBoxesScalar(*frustum, soa, 0, BOXES, &scalar[0]);
+    auto scalarMs = ElapsedMs(start) / ITERATIONS;
+
+    std::vector<uint32_t> simd(words);
+    start = BenchClock::now();
+    for (int it = 0; it < ITERATIONS; it++)
+        CullBoxes(*frustum, soa, 0, BOXES, &simd[0]);
+    auto simdMs = ElapsedMs(start) / ITERATIONS;
+
+    size_t visibles = 0;
+    for (auto word : reference)
+        for (; word; word &= word - 1)
+            visibles++;
+    printf("%d boxes (%d visible)\n", (int)BOXES, (int)visibles);
+    printf("Frustum::IsInside: %.3f ms\n", aosMs);
+    printf("CullBoxesScalar:   %.3f ms\n", scalarMs);
+    printf("CullBoxes:         %.3f ms\n", simdMs);
+    CHECK_CONDITION(visibles > 0 && visibles < BOXES);
+    CHECK_CONDITION(scalar == reference);
+    CHECK_CONDITION(simd == reference);
+
+    // unaligned ranges
+    std::vector<uint32_t> part(2);
+    CullBoxes(*frustum, soa, 13, 45, &part[0]);
+    for (size_t i = 0; i < 45; i++) {
+        auto expected = (reference[(i + 13) / 32] >> ((i + 13) % 32)) & 1;
+        CHECK_CONDITION(((part[i / 32] >> (i % 32)) & 1) == expected);
+    }
+}
+
+// The octree keeps its boxes in sync when nodes move or get hidden.
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto camera = CreateCamera(scene);
+    auto mesh(Mesh::Create<BoxMesh>());
+    std::mt19937 generator(4321);
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    std::vector<PSceneNode> nodes;
+    for (int i = 0; i < 2000; i++) {
+        auto node = scene->CreateChild<SceneNode>(); // at the origin
+        node->SetMesh(mesh);
+        nodes.push_back(node);
+    }
+
+    auto check = [&]() {
+        std::vector<SceneNode*> visibles;
+        scene->GetVisibleNodes(camera.get(), visibles);
+        CHECK_CONDITION(scene->GetOctree()->CheckIntegrity());
+        std::vector<SceneNode*> expected;
+        auto frustum = camera->GetFrustumPointer();
+        for (auto& node : nodes)
+            if (!node->IsHidden() &&
+                frustum->IsInside(node->GetWorldBoundingBox()) !=
+                    Intersection::OUTSIDE)
+                expected.push_back(node.get());
+        std::sort(visibles.begin(), visibles.end());
+        std::sort(expected.begin(), expected.end());
+        CHECK_CONDITION(std::adjacent_find(visibles.begin(), visibles.end()) ==
+                        visibles.end());
+        CHECK_CONDITION(!expected.empty());
+        CHECK_CONDITION(visibles == expected);
+    };
+
+    check();
+    // every node leaves the root octant
+    for (auto& node : nodes)
+        node->SetPosition(Vertex3(position(generator), position(generator),
+                                  position(generator)));
+    check();
+    for (size_t i = 0; i < nodes.size(); i += 3)
+        nodes[i]->SetPosition(Vertex3(position(generator),
+                                      position(generator),
+                                      position(generator)));
+    for (size_t i = 1; i < nodes.size(); i += 7)
+        nodes[i]->Hide(true);
+    check();
+    // destroyed nodes leave no octant behind
+    for (size_t i = 2; i < nodes.size(); i += 5)
+        nodes[i]->SetParent(nullptr);
+    for (size_t i = nodes.size(); i-- > 2;)
+        if (i % 5 == 2)
+            nodes.erase(nodes.begin() + i);
+    check();
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+}
@@ -0,0 +1,132 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "Decompress.h"
+#include "../BenchClock.h"
+#include "NSG.h"
+#include <cstring>
+#include <random>
+using namespace NSG;
+
+static const int ITERATIONS = 5;
+
+struct Case {
+    const char* name;
+    TextureFormat format;
+    int width;
+    int height;
+    int depth;
+};
+
+static size_t BlocksSize(const Case& c) {
+    switch (c.format) {
+    case TextureFormat::DXT1:
+    case TextureFormat::ETC1:
+        return ((c.width + 3) / 4) * ((c.height + 3) / 4) * c.depth * 8;
+    case TextureFormat::DXT3:
+    case TextureFormat::DXT5:
+        return ((c.width + 3) / 4) * ((c.height + 3) / 4) * c.depth * 16;
+    case TextureFormat::PVRTC_RGB_2BPP:
+    case TextureFormat::PVRTC_RGBA_2BPP:
+        return c.width * c.height / 4;
+    default:
+        return c.width * c.height / 2;
+    }
+}
+
+static void Decompress(const Case& c, unsigned char* rgba,
+                       const void* blocks, bool reference) {
+    switch (c.format) {
+    case TextureFormat::DXT1:
+    case TextureFormat::DXT3:
+    case TextureFormat::DXT5:
+        if (reference)
+            DecompressImageDXTReference(rgba, blocks, c.width, c.height,
+                                        c.depth, c.format);
+        else
+            DecompressImageDXT(rgba, blocks, c.width, c.height, c.depth,
+                               c.format);
+        break;
+    case TextureFormat::ETC1:
+        if (reference)
+            DecompressImageETCReference(rgba, blocks, c.width, c.height);
+        else
+            DecompressImageETC(rgba, blocks, c.width, c.height);
+        break;
+    default:
+        if (reference)
+            DecompressImagePVRTCReference(rgba, blocks, c.width, c.height,
+                                          c.format);
+        else
+            DecompressImagePVRTC(rgba, blocks, c.width, c.height, c.format);
+        break;
+    }
+}
+
+static double MegapixelsPerSecond(const Case& c, unsigned char* rgba,
+                                  const void* blocks, bool reference) {
+    auto start = BenchClock::now();
+    for (int it = 0; it < ITERATIONS; it++)
+        Decompress(c, rgba, blocks, reference);
+    auto ms = ElapsedMs(start) / ITERATIONS;
+    return (double)c.width * c.height * c.depth / (ms * 1000);
+}
+
+// Random blocks give the same pixels with both decoders (odd sizes, the
+// three colours mode of DXT1, both DXT5 alpha modes, ...)
+static void Test01() {
+    const Case cases[] = {
+        {"DXT1", TextureFormat::DXT1, 1001, 603, 1},
+        {"DXT1 3D", TextureFormat::DXT1, 66, 30, 5},
+        {"DXT3", TextureFormat::DXT3, 1001, 603, 1},
+        {"DXT5", TextureFormat::DXT5, 1001, 603, 1},
+        {"ETC1", TextureFormat::ETC1, 1001, 603, 1},
+        {"PVRTC 2bpp", TextureFormat::PVRTC_RGBA_2BPP, 1024, 512, 1},
+        {"PVRTC 4bpp", TextureFormat::PVRTC_RGBA_4BPP, 512, 512, 1},
+    };
+    std::mt19937 generator(1234);
+    for (auto& c : cases) {
+        std::vector<unsigned char> blocks(BlocksSize(c));
+        for (auto& byte : blocks)
+            byte = (unsigned char)generator();
+        size_t size = (size_t)c.width * c.height * c.depth * 4;
+        std::vector<unsigned char> expected(size, 0xcd);
+        std::vector<unsigned char> result(size, 0xab);
+        auto referenceMps =
+            MegapixelsPerSecond(c, &expected[0], &blocks[0], true);
+        auto mps = MegapixelsPerSecond(c, &result[0], &blocks[0], false);
+        printf("%-10s %4dx%-4d reference %8.1f MP/s, new %8.1f MP/s\n",
+               c.name, c.width, c.height * c.depth, referenceMps, mps);
+        CHECK_CONDITION(memcmp(&expected[0], &result[0], size) == 0);
+    }
+}
+
+void Tests() {
+    printf("Without job system:\n");
+    Test01();
+    auto jobs = Task::JobSystem::Create();
+    printf("With %u workers:\n", jobs->GetWorkersCount());
+    Test01();
+}
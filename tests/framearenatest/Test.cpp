@@ -0,0 +1,161 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+using namespace NSG;
+
+// Alignment, scopes and reset of a single arena.
+static void Test01() {
+    FrameArena arena(1024);
+    CHECK_CONDITION(arena.GetCapacity() == 0);
+    auto a = arena.Allocate(3, 1);
+    auto b = arena.Allocate(16, 16);
+    auto c = arena.Allocate(64, 64);
+    CHECK_CONDITION(a && b && c);
+    CHECK_CONDITION(reinterpret_cast<uintptr_t>(b) % 16 == 0);
+    CHECK_CONDITION(reinterpret_cast<uintptr_t>(c) % 64 == 0);
+    CHECK_CONDITION(arena.GetSystemAllocations() == 1);
+    auto used = arena.GetUsed();
+    {
+        FrameArena::Scope scope(arena);
+        arena.Allocate(100);
+        CHECK_CONDITION(arena.GetUsed() > used);
+    }
+    CHECK_CONDITION(arena.GetUsed() == used);
+    // the last allocation can be given back
+    auto d = arena.Allocate(32, 1);
+    arena.Release(d, 32);
+    CHECK_CONDITION(arena.GetUsed() == used);
+    CHECK_CONDITION(arena.Allocate(32, 1) == d);
+    // bigger than a block
+    arena.Allocate(4000);
+    CHECK_CONDITION(arena.GetBlocks() == 2);
+    arena.Reset();
+    CHECK_CONDITION(arena.GetUsed() == 0);
+    CHECK_CONDITION(arena.GetBlocks() == 1);
+    CHECK_CONDITION(arena.GetCapacity() >= 4000 + 1024);
+    CHECK_CONDITION(arena.Allocate(3, 1) != nullptr);
+}
+
+// Frames filling FrameVectors stop requesting memory to the system once the
+// arena has grown to the size of a frame.
+static void Test02() {
+    FrameArena arena(256);
+    size_t allocations = 0;
+    for (int frame = 0; frame < 100; frame++) {
+        arena.Reset();
+        if (frame == 3)
+            allocations = arena.GetSystemAllocations();
+        FrameArena::Scope scope(arena);
+        FrameVector<int> numbers{FrameAllocator<int>(arena)};
+        FrameVector<Vector4> positions{FrameAllocator<Vector4>(arena)};
+        for (int i = 0; i < 1000; i++) {
+            numbers.push_back(i);
+            positions.push_back(Vector4(float(i)));
+        }
+        auto copy = numbers;
+        CHECK_CONDITION(copy.size() == 1000 && copy[999] == 999);
+        for (auto& position : positions)
+            CHECK_CONDITION(reinterpret_cast<uintptr_t>(&position) %
+                                alignof(Vector4) ==
+                            0);
+    }
+    CHECK_CONDITION(allocations > 0);
+    CHECK_CONDITION(arena.GetSystemAllocations() == allocations);
+    CHECK_CONDITION(arena.GetBlocks() == 1);
+    LOGI("Frame arena: %u bytes peak, %u bytes capacity",
+         (unsigned)arena.GetPeak(), (unsigned)arena.GetCapacity());
+}
+
+// The frame arena used by the renderer.
+static void Test03() {
+    auto& arena = FrameArena::GetFrame();
+    arena.Reset();
+    {
+        FrameArena::Scope scope;
+        FrameVector<SceneNode*> nodes;
+        nodes.resize(10);
+        CHECK_CONDITION(nodes.get_allocator().GetArena() == &arena);
+        CHECK_CONDITION(arena.GetUsed() >= 10 * sizeof(SceneNode*));
+    }
+    CHECK_CONDITION(arena.GetUsed() == 0);
+}
+
+// Once the programs, the queues and the frame arena have grown, rendering a
+// scene does not allocate any memory
+static void Test04() {
+    const int WARM_UP_FRAMES = 10;
+    const int FRAMES = 50;
+    auto window = Window::Create("window", 0, 0, 64, 64,
+                                 (int)WindowFlag::HIDDEN);
+    CHECK_CONDITION(window->IsReady());
+    auto scene = std::make_shared<Scene>("scene");
+    auto camera = scene->CreateChild<Camera>("camera");
+    camera->SetPosition(Vertex3(0, 0, 30));
+    auto light = scene->CreateChild<Light>("light");
+    light->SetType(LightType::POINT);
+    light->SetPosition(Vertex3(0, 5, 10));
+    std::vector<PMesh> meshes{Mesh::Create<BoxMesh>(),
+                              Mesh::Create<SphereMesh>()};
+    std::vector<PMaterial> materials{Material::Create(), Material::Create()};
+    materials[1]->EnableTransparent(true);
+    materials[1]->SetAlpha(0.5f);
+    for (int y = -5; y <= 5; y++) {
+        for (int x = -5; x <= 5; x++) {
+            auto node = scene->CreateChild<SceneNode>();
+            node->SetMesh(meshes[(x + y) & 1]);
+            node->SetMaterial(materials[(x * y) & 1]);
+            node->SetPosition(Vertex3(2.f * x, 2.f * y, 0));
+        }
+    }
+
+    auto renderer = Renderer::GetPtr();
+    auto& arena = FrameArena::GetFrame();
+    size_t allocations = 0;
+    size_t arenaAllocations = 0;
+    for (int frame = 0; frame < WARM_UP_FRAMES + FRAMES; frame++) {
+        if (frame == WARM_UP_FRAMES) {
+            allocations = GetMemoryAllocations();
+            arenaAllocations = arena.GetSystemAllocations();
+        }
+        arena.Reset();
+        renderer->Render(window.get(), scene.get(), camera.get());
+    }
+    auto frameAllocations = GetMemoryAllocations() - allocations;
+    printf("%d frames: %u allocations, frame arena peak %u bytes\n", FRAMES,
+           (unsigned)frameAllocations, (unsigned)arena.GetPeak());
+#if defined(USE_POOLS)
+    CHECK_CONDITION(allocations > 0);
+    CHECK_CONDITION(frameAllocations == 0);
+#endif
+    CHECK_CONDITION(arena.GetSystemAllocations() == arenaAllocations);
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+    Test04();
+}
@@ -0,0 +1,219 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include <chrono>
+#include <future>
+#include <thread>
+using namespace NSG;
+using namespace NSG::Task;
+
+struct CountTask : NSG::Task::Task {
+    std::atomic<int>& runs_;
+    std::atomic<int>& exceptions_;
+    bool fail_;
+    CountTask(std::atomic<int>& runs, std::atomic<int>& exceptions, bool fail)
+        : runs_(runs), exceptions_(exceptions), fail_(fail) {}
+    void Run() override {
+        ++runs_;
+        if (fail_)
+            throw std::runtime_error("task failed");
+    }
+    void Exception(const std::exception& e) override { ++exceptions_; }
+};
+
+// Counters, dependencies, tasks and the main thread queue.
+static void Test01(int nWorkers) {
+    JobSystem jobs(nWorkers);
+    {
+        std::atomic<int> runs(0);
+        JobCounter counter;
+        for (int i = 0; i < 10000; i++)
+            jobs.Run([&runs]() { ++runs; }, &counter);
+        jobs.Wait(counter);
+        CHECK_CONDITION(runs == 10000 && counter.IsDone());
+    }
+    {
+        // b runs after all the a jobs, c after b
+        std::atomic<int> a(0);
+        std::atomic<int> b(0);
+        std::atomic<bool> ok(true);
+        JobCounter counterA, counterB, counterC;
+        for (int i = 0; i < 100; i++)
+            jobs.Run(
+                [&]() {
+                    std::this_thread::sleep_for(std::chrono::microseconds(10));
+                    ++a;
+                },
+                &counterA);
+        jobs.Run([&]() { ok = ok && b == 0 && a == 100; }, counterA,
+                 &counterB);
+        jobs.Run([&]() { ok = ok && a == 100 && ++b == 1; }, counterB,
+                 &counterC);
+        jobs.Wait(counterC);
+        CHECK_CONDITION(ok && a == 100 && b == 1);
+    }
+    {
+        std::atomic<int> runs(0);
+        std::atomic<int> exceptions(0);
+        JobCounter counter;
+        for (int i = 0; i < 100; i++)
+            jobs.AddTask(
+                std::make_shared<CountTask>(runs, exceptions, i % 10 == 0),
+                &counter);
+        jobs.Wait(counter);
+        CHECK_CONDITION(runs == 100 && exceptions == 10);
+    }
+    {
+        std::vector<int> values(100000, 1);
+        std::atomic<long long> sum(0);
+        jobs.ParallelFor(values.size(), 1000, [&](size_t begin, size_t end) {
+            long long partial = 0;
+            for (auto i = begin; i < end; i++)
+                partial += values[i];
+            sum += partial;
+        });
+        CHECK_CONDITION(sum == (long long)values.size());
+    }
+    {
+        // completions are delivered in the main thread
+        auto mainThread = std::this_thread::get_id();
+        std::atomic<int> completed(0);
+        JobCounter counter;
+        for (int i = 0; i < 10; i++)
+            jobs.Run(
+                [&]() {
+                    jobs.RunOnMainThread([&]() {
+                        CHECK_CONDITION(std::this_thread::get_id() ==
+                                        mainThread);
+                        ++completed;
+                    });
+                },
+                &counter);
+        jobs.Wait(counter);
+        CHECK_CONDITION(completed == 0);
+        jobs.ProcessMainThreadJobs();
+        CHECK_CONDITION(completed == 10);
+    }
+}
+
+static int Fibonacci(JobSystem& jobs, int n) {
+    if (n < 12)
+        return n < 2 ? n : Fibonacci(jobs, n - 1) + Fibonacci(jobs, n - 2);
+    int a = 0;
+    JobCounter counter;
+    jobs.Run([&]() { a = Fibonacci(jobs, n - 1); }, &counter);
+    auto b = Fibonacci(jobs, n - 2);
+    jobs.Wait(counter);
+    return a + b;
+}
+
+// Jobs spawning jobs from the workers and from other threads.
+static void Test02(int nWorkers) {
+    JobSystem jobs(nWorkers);
+    CHECK_CONDITION(Fibonacci(jobs, 25) == 75025);
+    std::atomic<int> runs(0);
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; i++)
+        producers.push_back(std::thread([&]() {
+            JobCounter counter;
+            for (int j = 0; j < 5000; j++)
+                jobs.Run([&runs]() { ++runs; }, &counter);
+            jobs.Wait(counter);
+        }));
+    for (auto& producer : producers)
+        producer.join();
+    CHECK_CONDITION(runs == 4 * 5000);
+}
+
+// Scheduling overhead compared with a thread or std::async per job.
+static void Test03() {
+    const int N = 200000;
+    JobSystem jobs;
+    std::atomic<int> runs(0);
+    auto start = BenchClock::now();
+    JobCounter counter;
+    for (int i = 0; i < N; i++)
+        jobs.Run([&runs]() { ++runs; }, &counter);
+    jobs.Wait(counter);
+    auto jobsMs = ElapsedMs(start);
+    CHECK_CONDITION(runs == N);
+
+    const int M = 1000;
+    start = BenchClock::now();
+    for (int i = 0; i < M; i++)
+        std::thread([&runs]() { ++runs; }).join();
+    auto threadsMs = ElapsedMs(start);
+
+    start = BenchClock::now();
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < M; i++)
+        futures.push_back(
+            std::async(std::launch::async, [&runs]() { ++runs; }));
+    for (auto& future : futures)
+        future.get();
+    auto asyncMs = ElapsedMs(start);
+
+    LOGI("%u workers, %u jobs stolen", jobs.GetWorkersCount(),
+         (unsigned)jobs.GetStolenJobs());
+    LOGI("Job system: %.1f ns/job", jobsMs * 1e6 / N);
+    LOGI("Thread per job: %.1f ns/job", threadsMs * 1e6 / M);
+    LOGI("std::async per job: %.1f ns/job", asyncMs * 1e6 / M);
+}
+
+// Waiting threads do not run the jobs of other counters.
+static void Test04(int nWorkers) {
+    JobSystem jobs(nWorkers);
+    auto mainThread = std::this_thread::get_id();
+    std::atomic<bool> slowOnMain(false);
+    JobCounter slow;
+    for (int i = 0; i < 4; i++)
+        jobs.Run(
+            [&]() {
+                if (std::this_thread::get_id() == mainThread)
+                    slowOnMain = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            },
+            &slow);
+    std::atomic<int> ranges(0);
+    jobs.ParallelFor(64, 1, [&](size_t begin, size_t end) {
+        ++ranges;
+    });
+    CHECK_CONDITION(ranges == 64 && !slowOnMain);
+    while (!slow.IsDone())
+        std::this_thread::yield();
+    CHECK_CONDITION(!slowOnMain);
+}
+
+void Tests() {
+    for (int nWorkers : {0, 1, 3}) {
+        Test01(nWorkers);
+        Test02(nWorkers);
+    }
+    for (int nWorkers : {1, 3})
+        Test04(nWorkers);
+    Test03();
+}
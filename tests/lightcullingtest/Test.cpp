@@ -0,0 +1,186 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+#include <algorithm>
+using namespace NSG;
+
+static Intersection Inside(const Cone& cone, const Vector3& center,
+                           float half) {
+    return cone.IsInside(BoundingBox(center - Vector3(half),
+                                     center + Vector3(half)));
+}
+
+static Intersection Inside(const Sphere& sphere, const Vector3& center,
+                           float half) {
+    return sphere.IsInside(BoundingBox(center - Vector3(half),
+                                       center + Vector3(half)));
+}
+
+// Boxes inside, outside and crossing the light volumes
+static void Test01() {
+    Sphere sphere(Vector3(0), 5);
+    CHECK_CONDITION(Inside(sphere, Vector3(0), 1) == Intersection::INSIDE);
+    CHECK_CONDITION(Inside(sphere, Vector3(5, 0, 0), 1) ==
+                    Intersection::INTERSECTS);
+    CHECK_CONDITION(Inside(sphere, Vector3(10, 0, 0), 1) ==
+                    Intersection::OUTSIDE);
+    // the corners of the box are out of the sphere but not the faces
+    CHECK_CONDITION(Inside(sphere, Vector3(0), 4) == Intersection::INTERSECTS);
+
+    // 30 degrees around -z
+    Cone cone(Vector3(0), Vector3(0, 0, -1), 10, Radians(30.f));
+    CHECK_CONDITION(Inside(cone, Vector3(0, 0, -5), 0.5f) ==
+                    Intersection::INSIDE);
+    CHECK_CONDITION(Inside(cone, Vector3(3, 0, -5), 1) ==
+                    Intersection::INTERSECTS);
+    CHECK_CONDITION(Inside(cone, Vector3(0), 1) == Intersection::INTERSECTS);
+    CHECK_CONDITION(Inside(cone, Vector3(0, 0, 5), 1) ==
+                    Intersection::OUTSIDE);
+    CHECK_CONDITION(Inside(cone, Vector3(8, 0, -5), 1) ==
+                    Intersection::OUTSIDE);
+    CHECK_CONDITION(Inside(cone, Vector3(0, 0, -20), 1) ==
+                    Intersection::OUTSIDE);
+}
+
+struct Room {
+    PScene scene_;
+    PLight point_;
+    PLight spot_;
+    PLight sun_;
+    std::vector<SceneNode*> nodes_;
+};
+
+// A grid of boxes lit by a small point light, a spot light and the sun
+static Room CreateRoom() {
+    Room room;
+    room.scene_ = std::make_shared<Scene>("scene");
+    auto mesh(Mesh::Create<BoxMesh>()); // 2 x 2 x 2
+    std::vector<PMaterial> materials{Material::Create(), Material::Create()};
+    for (int z = -20; z <= 20; z += 4) {
+        for (int x = -20; x <= 20; x += 4) {
+            auto node = room.scene_->CreateChild<SceneNode>();
+            node->SetMesh(mesh);
+            node->SetMaterial(materials[(x + z) / 4 & 1]);
+            node->SetPosition(Vertex3((float)x, 0, (float)z));
+            room.nodes_.push_back(node.get());
+        }
+    }
+    room.point_ = room.scene_->CreateChild<Light>("point");
+    room.point_->SetType(LightType::POINT);
+    room.point_->SetDistance(6);
+    room.spot_ = room.scene_->CreateChild<Light>("spot");
+    room.spot_->SetType(LightType::SPOT);
+    room.spot_->SetDistance(15);
+    room.spot_->SetSpotCutOff(60);
+    room.spot_->SetPosition(Vertex3(10, 0, 10));
+    room.spot_->SetGlobalLookAtPosition(Vector3(10, 0, 0));
+    room.sun_ = room.scene_->CreateChild<Light>("sun");
+    room.sun_->SetType(LightType::DIRECTIONAL);
+    return room;
+}
+
+// The octree finds the same nodes than testing each one of them
+static void Test02() {
+    auto room = CreateRoom();
+    auto scene = room.scene_;
+    for (auto light : {room.point_, room.spot_, room.sun_}) {
+        std::vector<SceneNode*> lighted;
+        scene->GetLightedNodes(light.get(), lighted);
+        std::sort(lighted.begin(), lighted.end());
+        CHECK_CONDITION(std::adjacent_find(lighted.begin(), lighted.end()) ==
+                        lighted.end());
+        for (auto node : room.nodes_) {
+            auto found =
+                std::binary_search(lighted.begin(), lighted.end(), node);
+            CHECK_CONDITION(found ==
+                            light->CanLight(node->GetWorldBoundingBox()));
+        }
+        printf("%s light reaches %d of %d nodes\n", light->GetName().c_str(),
+               (int)lighted.size(), (int)room.nodes_.size());
+    }
+    std::vector<SceneNode*> lighted;
+    scene->GetLightedNodes(room.point_.get(), lighted);
+    // the box around the light and its eight neighbours
+    CHECK_CONDITION(lighted.size() == 9);
+    scene->GetLightedNodes(room.spot_.get(), lighted);
+    CHECK_CONDITION(lighted.size() > 1 && lighted.size() < 40);
+    scene->GetLightedNodes(room.sun_.get(), lighted);
+    CHECK_CONDITION(lighted.size() == room.nodes_.size());
+}
+
+// The lit batches only keep the nodes reached by each light
+static void Test03() {
+    auto room = CreateRoom();
+    RenderQueue queue;
+    for (auto node : room.nodes_)
+        queue.Add(node, 0);
+    queue.Sort();
+    auto& batches = queue.GetBatches();
+    CHECK_CONDITION(batches.size() == 2);
+    FrameArena::Scope scope;
+    FrameVector<SceneNode*> nodes;
+    FrameVector<Batch> lightedBatches;
+    size_t pairs = 0;
+    size_t culledPairs = 0;
+    for (auto light : {room.point_, room.spot_, room.sun_}) {
+        Renderer::GetLightedBatches(room.scene_.get(), light.get(), batches,
+                                    nodes, lightedBatches);
+        size_t count = 0;
+        for (auto& batch : lightedBatches) {
+            CHECK_CONDITION(batch.GetNodesCount() > 0);
+            for (auto node : batch) {
+                CHECK_CONDITION(node->GetMaterial().get() ==
+                                batch.GetMaterial());
+                CHECK_CONDITION(light->CanLight(node->GetWorldBoundingBox()));
+            }
+            count += batch.GetNodesCount();
+        }
+        std::vector<SceneNode*> lighted;
+        room.scene_->GetLightedNodes(light.get(), lighted);
+        CHECK_CONDITION(count == lighted.size());
+        pairs += room.nodes_.size();
+        culledPairs += count;
+    }
+    printf("light x node draws: %d without culling, %d with culling\n",
+           (int)pairs, (int)culledPairs);
+
+    // the sun keeps the original batches
+    Renderer::GetLightedBatches(room.scene_.get(), room.sun_.get(), batches,
+                                nodes, lightedBatches);
+    CHECK_CONDITION(lightedBatches.size() == batches.size() && nodes.empty());
+    // unlit materials are skipped
+    batches[0].GetMaterial()->SetRenderPass(RenderPass::UNLIT);
+    Renderer::GetLightedBatches(room.scene_.get(), room.sun_.get(), batches,
+                                nodes, lightedBatches);
+    CHECK_CONDITION(lightedBatches.size() == 1);
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+    Test03();
+}
@@ -0,0 +1 @@
+setupTest()
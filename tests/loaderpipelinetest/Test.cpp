@@ -0,0 +1,252 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include "pugixml.hpp"
+#include <cstdio>
+#include <fstream>
+#include <thread>
+using namespace NSG;
+
+static const int OBJECTS = 100; // of each type
+static const int GRID = 24;     // quads per mesh side
+static const int IMAGE_SIZE = 32;
+
+static std::string Name(const char* prefix, int i) {
+    return prefix + ToString(i);
+}
+
+static std::string Text(int i) {
+    std::string text;
+    for (int j = 0; j < 100; j++)
+        text += "line " + ToString(j) + " of text " + ToString(i) + "\n";
+    return text;
+}
+
+static void SaveFile(const std::string& name, const std::string& data) {
+    std::ofstream file(Path(name).GetFullAbsoluteFilePath().c_str(),
+                       std::ios::binary);
+    file.write(data.c_str(), data.size());
+    CHECK_CONDITION(file.good());
+}
+
+// Uncompressed 32 bits TGA
+static void SaveImage(const std::string& name, int i) {
+    std::string data(18, 0);
+    data[2] = 2;
+    data[12] = IMAGE_SIZE;
+    data[14] = IMAGE_SIZE;
+    data[16] = 32;
+    data[17] = 8;
+    for (int p = 0; p < IMAGE_SIZE * IMAGE_SIZE; p++) {
+        data += (char)i;
+        data += (char)p;
+        data += (char)(p >> 8);
+        data += (char)0xFF;
+    }
+    SaveFile(name, data);
+}
+
+static VertexsData GridVertexs(int i) {
+    VertexsData data;
+    for (int y = 0; y <= GRID; y++) {
+        for (int x = 0; x <= GRID; x++) {
+            VertexData vertex;
+            vertex.position_ = Vertex3((float)x, (float)y, (float)i);
+            vertex.normal_ = Vertex3(0, 0, 1);
+            vertex.uv_[0] = Vertex2((float)x / GRID, (float)y / GRID);
+            data.push_back(vertex);
+        }
+    }
+    return data;
+}
+
+static Indexes GridIndexes() {
+    Indexes indexes;
+    for (int y = 0; y < GRID; y++) {
+        for (int x = 0; x < GRID; x++) {
+            IndexType v = y * (GRID + 1) + x;
+            IndexType quad[] = {v, v + 1, v + GRID + 2,
+                                v, v + GRID + 2, v + GRID + 1};
+            indexes.insert(indexes.end(), quad, quad + 6);
+        }
+    }
+    return indexes;
+}
+
+static BoundingBox GridBB(int i) {
+    BoundingBox bb;
+    for (auto& vertex : GridVertexs(i))
+        bb.Merge(vertex.position_);
+    return bb;
+}
+
+// Resources (images and lz4 files), meshes, materials and shapes
+static void SaveApp(const Path& file) {
+    pugi::xml_document doc;
+    auto app = doc.append_child("App");
+    auto resources = app.append_child("Resources");
+    auto meshes = app.append_child("Meshes");
+    auto materials = app.append_child("Materials");
+    auto shapes = app.append_child("Shapes");
+    for (int i = 0; i < OBJECTS; i++) {
+        auto imageName = Name("pipeline", i) + ".tga";
+        SaveImage(imageName, i);
+        resources.append_child("Resource")
+            .append_attribute("name")
+            .set_value(imageName.c_str());
+
+        auto textName = Name("pipeline", i) + ".txt.lz4";
+        SaveFile(textName, CompressBuffer(Text(i)));
+        resources.append_child("Resource")
+            .append_attribute("name")
+            .set_value(textName.c_str());
+
+        auto mesh = std::make_shared<ModelMesh>(Name("mesh", i));
+        mesh->SetMeshData(GridVertexs(i), GridIndexes());
+        mesh->SetOptimizeOnLoad(i % 2 == 0);
+        mesh->Save(meshes);
+
+        auto material = std::make_shared<Material>(Name("material", i));
+        auto resource = Resource::GetOrCreate<ResourceFile>(imageName);
+        material->SetTexture(std::make_shared<Texture2D>(resource));
+        material->Save(materials);
+        // the loader finds the resources with the name in the XML
+        materials.last_child()
+            .child("Texture")
+            .attribute("resource")
+            .set_value(imageName.c_str());
+
+        auto shape = shapes.append_child("Shape");
+        auto key = ShapeKey(mesh, Vector3(1));
+        shape.append_attribute("name").set_value(key.c_str());
+        shape.append_attribute("meshName").set_value(mesh->GetName().c_str());
+        shape.append_attribute("bb").set_value(ToString(GridBB(i)).c_str());
+        shape.append_attribute("type").set_value(
+            ToString(mesh->GetShapeType()));
+        shape.append_attribute("margin").set_value(0.06f);
+        shape.append_attribute("scale").set_value(
+            ToString(Vector3(1)).c_str());
+    }
+    CHECK_CONDITION(doc.save_file(file.GetFullAbsoluteFilePath().c_str()));
+}
+
+static void CheckApp() {
+    for (int i = 0; i < OBJECTS; i++) {
+        auto text = Resource::Get(Name("pipeline", i) + ".txt.lz4");
+        CHECK_CONDITION(text && text->IsReady());
+        CHECK_CONDITION(text->GetBuffer() == Text(i));
+
+        auto mesh = Mesh::Get(Name("mesh", i));
+        CHECK_CONDITION(mesh && mesh->IsReady());
+        CHECK_CONDITION(mesh->GetBB() == GridBB(i));
+        CHECK_CONDITION(mesh->GetIndexes(true).size() == GridIndexes().size());
+        CHECK_CONDITION(mesh->GetVertexBuffer());
+
+        auto material = Material::Get(Name("material", i));
+        CHECK_CONDITION(material && material->IsReady());
+        PTexture texture;
+        for (int m = 0; m < MaterialTexture::MAX_MAPS && !texture; m++)
+            texture = material->GetTexture((MaterialTexture)m);
+        CHECK_CONDITION(texture && texture->IsReady());
+        CHECK_CONDITION(texture->GetWidth() == IMAGE_SIZE);
+
+        auto shape = Shape::Get(ShapeKey(mesh, Vector3(1)));
+        CHECK_CONDITION(shape && shape->IsReady());
+        CHECK_CONDITION(shape->GetCollisionShape());
+    }
+}
+
+// The loaded objects are the saved ones, the progress grows up to 100 and
+// the main thread keeps close to the frame budget
+static void Test01() {
+    Path file("loaderpipeline.xml");
+    SaveApp(file);
+
+    auto engine = Engine::Create(); // creates the job system
+    auto resource = Resource::GetOrCreate<ResourceFile>(file.GetFilePath());
+    LoaderXML loader("loader");
+    loader.SetFrameBudget(Milliseconds(2));
+    std::vector<float> progress;
+    auto slotProgress = loader.SigProgress()->Connect(
+        [&](float percentage) { progress.push_back(percentage); });
+    bool loaded = false;
+    auto slotLoaded = loader.Load(resource)->Connect([&]() { loaded = true; });
+
+    auto start = BenchClock::now();
+    int frames = 0;
+    double maxFrameMs = 0;
+    while (!loaded) {
+        auto frameStart = BenchClock::now();
+        Engine::SigUpdate()->Run(0);
+        maxFrameMs = std::max(maxFrameMs, ElapsedMs(frameStart));
+        ++frames;
+    }
+    printf("%d objects loaded in %.2f ms: %d frames, slowest %.2f ms "
+           "(%u workers)\n",
+           5 * OBJECTS, ElapsedMs(start), frames, maxFrameMs,
+           Task::JobSystem::GetPtr()->GetWorkersCount());
+
+    CHECK_CONDITION(!progress.empty() && progress.back() == 100);
+    for (size_t i = 1; i < progress.size(); i++)
+        CHECK_CONDITION(progress[i - 1] <= progress[i]);
+    CheckApp();
+}
+
+// The workers do not touch the objects and invalidating the loader cancels
+// its jobs
+static void Test02() {
+    Path file("loaderpipeline.xml");
+    SaveApp(file);
+
+    auto engine = Engine::Create();
+    auto resource = Resource::GetOrCreate<ResourceFile>(file.GetFilePath());
+    LoaderXML loader("loader");
+    bool loaded = false;
+    auto slotLoaded = loader.Load(resource)->Connect([&]() { loaded = true; });
+    Engine::SigUpdate()->Run(0); // starts the jobs
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (int i = 0; i < OBJECTS; i++) {
+        auto mesh = Mesh::Get(Name("mesh", i));
+        CHECK_CONDITION(mesh && mesh->IsPreparing());
+        CHECK_CONDITION(mesh->GetVertexsData().empty());
+        auto text = Resource::Get(Name("pipeline", i) + ".txt.lz4");
+        CHECK_CONDITION(text && text->GetBuffer().empty());
+    }
+
+    loader.Invalidate(); // waits for the jobs
+    for (int i = 0; i < OBJECTS; i++)
+        CHECK_CONDITION(!Mesh::Get(Name("mesh", i))->IsPreparing());
+    while (!loaded)
+        Engine::SigUpdate()->Run(0);
+    CheckApp();
+}
+
+void Tests() {
+    auto window = Window::Create("window", (int)WindowFlag::HIDDEN);
+    Test01();
+    Test02();
+}
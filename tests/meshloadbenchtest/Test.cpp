@@ -0,0 +1,130 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include "pugixml.hpp"
+#include <cstdio>
+#include <fstream>
+using namespace NSG;
+
+static const size_t VERTEXES = 1000000; // multiple of 3, no indexes needed
+
+static PModelMesh CreateMesh() {
+    VertexsData data(VERTEXES - VERTEXES % 3);
+    for (size_t i = 0; i < data.size(); i++) {
+        auto& vertex = data[i];
+        // values survive the XML text conversion without precision loss
+        vertex.position_ =
+            Vertex3((float)(i % 1000), (i / 1000) * 0.5f, (float)(i % 3));
+        vertex.normal_ = Vertex3(0, 0, 1);
+        vertex.uv_[0] = Vertex2((i % 4) * 0.25f, (i % 3) * 0.5f);
+    }
+    auto mesh = std::make_shared<ModelMesh>("bench");
+    mesh->SetMeshData(data, Indexes());
+    return mesh;
+}
+
+static bool SameVertexs(const VertexsData& a, const VertexsData& b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i].position_ != b[i].position_ || a[i].normal_ != b[i].normal_ ||
+            a[i].uv_[0] != b[i].uv_[0])
+            return false;
+    return true;
+}
+
+// XML and binary files must load the same mesh, binary one much faster.
+static void Test01() {
+    Path xmlFile("meshloadbench.xml");
+    Path binFile("meshloadbench.nsgmesh");
+    {
+        auto mesh = CreateMesh();
+        pugi::xml_document doc;
+        mesh->Save(doc);
+        CHECK_CONDITION(
+            doc.save_file(xmlFile.GetFullAbsoluteFilePath().c_str()));
+        CHECK_CONDITION(mesh->SaveBinary(binFile));
+    }
+
+    auto start = BenchClock::now();
+    auto xmlMesh = std::make_shared<ModelMesh>("xml");
+    {
+        pugi::xml_document doc;
+        CHECK_CONDITION(
+            doc.load_file(xmlFile.GetFullAbsoluteFilePath().c_str()));
+        xmlMesh->Load(doc.child("Mesh"));
+        CHECK_CONDITION(xmlMesh->IsReady());
+    }
+    auto xmlMs = ElapsedMs(start);
+
+    start = BenchClock::now();
+    auto binMesh = std::make_shared<ModelMesh>("bin");
+    {
+        pugi::xml_document doc;
+        auto node = doc.append_child("Mesh");
+        node.append_attribute("name").set_value("bin");
+        node.append_attribute("file").set_value(binFile.GetFilePath().c_str());
+        binMesh->Load(node);
+        CHECK_CONDITION(binMesh->IsReady());
+    }
+    auto binMs = ElapsedMs(start);
+
+    printf("%d vertexes: XML %.2f ms, binary %.2f ms\n",
+           (int)xmlMesh->GetVertexsData().size(), xmlMs, binMs);
+
+    CHECK_CONDITION(SameVertexs(xmlMesh->GetVertexsData(),
+                                binMesh->GetVertexsData()));
+    CHECK_CONDITION(xmlMesh->GetBB() == binMesh->GetBB());
+    CHECK_CONDITION(xmlMesh->GetBoundingSphereRadius() ==
+                    binMesh->GetBoundingSphereRadius());
+}
+
+// Files with other version or layout must be rejected.
+static void Test02() {
+    Path binFile("meshloadbench.nsgmesh");
+    auto mesh = std::make_shared<ModelMesh>("bad");
+    {
+        std::fstream file(binFile.GetFullAbsoluteFilePath(),
+                          std::ios::binary | std::ios::in | std::ios::out);
+        MeshFileHeader header;
+        file.read((char*)&header, sizeof(header));
+        header.version_ = MESH_FILE_VERSION + 1;
+        file.seekp(0);
+        file.write((const char*)&header, sizeof(header));
+    }
+    pugi::xml_document doc;
+    auto node = doc.append_child("Mesh");
+    node.append_attribute("file").set_value(binFile.GetFilePath().c_str());
+    mesh->Load(node);
+    CHECK_CONDITION(mesh->GetVertexsData().empty());
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+}
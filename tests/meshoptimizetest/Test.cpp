@@ -0,0 +1,144 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+#include <algorithm>
+#include <array>
+#include <random>
+using namespace NSG;
+
+static const int GRID = 100;
+
+// Not indexed grid (3 vertexes per triangle) with shuffled triangles
+static void CreateGrid(VertexsData& vertexes, Indexes& indexes) {
+    std::vector<std::array<int, 3>> triangles;
+    for (int y = 0; y + 1 < GRID; y++)
+        for (int x = 0; x + 1 < GRID; x++) {
+            int i0 = y * GRID + x;
+            triangles.push_back({{i0, i0 + 1, i0 + GRID + 1}});
+            triangles.push_back({{i0, i0 + GRID + 1, i0 + GRID}});
+        }
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+    vertexes.clear();
+    indexes.clear();
+    for (auto& triangle : triangles)
+        for (auto i : triangle) {
+            VertexData vertex;
+            vertex.position_ = Vertex3(float(i % GRID), float(i / GRID), 0);
+            indexes.push_back((IndexType)vertexes.size());
+            vertexes.push_back(vertex);
+        }
+}
+
+static std::vector<std::string> Triangles(const VertexsData& vertexes,
+                                          const Indexes& indexes) {
+    std::vector<std::string> triangles;
+    for (size_t i = 0; i < indexes.size(); i += 3) {
+        std::vector<std::string> corners;
+        for (size_t k = 0; k < 3; k++)
+            corners.push_back(ToString(vertexes[indexes[i + k]].position_));
+        // keep the winding: rotate the smallest corner to the front
+        std::rotate(corners.begin(),
+                    std::min_element(corners.begin(), corners.end()),
+                    corners.end());
+        triangles.push_back(corners[0] + corners[1] + corners[2]);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+static void Test01() {
+    VertexsData vertexes;
+    Indexes indexes;
+    CreateGrid(vertexes, indexes);
+    auto triangles = Triangles(vertexes, indexes);
+    auto remap = WeldVertexes(vertexes, indexes);
+    CHECK_CONDITION(remap.size() == indexes.size());
+    CHECK_CONDITION(vertexes.size() == GRID * GRID);
+    CHECK_CONDITION(Triangles(vertexes, indexes) == triangles);
+
+    auto before = AnalyzeVertexCache(indexes, vertexes.size());
+    OptimizeVertexCache(indexes, vertexes.size());
+    auto after = AnalyzeVertexCache(indexes, vertexes.size());
+    printf("ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr_,
+           after.acmr_, before.atvr_, after.atvr_);
+    CHECK_CONDITION(after.acmr_ < 0.8f && after.acmr_ < before.acmr_);
+    CHECK_CONDITION(after.atvr_ < before.atvr_);
+    CHECK_CONDITION(Triangles(vertexes, indexes) == triangles);
+
+    OptimizeVertexFetch(vertexes, indexes);
+    CHECK_CONDITION(Triangles(vertexes, indexes) == triangles);
+    // vertexes appear in the order they are used
+    IndexType next = 0;
+    for (auto index : indexes) {
+        CHECK_CONDITION(index <= next);
+        if (index == next)
+            ++next;
+    }
+}
+
+static void Test02() {
+    VertexsData vertexes;
+    Indexes indexes;
+    CreateGrid(vertexes, indexes);
+    auto triangles = Triangles(vertexes, indexes);
+    auto mesh = Mesh::Create<ModelMesh>("grid");
+    mesh->SetMeshData(vertexes, Indexes());
+    mesh->Optimize(true);
+    CHECK_CONDITION(mesh->GetVertexsData().size() == GRID * GRID);
+    CHECK_CONDITION(Triangles(mesh->GetVertexsData(),
+                              mesh->GetIndexes(true)) == triangles);
+
+    WeldVertexes(vertexes, indexes);
+    OptimizeVertexCache(indexes, vertexes.size());
+    auto acmr = AnalyzeVertexCache(indexes, vertexes.size()).acmr_;
+    auto& meshIndexes = mesh->GetIndexes(true);
+    auto overdrawAcmr = AnalyzeVertexCache(meshIndexes, GRID * GRID).acmr_;
+    CHECK_CONDITION(overdrawAcmr <= 1.05f * acmr + 0.01f);
+}
+
+static void Test03() {
+    auto sphere = Mesh::Create<SphereMesh>("sphere");
+    sphere->Set(1, 32);
+    CHECK_CONDITION(sphere->IsReady());
+    auto& vertexes = sphere->GetVertexsData();
+    auto before = AnalyzeVertexCache(sphere->GetIndexes(true), vertexes.size());
+    auto nTriangles = sphere->GetNumberOfTriangles();
+    sphere->SetOptimizeOnLoad(true);
+    CHECK_CONDITION(sphere->IsReady());
+    auto after = AnalyzeVertexCache(sphere->GetIndexes(true), vertexes.size());
+    printf("Sphere ACMR %.3f -> %.3f\n", before.acmr_, after.acmr_);
+    CHECK_CONDITION(after.acmr_ <= before.acmr_);
+    CHECK_CONDITION(sphere->GetNumberOfTriangles() == nTriangles);
+    for (auto index : sphere->GetIndexes(false))
+        CHECK_CONDITION(index < vertexes.size());
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+    Test03();
+}
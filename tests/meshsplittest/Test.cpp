@@ -0,0 +1,156 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+using namespace NSG;
+
+static const int GRID = 300; // 90000 vertexes: needs 32 bits indexes
+
+static PModelMesh CreateGrid() {
+    VertexsData vertexes;
+    Indexes indexes;
+    for (int y = 0; y < GRID; y++)
+        for (int x = 0; x < GRID; x++) {
+            VertexData vertex;
+            vertex.position_ = Vertex3(x - GRID / 2.f, y - GRID / 2.f, 0);
+            vertexes.push_back(vertex);
+        }
+    for (int y = 0; y + 1 < GRID; y++)
+        for (int x = 0; x + 1 < GRID; x++) {
+            IndexType i0 = y * GRID + x;
+            IndexType i1 = i0 + 1;
+            IndexType i2 = i0 + GRID;
+            IndexType i3 = i2 + 1;
+            indexes.insert(indexes.end(), {i0, i1, i3, i0, i3, i2});
+        }
+    auto mesh = Mesh::Create<ModelMesh>("grid");
+    mesh->SetMeshData(vertexes, indexes);
+    return mesh;
+}
+
+static float Area(const Mesh& mesh) {
+    float area = 0;
+    auto& vertexes = mesh.GetVertexsData();
+    auto& indexes = mesh.GetIndexes(true);
+    for (size_t i = 0; i < indexes.size(); i += 3) {
+        auto v0 = vertexes[indexes[i]].position_;
+        auto v1 = vertexes[indexes[i + 1]].position_;
+        auto v2 = vertexes[indexes[i + 2]].position_;
+        area += 0.5f * (v1 - v0).Cross(v2 - v0).Length();
+    }
+    return area;
+}
+
+// Chunks keep every triangle, respect the limit and are spatially compact.
+static void Test01() {
+    auto mesh = CreateGrid();
+    CHECK_CONDITION(IndexBuffer::Needs32Bits(mesh->GetIndexes(true)));
+    auto chunks = mesh->Split(Mesh::MAX_CHUNK_VERTEXES);
+    CHECK_CONDITION(chunks.size() >= 2);
+    size_t triangles = 0;
+    float area = 0;
+    for (auto& chunk : chunks) {
+        CHECK_CONDITION(chunk->GetVertexsData().size() <=
+                        Mesh::MAX_CHUNK_VERTEXES);
+        CHECK_CONDITION(!IndexBuffer::Needs32Bits(chunk->GetIndexes(true)));
+        triangles += chunk->GetIndexes(true).size() / 3;
+        area += Area(*chunk);
+        BoundingBox bb;
+        for (auto& vertex : chunk->GetVertexsData())
+            bb.Merge(vertex.position_);
+        auto size = bb.Size();
+        CHECK_CONDITION(size.x * size.y < (GRID - 1) * (GRID - 1));
+    }
+    CHECK_CONDITION(triangles == mesh->GetIndexes(true).size() / 3);
+    CHECK_CONDITION(Distance(area, Area(*mesh)) < 1.f);
+}
+
+// Split nodes are replaced in the octree by their chunks.
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto camera = scene->CreateChild<Camera>("camera");
+    camera->SetGlobalLookAtPosition(Vector3(0, 0, -1));
+    auto node = scene->CreateChild<SceneNode>("node");
+    node->SetPosition(Vector3(0, 0, -50));
+    node->SetMesh(CreateGrid());
+    CHECK_CONDITION(node->GetMesh()->IsReady());
+
+    node->SplitMesh(20000);
+    CHECK_CONDITION(node->IsMeshSplit());
+    CHECK_CONDITION(node->GetChildren().size() >= 5);
+
+    std::vector<SceneNode*> visibles;
+    scene->GetVisibleNodes(camera.get(), visibles);
+    CHECK_CONDITION(!visibles.empty());
+    CHECK_CONDITION(std::find(visibles.begin(), visibles.end(), node.get()) ==
+                    visibles.end());
+    // only the chunks in front of the camera
+    CHECK_CONDITION(visibles.size() < node->GetChildren().size());
+
+    node->SetMesh(nullptr);
+    CHECK_CONDITION(!node->IsMeshSplit());
+    CHECK_CONDITION(node->GetChildren().empty());
+}
+
+// Without 32 bits indexes the scene splits the nodes when the mesh gets
+// ready. The chunks are skinned by the armature of the split node.
+static void Test03() {
+    RenderingCapabilities::GetPtr()->DisableElementIndexUint();
+    auto scene = std::make_shared<Scene>("scene");
+    auto camera = scene->CreateChild<Camera>("camera");
+    camera->SetGlobalLookAtPosition(Vector3(0, 0, -1));
+    auto armature = scene->CreateChild<SceneNode>("armature");
+    auto node = armature->CreateChild<SceneNode>("node");
+    node->SetPosition(Vector3(0, 0, -50));
+    node->SetArmature(armature);
+    node->SetMesh(CreateGrid());
+    CHECK_CONDITION(node->GetMesh()->IsReady());
+    CHECK_CONDITION(node->GetMesh()->NeedsSplit());
+
+    // the queries do not split it
+    std::vector<SceneNode*> visibles;
+    scene->GetVisibleNodes(camera.get(), visibles);
+    CHECK_CONDITION(!node->IsMeshSplit());
+
+    scene->UpdateAll(0);
+    CHECK_CONDITION(node->IsMeshSplit());
+    CHECK_CONDITION(node->GetChildren().size() >= 2);
+    for (auto& child : node->GetChildren()) {
+        auto chunk = std::dynamic_pointer_cast<SceneNode>(child);
+        CHECK_CONDITION(chunk->GetArmature() == armature);
+        CHECK_CONDITION(!chunk->GetMesh()->NeedsSplit());
+    }
+    scene->GetVisibleNodes(camera.get(), visibles);
+    CHECK_CONDITION(!visibles.empty());
+    CHECK_CONDITION(std::find(visibles.begin(), visibles.end(), node.get()) ==
+                    visibles.end());
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+    Test03(); // leaves the 32 bits indexes disabled
+}
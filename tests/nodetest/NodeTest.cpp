@@ -453,6 +453,77 @@ static void Test09() {
         0.001f);
 }
 
+static void CheckSameTransforms(const Node* a, const Node* b) {
+    CHECK_CONDITION(a->GetGlobalPosition().Distance(b->GetGlobalPosition()) <
+                    0.001f);
+    CHECK_CONDITION(a->GetGlobalScale().Distance(b->GetGlobalScale()) <
+                    0.001f);
+    CHECK_CONDITION(
+        a->GetLookAtDirection().Distance(b->GetLookAtDirection()) < 0.001f);
+    auto pa = a->GetGlobalModelInvMatrix() * Vertex4(1, 2, 3, 1);
+    auto pb = b->GetGlobalModelInvMatrix() * Vertex4(1, 2, 3, 1);
+    CHECK_CONDITION(Vertex3(pa).Distance(Vertex3(pb)) < 0.001f);
+    auto& childrenA = a->GetChildren();
+    auto& childrenB = b->GetChildren();
+    CHECK_CONDITION(childrenA.size() == childrenB.size());
+    for (size_t i = 0; i < childrenA.size(); i++)
+        CheckSameTransforms(childrenA[i].get(), childrenB[i].get());
+}
+
+// Flattened transforms must give the same results as the per node update
+static void Test10() {
+    auto legacy = std::make_shared<Scene>("legacy");
+    auto flat = std::make_shared<Scene>("flat");
+    flat->EnableFlatTransforms(true);
+    for (auto& scene : {legacy, flat}) {
+        for (int i = 0; i < 10; i++) {
+            auto child = scene->CreateChild<SceneNode>();
+            child->SetPosition(Vertex3(float(i), 0, 0));
+            child->Yaw(Radians(10.f * i));
+            for (int j = 0; j < 10; j++) {
+                auto grandChild = child->CreateChild<SceneNode>();
+                grandChild->SetPosition(Vertex3(0, float(j), 1));
+                grandChild->SetScale(1.f + j);
+            }
+        }
+    }
+    CheckSameTransforms(legacy.get(), flat.get());
+    auto hierarchy = flat->GetFlatTransforms();
+    CHECK_CONDITION(hierarchy->GetSize() == 111);
+
+    for (auto& scene : {legacy, flat}) {
+        auto child = scene->GetChild(3);
+        child->SetPosition(Vertex3(5, 5, 5));
+        child->SetScale(2);
+    }
+    hierarchy->Update();
+    // only the moved node and its 10 children
+    CHECK_CONDITION(hierarchy->GetUpdatedNodes() == 11);
+    CheckSameTransforms(legacy.get(), flat.get());
+
+    for (auto& scene : {legacy, flat}) {
+        auto child = scene->GetChild(4);
+        child->Hide(true);
+        child->SetPosition(Vertex3(1, 2, 3));
+    }
+    hierarchy->Update();
+    // hidden nodes are not updated until they are shown
+    CHECK_CONDITION(hierarchy->GetUpdatedNodes() == 0);
+    for (auto& scene : {legacy, flat})
+        scene->GetChild(4)->Hide(false);
+    CheckSameTransforms(legacy.get(), flat.get());
+
+    for (auto& scene : {legacy, flat}) {
+        auto child = scene->GetChild(5);
+        child->GetChild(0)->SetParent(scene->GetChild(7));
+        child->SetParent(nullptr);
+        scene->GetChild(7)->Roll(Radians(45.f));
+        scene->Translate(Vertex3(1, 0, 0));
+    }
+    CheckSameTransforms(legacy.get(), flat.get());
+    CHECK_CONDITION(hierarchy->GetSize() == 101);
+}
+
 void NodeTest() {
     Test01();
     Test02();
@@ -463,4 +534,5 @@ void NodeTest() {
     Test07();
     Test08();
     Test09();
+    Test10();
 }
@@ -0,0 +1,222 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include <algorithm>
+using namespace NSG;
+
+static const int ITERATIONS = 100;
+static const float MARGIN = 1; // around the silhouette of the wall
+
+// Known triangles seen from the origin looking to -z
+static void Test01() {
+    OcclusionBuffer buffer(256, 128);
+    Matrix4 projection(Radians(60.f), 2.f, 0.1f, 100.f);
+    buffer.SetView(projection);
+    // wall at z = -10
+    buffer.AddTriangle(Vector3(-5, -3, -10), Vector3(5, -3, -10),
+                       Vector3(5, 3, -10));
+    buffer.AddTriangle(Vector3(-5, -3, -10), Vector3(5, 3, -10),
+                       Vector3(-5, 3, -10));
+    buffer.BuildHierarchy();
+    CHECK_CONDITION(buffer.GetTrianglesCount() == 2);
+    CHECK_CONDITION(buffer.GetLevels() == 9);
+    CHECK_CONDITION(buffer.GetDepth(128, 64) < 1);
+    CHECK_CONDITION(buffer.GetDepth(0, 0) == 1);
+    auto visible = [&](const Vector3& min, const Vector3& max) {
+        return buffer.IsVisible(BoundingBox(min, max));
+    };
+    // behind, in front, aside, crossing and behind the camera
+    CHECK_CONDITION(!visible(Vector3(-1, -1, -21), Vector3(1, 1, -20)));
+    CHECK_CONDITION(!visible(Vector3(-3, -2, -50), Vector3(3, 2, -11)));
+    CHECK_CONDITION(visible(Vector3(-1, -1, -9), Vector3(1, 1, -8)));
+    CHECK_CONDITION(visible(Vector3(20, -1, -21), Vector3(22, 1, -20)));
+    CHECK_CONDITION(visible(Vector3(-1, -1, -12), Vector3(1, 1, -9)));
+    CHECK_CONDITION(visible(Vector3(-1, -1, 1), Vector3(1, 1, 2)));
+
+    // a floor crossing the near plane is clipped
+    buffer.SetView(projection);
+    buffer.AddTriangle(Vector3(-100, -1, 50), Vector3(100, -1, 50),
+                       Vector3(0, -1, -100));
+    buffer.BuildHierarchy();
+    CHECK_CONDITION(!visible(Vector3(-1, -5, -20), Vector3(1, -3, -18)));
+    CHECK_CONDITION(visible(Vector3(-1, 0, -20), Vector3(1, 1, -18)));
+}
+
+struct City {
+    PScene scene_;
+    PCamera camera_;
+    PSceneNode wall_;
+    std::vector<PSceneNode> buildings_;
+};
+
+// A wall in front of the camera hiding part of a grid of buildings
+static City CreateCity() {
+    City city;
+    city.scene_ = std::make_shared<Scene>("scene");
+    city.camera_ = city.scene_->CreateChild<Camera>();
+    city.camera_->SetPosition(Vertex3(0, 5, 30));
+    city.camera_->SetGlobalLookAtPosition(Vector3(0, 5, 0));
+    city.camera_->SetAspectRatio(2.f);
+    auto mesh(Mesh::Create<BoxMesh>()); // 2 x 2 x 2
+    city.wall_ = city.scene_->CreateChild<SceneNode>("wall");
+    city.wall_->SetMesh(mesh);
+    city.wall_->SetPosition(Vertex3(0, 5, -10));
+    city.wall_->SetScale(Vertex3(10, 10, .5f));
+    city.wall_->EnableFlags((int)SceneNodeFlag::OCCLUDER);
+    for (int z = 0; z >= -100; z -= 5) {
+        if (z == -10)
+            continue;
+        for (int x = -40; x <= 40; x += 5) {
+            auto node = city.scene_->CreateChild<SceneNode>();
+            node->SetMesh(mesh);
+            node->SetPosition(Vertex3((float)x, 5, (float)z));
+            city.buildings_.push_back(node);
+        }
+    }
+    return city;
+}
+
+// Projection of p in the plane of the front face of the wall
+static Vector3 ProjectInWall(const Vector3& eye, const Vector3& p) {
+    auto t = (eye.z + 9.5f) / (eye.z - p.z);
+    return eye + (p - eye) * t;
+}
+
+static bool InWall(const Vector3& p, float margin) {
+    return p.x >= -10 - margin && p.x <= 10 + margin && p.y >= -5 - margin &&
+           p.y <= 15 + margin;
+}
+
+// 1: behind the wall inside of its silhouette, -1: partly visible,
+// 0: too close to the silhouette to be sure
+static int Classify(const Vector3& eye, const BoundingBox& box) {
+    bool hidden = true;
+    for (int i = 0; i < 8; i++) {
+        Vector3 corner(i & 1 ? box.max_.x : box.min_.x,
+                       i & 2 ? box.max_.y : box.min_.y,
+                       i & 4 ? box.max_.z : box.min_.z);
+        if (corner.z > -10.5f)
+            return -1;
+        auto p = ProjectInWall(eye, corner);
+        if (!InWall(p, MARGIN))
+            return -1;
+        hidden &= InWall(p, -MARGIN);
+    }
+    return hidden ? 1 : 0;
+}
+
+// The nodes behind the wall are culled, the partly visible ones are kept
+static void Test02() {
+    auto city = CreateCity();
+    auto scene = city.scene_;
+    auto camera = city.camera_.get();
+    std::vector<SceneNode*> frustumVisibles;
+    auto start = BenchClock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        scene->GetVisibleNodes(camera, frustumVisibles);
+    auto frustumMs = ElapsedMs(start) / ITERATIONS;
+
+    scene->EnableOcclusionCulling(true);
+    std::vector<SceneNode*> visibles;
+    start = BenchClock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        scene->GetVisibleNodes(camera, visibles);
+    auto occlusionMs = ElapsedMs(start) / ITERATIONS;
+    auto buffer = scene->GetOcclusionBuffer();
+    printf("%d nodes in the frustum, %d culled by %u occluders (%u "
+           "triangles)\n",
+           (int)frustumVisibles.size(),
+           (int)(frustumVisibles.size() - visibles.size()),
+           buffer->GetOccludersCount(), buffer->GetTrianglesCount());
+    printf("Frustum query:   %.3f ms\n", frustumMs);
+    printf("Occlusion query: %.3f ms\n", occlusionMs);
+
+    CHECK_CONDITION(buffer->GetOccludersCount() == 1);
+    std::sort(frustumVisibles.begin(), frustumVisibles.end());
+    std::sort(visibles.begin(), visibles.end());
+    CHECK_CONDITION(std::includes(frustumVisibles.begin(),
+                                  frustumVisibles.end(), visibles.begin(),
+                                  visibles.end()));
+    CHECK_CONDITION(
+        std::binary_search(visibles.begin(), visibles.end(), city.wall_.get()));
+    auto eye = camera->GetGlobalPosition();
+    int hidden = 0;
+    int partlyVisible = 0;
+    for (auto node : frustumVisibles) {
+        if (node == city.wall_.get())
+            continue;
+        auto visible =
+            std::binary_search(visibles.begin(), visibles.end(), node);
+        auto type = Classify(eye, node->GetWorldBoundingBox());
+        if (type > 0) {
+            CHECK_CONDITION(!visible);
+            ++hidden;
+        } else if (type < 0) {
+            CHECK_CONDITION(visible);
+            ++partlyVisible;
+        }
+    }
+    CHECK_CONDITION(hidden > 0 && partlyVisible > 0);
+}
+
+// Disabled occluders hide nothing and smaller proxies hide less
+static void Test03() {
+    auto city = CreateCity();
+    auto scene = city.scene_;
+    auto camera = city.camera_.get();
+    std::vector<SceneNode*> frustumVisibles;
+    scene->GetVisibleNodes(camera, frustumVisibles);
+    scene->EnableOcclusionCulling(true);
+    std::vector<SceneNode*> visibles;
+    scene->GetVisibleNodes(camera, visibles);
+    auto culled = frustumVisibles.size() - visibles.size();
+    CHECK_CONDITION(culled > 0);
+
+    city.wall_->DisableFlags((int)SceneNodeFlag::OCCLUDER);
+    scene->GetVisibleNodes(camera, visibles);
+    CHECK_CONDITION(visibles.size() == frustumVisibles.size());
+    CHECK_CONDITION(scene->GetOcclusionBuffer()->GetOccludersCount() == 0);
+
+    auto proxy(Mesh::Create<BoxMesh>());
+    proxy->Set(1, 1, 1);
+    city.wall_->SetOccluderMesh(proxy);
+    city.wall_->EnableFlags((int)SceneNodeFlag::OCCLUDER);
+    scene->GetVisibleNodes(camera, visibles);
+    auto proxyCulled = frustumVisibles.size() - visibles.size();
+    CHECK_CONDITION(proxyCulled > 0 && proxyCulled < culled);
+
+    city.wall_->Hide(true);
+    scene->GetVisibleNodes(camera, visibles);
+    CHECK_CONDITION(visibles.size() == frustumVisibles.size() - 1);
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+    Test03();
+}
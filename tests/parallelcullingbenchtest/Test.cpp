@@ -0,0 +1,150 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include <random>
+using namespace NSG;
+using namespace NSG::Task;
+
+static const int GRID = 448; // ~200k drawables
+static const int ITERATIONS = 20;
+
+// A city: a grid of buildings with random heights
+static std::vector<PSceneNode> CreateCity(PScene scene) {
+    auto mesh(Mesh::Create<BoxMesh>());
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> height(1.f, 20.f);
+    std::vector<PSceneNode> nodes;
+    nodes.reserve(GRID * GRID);
+    for (int z = 0; z < GRID; z++)
+        for (int x = 0; x < GRID; x++) {
+            auto node = scene->CreateChild<SceneNode>();
+            node->SetMesh(mesh);
+            auto h = height(generator);
+            node->SetPosition(
+                Vertex3(4.f * (x - GRID / 2), .5f * h, 4.f * (z - GRID / 2)));
+            node->SetScale(Vertex3(2, h, 2));
+            nodes.push_back(node);
+        }
+    return nodes;
+}
+
+// Queries with 1, 2, 4 and 8 threads. The results must be identical,
+// including the order.
+static void Test01() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto nodes = CreateCity(scene);
+    auto camera = scene->CreateChild<Camera>();
+    camera->SetPosition(Vertex3(0, 30, 800));
+    camera->SetGlobalLookAtPosition(Vector3(0, 0, 0));
+    camera->SetFarClip(2000);
+    auto light = scene->CreateChild<Camera>();
+    light->SetPosition(Vertex3(-600, 300, -600));
+    light->SetGlobalLookAtPosition(Vector3(0, 0, 0));
+    light->SetFarClip(2000);
+    Ray ray(Vertex3(-900, 2, -900), Vector3(1, 0, 1).Normalize());
+
+    auto octree = scene->GetOctree();
+    std::vector<SceneNode*> expectedCamera, expectedLight, expectedRay;
+    octree->SetParallelDepth(0);
+    scene->GetVisibleNodes(camera.get(), expectedCamera);
+    scene->GetVisibleNodes(light.get(), expectedLight);
+    scene->GetFastRayNodesIntersection(ray, expectedRay);
+    CHECK_CONDITION(!expectedCamera.empty() && !expectedLight.empty() &&
+                    !expectedRay.empty());
+    LOGI("%u drawables: %u visible from the camera, %u from the light, %u "
+         "along the ray",
+         octree->GetNumDrawables(), (unsigned)expectedCamera.size(),
+         (unsigned)expectedLight.size(), (unsigned)expectedRay.size());
+
+    double serialMs = 0;
+    for (int threads : {1, 2, 4, 8}) {
+        std::unique_ptr<JobSystem> jobs;
+        if (threads > 1) {
+            jobs.reset(new JobSystem(threads - 1));
+            octree->SetJobSystem(jobs.get());
+            octree->SetParallelDepth(2);
+        } else
+            octree->SetParallelDepth(0);
+        std::vector<SceneNode*> visibles;
+        double frustumMs = 0;
+        double rayMs = 0;
+        for (int i = 0; i < ITERATIONS; i++) {
+            auto start = BenchClock::now();
+            scene->GetVisibleNodes(camera.get(), visibles);
+            CHECK_CONDITION(visibles == expectedCamera);
+            scene->GetVisibleNodes(light.get(), visibles);
+            CHECK_CONDITION(visibles == expectedLight);
+            frustumMs += ElapsedMs(start);
+            start = BenchClock::now();
+            scene->GetFastRayNodesIntersection(ray, visibles);
+            CHECK_CONDITION(visibles == expectedRay);
+            rayMs += ElapsedMs(start);
+        }
+        frustumMs /= ITERATIONS;
+        rayMs /= ITERATIONS;
+        if (threads == 1)
+            serialMs = frustumMs;
+        LOGI("%d threads: %.2f ms camera+light, %.3f ms ray (x%.2f)",
+             threads, frustumMs, rayMs, serialMs / frustumMs);
+        octree->SetJobSystem(nullptr);
+    }
+    octree->SetParallelDepth(2);
+}
+
+// The parallel query sees the moved and hidden nodes.
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto nodes = CreateCity(scene);
+    auto camera = scene->CreateChild<Camera>();
+    camera->SetPosition(Vertex3(0, 100, 0));
+    camera->SetGlobalLookAtPosition(Vector3(300, 0, 300));
+    camera->SetFarClip(500);
+    JobSystem jobs(3);
+    auto octree = scene->GetOctree();
+    octree->SetJobSystem(&jobs);
+    std::mt19937 generator(4321);
+    std::uniform_real_distribution<float> position(-800.f, 800.f);
+    for (size_t i = 0; i < nodes.size(); i += 5)
+        nodes[i]->SetPosition(Vertex3(position(generator), 10,
+                                      position(generator)));
+    for (size_t i = 1; i < nodes.size(); i += 7)
+        nodes[i]->Hide(true);
+    std::vector<SceneNode*> visibles;
+    octree->SetParallelDepth(3);
+    scene->GetVisibleNodes(camera.get(), visibles);
+    std::vector<SceneNode*> expected;
+    octree->SetParallelDepth(0);
+    scene->GetVisibleNodes(camera.get(), expected);
+    CHECK_CONDITION(!expected.empty() && visibles == expected);
+    octree->SetJobSystem(nullptr);
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+}
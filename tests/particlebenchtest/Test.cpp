@@ -0,0 +1,93 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+using namespace NSG;
+
+static const float DELTA_TIME = 1.f / 30.f;
+static const int FRAMES = 60; // covers the whole emission time (2 secs)
+
+static PParticleSystem CreateParticleSystem(PScene scene,
+                                            ParticleSystemMode mode,
+                                            size_t amount) {
+    auto ps = scene->CreateChild<ParticleSystem>("ps");
+    ps->SetMesh(Mesh::Create<PlaneMesh>());
+    ps->SetMode(mode);
+    ps->SetAmount(amount);
+    return ps;
+}
+
+static size_t Simulate(ParticleSystemMode mode, size_t amount) {
+    auto scene = std::make_shared<Scene>("scene");
+    auto ps = CreateParticleSystem(scene, mode, amount);
+    auto start = BenchClock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        scene->UpdateAll(DELTA_TIME);
+    auto ms = ElapsedMs(start);
+    auto active = ps->GetActiveParticles();
+    printf("%s %d particles: %.2f ms/frame (%d active)\n",
+           mode == ParticleSystemMode::ARRAYS ? "ARRAYS" : "NODES ",
+           (int)amount, ms / FRAMES, (int)active);
+    return active;
+}
+
+// Both modes must emit the same particles, arrays should be much faster.
+static void Test01() {
+    const size_t amounts[] = {10000, 100000};
+    for (auto amount : amounts) {
+        auto nodes = Simulate(ParticleSystemMode::NODES, amount);
+        auto arrays = Simulate(ParticleSystemMode::ARRAYS, amount);
+        CHECK_CONDITION(nodes == amount);
+        CHECK_CONDITION(arrays == nodes);
+    }
+}
+
+// Particles in arrays must collide with the physics world.
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto boxMesh(Mesh::Create<BoxMesh>());
+    auto nodeFloor = scene->CreateChild<SceneNode>("floor");
+    nodeFloor->SetMesh(boxMesh);
+    auto scale = Vertex3(100, 2, 100);
+    nodeFloor->SetScale(scale);
+    nodeFloor->SetPosition(Vertex3(0, -10, 0));
+    auto body = nodeFloor->GetOrCreateRigidBody();
+    body->AddShape(Shape::Create(ShapeKey(boxMesh, scale)));
+    CHECK_CONDITION(body->IsReady());
+
+    auto ps = CreateParticleSystem(scene, ParticleSystemMode::ARRAYS, 1000);
+    for (int frame = 0; frame < FRAMES; frame++)
+        scene->UpdateAll(DELTA_TIME);
+    CHECK_CONDITION(ps->GetActiveParticles() == 1000);
+    // without the floor they would be falling around y = -20
+    CHECK_CONDITION(ps->GetParticlesBoundingBox().min_.y > -12.f);
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+}
@@ -0,0 +1,191 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include "Pool.h"
+#include <functional>
+#include <random>
+#include <thread>
+using namespace NSG;
+
+static const int THREADS = 8;
+
+// The pool grows by chunks and reuses the released objects.
+static void Test01() {
+    typedef Pool<64, 16> TestPool;
+    TestPool pool;
+    std::vector<void*> objs;
+    for (int i = 0; i < 1000; i++) {
+        auto p = pool.Allocate(64);
+        CHECK_CONDITION(p && pool.PointerInPool(p));
+        objs.push_back(p);
+    }
+    auto stats = pool.GetStats();
+    CHECK_CONDITION(stats.chunks_ >= 1000 / 16);
+    CHECK_CONDITION(stats.allocated_ >= 1000);
+    std::sort(objs.begin(), objs.end());
+    CHECK_CONDITION(std::unique(objs.begin(), objs.end()) == objs.end());
+    for (auto p : objs)
+        pool.DeAllocate(p);
+    // what is left is in this thread's cache
+    CHECK_CONDITION(pool.GetStats().allocated_ <= TestPool::CacheSize);
+    for (int i = 0; i < 1000; i++)
+        pool.DeAllocate(pool.Allocate(64));
+    CHECK_CONDITION(pool.GetStats().chunks_ == stats.chunks_);
+}
+
+// Objects are allocated, stamped and released (often by another thread)
+// as fast as possible: a stamp changing while owned means two threads got
+// the same object.
+static void Test02() {
+    typedef Pool<32, 256> StressPool;
+    StressPool pool;
+    std::mutex mutex;
+    std::vector<uint64_t*> shared;
+    std::atomic<int> errors(0);
+    auto worker = [&](int id) {
+        std::mt19937 generator(id);
+        std::vector<uint64_t*> owned;
+        for (int i = 0; i < 200000; i++) {
+            auto op = generator() % 4;
+            if (op < 2 || owned.empty()) {
+                auto p = (uint64_t*)pool.Allocate(32);
+                if (!p) {
+                    ++errors;
+                    continue;
+                }
+                p[0] = p[3] = (uint64_t)p ^ id;
+                owned.push_back(p);
+            } else {
+                auto p = owned.back();
+                owned.pop_back();
+                if (p[0] != ((uint64_t)p ^ id) || p[3] != p[0])
+                    ++errors;
+                if (op == 2) {
+                    pool.DeAllocate(p);
+                } else {
+                    p[0] = p[3] = (uint64_t)p;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    shared.push_back(p);
+                }
+            }
+            if (i % 64 == 0) {
+                std::vector<uint64_t*> others;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    others.swap(shared);
+                }
+                for (auto p : others) {
+                    if (p[0] != (uint64_t)p || p[3] != p[0])
+                        ++errors;
+                    pool.DeAllocate(p);
+                }
+            }
+        }
+        for (auto p : owned)
+            pool.DeAllocate(p);
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; i++)
+        threads.push_back(std::thread(worker, i + 1));
+    for (auto& thread : threads)
+        thread.join();
+    for (auto p : shared)
+        pool.DeAllocate(p);
+    pool.LogStatus();
+    auto stats = pool.GetStats();
+    CHECK_CONDITION(errors == 0);
+    // the caches of the finished threads have been returned
+    CHECK_CONDITION(stats.allocated_ <= StressPool::CacheSize);
+    CHECK_CONDITION(stats.peakAllocated_ <= stats.capacity_);
+    CHECK_CONDITION(stats.refills_ > 0 && stats.flushes_ > 0);
+}
+
+// Allocation throughput with the engine's pattern: small objects, shared
+// pointers and functions, released soon after.
+static double Benchmark(int nThreads, bool useMalloc) {
+    const int OPS = 1000000;
+    auto worker = [&]() {
+        std::mt19937 generator(1);
+        std::vector<void*> objs(64, nullptr);
+        for (int i = 0; i < OPS / nThreads; i++) {
+            auto& obj = objs[generator() % objs.size()];
+            auto size = 16 + generator() % 240;
+            if (useMalloc) {
+                std::free(obj);
+                obj = std::malloc(size);
+            } else {
+                ::operator delete(obj);
+                obj = ::operator new(size);
+            }
+        }
+        for (auto obj : objs)
+            if (useMalloc)
+                std::free(obj);
+            else
+                ::operator delete(obj);
+    };
+    auto start = BenchClock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; i++)
+        threads.push_back(std::thread(worker));
+    for (auto& thread : threads)
+        thread.join();
+    return OPS / ElapsedMs(start) / 1000.;
+}
+
+static void Test03() {
+    Benchmark(THREADS, false); // grows the pools
+    for (int nThreads : {1, 4, THREADS}) {
+        auto pools = Benchmark(nThreads, false);
+        auto heap = Benchmark(nThreads, true);
+        printf("%d threads: operator new %.1f Mops/s, malloc %.1f Mops/s\n",
+               nThreads, pools, heap);
+    }
+    // shared_ptr and std::function released from other threads
+    std::vector<std::shared_ptr<std::function<int()>>> objs;
+    for (int i = 0; i < 10000; i++)
+        objs.push_back(std::make_shared<std::function<int()>>(
+            [i]() { return i; }));
+    std::vector<std::thread> threads;
+    auto perThread = objs.size() / THREADS;
+    for (int i = 0; i < THREADS; i++)
+        threads.push_back(std::thread([&objs, i, perThread]() {
+            for (size_t j = i * perThread; j < (i + 1) * perThread; j++) {
+                CHECK_CONDITION((*objs[j])() == (int)j);
+                objs[j] = nullptr;
+            }
+        }));
+    for (auto& thread : threads)
+        thread.join();
+    LogMemoryManagerStats();
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+}
@@ -0,0 +1,235 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+using namespace NSG;
+
+#ifdef USE_PROFILER
+static const Profiler::ZoneStats* FindZone(
+    const std::vector<Profiler::ZoneStats>& zones, const char* name,
+    unsigned depth) {
+    for (auto& zone : zones)
+        if (!strcmp(zone.name_, name) && zone.depth_ == depth)
+            return &zone;
+    return nullptr;
+}
+
+static size_t CountOf(const std::string& text, const std::string& pattern) {
+    size_t n = 0;
+    for (auto pos = text.find(pattern); pos != std::string::npos;
+         pos = text.find(pattern, pos + 1))
+        ++n;
+    return n;
+}
+
+// Brackets and quotes are balanced
+static bool IsWellFormed(const std::string& json) {
+    std::string stack;
+    bool inString = false;
+    for (size_t i = 0; i < json.size(); i++) {
+        auto c = json[i];
+        if (inString) {
+            if (c == '\\')
+                ++i;
+            else if (c == '"')
+                inString = false;
+        } else if (c == '"')
+            inString = true;
+        else if (c == '{' || c == '[')
+            stack += c;
+        else if (c == '}' || c == ']') {
+            if (stack.empty() || stack.back() != (c == '}' ? '{' : '['))
+                return false;
+            stack.pop_back();
+        }
+    }
+    return !inString && stack.empty();
+}
+
+// Nested zones are added by parent in call order
+static void Test01() {
+    Profiler::Clear();
+    {
+        PROFILE_ZONE("outer");
+        for (int i = 0; i < 3; i++) {
+            PROFILE_ZONE("inner");
+        }
+        PROFILE_ZONE("other");
+        {
+            PROFILE_ZONE("inner");
+        }
+    }
+    {
+        PROFILE_ZONE("outer");
+    }
+    PROFILE_FRAME();
+    auto& zones = Profiler::GetLastFrame().zones_;
+    CHECK_CONDITION(zones.size() == 4);
+    CHECK_CONDITION(!strcmp(zones[0].name_, "outer"));
+    CHECK_CONDITION(zones[0].depth_ == 0 && zones[0].calls_ == 2);
+    CHECK_CONDITION(!strcmp(zones[1].name_, "inner"));
+    CHECK_CONDITION(zones[1].depth_ == 1 && zones[1].calls_ == 3);
+    CHECK_CONDITION(!strcmp(zones[2].name_, "other"));
+    CHECK_CONDITION(zones[2].depth_ == 1 && zones[2].calls_ == 1);
+    // inner inside other is a different node of the tree
+    CHECK_CONDITION(!strcmp(zones[3].name_, "inner"));
+    CHECK_CONDITION(zones[3].depth_ == 2 && zones[3].calls_ == 1);
+    CHECK_CONDITION(zones[0].ms_ >= zones[1].ms_ + zones[2].ms_);
+    CHECK_CONDITION(Profiler::GetLastFrame().workerZones_.empty());
+
+    // nothing left for the next frame
+    PROFILE_FRAME();
+    CHECK_CONDITION(Profiler::GetLastFrame().zones_.empty());
+}
+
+// Counters from several threads belong to the frame they are counted
+static void Test02() {
+    Profiler::Clear();
+    auto jobs = Task::JobSystem::GetPtr();
+    const size_t COUNT = 10000;
+    jobs->ParallelFor(COUNT, 16, [](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i++) {
+            PROFILE_COUNT(DRAW_CALLS, 1);
+            PROFILE_COUNT(UNIFORM_UPLOADS, 2);
+        }
+    });
+    PROFILE_COUNT(BATCHES, 7);
+    CHECK_CONDITION(Profiler::GetCount(ProfileCounter::DRAW_CALLS) == COUNT);
+    PROFILE_FRAME();
+    auto& counters = Profiler::GetLastFrame().counters_;
+    CHECK_CONDITION(counters[(int)ProfileCounter::DRAW_CALLS] == COUNT);
+    CHECK_CONDITION(counters[(int)ProfileCounter::UNIFORM_UPLOADS] ==
+                    2 * COUNT);
+    CHECK_CONDITION(counters[(int)ProfileCounter::BATCHES] == 7);
+    CHECK_CONDITION(counters[(int)ProfileCounter::VAO_BINDS] == 0);
+    CHECK_CONDITION(Profiler::GetCount(ProfileCounter::DRAW_CALLS) == 0);
+    PROFILE_FRAME();
+    CHECK_CONDITION(
+        Profiler::GetLastFrame().counters_[(int)ProfileCounter::BATCHES] == 0);
+}
+
+// Zones of the workers are recorded in their own buffers
+static void Test03() {
+    Profiler::Clear();
+    auto jobs = Task::JobSystem::GetPtr();
+    const size_t COUNT = 1000;
+    {
+        PROFILE_ZONE("parallel");
+        jobs->ParallelFor(COUNT, 1, [](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i++) {
+                PROFILE_ZONE("job");
+                volatile int work = 0;
+                for (int j = 0; j < 1000; j++)
+                    work = work + j;
+            }
+        });
+    }
+    PROFILE_FRAME();
+    auto& frame = Profiler::GetLastFrame();
+    CHECK_CONDITION(FindZone(frame.zones_, "parallel", 0));
+    // the main thread runs some of them too
+    unsigned calls = 0;
+    auto mainJobs = FindZone(frame.zones_, "job", 1);
+    if (mainJobs)
+        calls += mainJobs->calls_;
+    auto workerJobs = FindZone(frame.workerZones_, "job", 0);
+    if (workerJobs)
+        calls += workerJobs->calls_;
+    CHECK_CONDITION(calls == COUNT);
+    printf("%u jobs in the workers\n", workerJobs ? workerJobs->calls_ : 0);
+}
+
+// The trace has every zone, the thread names and the counters per frame
+static void Test04() {
+    Profiler::Clear();
+    const int FRAMES = 3;
+    auto jobs = Task::JobSystem::GetPtr();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        {
+            PROFILE_ZONE("Frame \"quoted\"");
+            jobs->ParallelFor(64, 1, [](size_t begin, size_t end) {
+                for (auto i = begin; i < end; i++) {
+                    PROFILE_ZONE("job");
+                }
+            });
+        }
+        PROFILE_COUNT(VISIBLE_NODES, 10);
+        PROFILE_FRAME();
+    }
+    auto json = Profiler::GetChromeTrace();
+    CHECK_CONDITION(IsWellFormed(json));
+    CHECK_CONDITION(json.find("{\"traceEvents\":[") == 0);
+    CHECK_CONDITION(CountOf(json, "\"ph\":\"X\"") == FRAMES * (64 + 1));
+    CHECK_CONDITION(CountOf(json, "\"name\":\"job\"") == FRAMES * 64);
+    CHECK_CONDITION(CountOf(json, "\"name\":\"Frame \\\"quoted\\\"\"") ==
+                    FRAMES);
+    CHECK_CONDITION(CountOf(json, "\"ph\":\"C\"") == FRAMES);
+    CHECK_CONDITION(CountOf(json, "\"visible nodes\":10") == FRAMES);
+    CHECK_CONDITION(CountOf(json, "\"name\":\"main\"") == 1);
+    CHECK_CONDITION(CountOf(json, "\"ph\":\"M\"") ==
+                    CountOf(json, "\"name\":\"thread_name\""));
+
+    Path path("profilertest.json");
+    CHECK_CONDITION(Profiler::SaveChromeTrace(path.GetFullAbsoluteFilePath()));
+    std::ifstream file(path.GetFullAbsoluteFilePath().c_str());
+    std::stringstream saved;
+    saved << file.rdbuf();
+    CHECK_CONDITION(saved.str() == json);
+}
+
+// The oldest zones are lost when a ring buffer is full
+static void Test05() {
+    Profiler::Clear();
+    const size_t EXTRA = 100;
+    for (size_t i = 0; i < Profiler::EVENTS_PER_THREAD + EXTRA; i++) {
+        PROFILE_ZONE("zone");
+    }
+    PROFILE_FRAME();
+    auto& zones = Profiler::GetLastFrame().zones_;
+    CHECK_CONDITION(zones.size() == 1);
+    CHECK_CONDITION(zones[0].calls_ == Profiler::EVENTS_PER_THREAD);
+    auto json = Profiler::GetChromeTrace();
+    CHECK_CONDITION(CountOf(json, "\"ph\":\"X\"") ==
+                    Profiler::EVENTS_PER_THREAD);
+}
+#endif
+
+void Tests() {
+#ifdef USE_PROFILER
+    PROFILE_THREAD("main");
+    auto jobs = Task::JobSystem::Create();
+    printf("%u workers\n", jobs->GetWorkersCount());
+    Test01();
+    Test02();
+    Test03();
+    Test04();
+    Test05();
+#else
+    printf("Profiler disabled, build with USE_PROFILER\n");
+#endif
+}
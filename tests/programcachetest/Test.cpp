@@ -0,0 +1,183 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+using namespace NSG;
+
+static const int NODES = 5000;
+static const int FRAMES = 10;
+
+// Emulates the per draw program setup of a scene with many non instanced
+// nodes sharing the same material: without any GL context.
+static void Test01() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto camera = scene->CreateChild<Camera>("camera");
+    auto mesh = Mesh::Create<SphereMesh>();
+    auto material = Material::Create();
+    Pass pass;
+    pass.SetType(PassType::DEFAULT);
+
+    std::vector<PSceneNode> nodes;
+    for (int i = 0; i < NODES; i++) {
+        auto node = std::make_shared<SceneNode>(GetUniqueName("node"));
+        node->SetMaterial(material);
+        node->SetMesh(mesh);
+        nodes.push_back(node);
+    }
+
+    Program::Clear();
+    Program::ResetCacheStats();
+    auto start = BenchClock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        auto before = Program::GetCacheStats();
+        for (auto& node : nodes) {
+            auto program = Program::GetOrCreateVariation(
+                &pass, scene.get(), camera.get(), mesh.get(), material.get(),
+                nullptr, node.get());
+            CHECK_CONDITION(program);
+        }
+        auto& stats = Program::GetCacheStats();
+        printf("Frame %d: keys=%d lookups=%d defines=%d\n", frame,
+               (int)(stats.keys_ - before.keys_),
+               (int)(stats.lookups_ - before.lookups_),
+               (int)(stats.defines_ - before.defines_));
+        if (frame > 0)
+            CHECK_CONDITION(stats.defines_ == before.defines_);
+    }
+    auto keyTime = ElapsedMs(start);
+    auto& stats = Program::GetCacheStats();
+    CHECK_CONDITION(stats.keys_ == NODES * FRAMES);
+    CHECK_CONDITION(stats.defines_ == 1);
+    CHECK_CONDITION(stats.lookups_ == stats.keys_ - stats.defines_);
+
+    start = BenchClock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        for (auto& node : nodes) {
+            auto defines = Program::GetShaderVariation(
+                &pass, scene.get(), camera.get(), mesh.get(), material.get(),
+                nullptr, node.get());
+            CHECK_CONDITION(Program::GetOrCreate(defines));
+        }
+    }
+    auto stringTime = ElapsedMs(start);
+    printf("%d draws x %d frames: keys %.2f ms, define strings %.2f ms\n",
+           NODES, FRAMES, keyTime, stringTime);
+    Program::Clear();
+}
+
+// The variation key must follow every change that modifies the defines.
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto camera = scene->CreateChild<Camera>("camera");
+    auto light = scene->CreateChild<Light>("light");
+    auto mesh = Mesh::Create<SphereMesh>();
+    auto material = Material::Create();
+    auto node = scene->CreateChild<SceneNode>("node");
+    node->SetMaterial(material);
+    node->SetMesh(mesh);
+    Pass pass;
+    pass.SetType(PassType::LIT);
+
+    auto getProgram = [&]() {
+        return Program::GetOrCreateVariation(&pass, scene.get(), camera.get(),
+                                             mesh.get(), material.get(),
+                                             light.get(), node.get());
+    };
+
+    auto getDefines = [&]() {
+        return Program::GetShaderVariation(&pass, scene.get(), camera.get(),
+                                           mesh.get(), material.get(),
+                                           light.get(), node.get());
+    };
+
+    auto checkProgram = [&]() {
+        auto program = getProgram();
+        CHECK_CONDITION(program == Program::GetOrCreate(getDefines()));
+        CHECK_CONDITION(program == getProgram());
+        return program;
+    };
+
+    Program::Clear();
+    auto p0 = checkProgram();
+    material->SetRenderPass(RenderPass::UNLIT);
+    auto p1 = checkProgram();
+    CHECK_CONDITION(p0 != p1);
+    material->SetRenderPass(RenderPass::LIT);
+    CHECK_CONDITION(p0 == checkProgram());
+    scene->EnableFog(true);
+    CHECK_CONDITION(p0 != checkProgram());
+    camera->EnableColorSplits(true);
+    checkProgram();
+    light->SetType(LightType::SPOT);
+    checkProgram();
+    material->SetBillboardType(BillboardType::SPHERICAL);
+    checkProgram();
+    material->FlipYTextureCoords(true);
+    checkProgram();
+    pass.SetType(PassType::SHADOW);
+    checkProgram();
+    pass.SetType(PassType::DEFAULT);
+    checkProgram();
+    Program::Clear();
+}
+
+// Restamped materials do not leave their old variations in the cache
+static void Test03() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto camera = scene->CreateChild<Camera>("camera");
+    auto mesh = Mesh::Create<SphereMesh>();
+    auto material = Material::Create();
+    auto node = scene->CreateChild<SceneNode>("node");
+    node->SetMaterial(material);
+    node->SetMesh(mesh);
+    Pass pass;
+    pass.SetType(PassType::DEFAULT);
+
+    Program::Clear();
+    for (int i = 0; i < 100; i++) {
+        material->FlipYTextureCoords(i % 2 == 0);
+        CHECK_CONDITION(Program::GetOrCreateVariation(
+            &pass, scene.get(), camera.get(), mesh.get(), material.get(),
+            nullptr, node.get()));
+        CHECK_CONDITION(Program::GetVariationsCount() == 1);
+    }
+
+    // a new material for each draw is bounded by the cache size
+    for (int i = 0; i < 2000; i++) {
+        auto other = Material::Create();
+        Program::GetOrCreateVariation(&pass, scene.get(), camera.get(),
+                                      mesh.get(), other.get(), nullptr,
+                                      node.get());
+    }
+    CHECK_CONDITION(Program::GetVariationsCount() <= 1024);
+    Program::Clear();
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+}
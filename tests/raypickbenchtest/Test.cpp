@@ -0,0 +1,180 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include <random>
+using namespace NSG;
+
+static const int GRID = 500; // ~500k triangles
+static const float NO_HIT = std::numeric_limits<float>::max();
+
+// Bumpy height field facing +z
+static PModelMesh CreateTerrain(int grid) {
+    VertexsData vertexes;
+    Indexes indexes;
+    for (int y = 0; y < grid; y++)
+        for (int x = 0; x < grid; x++) {
+            VertexData vertex;
+            auto z = 2.f * std::sin(x * 0.1f) * std::cos(y * 0.13f);
+            vertex.position_ = Vertex3(x - grid / 2.f, y - grid / 2.f, z);
+            vertexes.push_back(vertex);
+        }
+    for (int y = 0; y + 1 < grid; y++)
+        for (int x = 0; x + 1 < grid; x++) {
+            IndexType i0 = y * grid + x;
+            IndexType i1 = i0 + 1;
+            IndexType i2 = i0 + grid;
+            IndexType i3 = i2 + 1;
+            indexes.insert(indexes.end(), {i0, i1, i3, i0, i3, i2});
+        }
+    auto mesh = Mesh::Create<ModelMesh>("terrain" + ToString(grid));
+    mesh->SetMeshData(vertexes, indexes);
+    return mesh;
+}
+
+static float BruteForceHit(Mesh& mesh, const Ray& ray) {
+    auto nearest = NO_HIT;
+    for (size_t i = 0; i < mesh.GetNumberOfTriangles(); i++) {
+        auto t = ray.HitDistance(mesh.GetTriangleVertex(i, 0).position_,
+                                 mesh.GetTriangleVertex(i, 1).position_,
+                                 mesh.GetTriangleVertex(i, 2).position_);
+        if (t >= 0)
+            nearest = std::min(nearest, t);
+    }
+    return nearest;
+}
+
+static std::vector<Ray> RandomRays(size_t n, int grid) {
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> position(-grid / 2.f, grid / 2.f);
+    std::uniform_real_distribution<float> slope(-0.5f, 0.5f);
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < n; i++) {
+        Vertex3 origin(position(generator), position(generator), 10);
+        // a few rays go up and miss
+        auto dz = i % 10 ? -1.f : 1.f;
+        rays.push_back(
+            Ray(origin, Vector3(slope(generator), slope(generator), dz)));
+    }
+    return rays;
+}
+
+// The BVH must find the same hits as testing every triangle.
+static void Test01() {
+    auto mesh = CreateTerrain(GRID);
+    CHECK_CONDITION(mesh->IsReady());
+    auto start = BenchClock::now();
+    auto bvh = mesh->GetBVH();
+    CHECK_CONDITION(bvh);
+    printf("BVH: %d triangles, %d nodes built in %.1f ms\n",
+           (int)bvh->GetTrianglesCount(), (int)bvh->GetNodesCount(),
+           ElapsedMs(start));
+    CHECK_CONDITION(bvh->GetTrianglesCount() == mesh->GetNumberOfTriangles());
+    CHECK_CONDITION(mesh->GetBVH() == bvh); // cached
+
+    const size_t BRUTE_RAYS = 50;
+    const size_t BVH_RAYS = 100000;
+    auto rays = RandomRays(BVH_RAYS, GRID);
+    std::vector<float> expected;
+    start = BenchClock::now();
+    for (size_t i = 0; i < BRUTE_RAYS; i++)
+        expected.push_back(BruteForceHit(*mesh, rays[i]));
+    auto bruteMs = ElapsedMs(start);
+
+    size_t hits = 0;
+    start = BenchClock::now();
+    for (auto& ray : rays)
+        if (bvh->ClosestHit(ray) < NO_HIT)
+            hits++;
+    auto bvhMs = ElapsedMs(start);
+    printf("Brute force: %.1f picks/s\n", 1000. * BRUTE_RAYS / bruteMs);
+    printf("BVH closest hit: %.1f picks/s (%d hits)\n",
+           1000. * BVH_RAYS / bvhMs, (int)hits);
+
+    start = BenchClock::now();
+    size_t anyHits = 0;
+    for (auto& ray : rays)
+        if (bvh->AnyHit(ray, NO_HIT))
+            anyHits++;
+    printf("BVH any hit: %.1f picks/s\n",
+           1000. * BVH_RAYS / ElapsedMs(start));
+    CHECK_CONDITION(hits == anyHits);
+    CHECK_CONDITION(hits > BVH_RAYS / 2 && hits < BVH_RAYS);
+
+    for (size_t i = 0; i < BRUTE_RAYS; i++) {
+        size_t triangle = 0;
+        auto distance = bvh->ClosestHit(rays[i], &triangle);
+        if (expected[i] == NO_HIT) {
+            CHECK_CONDITION(distance == NO_HIT);
+            continue;
+        }
+        CHECK_CONDITION(Distance(distance, expected[i]) < 0.001f);
+        auto& v0 = mesh->GetTriangleVertex(triangle, 0).position_;
+        auto& v1 = mesh->GetTriangleVertex(triangle, 1).position_;
+        auto& v2 = mesh->GetTriangleVertex(triangle, 2).position_;
+        CHECK_CONDITION(rays[i].HitDistance(v0, v1, v2) == distance);
+        CHECK_CONDITION(bvh->AnyHit(rays[i], distance + 0.01f));
+        CHECK_CONDITION(!bvh->AnyHit(rays[i], distance - 0.01f));
+    }
+}
+
+// Scene queries use the mesh BVH, which is rebuilt with the mesh data.
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto mesh = CreateTerrain(50);
+    auto node = scene->CreateChild<SceneNode>();
+    node->SetMesh(mesh);
+    node->SetPosition(Vertex3(0, 0, -10));
+    node->SetScale(Vertex3(2));
+    CHECK_CONDITION(mesh->IsReady());
+
+    Ray down(Vertex3(0, 0, 20), Vector3(0, 0, -1));
+    RayNodeResult closest;
+    CHECK_CONDITION(scene->GetClosestRayNodeIntersection(down, closest));
+    CHECK_CONDITION(closest.node_ == node.get());
+    CHECK_CONDITION(Distance(closest.distance_, 30.f) < 0.01f);
+    CHECK_CONDITION(scene->IsRayBlocked(down));
+    CHECK_CONDITION(!scene->IsRayBlocked(Ray(down.GetOrigin(),
+                                             down.GetDirection(), 25)));
+    Ray up(Vertex3(0, 0, 20), Vector3(0, 0, 1));
+    CHECK_CONDITION(!scene->GetClosestRayNodeIntersection(up, closest));
+    CHECK_CONDITION(!scene->IsRayBlocked(up));
+
+    auto sphere(Mesh::Create<SphereMesh>());
+    sphere->Set(1, 8);
+    CHECK_CONDITION(sphere->IsReady());
+    auto triangles = sphere->GetBVH()->GetTrianglesCount();
+    CHECK_CONDITION(triangles == sphere->GetNumberOfTriangles());
+    sphere->Set(1, 16);
+    CHECK_CONDITION(sphere->IsReady());
+    CHECK_CONDITION(sphere->GetBVH()->GetTrianglesCount() > triangles);
+}
+
+void Tests() {
+    auto window = Window::Create("window", 0, 0, 10, 10);
+    Test01();
+    Test02();
+}
@@ -0,0 +1,178 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "NSG.h"
+#include <algorithm>
+#include <map>
+#include <random>
+using namespace NSG;
+
+static std::vector<SceneNode*> CreateNodes(PScene scene, int materials,
+                                           int meshes, int nodesPerPair) {
+    std::vector<PMesh> meshList{Mesh::Create<BoxMesh>(),
+                                Mesh::Create<SphereMesh>(),
+                                Mesh::Create<PlaneMesh>()};
+    std::vector<SceneNode*> nodes;
+    for (int i = 0; i < materials; i++) {
+        auto material = Material::Create();
+        for (int j = 0; j < meshes; j++)
+            for (int k = 0; k < nodesPerPair; k++) {
+                auto node = scene->CreateChild<SceneNode>();
+                node->SetMaterial(material);
+                node->SetMesh(meshList[j % meshList.size()]);
+                nodes.push_back(node.get());
+            }
+    }
+    std::shuffle(nodes.begin(), nodes.end(), std::mt19937(1));
+    return nodes;
+}
+
+// Each material and mesh pair ends up in a single batch sorted by depth.
+static void Test01() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto nodes = CreateNodes(scene, 3, 2, 100);
+    std::map<SceneNode*, float> depths;
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> distribution(0, 1);
+    RenderQueue queue;
+    for (auto node : nodes) {
+        depths[node] = distribution(generator);
+        queue.Add(node, depths[node]);
+    }
+    queue.Sort();
+    auto& batches = queue.GetBatches();
+    CHECK_CONDITION(batches.size() == 6);
+    size_t total = 0;
+    for (auto& batch : batches) {
+        CHECK_CONDITION(batch.GetNodesCount() == 100);
+        float lastDepth = -1;
+        for (auto node : batch) {
+            CHECK_CONDITION(node->GetMaterial().get() == batch.GetMaterial());
+            CHECK_CONDITION(node->GetMesh().get() == batch.GetMesh());
+            CHECK_CONDITION(depths[node] >= lastDepth - 1.f / 65535);
+            lastDepth = depths[node];
+        }
+        total += batch.GetNodesCount();
+    }
+    CHECK_CONDITION(total == nodes.size());
+
+    // a different pass goes after all the previous ones
+    queue.Clear();
+    CHECK_CONDITION(queue.GetBatches().empty());
+    queue.Add(nodes[0], 0, 1);
+    queue.Add(nodes[1], 1, 0);
+    queue.Sort();
+    CHECK_CONDITION(*queue.GetBatches().back().begin() == nodes[0]);
+}
+
+// The keys are kept while material and mesh do not change.
+static void Test02() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto node = scene->CreateChild<SceneNode>();
+    auto material = Material::Create();
+    node->SetMaterial(material);
+    node->SetMesh(Mesh::Create<BoxMesh>());
+    auto key = node->GetRenderKey();
+    CHECK_CONDITION(key == node->GetRenderKey());
+    material->SetRenderPass(RenderPass::UNLIT);
+    auto newKey = node->GetRenderKey();
+    CHECK_CONDITION(newKey != key);
+    CHECK_CONDITION(newKey == node->GetRenderKey());
+    node->SetMaterial(Material::Create());
+    CHECK_CONDITION(newKey != node->GetRenderKey());
+}
+
+static void Test03() {
+    const int FRAMES = 100;
+    auto scene = std::make_shared<Scene>("scene");
+    auto nodes = CreateNodes(scene, 20, 3, 200);
+    RenderQueue queue;
+    auto start = BenchClock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        queue.Clear();
+        for (size_t i = 0; i < nodes.size(); i++)
+            queue.Add(nodes[i], float((i + frame) % nodes.size()) /
+                                    nodes.size());
+        queue.Sort();
+    }
+    printf("RenderQueue %d nodes: %.3f ms/frame (%d batches)\n",
+           (int)nodes.size(), ElapsedMs(start) / FRAMES,
+           (int)queue.GetBatches().size());
+    CHECK_CONDITION(queue.GetBatches().size() == 60);
+}
+
+// The variation part of the key is the program drawing the node
+static void Test04() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto nodes = CreateNodes(scene, 2, 1, 2);
+    const int shift = RenderQueue::DEPTH_BITS + RenderQueue::MESH_BITS +
+                      RenderQueue::MATERIAL_BITS;
+    Pass pass;
+    for (auto node : nodes) {
+        auto program = Program::GetOrCreateVariation(
+            &pass, nullptr, nullptr, node->GetMesh().get(),
+            node->GetMaterial().get(), nullptr, node);
+        const uint64_t mask = (1 << RenderQueue::VARIATION_BITS) - 1;
+        auto variation = (node->GetRenderKey() >> shift) & mask;
+        CHECK_CONDITION(variation == (program->GetSortId() & mask));
+    }
+}
+
+// A depth first queue is back to front across materials and meshes
+static void Test05() {
+    auto scene = std::make_shared<Scene>("scene");
+    auto nodes = CreateNodes(scene, 3, 3, 20);
+    std::map<SceneNode*, float> depths;
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> distribution(0, 1);
+    RenderQueue queue(true);
+    for (auto node : nodes) {
+        depths[node] = distribution(generator);
+        queue.Add(node, 1 - depths[node]);
+    }
+    queue.Sort();
+    float lastDepth = 2;
+    size_t total = 0;
+    for (auto& batch : queue.GetBatches()) {
+        for (auto node : batch) {
+            CHECK_CONDITION(node->GetMaterial().get() == batch.GetMaterial());
+            CHECK_CONDITION(depths[node] <= lastDepth + 1.f / 65535);
+            lastDepth = depths[node];
+        }
+        total += batch.GetNodesCount();
+    }
+    CHECK_CONDITION(total == nodes.size());
+    // the materials are interleaved by depth
+    CHECK_CONDITION(queue.GetBatches().size() > 9);
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+    Test04();
+    Test05();
+}
@@ -119,7 +119,55 @@ static void Test02() {
     engine->Run();
 }
 
+// A single multi-frustum traversal finds the same nodes and shadow bounds
+// as one traversal per frustum.
+static void Test03() {
+    auto window = Window::Create("0", 0, 0, 10, 10, (int)WindowFlag::HIDDEN);
+    auto scene = std::make_shared<Scene>();
+    auto mesh(Mesh::Create<BoxMesh>());
+    auto receiver = Material::Create();
+    receiver->CastShadow(false);
+    auto caster = Material::Create();
+    for (int x = -20; x <= 20; x += 2)
+        for (int z = -20; z <= 20; z += 2) {
+            auto node = scene->CreateChild<SceneNode>();
+            node->SetMesh(mesh);
+            node->SetMaterial((x + z) % 4 ? receiver : caster);
+            node->SetPosition(Vertex3((float)x, 0, (float)z));
+        }
+
+    std::vector<PCamera> cameras;
+    const Frustum* frustums[4];
+    for (int i = 0; i < 4; i++) {
+        auto camera = scene->CreateChild<Camera>();
+        camera->SetPosition(Vertex3(0, 10, 0));
+        camera->SetGlobalLookAtPosition(Vector3(i * 8.f - 12.f, 0, -10));
+        camera->SetFarClip(40);
+        cameras.push_back(camera);
+        frustums[i] = camera->GetFrustumPointer();
+    }
+
+    std::vector<FrustumQueryResult> results;
+    scene->GetVisibleNodes(frustums, 4, results);
+    CHECK_CONDITION(results.size() == 4);
+    for (int i = 0; i < 4; i++) {
+        std::vector<SceneNode*> visibles;
+        scene->GetVisibleNodes(frustums[i], visibles);
+        auto nodes = results[i].nodes_;
+        std::sort(visibles.begin(), visibles.end());
+        std::sort(nodes.begin(), nodes.end());
+        CHECK_CONDITION(!nodes.empty() && nodes == visibles);
+        CHECK_CONDITION(results[i].receiversBox_ ==
+                        Camera::GetViewBox(frustums[i], scene.get(), true,
+                                           false));
+        CHECK_CONDITION(results[i].castersBox_ ==
+                        Camera::GetViewBox(frustums[i], scene.get(), false,
+                                           true));
+    }
+}
+
 void Test() {
     Test01();
+    Test03();
     // Test02();
 }
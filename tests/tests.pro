@@ -1,24 +1,47 @@
 TEMPLATE = subdirs
-SUBDIRS = batchingtest\
+SUBDIRS = animationcompresstest\
+animationcrowdtest\
+animationposetest\
+batchingtest\
 bbtest\
+bonepalettetest\
 cameratest\
 charactertest\
+cullingbenchtest\
+decompressbenchtest\
 filesystemtest\
+framearenatest\
 fsmtest\
 grouptest\
+jobsystemtest\
+lightcullingtest\
+loaderpipelinetest\
 mathtest\
 memtest\
+meshloadbenchtest\
+meshoptimizetest\
+meshsplittest\
 nettest\
 nodetest\
+occlusioncullingtest\
+parallelcullingbenchtest\
+particlebenchtest\
 pathtest\
 physcaletest\
 pointonspheretest\
+pooltest\
+profilertest\
+programcachetest\
 queuedtasktest\
+raypickbenchtest\
+renderqueuetest\
 scenetest\
 shadowtest\
+texturecompresstest\
 timedtasktest\
 transformstest\
 uvmaptest\
+vertexformattest\
 windowtest
 
 
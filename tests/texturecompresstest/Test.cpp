@@ -0,0 +1,187 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "../BenchClock.h"
+#include "Compress.h"
+#include "Decompress.h"
+#include "NSG.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+using namespace NSG;
+
+// Smooth gradients with some noise and an alpha ramp (if not opaque)
+static std::vector<unsigned char> CreateImage(int width, int height,
+                                              bool opaque) {
+    std::mt19937 generator(1234);
+    std::uniform_int_distribution<int> noise(-6, 6);
+    std::vector<unsigned char> rgba(width * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            auto pixel = &rgba[4 * (y * width + x)];
+            int values[] = {255 * x / width, 255 * y / height,
+                            (int)(127 + 120 * std::sin(0.05 * (x + y))),
+                            opaque ? 255 : 255 * (x + y) / (width + height)};
+            for (int c = 0; c < 4; c++)
+                pixel[c] = (unsigned char)std::min(
+                    std::max(values[c] + noise(generator), 0), 255);
+        }
+    }
+    return rgba;
+}
+
+static std::vector<unsigned char> Decode(const std::vector<unsigned char>& blocks,
+                                         int width, int height,
+                                         TextureFormat format) {
+    std::vector<unsigned char> rgba(width * height * 4);
+    if (format == TextureFormat::ETC1)
+        DecompressImageETC(&rgba[0], &blocks[0], width, height);
+    else
+        DecompressImageDXT(&rgba[0], &blocks[0], width, height, 1, format);
+    return rgba;
+}
+
+static double PSNR(const std::vector<unsigned char>& a,
+                   const std::vector<unsigned char>& b, int channels) {
+    double error = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        for (int c = 0; c < channels; c++) {
+            double d = (double)a[i + c] - b[i + c];
+            error += d * d;
+            ++count;
+        }
+    }
+    error /= count;
+    return error == 0 ? 100 : 10 * std::log10(255 * 255 / error);
+}
+
+static std::vector<unsigned char> Compress(const std::vector<unsigned char>& rgba,
+                                           int width, int height,
+                                           TextureFormat format,
+                                           CompressQuality quality) {
+    std::vector<unsigned char> blocks(
+        GetCompressedImageSize(width, height, format));
+    CompressImage(&blocks[0], &rgba[0], width, height, format, quality);
+    return blocks;
+}
+
+// The decoded images are close to the originals (odd sizes included) and
+// the quality presets do not lose quality
+static void Test01() {
+    const int WIDTH = 257;
+    const int HEIGHT = 131;
+    auto rgba = CreateImage(WIDTH, HEIGHT, false);
+    auto opaque = CreateImage(WIDTH, HEIGHT, true);
+    const TextureFormat formats[] = {TextureFormat::DXT1, TextureFormat::DXT3,
+                                     TextureFormat::DXT5, TextureFormat::ETC1};
+    const char* names[] = {"DXT1", "DXT3", "DXT5", "ETC1"};
+    const char* qualities[] = {"fast", "normal", "high"};
+    for (int f = 0; f < 4; f++) {
+        auto format = formats[f];
+        // DXT1 decodes the transparent pixels as black
+        auto& image = format == TextureFormat::DXT1 ? opaque : rgba;
+        double previous = 0;
+        for (int q = 0; q < 3; q++) {
+            auto start = BenchClock::now();
+            auto blocks =
+                Compress(image, WIDTH, HEIGHT, format, (CompressQuality)q);
+            auto ms = ElapsedMs(start);
+            auto decoded = Decode(blocks, WIDTH, HEIGHT, format);
+            auto psnr = PSNR(image, decoded, 3);
+            printf("%s %-6s: %6.2f dB, %7.2f MP/s\n", names[f], qualities[q],
+                   psnr, WIDTH * HEIGHT / (ms * 1000));
+            CHECK_CONDITION(psnr > 30);
+            CHECK_CONDITION(psnr >= previous - 0.05);
+            previous = psnr;
+            if (format == TextureFormat::DXT3 || format == TextureFormat::DXT5)
+                CHECK_CONDITION(PSNR(rgba, decoded, 4) > 30);
+        }
+    }
+}
+
+// Exact results: colours of 565, DXT1 transparency and DXT5 alpha extremes
+static void Test02() {
+    const int SIZE = 8;
+    std::vector<unsigned char> rgba(SIZE * SIZE * 4);
+    for (int i = 0; i < SIZE * SIZE; i++) {
+        bool hole = (i % SIZE) < 2 && (i / SIZE) < 2;
+        bool black = i % 3 == 0;
+        rgba[4 * i + 0] = black ? 0 : 255;
+        rgba[4 * i + 1] = black ? 0 : 130; // 6 bits: 32 * 255 / 63 = 129.5
+        rgba[4 * i + 2] = black ? 0 : 8;   // 5 bits: 8 * 31 / 255 = 0.97
+        rgba[4 * i + 3] = hole ? 0 : 255;
+    }
+    auto expected = rgba;
+    for (int i = 0; i < SIZE * SIZE; i++) {
+        if (expected[4 * i] == 255) {
+            expected[4 * i + 1] = 130; // (32 << 2) | (32 >> 4)
+            expected[4 * i + 2] = 8;   // (1 << 3) | (1 >> 2)
+        }
+    }
+    for (int q = 0; q < 3; q++) {
+        auto dxt5 = Decode(
+            Compress(rgba, SIZE, SIZE, TextureFormat::DXT5, (CompressQuality)q),
+            SIZE, SIZE, TextureFormat::DXT5);
+        CHECK_CONDITION(dxt5 == expected);
+
+        auto dxt1 = Decode(
+            Compress(rgba, SIZE, SIZE, TextureFormat::DXT1, (CompressQuality)q),
+            SIZE, SIZE, TextureFormat::DXT1);
+        for (int i = 0; i < SIZE * SIZE; i++) {
+            if (rgba[4 * i + 3] == 0) {
+                CHECK_CONDITION(dxt1[4 * i + 3] == 0);
+            } else {
+                CHECK_CONDITION(
+                    memcmp(&dxt1[4 * i], &expected[4 * i], 4) == 0);
+            }
+        }
+    }
+}
+
+// Same blocks with and without the job system
+static void Test03() {
+    const int WIDTH = 130;
+    const int HEIGHT = 70;
+    auto rgba = CreateImage(WIDTH, HEIGHT, false);
+    std::vector<std::vector<unsigned char>> results;
+    for (auto format : {TextureFormat::DXT1, TextureFormat::DXT5,
+                        TextureFormat::ETC1})
+        results.push_back(
+            Compress(rgba, WIDTH, HEIGHT, format, CompressQuality::NORMAL));
+    auto jobs = Task::JobSystem::Create();
+    size_t i = 0;
+    for (auto format : {TextureFormat::DXT1, TextureFormat::DXT5,
+                        TextureFormat::ETC1})
+        CHECK_CONDITION(results[i++] == Compress(rgba, WIDTH, HEIGHT, format,
+                                                 CompressQuality::NORMAL));
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+}
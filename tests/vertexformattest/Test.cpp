@@ -0,0 +1,109 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "NSG.h"
+#include <cstring>
+using namespace NSG;
+
+template <typename T> static T Read(const std::vector<char>& data, size_t pos) {
+    T value;
+    memcpy(&value, &data[pos], sizeof(T));
+    return value;
+}
+
+// The default format has to be the VertexData layout.
+static void Test01() {
+    VertexFormat format;
+    CHECK_CONDITION(format.IsFloat());
+    CHECK_CONDITION(format.GetKey() == 0);
+    CHECK_CONDITION(format.GetStride() == sizeof(VertexData));
+    CHECK_CONDITION(format.GetOffset(AttributesLoc::NORMAL) ==
+                    offsetof(VertexData, normal_));
+    CHECK_CONDITION(format.GetOffset(AttributesLoc::BONES_WEIGHT) ==
+                    offsetof(VertexData, bonesWeight_));
+
+    VertexsData vertexes(2);
+    vertexes[1].position_ = Vertex3(1, 2, 3);
+    std::vector<char> data;
+    format.Pack(vertexes, data);
+    CHECK_CONDITION(data.size() == 2 * sizeof(VertexData));
+    CHECK_CONDITION(memcmp(&data[0], &vertexes[0], data.size()) == 0);
+}
+
+static void Test02() {
+    auto format = VertexFormat::Compact();
+    auto skinned = VertexFormat::Compact(true);
+    CHECK_CONDITION(format.GetStride() == 32);
+    CHECK_CONDITION(skinned.GetStride() == 40);
+    CHECK_CONDITION(!format.Has(AttributesLoc::BONES_ID));
+    CHECK_CONDITION(skinned.Has(AttributesLoc::BONES_ID));
+    CHECK_CONDITION(VertexFormat::FromKey(skinned.GetKey()) == skinned);
+    printf("Bytes per vertex: float=%d compact=%d skinned=%d\n",
+           (int)sizeof(VertexData), format.GetStride(), skinned.GetStride());
+}
+
+static void Test03() {
+    auto format = VertexFormat::Compact(true);
+    VertexData vertex;
+    vertex.position_ = Vertex3(1, 2, 3);
+    vertex.normal_ = Vertex3(0, -1, 1);
+    vertex.uv_[0] = Vertex2(0.5f, 1);
+    vertex.color_ = Color(1, 0, 0, 1);
+    vertex.bonesID_ = Vector4(3, 0, 7, 255);
+    vertex.bonesWeight_ = Vector4(0.5f, 0.5f, 0, 0);
+    std::vector<char> data;
+    format.Pack(VertexsData{vertex}, data);
+    CHECK_CONDITION(data.size() == format.GetStride());
+
+    auto pos = format.GetOffset(AttributesLoc::POSITION);
+    CHECK_CONDITION(Read<float>(data, pos + 8) == 3);
+
+    auto normal = Read<uint32_t>(data, format.GetOffset(AttributesLoc::NORMAL));
+    CHECK_CONDITION((normal & 0x3ff) == 0);
+    CHECK_CONDITION(((normal >> 10) & 0x3ff) == (uint32_t)(-511 & 0x3ff));
+    CHECK_CONDITION(((normal >> 20) & 0x3ff) == 511);
+
+    auto uv = format.GetOffset(AttributesLoc::TEXTURECOORD0);
+    CHECK_CONDITION(Read<uint16_t>(data, uv) == 0x3800);
+    CHECK_CONDITION(Read<uint16_t>(data, uv + 2) == 0x3c00);
+
+    auto color = format.GetOffset(AttributesLoc::COLOR);
+    CHECK_CONDITION((uint8_t)data[color] == 255);
+    CHECK_CONDITION((uint8_t)data[color + 1] == 0);
+    CHECK_CONDITION((uint8_t)data[color + 3] == 255);
+
+    auto bones = format.GetOffset(AttributesLoc::BONES_ID);
+    CHECK_CONDITION((uint8_t)data[bones + 2] == 7);
+    CHECK_CONDITION((uint8_t)data[bones + 3] == 255);
+
+    auto weights = format.GetOffset(AttributesLoc::BONES_WEIGHT);
+    CHECK_CONDITION((uint8_t)data[weights] == 128);
+}
+
+void Tests() {
+    Test01();
+    Test02();
+    Test03();
+}
@@ -0,0 +1,203 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#include "TextureConverter.h"
+#include "Check.h"
+#include "DDS.h"
+#include "Image.h"
+#include "Log.h"
+#include "Maths.h"
+#include "Resource.h"
+#include "ResourceFile.h"
+#include "image_helper.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifndef MAKEFOURCC
+#define MAKEFOURCC(ch0, ch1, ch2, ch3)                                         \
+    ((unsigned)(ch0) | ((unsigned)(ch1) << 8) | ((unsigned)(ch2) << 16) |      \
+     ((unsigned)(ch3) << 24))
+#endif
+
+namespace NSG {
+TextureConverter::TextureConverter(const Path& path, TextureFormat format,
+                                   CompressQuality quality)
+    : path_(path), format_(format), quality_(quality), width_(0),
+      height_(0) {}
+
+bool TextureConverter::Load() {
+    auto resource =
+        Resource::GetOrCreateClass<ResourceFile>(path_.GetFilePath());
+    CHECK_CONDITION(resource->IsReady());
+    int channels = 0;
+    const unsigned char* pixels = stbi_load_from_memory(
+        (const unsigned char*)resource->GetData(), (int)resource->GetBytes(),
+        &width_, &height_, &channels, 4);
+    if (!pixels) {
+        LOGE("Cannot load %s: %s", path_.GetFilePath().c_str(),
+             stbi_failure_reason());
+        return false;
+    }
+
+    bool opaque = true;
+    for (int i = 0; i < width_ * height_ && opaque; i++)
+        opaque = pixels[4 * i + 3] == 255;
+    if (format_ == TextureFormat::UNKNOWN)
+        format_ = opaque ? TextureFormat::DXT1 : TextureFormat::DXT5;
+    else if (!opaque &&
+             (format_ == TextureFormat::ETC1 || format_ == TextureFormat::DXT1))
+        LOGW("%s: the alpha channel will be lost or reduced to one bit",
+             path_.GetFilePath().c_str());
+
+    // compressed images cannot be resized when they are loaded
+    if (!IsPowerOfTwo(width_) || !IsPowerOfTwo(height_)) {
+        Image::Resize2PowerOf2(pixels, width_, height_, 4);
+        LOGI("%s has been resized to %dx%d", path_.GetFilePath().c_str(),
+             width_, height_);
+    }
+
+    levels_.clear();
+    int width = width_;
+    int height = height_;
+    for (;;) {
+        std::string blocks(GetCompressedImageSize(width, height, format_), 0);
+        CompressImage((unsigned char*)&blocks[0], pixels, width, height,
+                      format_, quality_);
+        levels_.push_back(blocks);
+        if (width == 1 && height == 1)
+            break;
+        int mipWidth = std::max(width / 2, 1);
+        int mipHeight = std::max(height / 2, 1);
+        auto mip = (unsigned char*)malloc(4 * mipWidth * mipHeight);
+        mipmap_image(pixels, width, height, 4, mip, width > 1 ? 2 : 1,
+                     height > 1 ? 2 : 1);
+        free((void*)pixels); // same as stbi_image_free
+        pixels = mip;
+        width = mipWidth;
+        height = mipHeight;
+    }
+    free((void*)pixels);
+    return true;
+}
+
+void TextureConverter::SaveDDS(std::ostream& file) const {
+    const unsigned DDSD_CAPS = 0x1;
+    const unsigned DDSD_HEIGHT = 0x2;
+    const unsigned DDSD_WIDTH = 0x4;
+    const unsigned DDSD_PIXELFORMAT = 0x1000;
+    const unsigned DDSD_MIPMAPCOUNT = 0x20000;
+    const unsigned DDSD_LINEARSIZE = 0x80000;
+    const unsigned DDPF_FOURCC = 0x4;
+    const unsigned DDSCAPS_COMPLEX = 0x8;
+    const unsigned DDSCAPS_TEXTURE = 0x1000;
+    const unsigned DDSCAPS_MIPMAP = 0x400000;
+
+    DDSurfaceDesc2 ddsd;
+    memset(&ddsd, 0, sizeof(ddsd));
+    ddsd.dwSize_ = sizeof(ddsd);
+    ddsd.dwFlags_ = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+                    DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    ddsd.dwHeight_ = height_;
+    ddsd.dwWidth_ = width_;
+    ddsd.dwLinearSize_ = (unsigned)levels_[0].size();
+    ddsd.dwMipMapCount_ = (unsigned)levels_.size();
+    ddsd.ddpfPixelFormat_.dwSize_ = sizeof(DDPixelFormat);
+    ddsd.ddpfPixelFormat_.dwFlags_ = DDPF_FOURCC;
+    switch (format_) {
+    case TextureFormat::DXT1:
+        ddsd.ddpfPixelFormat_.dwFourCC_ = MAKEFOURCC('D', 'X', 'T', '1');
+        break;
+    case TextureFormat::DXT3:
+        ddsd.ddpfPixelFormat_.dwFourCC_ = MAKEFOURCC('D', 'X', 'T', '3');
+        break;
+    default:
+        ddsd.ddpfPixelFormat_.dwFourCC_ = MAKEFOURCC('D', 'X', 'T', '5');
+        break;
+    }
+    ddsd.ddsCaps_.dwCaps_ = DDSCAPS_TEXTURE;
+    if (levels_.size() > 1)
+        ddsd.ddsCaps_.dwCaps_ |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+    file.write("DDS ", 4);
+    file.write((const char*)&ddsd, sizeof(ddsd));
+    for (auto& level : levels_)
+        file.write(level.c_str(), level.size());
+}
+
+void TextureConverter::SaveKTX(std::ostream& file) const {
+    const unsigned char IDENTIFIER[12] = {0xAB, 'K',  'T',  'X',  ' ', '1',
+                                          '1',  0xBB, '\r', '\n', 0x1A, '\n'};
+    const unsigned GL_ETC1_RGB8 = 0x8d64;
+    const unsigned GL_RGB_FORMAT = 0x1907;
+    const unsigned header[] = {
+        0x04030201,               // endianness
+        0,                        // type
+        1,                        // type size
+        0,                        // format
+        GL_ETC1_RGB8,             // internal format
+        GL_RGB_FORMAT,            // base internal format
+        (unsigned)width_,         // width
+        (unsigned)height_,        // height
+        0,                        // depth
+        0,                        // array elements
+        1,                        // faces
+        (unsigned)levels_.size(), // mipmaps
+        0                         // key value bytes
+    };
+    file.write((const char*)IDENTIFIER, sizeof(IDENTIFIER));
+    file.write((const char*)header, sizeof(header));
+    // the blocks keep the levels aligned to four bytes
+    for (auto& level : levels_) {
+        auto size = (unsigned)level.size();
+        file.write((const char*)&size, sizeof(size));
+        file.write(level.c_str(), level.size());
+    }
+}
+
+bool TextureConverter::Save(const Path& outputDir) const {
+    Path outputFile(outputDir);
+    outputFile.SetName(path_.GetName());
+    outputFile.SetExtension(format_ == TextureFormat::ETC1 ? "ktx" : "dds");
+    std::ofstream file(outputFile.GetFullAbsoluteFilePath().c_str(),
+                       std::ios::binary);
+    if (format_ == TextureFormat::ETC1)
+        SaveKTX(file);
+    else
+        SaveDDS(file);
+    if (!file.good()) {
+        LOGE("Cannot write %s", outputFile.GetFilePath().c_str());
+        return false;
+    }
+    size_t bytes = 0;
+    for (auto& level : levels_)
+        bytes += level.size();
+    LOGI("%s: %dx%d, %d mip levels, %d bytes (%d uncompressed)",
+         outputFile.GetFilePath().c_str(), width_, height_,
+         (int)levels_.size(), (int)bytes, 4 * width_ * height_ * 4 / 3);
+    return true;
+}
+}
@@ -0,0 +1,55 @@
+/*
+-------------------------------------------------------------------------------
+This file is part of nsg-library.
+http://github.com/woodjazz/nsg-library
+
+Copyright (c) 2014-2017 Néstor Silveira Gorski
+
+-------------------------------------------------------------------------------
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+claim that you wrote the original software. If you use this software
+in a product, an acknowledgment in the product documentation would be
+appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------
+*/
+#pragma once
+#include "Compress.h"
+#include "Path.h"
+#include "Types.h"
+#include <iosfwd>
+#include <string>
+#include <vector>
+namespace NSG {
+// Compresses an image (png, jpg, tga, ...) with all its mip levels to DDS
+// (DXT1, DXT3, DXT5) or KTX (ETC1), the files that Image loads without
+// decoding. With TextureFormat::UNKNOWN the format is DXT1 for opaque images
+// and DXT5 otherwise.
+class TextureConverter {
+public:
+    TextureConverter(const Path& path, TextureFormat format,
+                     CompressQuality quality);
+    bool Load();
+    bool Save(const Path& outputDir) const;
+
+private:
+    void SaveDDS(std::ostream& file) const;
+    void SaveKTX(std::ostream& file) const;
+    Path path_;
+    TextureFormat format_;
+    CompressQuality quality_;
+    int width_;
+    int height_;
+    std::vector<std::string> levels_; // blocks of each mip level
+};
+}
@@ -24,9 +24,11 @@ misrepresented as being the original software.
 -------------------------------------------------------------------------------
 */
 #include "NSG.h"
+#include "TextureConverter.h"
 #include "TrueTypeConverter.h"
 #include "tclap/CmdLine.h"
 #include <cstdint>
+#include <cstdio>
 #include <fstream>
 using namespace NSG;
 class IFileConstraint : public TCLAP::Constraint<std::string> {
@@ -112,6 +114,185 @@ public:
     bool check(const int& ch) const { return ch > 31; }
 };
 
+// Moves the meshes of a scene file to binary .nsgmesh files (see MeshFormat.h)
+// and saves the scene referencing them in the output directory.
+// The meshes can be optimized for the GPU caches (see Mesh::Optimize)
+static bool ConvertMeshes(const Path& inputFile, const Path& outputDir,
+                          bool compress, bool optimize, bool overdraw) {
+    pugi::xml_document doc;
+    auto result = doc.load_file(inputFile.GetFullAbsoluteFilePath().c_str());
+    if (!result) {
+        LOGE("Cannot load %s: %s", inputFile.GetFilePath().c_str(),
+             result.description());
+        return false;
+    }
+
+    auto meshesNode = doc.child("App").child("Meshes");
+    if (!meshesNode) {
+        LOGE("%s has no meshes", inputFile.GetFilePath().c_str());
+        return false;
+    }
+
+    Path meshPath;
+    meshPath.SetPath(outputDir.GetPath());
+
+    std::vector<PModelMesh> meshes;
+    for (auto child = meshesNode.first_child(); child;
+         child = child.next_sibling()) {
+        auto mesh =
+            std::make_shared<ModelMesh>(child.attribute("name").as_string());
+        mesh->Load(child);
+        if (optimize)
+            mesh->Optimize(overdraw);
+        meshes.push_back(mesh);
+    }
+
+    auto appNode = doc.child("App");
+    auto newMeshesNode = appNode.insert_child_after("Meshes", meshesNode);
+    appNode.remove_child(meshesNode);
+    for (auto& mesh : meshes)
+        mesh->SaveExternal(newMeshesNode, meshPath, outputDir);
+
+    Path outputFile;
+    outputFile.SetPath(outputDir.GetPath());
+    outputFile.SetFileName(inputFile.GetFilename());
+    return FileSystem::SaveDocument(outputFile, doc, compress);
+}
+
+// Maximum error of the joints of a compressed clip, sampling both clips at the
+// times of the original key frames and between them. The errors only grow.
+static void MeasureError(PAnimation original, PAnimation compressed,
+                         float& positionError, float& rotationError,
+                         float& scaleError) {
+    auto length = original->GetLength();
+    auto& tracks = original->GetTracks();
+    for (size_t i = 0; i < tracks.size(); i++) {
+        auto& track = tracks[i];
+        auto& keyFrames = track.keyFrames_;
+        size_t cursor0 = 0, cursor1 = 0;
+        for (size_t k = 0; k < keyFrames.size(); k++) {
+            auto time = keyFrames[k].time_;
+            auto next = k + 1 < keyFrames.size() ? keyFrames[k + 1].time_
+                                                  : time;
+            for (auto t : {time, (time + next) * 0.5f}) {
+                Vector3 position0, position1, scale0, scale1;
+                Quaternion rotation0, rotation1;
+                track.Sample(t, length, false, cursor0, position0, rotation0,
+                             scale0);
+                compressed->GetTracks()[i].Sample(t, length, false, cursor1,
+                                                  position1, rotation1,
+                                                  scale1);
+                auto mask = track.channelMask_;
+                if (mask & (int)AnimationChannel::POSITION)
+                    positionError = std::max(positionError,
+                                             position0.Distance(position1));
+                if (mask & (int)AnimationChannel::ROTATION)
+                    rotationError = std::max(rotationError,
+                                             rotation0.Angle(rotation1));
+                if (mask & (int)AnimationChannel::SCALE)
+                    scaleError = std::max(scaleError, scale0.Distance(scale1));
+            }
+        }
+    }
+}
+
+// Compresses the animations of a scene file (see Animation::Compress),
+// reports the compression ratio and the maximum joint error of each clip, as
+// it is and resolved for every skeleton of the scene, and saves the scene with
+// them in the output directory
+static bool ConvertAnimations(const Path& inputFile, const Path& outputDir,
+                              bool compress) {
+    pugi::xml_document doc;
+    auto result = doc.load_file(inputFile.GetFullAbsoluteFilePath().c_str());
+    if (!result) {
+        LOGE("Cannot load %s: %s", inputFile.GetFilePath().c_str(),
+             result.description());
+        return false;
+    }
+
+    auto appNode = doc.child("App");
+    auto animationsNode = appNode.child("Animations");
+    if (!animationsNode) {
+        LOGE("%s has no animations", inputFile.GetFilePath().c_str());
+        return false;
+    }
+
+    std::vector<PSkeleton> skeletons;
+    for (auto child = appNode.child("Skeletons").child("Skeleton"); child;
+         child = child.next_sibling("Skeleton")) {
+        auto skeleton =
+            std::make_shared<Skeleton>(child.attribute("name").as_string());
+        skeleton->Load(child);
+        skeletons.push_back(skeleton);
+    }
+
+    auto newAnimationsNode =
+        appNode.insert_child_after("Animations", animationsNode);
+    AnimationCompression settings;
+    for (auto child = animationsNode.child("Animation"); child;
+         child = child.next_sibling("Animation")) {
+        auto original =
+            std::make_shared<Animation>(child.attribute("name").as_string());
+        original->Load(child);
+        auto compressed = original->Clone();
+        compressed->Compress(settings);
+        float positionError = 0, rotationError = 0, scaleError = 0;
+        MeasureError(original, compressed, positionError, rotationError,
+                     scaleError);
+        for (auto& skeleton : skeletons)
+            MeasureError(original->GetResolvedFor(skeleton),
+                         compressed->GetResolvedFor(skeleton), positionError,
+                         rotationError, scaleError);
+        auto size = compressed->GetSize();
+        printf("%s: %u -> %u bytes (%.1f:1), max joint error: position %g, "
+               "rotation %g degrees, scale %g\n",
+               original->GetName().c_str(), (unsigned)original->GetSize(),
+               (unsigned)size, size ? (float)original->GetSize() / size : 0.f,
+               positionError, Degrees(rotationError), scaleError);
+        compressed->Save(newAnimationsNode);
+    }
+    appNode.remove_child(animationsNode);
+
+    Path outputFile;
+    outputFile.SetPath(outputDir.GetPath());
+    outputFile.SetFileName(inputFile.GetFilename());
+    return FileSystem::SaveDocument(outputFile, doc, compress);
+}
+
+static bool IsImage(const Path& inputFile) {
+    static const char* EXTENSIONS[] = {"png", "jpg", "jpeg", "tga",
+                                       "bmp", "psd", "gif"};
+    auto extension = Path::GetLowercaseFileExtension(inputFile.GetFilename());
+    for (auto ext : EXTENSIONS)
+        if (extension == ext)
+            return true;
+    return false;
+}
+
+// Compresses an image with its mip levels (see TextureConverter). The blocks
+// of each level are encoded in parallel by the job system.
+static bool ConvertTexture(const Path& inputFile, const Path& outputDir,
+                           const std::string& format,
+                           const std::string& quality) {
+    auto textureFormat = TextureFormat::UNKNOWN;
+    if (format == "dxt1")
+        textureFormat = TextureFormat::DXT1;
+    else if (format == "dxt3")
+        textureFormat = TextureFormat::DXT3;
+    else if (format == "dxt5")
+        textureFormat = TextureFormat::DXT5;
+    else if (format == "etc1")
+        textureFormat = TextureFormat::ETC1;
+    auto compressQuality = CompressQuality::NORMAL;
+    if (quality == "fast")
+        compressQuality = CompressQuality::FAST;
+    else if (quality == "high")
+        compressQuality = CompressQuality::HIGH;
+    auto jobs = Task::JobSystem::Create();
+    TextureConverter obj(inputFile, textureFormat, compressQuality);
+    return obj.Load() && obj.Save(outputDir);
+}
+
 int NSG_MAIN(int argc, char* argv[]) {
     using namespace NSG;
 
@@ -154,6 +335,35 @@ int NSG_MAIN(int argc, char* argv[]) {
 
         TCLAP::SwitchArg zArg("z", "compress", "Compress the file.", false);
 
+        TCLAP::SwitchArg pArg("p", "optimize",
+                              "Optimize the meshes for the vertex cache.",
+                              false);
+        TCLAP::SwitchArg dArg(
+            "d", "overdraw",
+            "Also reorder the triangles to reduce overdraw (needs -p).", false);
+
+        TCLAP::SwitchArg aArg("a", "animations",
+                              "Compress the animations of the scene file "
+                              "(instead of its meshes) and report the "
+                              "compression ratio and the error of each clip.",
+                              false);
+
+        std::vector<std::string> formats = {"auto", "dxt1", "dxt3", "dxt5",
+                                            "etc1"};
+        TCLAP::ValuesConstraint<std::string> formatConstraint(formats);
+        TCLAP::ValueArg<std::string> tArg(
+            "t", "texture",
+            "Compressed format of the images. By default is auto (DXT1 for "
+            "opaque images, DXT5 otherwise).",
+            false, "auto", &formatConstraint);
+
+        std::vector<std::string> qualities = {"fast", "normal", "high"};
+        TCLAP::ValuesConstraint<std::string> qualityConstraint(qualities);
+        TCLAP::ValueArg<std::string> qArg(
+            "q", "quality",
+            "Quality of the image compression. By default is normal.", false,
+            "normal", &qualityConstraint);
+
         cmd.add(iArg);
         cmd.add(oArg);
         cmd.add(wArg);
@@ -162,6 +372,11 @@ int NSG_MAIN(int argc, char* argv[]) {
         cmd.add(sArg);
         cmd.add(eArg);
         cmd.add(zArg);
+        cmd.add(pArg);
+        cmd.add(dArg);
+        cmd.add(aArg);
+        cmd.add(tArg);
+        cmd.add(qArg);
 
         cmd.parse(argc, argv);
 
@@ -183,6 +398,20 @@ int NSG_MAIN(int argc, char* argv[]) {
                                       bitmapWidth, bitmapHeight);
                 obj.Load();
                 CHECK_CONDITION(obj.Save(outputDir, zArg.getValue()));
+            } else if (Path::GetLowercaseFileExtension(
+                           inputFile.GetFilename()) == "xml") {
+                if (aArg.getValue()) {
+                    CHECK_CONDITION(ConvertAnimations(inputFile, outputDir,
+                                                      zArg.getValue()));
+                } else {
+                    CHECK_CONDITION(ConvertMeshes(
+                        inputFile, outputDir, zArg.getValue(), pArg.getValue(),
+                        dArg.getValue()));
+                }
+            } else if (IsImage(inputFile)) {
+                CHECK_CONDITION(ConvertTexture(inputFile, outputDir,
+                                               tArg.getValue(),
+                                               qArg.getValue()));
             } else {
                 LOGE("Cannot convert file. Unknown file extension");
                 return -1;